@@ -17,9 +17,11 @@
 #include "Pipeline/ShaderCore.hpp"
 #include "Reactor/Reactor.hpp"
 #include "System/Memory.hpp"
+#include "System/ThreadPool.hpp"
 #include "Vulkan/VkDebug.hpp"
 #include "Vulkan/VkImage.hpp"
 
+#include <algorithm>
 #include <utility>
 
 namespace sw
@@ -27,11 +29,13 @@ namespace sw
 	Blitter::Blitter()
 	{
 		blitCache = new RoutineCache<State>(1024);
+		resolveCache = new RoutineCache<State>(64);
 	}
 
 	Blitter::~Blitter()
 	{
 		delete blitCache;
+		delete resolveCache;
 	}
 
 	void Blitter::clear(void *pixel, vk::Format format, vk::Image *dest, const VkImageSubresourceRange& subresourceRange, const VkRect2D* renderArea)
@@ -48,6 +52,7 @@ namespace sw
 		}
 
 		State state(format, dest->getFormat(aspect), dest->getSampleCountFlagBits(), { 0xF });
+		state.destQuadLayout = dest->hasQuadLayout(aspect);
 		Routine *blitRoutine = getRoutine(state);
 		if(!blitRoutine)
 		{
@@ -1304,8 +1309,8 @@ namespace sw
 			bool intSrc = state.sourceFormat.isNonNormalizedInteger();
 			bool intDst = state.destFormat.isNonNormalizedInteger();
 			bool intBoth = intSrc && intDst;
-			bool srcQuadLayout = state.sourceFormat.hasQuadLayout();
-			bool dstQuadLayout = state.destFormat.hasQuadLayout();
+			bool srcQuadLayout = state.sourceQuadLayout;
+			bool dstQuadLayout = state.destQuadLayout;
 			int srcBytes = state.sourceFormat.bytes();
 			int dstBytes = state.destFormat.bytes();
 
@@ -1350,9 +1355,14 @@ namespace sw
 
 					if(hasConstantColorI)
 					{
-						if(!write(constantColorI, d, state))
+						for(int s = 0; s < state.destSamples; s++)
 						{
-							return nullptr;
+							if(!write(constantColorI, d, state))
+							{
+								return nullptr;
+							}
+
+							d += *Pointer<Int>(blit + OFFSET(BlitData, dSliceB));
 						}
 					}
 					else if(hasConstantColorF)
@@ -1486,6 +1496,162 @@ namespace sw
 		return function("BlitRoutine");
 	}
 
+	Routine *Blitter::generateResolve(const State &state)
+	{
+		Function<Void(Pointer<Byte>)> function;
+		{
+			Pointer<Byte> resolve(function.Arg<0>());
+
+			Pointer<Byte> source = *Pointer<Pointer<Byte>>(resolve + OFFSET(ResolveData,source));
+			Pointer<Byte> dest = *Pointer<Pointer<Byte>>(resolve + OFFSET(ResolveData,dest));
+			Int sPitchB = *Pointer<Int>(resolve + OFFSET(ResolveData,sPitchB));
+			Int sSliceB = *Pointer<Int>(resolve + OFFSET(ResolveData,sSliceB));
+			Int dPitchB = *Pointer<Int>(resolve + OFFSET(ResolveData,dPitchB));
+			Int width = *Pointer<Int>(resolve + OFFSET(ResolveData,width));
+			Int height = *Pointer<Int>(resolve + OFFSET(ResolveData,height));
+
+			const int samples = state.sourceSamples;
+			const int bytes = state.destFormat.bytes();
+			const bool intFormat = state.sourceFormat.isNonNormalizedInteger();
+			const bool sRGB = state.sourceFormat.isSRGBformat();
+
+			// The channels of these formats are averaged as bytes, independently of their
+			// order, so each iteration of the vector loop resolves several pixels at once.
+			bool averageBytes = false;
+			switch(state.destFormat)
+			{
+			case VK_FORMAT_R8_UNORM:
+			case VK_FORMAT_R8G8_UNORM:
+			case VK_FORMAT_R8G8B8A8_UNORM:
+			case VK_FORMAT_B8G8R8A8_UNORM:
+			case VK_FORMAT_A8B8G8R8_UNORM_PACK32:
+				averageBytes = true;
+				break;
+			default:
+				break;
+			}
+
+			int shift = 0;   // Sample counts are powers of two
+			while((1 << shift) < samples)
+			{
+				shift++;
+			}
+
+			float4 scale;
+			if(sRGB && !state.sourceFormat.getScale(scale))
+			{
+				return nullptr;
+			}
+
+			For(Int y = 0, y < height, y++)
+			{
+				Pointer<Byte> s = source + y * sPitchB;
+				Pointer<Byte> d = dest + y * dPitchB;
+				Int x = 0;
+
+				if(averageBytes)
+				{
+					const int pixels = 8 / bytes;
+
+					While(x <= width - pixels)
+					{
+						Short4 low = Short4(0);
+						Short4 high = Short4(0);
+
+						Pointer<Byte> sample = s;
+						for(int i = 0; i < samples; i++)
+						{
+							Byte8 c = *Pointer<Byte8>(sample);
+							low += UnpackLow(c, Byte8(0, 0, 0, 0, 0, 0, 0, 0));
+							high += UnpackHigh(c, Byte8(0, 0, 0, 0, 0, 0, 0, 0));
+
+							sample += sSliceB;
+						}
+
+						// Round to nearest
+						low = (low + Short4(static_cast<short>(samples / 2))) >> shift;
+						high = (high + Short4(static_cast<short>(samples / 2))) >> shift;
+
+						*Pointer<Byte8>(d) = PackUnsigned(low, high);
+
+						s += 8;
+						d += 8;
+						x += pixels;
+					}
+				}
+
+				// Remaining pixels, or all of them for formats without a vector path
+				While(x < width)
+				{
+					if(intFormat)
+					{
+						// Integer samples can't be averaged, so the first one is used
+						Int4 color;
+
+						if(!read(color, s, state))
+						{
+							return nullptr;
+						}
+
+						if(!write(color, d, state))
+						{
+							return nullptr;
+						}
+					}
+					else
+					{
+						Float4 color = Float4(0.0f);
+
+						Pointer<Byte> sample = s;
+						for(int i = 0; i < samples; i++)
+						{
+							Float4 c;
+
+							if(!read(c, sample, state))
+							{
+								return nullptr;
+							}
+
+							if(sRGB)   // Average linear values
+							{
+								c *= Float4(1.0f / scale.x, 1.0f / scale.y, 1.0f / scale.z, 1.0f / scale.w);
+								c = sRGBtoLinear(c);
+							}
+
+							color += c;
+							sample += sSliceB;
+						}
+
+						color *= Float4(1.0f / samples);
+
+						if(averageBytes)
+						{
+							// Round halfway cases up like the vector loop, so all pixels match
+							color = Floor(color + Float4(0.5f));
+						}
+
+						if(sRGB)
+						{
+							color = LinearToSRGB(color);
+							color *= Float4(scale.x, scale.y, scale.z, scale.w);
+						}
+
+						if(!write(color, d, state))
+						{
+							return nullptr;
+						}
+					}
+
+					s += bytes;
+					d += bytes;
+					x++;
+				}
+			}
+		}
+
+		return function("ResolveRoutine");
+	}
+
 	Routine *Blitter::getRoutine(const State &state)
 	{
 		criticalSection.lock();
@@ -1510,6 +1676,30 @@ namespace sw
 		return blitRoutine;
 	}
 
+	Routine *Blitter::getResolveRoutine(const State &state)
+	{
+		criticalSection.lock();
+		Routine *resolveRoutine = resolveCache->query(state);
+
+		if(!resolveRoutine)
+		{
+			resolveRoutine = generateResolve(state);
+
+			if(!resolveRoutine)
+			{
+				criticalSection.unlock();
+				UNIMPLEMENTED("resolveRoutine");
+				return nullptr;
+			}
+
+			resolveCache->add(state, resolveRoutine);
+		}
+
+		criticalSection.unlock();
+
+		return resolveRoutine;
+	}
+
 	void Blitter::blit(vk::Image *src, vk::Image *dst, VkImageBlit region, VkFilter filter)
 	{
 		if(dst->getFormat() == VK_FORMAT_UNDEFINED)
@@ -1549,6 +1739,8 @@ namespace sw
 		                    (region.srcOffsets[0].y < 0) ||
 		                    (static_cast<uint32_t>(region.srcOffsets[1].x) > srcExtent.width) ||
 		                    (static_cast<uint32_t>(region.srcOffsets[1].y) > srcExtent.height);
+		state.sourceQuadLayout = src->hasQuadLayout(srcAspect);
+		state.destQuadLayout = dst->hasQuadLayout(dstAspect);
 
 		Routine *blitRoutine = getRoutine(state);
 		if(!blitRoutine)
@@ -1628,4 +1820,67 @@ namespace sw
 			}
 		}
 	}
+
+	void Blitter::resolve(vk::Image *src, vk::Image *dst, VkImageResolve region, ThreadPool &pool)
+	{
+		if((region.srcSubresource.aspectMask != VK_IMAGE_ASPECT_COLOR_BIT) ||
+		   (region.dstSubresource.aspectMask != VK_IMAGE_ASPECT_COLOR_BIT) ||
+		   (region.srcSubresource.layerCount != region.dstSubresource.layerCount))
+		{
+			UNIMPLEMENTED("region");
+		}
+
+		ASSERT(src->getFormat() == dst->getFormat());
+		ASSERT(dst->getSampleCountFlagBits() == VK_SAMPLE_COUNT_1_BIT);
+		ASSERT(region.extent.depth == 1);   // Multisample images are 2D
+
+		State state(src->getFormat(), dst->getFormat(), 1, { false, false, false });
+		state.sourceSamples = src->getSampleCountFlagBits();
+
+		Routine *resolveRoutine = getResolveRoutine(state);
+		if(!resolveRoutine)
+		{
+			return;
+		}
+
+		void(*resolveFunction)(const ResolveData *data) = (void(*)(const ResolveData*))resolveRoutine->getEntry();
+
+		ResolveData data;
+
+		data.sPitchB = src->rowPitchBytes(VK_IMAGE_ASPECT_COLOR_BIT, region.srcSubresource.mipLevel);
+		data.sSliceB = src->slicePitchBytes(VK_IMAGE_ASPECT_COLOR_BIT, region.srcSubresource.mipLevel);
+		data.dPitchB = dst->rowPitchBytes(VK_IMAGE_ASPECT_COLOR_BIT, region.dstSubresource.mipLevel);
+		data.width = region.extent.width;
+		data.height = region.extent.height;
+
+		// Rows are resolved in parallel once there are enough samples to make up for
+		// waking the other threads. Tasks outnumber threads to balance the load.
+		const size_t minParallelBytes = 256 * 1024;
+		size_t sourceBytes = static_cast<size_t>(data.width) * data.height * state.sourceSamples * src->getFormat().bytes();
+		int tasks = (sourceBytes < minParallelBytes) ? 1 : std::min(data.height, 4 * pool.getThreadCount());
+
+		VkImageSubresourceLayers srcSubresLayers = region.srcSubresource;
+		VkImageSubresourceLayers dstSubresLayers = region.dstSubresource;
+		srcSubresLayers.layerCount = 1;
+		dstSubresLayers.layerCount = 1;
+
+		for(uint32_t i = 0; i < region.srcSubresource.layerCount; i++, srcSubresLayers.baseArrayLayer++, dstSubresLayers.baseArrayLayer++)
+		{
+			uint8_t *source = static_cast<uint8_t*>(src->getTexelPointer(region.srcOffset, srcSubresLayers));
+			uint8_t *dest = static_cast<uint8_t*>(dst->getTexelPointer(region.dstOffset, dstSubresLayers));
+
+			pool.parallelFor(tasks, [&](int task)
+			{
+				int begin = data.height * task / tasks;
+				int end = data.height * (task + 1) / tasks;
+
+				ResolveData rows = data;
+				rows.source = source + begin * data.sPitchB;
+				rows.dest = dest + begin * data.dPitchB;
+				rows.height = end - begin;
+
+				resolveFunction(&rows);
+			});
+		}
+	}
 }
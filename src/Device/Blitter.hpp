@@ -29,6 +29,8 @@ namespace vk
 
 namespace sw
 {
+	class ThreadPool;
+
 	class Blitter
 	{
 		struct Options
@@ -71,8 +73,11 @@ namespace sw
 				return memcmp(this, &state, sizeof(State)) == 0;
 			}
 
+			bool sourceQuadLayout = false;   // Texels of each 2x2 quad are stored contiguously
+			bool destQuadLayout = false;
 			vk::Format sourceFormat = VK_FORMAT_UNDEFINED;
 			vk::Format destFormat = VK_FORMAT_UNDEFINED;
+			int sourceSamples = 1;   // Only used by resolves
 			int destSamples = 0;
 		};
 
@@ -98,6 +103,18 @@ namespace sw
 			int sHeight;
 		};
 
+		struct ResolveData
+		{
+			void *source;
+			void *dest;
+			int sPitchB;
+			int sSliceB;   // Distance between the samples of a pixel
+			int dPitchB;
+
+			int width;
+			int height;
+		};
+
 	public:
 		Blitter();
 		virtual ~Blitter();
@@ -105,6 +122,7 @@ namespace sw
 		void clear(void *pixel, vk::Format format, vk::Image *dest, const VkImageSubresourceRange& subresourceRange, const VkRect2D* renderArea = nullptr);
 
 		void blit(vk::Image *src, vk::Image *dst, VkImageBlit region, VkFilter filter);
+		void resolve(vk::Image *src, vk::Image *dst, VkImageResolve region, ThreadPool &pool);
 
 	private:
 		bool fastClear(void *pixel, vk::Format format, vk::Image *dest, const VkImageSubresourceRange& subresourceRange, const VkRect2D* renderArea);
@@ -119,8 +137,11 @@ namespace sw
 		static Float4 sRGBtoLinear(Float4 &color);
 		Routine *getRoutine(const State &state);
 		Routine *generate(const State &state);
+		Routine *getResolveRoutine(const State &state);
+		Routine *generateResolve(const State &state);
 
 		RoutineCache<State> *blitCache;
+		RoutineCache<State> *resolveCache;
 		MutexLock criticalSection;
 	};
 }
@@ -75,7 +75,6 @@ namespace sw
 
 	enum
 	{
-		OUTLINE_RESOLUTION = 8192,   // Maximum vertical resolution of the render target
 		MIPMAP_LEVELS = 14,
 		TEXTURE_IMAGE_UNITS = 16,
 		VERTEX_TEXTURE_IMAGE_UNITS = 16,
@@ -98,6 +97,7 @@ namespace sw
 		RENDERTARGETS = 8,
 		NUM_TEMPORARY_REGISTERS = 4096,
 		MAX_INTERFACE_COMPONENTS = 32 * 4,
+		MAX_THREAD_COUNT = 128,   // Rendering threads, each of which has its own pixel cluster
 	};
 }
 
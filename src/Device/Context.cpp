@@ -210,6 +210,7 @@ namespace sw
 		instanceID = 0;
 
 		occlusionEnabled = false;
+		statisticsEnabled = false;
 
 		lineWidth = 1.0f;
 
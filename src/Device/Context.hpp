@@ -199,9 +199,10 @@ namespace sw
 		const SpirvShader *vertexShader;
 
 		// Instancing
-		int instanceID;
+		int instanceID;   // Of the first instance drawn
 
 		bool occlusionEnabled;
+		bool statisticsEnabled;   // Pipeline statistics are being gathered
 
 		// Pixel processor states
 		bool rasterizerDiscard;
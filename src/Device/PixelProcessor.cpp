@@ -29,6 +29,13 @@ namespace sw
 
 	bool precachePixel = false;
 
+	static void canonicalizeStencilValues(VkStencilOpState &stencil)
+	{
+		stencil.compareMask = (stencil.compareMask == 0xFF) ? 0xFF : 0;
+		stencil.writeMask = (stencil.writeMask != 0) ? 0xFF : 0;
+		stencil.reference = 0;
+	}
+
 	unsigned int PixelProcessor::States::computeHash()
 	{
 		unsigned int *state = (unsigned int*)this;
@@ -295,17 +302,24 @@ namespace sw
 			state.twoSidedStencil = context->twoSidedStencil;
 			state.frontStencil = context->frontStencil;
 			state.backStencil = context->backStencil;
+
+			// The routine reads the reference and masks from DrawData, and only
+			// specializes on whether masking is needed, so that changing these
+			// dynamic states does not require a new routine.
+			canonicalizeStencilValues(state.frontStencil);
+			canonicalizeStencilValues(state.backStencil);
 		}
 
 		if(context->depthBufferActive())
 		{
 			state.depthTestActive = true;
 			state.depthCompareMode = context->depthCompareMode;
-			state.quadLayoutDepthBuffer = context->depthBuffer->getFormat().hasQuadLayout();
+			state.quadLayoutDepthBuffer = context->depthBuffer->getImage()->hasQuadLayout(VK_IMAGE_ASPECT_DEPTH_BIT);
 			state.depthFormat = context->depthBuffer->getFormat();
 		}
 
 		state.occlusionEnabled = context->occlusionEnabled;
+		state.statisticsEnabled = context->statisticsEnabled;
 
 		state.perspective = context->perspectiveActive();
 		state.depthClamp = (context->depthBias != 0.0f) || (context->slopeDepthBias != 0.0f);
@@ -330,6 +344,7 @@ namespace sw
 		state.writeSRGB	= context->writeSRGB && context->renderTarget[0] && context->renderTarget[0]->getFormat().isSRGBwritable();
 		state.multiSample = context->sampleCount;
 		state.multiSampleMask = context->multiSampleMask;
+		state.unrolledEdges = Primitive::unrolledEdges(context->isDrawTriangle());
 
 		if(state.multiSample > 1 && context->pixelShader)
 		{
@@ -45,6 +45,7 @@ namespace sw
 
 			bool depthTestActive;
 			bool occlusionEnabled;
+			bool statisticsEnabled;
 			bool perspective;
 			bool depthClamp;
 
@@ -61,6 +62,7 @@ namespace sw
 			bool writeSRGB;
 			unsigned int multiSample;
 			unsigned int multiSampleMask;
+			int unrolledEdges;   // Primitive::unrolledEdges()
 			TransparencyAntialiasing transparencyAntialiasing;
 			bool centroid;
 			bool frontFaceCCW;
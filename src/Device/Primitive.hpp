@@ -20,11 +20,22 @@
 
 namespace sw
 {
+	// Vertices are Vertex::stride() bytes apart, as determined by the draw's vertex shader.
+	// The struct reserves room for the largest vertices, so batches can be allocated with it.
 	struct Triangle
 	{
-		Vertex v0;
-		Vertex v1;
-		Vertex v2;
+		Vertex &vertex(int i, int stride)
+		{
+			return *reinterpret_cast<Vertex*>(reinterpret_cast<char*>(this) + i * stride);
+		}
+
+		Triangle *next(int stride)
+		{
+			return reinterpret_cast<Triangle*>(reinterpret_cast<char*>(this) + 3 * stride);
+		}
+
+	private:
+		Vertex v[3];
 	};
 
 	struct PlaneEquation   // z = A * x + B * y + C
@@ -38,6 +49,8 @@ namespace sw
 	{
 		int yMin;
 		int yMax;
+		int xMin;   // Conservative horizontal range, the origin of the edge equations
+		int xMax;
 
 		float4 xQuad;
 		float4 yQuad;
@@ -56,17 +69,29 @@ namespace sw
 		int64_t clockwiseMask;
 		int64_t invClockwiseMask;
 
-		struct Span
+		// Pixel (x, y) is covered when A * (x - xMin) + B * (y - yMin) + C > 0 for all edges, and it's inside
+		// the scissor rectangle. Edges are exact in the fixed-point subpixel grid, and follow the top-left rule.
+		struct Edge
 		{
-			unsigned short left;
-			unsigned short right;
+			int A;
+			int B;
+			int C;
 		};
 
-		// The rasterizer adds a zero length span to the top and bottom of the polygon to allow
-		// for 2x2 pixel processing. We need an even number of spans to keep accesses aligned.
-		Span outlineUnderflow[2];
-		Span outline[OUTLINE_RESOLUTION];
-		Span outlineOverflow[2];
+		enum
+		{
+			MAX_EDGES = 16   // Clipped polygon's edges
+		};
+
+		// Setup pads the edges of unclipped primitives to this many, which the rasterizer
+		// evaluates without looping. Only clipped polygons have more edges.
+		static int unrolledEdges(bool triangle)
+		{
+			return triangle ? 3 : 4;
+		}
+
+		int edgeCount;
+		Edge edge[MAX_EDGES];
 	};
 }
 
@@ -47,21 +47,73 @@ namespace sw
 
 		constants = *Pointer<Pointer<Byte>>(data + OFFSET(DrawData,constants));
 		occlusion = 0;
+		fragments = 0;
 		int clusterCount = Renderer::getClusterCount();
+		int tileSize = Renderer::getTileSize();
+
+		int tileShift = 0;
+		while((1 << tileShift) < tileSize)
+		{
+			tileShift++;
+		}
+
+		// Offset between the owners of vertically adjacent tiles. Tile (x, y) belongs to cluster
+		// (x + y * tileRowOffset) % clusterCount, so each cluster's tiles are spread out diagonally.
+		int tileRowOffset = std::max(1, static_cast<int>(sqrt(static_cast<float>(clusterCount))));
 
 		Do
 		{
 			Int yMin = *Pointer<Int>(primitive + OFFSET(Primitive,yMin));
 			Int yMax = *Pointer<Int>(primitive + OFFSET(Primitive,yMax));
+			Int xMin = *Pointer<Int>(primitive + OFFSET(Primitive,xMin));
+			Int xMax = *Pointer<Int>(primitive + OFFSET(Primitive,xMax));
 
-			Int cluster2 = cluster + cluster;
-			yMin += clusterCount * 2 - 2 - cluster2;
-			yMin &= -clusterCount * 2;
-			yMin += cluster2;
+			if(tileSize == 0)   // Clusters own interleaved pairs of rows
+			{
+				// Start at the first pair of rows belonging to this cluster
+				Int cluster2 = cluster + cluster;
+				yMin += clusterCount * 2 - 2 - cluster2;
 
-			If(yMin < yMax)
+				if(isPow2(clusterCount))
+				{
+					yMin &= -clusterCount * 2;
+				}
+				else
+				{
+					yMin = (yMin / (clusterCount * 2)) * (clusterCount * 2);
+				}
+
+				yMin += cluster2;
+
+				If(yMin < yMax)
+				{
+					rasterize(yMin, yMax, xMin, xMax);
+				}
+			}
+			else   // Clusters own tiles, and only visit those overlapping the primitive's bounds
 			{
-				rasterize(yMin, yMax);
+				If(yMin < yMax && xMin < xMax)
+				{
+					Int tileXMin = xMin >> tileShift;
+					Int tileXMax = (xMax - 1) >> tileShift;
+					Int tileYMax = (yMax - 1) >> tileShift;
+
+					For(Int tileY = yMin >> tileShift, tileY <= tileYMax, tileY++)
+					{
+						Int owner = (tileXMin + tileY * tileRowOffset) % clusterCount;   // Of the row's first tile
+						Int tileX = tileXMin + (cluster - owner + clusterCount) % clusterCount;
+
+						For(, tileX <= tileXMax, tileX += clusterCount)
+						{
+							Int y0 = Max(yMin & Int(-2), tileY << tileShift);
+							Int y1 = Min(yMax, (tileY + 1) << tileShift);
+							Int x0 = Max(xMin, tileX << tileShift);
+							Int x1 = Min(xMax, (tileX << tileShift) + tileSize);
+
+							rasterize(y0, y1, x0, x1);
+						}
+					}
+				}
 			}
 
 			primitive += sizeof(Primitive) * state.multiSample;
@@ -76,6 +128,13 @@ namespace sw
 			*Pointer<UInt>(data + OFFSET(DrawData,occlusion) + 4 * cluster) = clusterOcclusion;
 		}
 
+		if(state.statisticsEnabled)
+		{
+			UInt clusterFragments = *Pointer<UInt>(data + OFFSET(DrawData,fragments) + 4 * cluster);
+			clusterFragments += fragments;
+			*Pointer<UInt>(data + OFFSET(DrawData,fragments) + 4 * cluster) = clusterFragments;
+		}
+
 		#if PERF_PROFILE
 			cycles[PERF_PIXEL] = Ticks() - pixelTime;
 
@@ -88,8 +147,33 @@ namespace sw
 		Return();
 	}
 
-	void QuadRasterizer::rasterize(Int &yMin, Int &yMax)
+	void QuadRasterizer::rasterize(Int &yMin, Int &yMax, Int &xMin, Int &xMax)
 	{
+		int tileSize = Renderer::getTileSize();
+
+		// Origin of the edge equations
+		Int originX = *Pointer<Int>(primitive + OFFSET(Primitive,xMin));
+		Int originY = *Pointer<Int>(primitive + OFFSET(Primitive,yMin));
+
+		// The first edges are kept in registers, and evaluated by unrolled code. Only clipped
+		// polygons have more edges, which are evaluated from the primitive at each quad.
+		const int unrolledEdges = state.unrolledEdges;
+		ASSERT(unrolledEdges <= 4);
+
+		Int edgeCount[4];
+		Int4 edgeValue[4][4];   // At the current quad, for each sample
+		Int4 edgeStep[4][4];    // Along x, from one quad to the next
+
+		for(unsigned int q = 0; q < state.multiSample; q++)
+		{
+			edgeCount[q] = *Pointer<Int>(primitive + q * sizeof(Primitive) + OFFSET(Primitive,edgeCount));
+		}
+
+		Int4 scissorX0 = Int4(*Pointer<Int>(data + OFFSET(DrawData,scissorX0)));
+		Int4 scissorX1 = Int4(*Pointer<Int>(data + OFFSET(DrawData,scissorX1)));
+		Int4 scissorY0 = Int4(*Pointer<Int>(data + OFFSET(DrawData,scissorY0)));
+		Int4 scissorY1 = Int4(*Pointer<Int>(data + OFFSET(DrawData,scissorY1)));
+
 		Pointer<Byte> cBuffer[RENDERTARGETS];
 		Pointer<Byte> zBuffer;
 		Pointer<Byte> sBuffer;
@@ -116,30 +200,38 @@ namespace sw
 
 		Do
 		{
-			Int x0a = Int(*Pointer<Short>(primitive + OFFSET(Primitive,outline->left) + (y + 0) * sizeof(Primitive::Span)));
-			Int x0b = Int(*Pointer<Short>(primitive + OFFSET(Primitive,outline->left) + (y + 1) * sizeof(Primitive::Span)));
-			Int x0 = Min(x0a, x0b);
+			// Find the horizontal span of the pair of rows from the edges of the first sample. It only
+			// has to be conservative, since coverage is determined per quad.
+			Int v = y - originY;
+			Int x0 = xMin;
+			Int x1 = xMax;
 
-			for(unsigned int q = 1; q < state.multiSample; q++)
+			// The other samples are less than a pixel away
+			int margin = (state.multiSample > 1) ? 1 : 0;
+
+			For(Int i = 0, i < edgeCount[0], i++)
 			{
-				x0a = Int(*Pointer<Short>(primitive + q * sizeof(Primitive) + OFFSET(Primitive,outline->left) + (y + 0) * sizeof(Primitive::Span)));
-				x0b = Int(*Pointer<Short>(primitive + q * sizeof(Primitive) + OFFSET(Primitive,outline->left) + (y + 1) * sizeof(Primitive::Span)));
-				x0 = Min(x0, Min(x0a, x0b));
-			}
+				Pointer<Byte> edge = primitive + OFFSET(Primitive,edge) + i * sizeof(Primitive::Edge);
+				Int A = *Pointer<Int>(edge + OFFSET(Primitive::Edge,A));
+				Int B = *Pointer<Int>(edge + OFFSET(Primitive::Edge,B));
+				Int C = *Pointer<Int>(edge + OFFSET(Primitive::Edge,C));
 
-			x0 &= 0xFFFFFFFE;
+				// Value at x = originX, on the row for which the edge leaves the widest span
+				Int E = Max(B * v, B * (v + 1)) + C;
 
-			Int x1a = Int(*Pointer<Short>(primitive + OFFSET(Primitive,outline->right) + (y + 0) * sizeof(Primitive::Span)));
-			Int x1b = Int(*Pointer<Short>(primitive + OFFSET(Primitive,outline->right) + (y + 1) * sizeof(Primitive::Span)));
-			Int x1 = Max(x1a, x1b);
+				If(A > 0)   // Covered when x - originX > -E / A
+				{
+					x0 = Max(x0, originX - E / A - margin);
+				}
 
-			for(unsigned int q = 1; q < state.multiSample; q++)
-			{
-				x1a = Int(*Pointer<Short>(primitive + q * sizeof(Primitive) + OFFSET(Primitive,outline->right) + (y + 0) * sizeof(Primitive::Span)));
-				x1b = Int(*Pointer<Short>(primitive + q * sizeof(Primitive) + OFFSET(Primitive,outline->right) + (y + 1) * sizeof(Primitive::Span)));
-				x1 = Max(x1, Max(x1a, x1b));
+				If(A < 0)   // Covered when x - originX < E / -A
+				{
+					x1 = Min(x1, originX + E / -A + 1 + margin);
+				}
 			}
 
+			x0 &= 0xFFFFFFFE;
+
 			Float4 yyyy = Float4(Float(y)) + *Pointer<Float4>(primitive + OFFSET(Primitive,yQuad), 16);
 
 			if(interpolateZ())
@@ -176,58 +268,101 @@ namespace sw
 					}
 				}
 
-				Short4 xLeft[4];
-				Short4 xRight[4];
-
 				for(unsigned int q = 0; q < state.multiSample; q++)
 				{
-					xLeft[q] = *Pointer<Short4>(primitive + q * sizeof(Primitive) + OFFSET(Primitive,outline) + y * sizeof(Primitive::Span));
-					xRight[q] = xLeft[q];
+					for(int i = 0; i < unrolledEdges; i++)
+					{
+						Pointer<Byte> edge = primitive + q * sizeof(Primitive) + OFFSET(Primitive,edge) + i * sizeof(Primitive::Edge);
+						Int A = *Pointer<Int>(edge + OFFSET(Primitive::Edge,A));
+						Int B = *Pointer<Int>(edge + OFFSET(Primitive::Edge,B));
+						Int C = *Pointer<Int>(edge + OFFSET(Primitive::Edge,C));
 
-					xLeft[q] = Swizzle(xLeft[q], 0xA0) - Short4(1, 2, 1, 2);
-					xRight[q] = Swizzle(xRight[q], 0xF5) - Short4(0, 1, 0, 1);
+						edgeValue[q][i] = quadEdge(A, B, C, x0 - originX, v);
+						edgeStep[q][i] = Int4(A * 2);
+					}
 				}
 
+				// Quads straddling the scissor rectangle are only partially covered
+				Int4 quadY = Int4(y) + Int4(0, 0, 1, 1);
+				Int4 scissorRows = CmpGE(quadY, scissorY0) & CmpLT(quadY, scissorY1);
+
 				For(Int x = x0, x < x1, x += 2)
 				{
-					Short4 xxxx = Short4(x);
+					Int4 quadX = Int4(x) + Int4(0, 1, 0, 1);
+					Int4 scissorMask = scissorRows & CmpGE(quadX, scissorX0) & CmpLT(quadX, scissorX1);
+
 					Int cMask[4];
+					Int anyMask = 0;
 
 					for(unsigned int q = 0; q < state.multiSample; q++)
 					{
-						Short4 mask = CmpGT(xxxx, xLeft[q]) & CmpGT(xRight[q], xxxx);
-						cMask[q] = SignMask(PackSigned(mask, mask)) & 0x0000000F;
+						Int4 mask = scissorMask;
+
+						for(int i = 0; i < unrolledEdges; i++)
+						{
+							mask &= CmpGT(edgeValue[q][i], Int4(0));
+							edgeValue[q][i] += edgeStep[q][i];
+						}
+
+						If(edgeCount[q] > unrolledEdges)
+						{
+							For(Int i = unrolledEdges, i < edgeCount[q], i++)
+							{
+								Pointer<Byte> edge = primitive + q * sizeof(Primitive) + OFFSET(Primitive,edge) + i * sizeof(Primitive::Edge);
+								Int A = *Pointer<Int>(edge + OFFSET(Primitive::Edge,A));
+								Int B = *Pointer<Int>(edge + OFFSET(Primitive::Edge,B));
+								Int C = *Pointer<Int>(edge + OFFSET(Primitive::Edge,C));
+
+								mask &= CmpGT(quadEdge(A, B, C, x - originX, v), Int4(0));
+							}
+						}
+
+						cMask[q] = SignMask(mask);
+						anyMask |= cMask[q];
 					}
 
-					quad(cBuffer, zBuffer, sBuffer, cMask, x, y);
+					If(anyMask != 0)
+					{
+						quad(cBuffer, zBuffer, sBuffer, cMask, x, y);
+					}
 				}
 			}
 
-			int clusterCount = Renderer::getClusterCount();
+			// Tiles consist of consecutive pairs of rows
+			int rowStep = (tileSize != 0) ? 2 : 2 * Renderer::getClusterCount();
 
 			for(int index = 0; index < RENDERTARGETS; index++)
 			{
 				if(state.colorWriteActive(index))
 				{
-					cBuffer[index] += *Pointer<Int>(data + OFFSET(DrawData,colorPitchB[index])) << (1 + sw::log2(clusterCount));   // FIXME: Precompute
+					cBuffer[index] += *Pointer<Int>(data + OFFSET(DrawData,colorPitchB[index])) * rowStep;   // FIXME: Precompute
 				}
 			}
 
 			if(state.depthTestActive)
 			{
-				zBuffer += *Pointer<Int>(data + OFFSET(DrawData,depthPitchB)) << (1 + sw::log2(clusterCount));   // FIXME: Precompute
+				zBuffer += *Pointer<Int>(data + OFFSET(DrawData,depthPitchB)) * rowStep;   // FIXME: Precompute
 			}
 
 			if(state.stencilActive)
 			{
-				sBuffer += *Pointer<Int>(data + OFFSET(DrawData,stencilPitchB)) << (1 + sw::log2(clusterCount));   // FIXME: Precompute
+				sBuffer += *Pointer<Int>(data + OFFSET(DrawData,stencilPitchB)) * rowStep;   // FIXME: Precompute
 			}
 
-			y += 2 * clusterCount;
+			y += rowStep;
 		}
 		Until(y >= yMax)
 	}
 
+	Int4 QuadRasterizer::quadEdge(const Int &A, const Int &B, const Int &C, const Int &u, const Int &v)
+	{
+		// Quads consist of pixels (x, y), (x + 1, y), (x, y + 1) and (x + 1, y + 1)
+		Int4 E = Int4(A * u + B * v + C);
+		E += (Int4(A) & Int4(0, -1, 0, -1)) + (Int4(B) & Int4(0, 0, -1, -1));
+
+		return E;
+	}
+
 	Float4 QuadRasterizer::interpolate(Float4 &x, Float4 &D, Float4 &rhw, Pointer<Byte> planeEquation, bool flat, bool perspective, bool clamp)
 	{
 		Float4 interpolant = D;
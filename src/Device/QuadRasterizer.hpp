@@ -39,6 +39,7 @@ namespace sw
 		Float4 Df;
 
 		UInt occlusion;
+		UInt fragments;
 
 #if PERF_PROFILE
 		Long cycles[PERF_TIMERS];
@@ -54,7 +55,8 @@ namespace sw
 		const SpirvShader *const spirvShader;
 
 	private:
-		void rasterize(Int &yMin, Int &yMax);
+		void rasterize(Int &yMin, Int &yMax, Int &xMin, Int &xMax);   // Spans are limited to the horizontal range
+		Int4 quadEdge(const Int &A, const Int &B, const Int &C, const Int &u, const Int &v);   // Edge values of the quad at (u, v) from the origin
 	};
 }
 
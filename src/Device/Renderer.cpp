@@ -26,13 +26,19 @@
 #include "System/Resource.hpp"
 #include "System/Half.hpp"
 #include "System/Math.hpp"
+#include "System/ThreadPool.hpp"
 #include "System/Timer.hpp"
 #include "Vulkan/VkConfig.h"
 #include "Vulkan/VkDebug.hpp"
+#include "Vulkan/VkEvent.hpp"
 #include "Vulkan/VkImageView.hpp"
+#include "Vulkan/VkQueryPool.hpp"
 #include "Pipeline/SpirvShader.hpp"
 #include "Vertex.hpp"
 
+#include <algorithm>
+#include <cstring>
+
 #undef max
 
 bool disableServer = true;
@@ -61,9 +67,11 @@ namespace sw
 	extern bool precachePixel;
 
 	static const int batchSize = 128;
+	static const int spinCount = 64;   // Attempts at finding a task before a thread parks
 	AtomicInt threadCount(1);
 	AtomicInt Renderer::unitCount(1);
 	AtomicInt Renderer::clusterCount(1);
+	AtomicInt Renderer::tileSize(0);
 
 	TranscendentalPrecision logPrecision = ACCURATE;
 	TranscendentalPrecision expPrecision = ACCURATE;
@@ -87,6 +95,22 @@ namespace sw
 		}
 	}
 
+	// Returns the number of vertices which input assembly reads for a batch of
+	// primitives. Strips and fans read their leading vertices with the first batch.
+	static int assemblyVertexCount(int drawType, int firstPrimitive, int count)
+	{
+		switch(drawType & 0x0F)
+		{
+		case DRAW_POINTLIST:     return count;
+		case DRAW_LINELIST:      return 2 * count;
+		case DRAW_LINESTRIP:     return count + ((firstPrimitive == 0) ? 1 : 0);
+		case DRAW_TRIANGLELIST:  return 3 * count;
+		case DRAW_TRIANGLESTRIP: return count + ((firstPrimitive == 0) ? 2 : 0);
+		case DRAW_TRIANGLEFAN:   return count + ((firstPrimitive == 0) ? 2 : 0);
+		default: ASSERT(false);  return 0;
+		}
+	}
+
 	struct Parameters
 	{
 		Renderer *renderer;
@@ -122,29 +146,16 @@ namespace sw
 			resetTimers();
 		#endif
 
-		for(int i = 0; i < 16; i++)
-		{
-			vertexTask[i] = nullptr;
-
-			worker[i] = nullptr;
-			resume[i] = nullptr;
-			suspend[i] = nullptr;
-		}
-
-		threadsAwake = 0;
 		resumeApp = new Event();
 
 		currentDraw = 0;
 		nextDraw = 0;
+		completedDraws = 0;
 
-		qHead = 0;
-		qSize = 0;
-
-		for(int i = 0; i < 16; i++)
-		{
-			triangleBatch[i] = nullptr;
-			primitiveBatch[i] = nullptr;
-		}
+		parkedThreads = 0;
+		taskEpoch = 0;
+		nextBatch = 0;
+		batchUnitMask = 0;
 
 		for(int draw = 0; draw < DRAW_COUNT; draw++)
 		{
@@ -152,21 +163,13 @@ namespace sw
 			drawList[draw] = drawCall[draw];
 		}
 
-		for(int unit = 0; unit < 16; unit++)
-		{
-			primitiveProgress[unit].init();
-		}
-
-		for(int cluster = 0; cluster < 16; cluster++)
-		{
-			pixelProgress[cluster].init();
-		}
-
 		clipFlags = 0;
 
 		swiftConfig = new SwiftConfig(disableServer);
 		updateConfiguration(true);
 
+		transferPool = new ThreadPool(threadCount);
+
 		sync = new Resource(0);
 	}
 
@@ -183,6 +186,9 @@ namespace sw
 		delete blitter;
 		blitter = nullptr;
 
+		delete transferPool;
+		transferPool = nullptr;
+
 		delete resumeApp;
 		resumeApp = nullptr;
 
@@ -208,8 +214,13 @@ namespace sw
 		sw::deallocate(mem);
 	}
 
-	void Renderer::draw(DrawType drawType, unsigned int count, bool update)
+	void Renderer::draw(DrawType drawType, unsigned int count, unsigned int instanceCount, bool update)
 	{
+		if(count == 0 || instanceCount == 0)
+		{
+			return;
+		}
+
 		#ifndef NDEBUG
 			if(count < minPrimitives || count > maxPrimitives)
 			{
@@ -217,6 +228,19 @@ namespace sw
 			}
 		#endif
 
+		SubDraw subDraw = { context->indexBuffer, 0, count, instanceCount, static_cast<unsigned int>(context->instanceID) };
+
+		draw(drawType, &subDraw, 1, update);
+	}
+
+	void Renderer::draw(DrawType drawType, const SubDraw *subDraws, unsigned int subDrawCount, bool update)
+	{
+		// Sub-draws must not be empty
+		if(subDrawCount == 0)
+		{
+			return;
+		}
+
 		context->drawType = drawType;
 
 		updateConfiguration();
@@ -286,10 +310,10 @@ namespace sw
 
 		if(queries.size() != 0)
 		{
-			draw->queries = new std::list<Query*>();
+			draw->queries = new std::list<vk::Query*>();
 			for(auto &query : queries)
 			{
-				++query->reference; // Atomic
+				query->addReference();
 				draw->queries->push_back(query);
 			}
 		}
@@ -316,16 +340,6 @@ namespace sw
 			data->stride[i] = context->input[i].stride;
 		}
 
-		if(context->indexBuffer)
-		{
-			data->indices = context->indexBuffer;
-		}
-
-		if(context->vertexShader->hasBuiltinInput(spv::BuiltInInstanceId))
-		{
-			data->instanceID = context->instanceID;
-		}
-
 		if(pixelState.stencilActive)
 		{
 			data->stencil[0].set(context->frontStencil.reference, context->frontStencil.compareMask, context->frontStencil.writeMask);
@@ -356,12 +370,12 @@ namespace sw
 			else ASSERT(false);
 		}
 
-		if(pixelState.occlusionEnabled)
+		// Queries add up the counters of every draw they're active for, so these
+		// are zeroed even when the pixel routine doesn't gather them.
+		for(int cluster = 0; cluster < clusterCount; cluster++)
 		{
-			for(int cluster = 0; cluster < clusterCount; cluster++)
-			{
-				data->occlusion[cluster] = 0;
-			}
+			data->occlusion[cluster] = 0;
+			data->fragments[cluster] = 0;
 		}
 
 		#if PERF_PROFILE
@@ -449,42 +463,45 @@ namespace sw
 			data->pushConstants = context->pushConstants;
 		}
 
+		draw->subDraws.assign(subDraws, subDraws + subDrawCount);
+		draw->subDraw = 0;
+		draw->instance = 0;
 		draw->primitive = 0;
-		draw->count = count;
 
-		draw->references = (count + batch - 1) / batch;
+		// Batches add their references as they get assigned, since the total
+		// of a large instanced draw doesn't fit an int.
+		draw->references = 1;
 
-		schedulerMutex.lock();
+		batchMutex.lock();
 		++nextDraw; // Atomic
-		schedulerMutex.unlock();
+		assignBatches(-1);
+		batchMutex.unlock();
 
-		#ifndef NDEBUG
-		if(threadCount == 1)   // Use main thread for draw execution
+		for(auto &access : nextDrawAccesses)
 		{
-			threadsAwake = 1;
-			task[0].type = Task::RESUME;
-
-			taskLoop(0);
+			access.draw = nextDraw;
+			drawAccesses.push_back(access);
 		}
-		else
-		#endif
-		{
-			if(!threadsAwake)
-			{
-				suspend[0]->wait();
 
-				threadsAwake = 1;
-				task[0].type = Task::RESUME;
+		nextDrawAccesses.clear();
 
-				resume[0]->signal();
+		#ifndef NDEBUG
+		if(threadCount == 1)   // Use main thread for draw execution
+		{
+			int task;
+			while(tryTakeTask(0, task))
+			{
+				executeTask(0, task);
 			}
 		}
+		#endif
 	}
 
 	void Renderer::threadFunction(void *parameters)
 	{
 		Renderer *renderer = static_cast<Parameters*>(parameters)->renderer;
 		int threadIndex = static_cast<Parameters*>(parameters)->threadIndex;
+		delete static_cast<Parameters*>(parameters);
 
 		if(logPrecision < IEEE)
 		{
@@ -497,248 +514,388 @@ namespace sw
 
 	void Renderer::threadLoop(int threadIndex)
 	{
-		while(!exitThreads)
+		int task;
+		while(takeTask(threadIndex, task))
 		{
-			taskLoop(threadIndex);
-
-			suspend[threadIndex]->signal();
-			resume[threadIndex]->wait();
+			executeTask(threadIndex, task);
 		}
 	}
 
-	void Renderer::taskLoop(int threadIndex)
+	bool Renderer::takeTask(int threadIndex, int &task)
 	{
-		while(task[threadIndex].type != Task::SUSPEND)
+		int attempts = 0;
+
+		while(!exitThreads)
 		{
-			scheduleTask(threadIndex);
-			executeTask(threadIndex);
+			if(tryTakeTask(threadIndex, task))
+			{
+				return true;
+			}
+
+			if(++attempts < spinCount)
+			{
+				Thread::yield();
+				continue;
+			}
+
+			// Park until a task gets pushed. Threads pushing tasks only wake parked threads,
+			// so look for tasks once more after announcing this thread is about to park.
+			int epoch = taskEpoch;
+			parkedThreads++;
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+
+			bool found = tryTakeTask(threadIndex, task);
+
+			if(!found)
+			{
+				std::unique_lock<std::mutex> lock(parkMutex);
+				parkCondition.wait(lock, [&] { return (taskEpoch != epoch) || exitThreads; });
+			}
+
+			parkedThreads--;
+
+			if(found)
+			{
+				return true;
+			}
+
+			attempts = 0;
 		}
+
+		return false;
 	}
 
-	void Renderer::findAvailableTasks()
+	bool Renderer::tryTakeTask(int threadIndex, int &task)
 	{
-		// Find pixel tasks
-		for(int cluster = 0; cluster < clusterCount; cluster++)
+		if(taskDeque[threadIndex]->pop(task))
 		{
-			if(!pixelProgress[cluster].executing)
-			{
-				for(int unit = 0; unit < unitCount; unit++)
-				{
-					if(primitiveProgress[unit].references > 0)   // Contains processed primitives
-					{
-						if(pixelProgress[cluster].drawCall == primitiveProgress[unit].drawCall)
-						{
-							if(pixelProgress[cluster].processedPrimitives == primitiveProgress[unit].firstPrimitive)   // Previous primitives have been rendered
-							{
-								Task &task = taskQueue[qHead];
-								task.type = Task::PIXELS;
-								task.primitiveUnit = unit;
-								task.pixelCluster = cluster;
+			return true;
+		}
+
+		if(injectedTasks.tryTake(task))
+		{
+			return true;
+		}
 
-								pixelProgress[cluster].executing = true;
+		int threads = static_cast<int>(taskDeque.size());
 
-								// Commit to the task queue
-								qHead = (qHead + 1) & TASK_COUNT_BITS;
-								qSize++;
+		for(int i = 1; i < threads; i++)
+		{
+			int victim = (threadIndex + i) % threads;
 
-								break;
-							}
-						}
-					}
-				}
+			if(taskDeque[victim]->steal(task))
+			{
+				return true;
 			}
 		}
 
-		// Find primitive tasks
-		if(currentDraw == nextDraw)
+		return false;
+	}
+
+	void Renderer::pushTask(int threadIndex, int task)
+	{
+		if(threadIndex < 0)   // Application thread
+		{
+			injectedTasks.put(task);
+		}
+		else
+		{
+			taskDeque[threadIndex]->push(task);
+		}
+
+		taskEpoch++;
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		if(parkedThreads > 0)
 		{
-			return;   // No more primitives to process
+			// Parked threads check the epoch while holding the mutex
+			{
+				std::unique_lock<std::mutex> lock(parkMutex);
+			}
+
+			parkCondition.notify_one();
 		}
+	}
 
-		for(int unit = 0; unit < unitCount; unit++)
+	void Renderer::assignBatches(int threadIndex)
+	{
+		// Batches are numbered in the order of their primitives, which is the order
+		// each cluster renders them in.
+		while(!freeUnits.empty() && (currentDraw != nextDraw))
 		{
 			DrawCall *draw = drawList[currentDraw & DRAW_COUNT_BITS];
 
+			const SubDraw &subDraw = draw->subDraws[draw->subDraw];
 			int primitive = draw->primitive;
-			int count = draw->count;
-
-			if(primitive >= count)
+			int count = subDraw.count;
+			int batch = draw->batchSize;
+			int remaining = count - primitive;   // In the current instance
+			int primitiveCount = remaining >= batch ? batch : remaining;
+
+			int unit = freeUnits.back();
+			freeUnits.pop_back();
+
+			primitiveProgress[unit].drawCall = currentDraw;
+			primitiveProgress[unit].firstPrimitive = primitive;
+			primitiveProgress[unit].subDraw = draw->subDraw;
+			primitiveProgress[unit].instance = draw->instance;
+			primitiveProgress[unit].primitiveCount = primitiveCount;
+			primitiveProgress[unit].batch = nextBatch;
+			batchUnit[nextBatch & batchUnitMask] = unit;
+			nextBatch++;
+
+			++draw->references; // Atomic
+			draw->primitive += primitiveCount;
+
+			if(draw->primitive == count)
 			{
-				++currentDraw; // Atomic
+				draw->primitive = 0;
+				++draw->instance;
 
-				if(currentDraw == nextDraw)
+				if(static_cast<unsigned int>(draw->instance) == subDraw.instanceCount)
 				{
-					return;   // No more primitives to process
-				}
+					draw->instance = 0;
+					++draw->subDraw;
 
-				draw = drawList[currentDraw & DRAW_COUNT_BITS];
+					// Move on as soon as the last batch is assigned, since the draw can then
+					// complete and have its slot reused before more units become free. The
+					// batch just assigned keeps the draw's references from dropping to 0 here.
+					if(static_cast<size_t>(draw->subDraw) == draw->subDraws.size())
+					{
+						--draw->references; // Atomic
+						++currentDraw; // Atomic
+					}
+				}
 			}
 
-			if(!primitiveProgress[unit].references)   // Task not already being executed and not still in use by a pixel unit
-			{
-				primitive = draw->primitive;
-				count = draw->count;
-				int batch = draw->batchSize;
+			pushTask(threadIndex, unit);
+		}
+	}
 
-				primitiveProgress[unit].drawCall = currentDraw;
-				primitiveProgress[unit].firstPrimitive = primitive;
-				primitiveProgress[unit].primitiveCount = count - primitive >= batch ? batch : count - primitive;
+	void Renderer::releaseUnit(int threadIndex, int unit)
+	{
+		batchMutex.lock();
+		freeUnits.push_back(unit);
+		assignBatches(threadIndex);
+		batchMutex.unlock();
+	}
 
-				draw->primitive += batch;
+	bool Renderer::pixelsReady(int cluster)
+	{
+		int batch = pixelProgress[cluster].batch;
+		int unit = batchUnit[batch & batchUnitMask];
 
-				Task &task = taskQueue[qHead];
-				task.type = Task::PRIMITIVES;
-				task.primitiveUnit = unit;
+		return primitiveProgress[unit].ready == batch;
+	}
 
-				primitiveProgress[unit].references = -1;
+	void Renderer::dispatchPixels(int threadIndex, int cluster)
+	{
+		// Only the thread which claims the cluster queues its task. Claiming can fail
+		// because another thread holds the cluster, which checks again once released.
+		while(pixelsReady(cluster))
+		{
+			if(pixelProgress[cluster].executing.exchange(true))
+			{
+				return;
+			}
 
-				// Commit to the task queue
-				qHead = (qHead + 1) & TASK_COUNT_BITS;
-				qSize++;
+			if(pixelsReady(cluster))
+			{
+				pushTask(threadIndex, unitCount + cluster);
+				return;
 			}
+
+			pixelProgress[cluster].executing.exchange(false);
 		}
 	}
 
-	void Renderer::scheduleTask(int threadIndex)
+	void Renderer::executeTask(int threadIndex, int task)
 	{
-		schedulerMutex.lock();
-
-		int curThreadsAwake = threadsAwake;
+		#if PERF_HUD
+			int64_t startTick = Timer::ticks();
+		#endif
 
-		if((int)qSize < threadCount - curThreadsAwake + 1)
+		if(task < unitCount)
 		{
-			findAvailableTasks();
-		}
+			int unit = task;
 
-		if(qSize != 0)
-		{
-			task[threadIndex] = taskQueue[(qHead - qSize) & TASK_COUNT_BITS];
-			qSize--;
+			int input = primitiveProgress[unit].firstPrimitive;
+			int count = primitiveProgress[unit].primitiveCount;
+			DrawCall *draw = drawList[primitiveProgress[unit].drawCall & DRAW_COUNT_BITS];
+			int (Renderer::*setupPrimitives)(int batch, int count) = draw->setupPrimitives;
+			const SubDraw &subDraw = draw->subDraws[primitiveProgress[unit].subDraw];
+			unsigned int instance = primitiveProgress[unit].instance;
+
+			processPrimitiveVertices(unit, subDraw, input, count, subDraw.firstInstance + instance, threadIndex);
+
+			#if PERF_HUD
+				int64_t time = Timer::ticks();
+				vertexTime[threadIndex] += time - startTick;
+				startTick = time;
+			#endif
 
-			if(curThreadsAwake != threadCount)
+			int visible = 0;
+
+			if(!draw->setupState.rasterizerDiscard)
 			{
-				int wakeup = qSize - curThreadsAwake + 1;
+				visible = (this->*setupPrimitives)(unit, count);
+			}
 
-				for(int i = 0; i < threadCount && wakeup > 0; i++)
+			if(draw->queries)
+			{
+				for(auto &query : *(draw->queries))
 				{
-					if(task[i].type == Task::SUSPEND)
+					if(query->getType() == VK_QUERY_TYPE_PIPELINE_STATISTICS)
 					{
-						suspend[i]->wait();
-						task[i].type = Task::RESUME;
-						resume[i]->signal();
+						query->addStatistic(vk::Query::INPUT_ASSEMBLY_VERTICES, assemblyVertexCount(draw->drawType, input, count));
+						query->addStatistic(vk::Query::INPUT_ASSEMBLY_PRIMITIVES, count);
+						query->addStatistic(vk::Query::VERTEX_SHADER_INVOCATIONS, vertexTask[threadIndex]->invocations);
 
-						++threadsAwake; // Atomic
-						wakeup--;
+						if(!draw->setupState.rasterizerDiscard)
+						{
+							// Setup clips and culls in one pass, so culled primitives aren't part of the clipping output
+							query->addStatistic(vk::Query::CLIPPING_INVOCATIONS, count);
+							query->addStatistic(vk::Query::CLIPPING_PRIMITIVES, visible);
+						}
 					}
 				}
 			}
+
+			primitiveProgress[unit].visible = visible;
+			primitiveProgress[unit].references = clusterCount;
+			primitiveProgress[unit].ready = primitiveProgress[unit].batch;
+
+			#if PERF_HUD
+				setupTime[threadIndex] += Timer::ticks() - startTick;
+			#endif
+
+			for(int cluster = 0; cluster < clusterCount; cluster++)
+			{
+				dispatchPixels(threadIndex, cluster);
+			}
 		}
 		else
 		{
-			task[threadIndex].type = Task::SUSPEND;
+			int cluster = task - unitCount;
+			int unit = batchUnit[pixelProgress[cluster].batch & batchUnitMask];
+			int visible = primitiveProgress[unit].visible;
 
-			--threadsAwake; // Atomic
-		}
+			if(visible > 0)
+			{
+				Primitive *primitive = primitiveBatch[unit];
+				DrawCall *draw = drawList[primitiveProgress[unit].drawCall & DRAW_COUNT_BITS];
+				DrawData *data = draw->data;
+				PixelProcessor::RoutinePointer pixelRoutine = draw->pixelPointer;
+
+				pixelRoutine(primitive, visible, cluster, data);
+			}
+
+			finishRendering(threadIndex, unit, cluster);
 
-		schedulerMutex.unlock();
+			#if PERF_HUD
+				pixelTime[threadIndex] += Timer::ticks() - startTick;
+			#endif
+		}
 	}
 
-	void Renderer::executeTask(int threadIndex)
+	void Renderer::addDrawAccess(const void *memory, size_t size, bool write, bool ordered)
 	{
-		#if PERF_HUD
-			int64_t startTick = Timer::ticks();
-		#endif
+		const uint8_t *begin = static_cast<const uint8_t*>(memory);
+		MemoryAccess access = { begin, begin + size, write, ordered, 0 };
 
-		switch(task[threadIndex].type)
-		{
-		case Task::PRIMITIVES:
-			{
-				int unit = task[threadIndex].primitiveUnit;
+		waitForConflicts(access, true);
 
-				int input = primitiveProgress[unit].firstPrimitive;
-				int count = primitiveProgress[unit].primitiveCount;
-				DrawCall *draw = drawList[primitiveProgress[unit].drawCall & DRAW_COUNT_BITS];
-				int (Renderer::*setupPrimitives)(int batch, int count) = draw->setupPrimitives;
+		nextDrawAccesses.push_back(access);
+	}
 
-				processPrimitiveVertices(unit, input, count, draw->count, threadIndex);
+	void Renderer::waitForAccess(const void *memory, size_t size, bool write)
+	{
+		const uint8_t *begin = static_cast<const uint8_t*>(memory);
+		MemoryAccess access = { begin, begin + size, write, false, 0 };
 
-				#if PERF_HUD
-					int64_t time = Timer::ticks();
-					vertexTime[threadIndex] += time - startTick;
-					startTick = time;
-				#endif
+		waitForConflicts(access, false);
+	}
 
-				int visible = 0;
+	bool Renderer::isCompleted(int draw) const
+	{
+		// Serial numbers wrap around
+		return static_cast<int>(static_cast<unsigned int>(completedDraws) - static_cast<unsigned int>(draw)) >= 0;
+	}
 
-				if(!draw->setupState.rasterizerDiscard)
-				{
-					visible = (this->*setupPrimitives)(unit, count);
-				}
+	void Renderer::waitForConflicts(const MemoryAccess &access, bool drawOrdered)
+	{
+		drawAccesses.erase(std::remove_if(drawAccesses.begin(), drawAccesses.end(),
+			[this](const MemoryAccess &drawAccess) { return isCompleted(drawAccess.draw); }),
+			drawAccesses.end());
 
-				primitiveProgress[unit].visible = visible;
-				primitiveProgress[unit].references = clusterCount;
+		// Draws write their attachments in the order they were issued, after having read
+		// their vertices, so another draw only has to wait when it reads what they write.
+		// Shaders access descriptor resources in any order.
+		int lastConflict = completedDraws;
 
-				#if PERF_HUD
-					setupTime[threadIndex] += Timer::ticks() - startTick;
-				#endif
-			}
-			break;
-		case Task::PIXELS:
+		for(const auto &drawAccess : drawAccesses)
+		{
+			bool overlaps = (access.begin < drawAccess.end) && (drawAccess.begin < access.end);
+			bool ordered = drawOrdered && access.ordered && drawAccess.ordered;
+			bool conflicts = ordered ? (drawAccess.write && !access.write) : (drawAccess.write || access.write);
+
+			if(overlaps && conflicts)
 			{
-				int unit = task[threadIndex].primitiveUnit;
-				int visible = primitiveProgress[unit].visible;
+				lastConflict = drawAccess.draw;   // Accesses are ordered by draw
+			}
+		}
 
-				if(visible > 0)
-				{
-					int cluster = task[threadIndex].pixelCluster;
-					Primitive *primitive = primitiveBatch[unit];
-					DrawCall *draw = drawList[pixelProgress[cluster].drawCall & DRAW_COUNT_BITS];
-					DrawData *data = draw->data;
-					PixelProcessor::RoutinePointer pixelRoutine = draw->pixelPointer;
+		while(!isCompleted(lastConflict))
+		{
+			resumeApp->wait();
+		}
+	}
 
-					pixelRoutine(primitive, visible, cluster, data);
-				}
+	void Renderer::setEventAfterDraws(vk::Event *event, bool set)
+	{
+		eventMutex.lock();
+		eventUpdates.push_back({ event, set, nextDraw });
+		eventMutex.unlock();
+
+		updateEvents();
+	}
 
-				finishRendering(task[threadIndex]);
+	void Renderer::updateEvents()
+	{
+		eventMutex.lock();
 
-				#if PERF_HUD
-					pixelTime[threadIndex] += Timer::ticks() - startTick;
-				#endif
+		auto update = eventUpdates.begin();
+		for(; update != eventUpdates.end() && isCompleted(update->draw); update++)
+		{
+			if(update->set)
+			{
+				update->event->signal();
+			}
+			else
+			{
+				update->event->reset();
 			}
-			break;
-		case Task::RESUME:
-			break;
-		case Task::SUSPEND:
-			break;
-		default:
-			ASSERT(false);
 		}
+
+		eventUpdates.erase(eventUpdates.begin(), update);
+
+		eventMutex.unlock();
 	}
 
 	void Renderer::synchronize()
 	{
 		sync->lock(sw::PUBLIC);
 		sync->unlock();
+
+		drawAccesses.clear();
 	}
 
-	void Renderer::finishRendering(Task &pixelTask)
+	void Renderer::finishRendering(int threadIndex, int unit, int cluster)
 	{
-		int unit = pixelTask.primitiveUnit;
-		int cluster = pixelTask.pixelCluster;
-
 		DrawCall &draw = *drawList[primitiveProgress[unit].drawCall & DRAW_COUNT_BITS];
 		DrawData &data = *draw.data;
-		int primitive = primitiveProgress[unit].firstPrimitive;
-		int count = primitiveProgress[unit].primitiveCount;
-		int processedPrimitives = primitive + count;
-
-		pixelProgress[cluster].processedPrimitives = processedPrimitives;
 
-		if(pixelProgress[cluster].processedPrimitives >= draw.count)
-		{
-			++pixelProgress[cluster].drawCall; // Atomic
-			pixelProgress[cluster].processedPrimitives = 0;
-		}
+		++pixelProgress[cluster].batch; // Atomic
 
 		int ref = primitiveProgress[unit].references--; // Atomic
 
@@ -762,22 +919,25 @@ namespace sw
 				{
 					for(auto &query : *(draw.queries))
 					{
-						switch(query->type)
+						switch(query->getType())
 						{
-						case Query::FRAGMENTS_PASSED:
+						case VK_QUERY_TYPE_OCCLUSION:
 							for(int cluster = 0; cluster < clusterCount; cluster++)
 							{
-								query->data += data.occlusion[cluster];
+								query->add(data.occlusion[cluster]);
 							}
 							break;
-						case Query::TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN:
-							query->data += processedPrimitives;
+						case VK_QUERY_TYPE_PIPELINE_STATISTICS:
+							for(int cluster = 0; cluster < clusterCount; cluster++)
+							{
+								query->addStatistic(vk::Query::FRAGMENT_SHADER_INVOCATIONS, data.fragments[cluster]);
+							}
 							break;
 						default:
 							break;
 						}
 
-						--query->reference; // Atomic
+						query->releaseReference();
 					}
 
 					delete draw.queries;
@@ -788,17 +948,24 @@ namespace sw
 				draw.setupRoutine->unbind();
 				draw.pixelRoutine->unbind();
 
+				++completedDraws;
+				updateEvents();
+
 				sync->unlock();
 
 				draw.references = -1;
 				resumeApp->signal();
 			}
+
+			// All clusters have rendered the unit's primitives
+			releaseUnit(threadIndex, unit);
 		}
 
-		pixelProgress[cluster].executing = false;
+		pixelProgress[cluster].executing.exchange(false);
+		dispatchPixels(threadIndex, cluster);
 	}
 
-	void Renderer::processPrimitiveVertices(int unit, unsigned int start, unsigned int triangleCount, unsigned int loop, int thread)
+	void Renderer::processPrimitiveVertices(int unit, const SubDraw &subDraw, unsigned int start, unsigned int triangleCount, unsigned int instanceID, int thread)
 	{
 		Triangle *triangle = triangleBatch[unit];
 		int primitiveDrawCall = primitiveProgress[unit].drawCall;
@@ -806,13 +973,14 @@ namespace sw
 		DrawData *data = draw->data;
 		VertexTask *task = vertexTask[thread];
 
-		const void *indices = data->indices;
+		const void *indices = subDraw.indices;
 		VertexProcessor::RoutinePointer vertexRoutine = draw->vertexPointer;
 
-		if(task->vertexCache.drawCall != primitiveDrawCall)
+		if(task->vertexCache.drawCall != primitiveDrawCall || task->instanceID != instanceID)
 		{
 			task->vertexCache.clear();
 			task->vertexCache.drawCall = primitiveDrawCall;
+			task->instanceID = instanceID;
 		}
 
 		unsigned int batch[128][3];   // FIXME: Adjust to dynamic batch size
@@ -1090,9 +1258,19 @@ namespace sw
 			return;
 		}
 
+		if(subDraw.vertexOffset != 0)
+		{
+			for(unsigned int i = 0; i < triangleCount; i++)
+			{
+				batch[i][0] += subDraw.vertexOffset;
+				batch[i][1] += subDraw.vertexOffset;
+				batch[i][2] += subDraw.vertexOffset;
+			}
+		}
+
 		task->primitiveStart = start;
 		task->vertexCount = triangleCount * 3;
-		vertexRoutine(&triangle->v0, (unsigned int*)&batch, task, data);
+		vertexRoutine(&triangle->vertex(0, draw->setupState.vertexStride), (unsigned int*)&batch, task, data);
 	}
 
 	int Renderer::setupTriangles(int unit, int count)
@@ -1105,14 +1283,15 @@ namespace sw
 		const SetupProcessor::RoutinePointer &setupRoutine = draw.setupPointer;
 
 		int ms = state.multiSample;
+		int stride = state.vertexStride;
 		const DrawData *data = draw.data;
 		int visible = 0;
 
-		for(int i = 0; i < count; i++, triangle++)
+		for(int i = 0; i < count; i++, triangle = triangle->next(stride))
 		{
-			Vertex &v0 = triangle->v0;
-			Vertex &v1 = triangle->v1;
-			Vertex &v2 = triangle->v2;
+			Vertex &v0 = triangle->vertex(0, stride);
+			Vertex &v1 = triangle->vertex(1, stride);
+			Vertex &v2 = triangle->vertex(2, stride);
 
 			if((v0.clipFlags & v1.clipFlags & v2.clipFlags) == Clipper::CLIP_FINITE)
 			{
@@ -1158,7 +1337,7 @@ namespace sw
 				visible++;
 			}
 
-			triangle++;
+			triangle = triangle->next(state.vertexStride);
 		}
 
 		return visible;
@@ -1183,7 +1362,7 @@ namespace sw
 				visible++;
 			}
 
-			triangle++;
+			triangle = triangle->next(state.vertexStride);
 		}
 
 		return visible;
@@ -1197,8 +1376,8 @@ namespace sw
 
 		float lineWidth = data.lineWidth;
 
-		Vertex &v0 = triangle.v0;
-		Vertex &v1 = triangle.v1;
+		Vertex &v0 = triangle.vertex(0, state.vertexStride);
+		Vertex &v1 = triangle.vertex(1, state.vertexStride);
 
 		const float4 &P0 = v0.builtins.position;
 		const float4 &P1 = v1.builtins.position;
@@ -1386,9 +1565,10 @@ namespace sw
 	bool Renderer::setupPoint(Primitive &primitive, Triangle &triangle, const DrawCall &draw)
 	{
 		const SetupProcessor::RoutinePointer &setupRoutine = draw.setupPointer;
+		const SetupProcessor::State &state = draw.setupState;
 		const DrawData &data = *draw.data;
 
-		Vertex &v = triangle.v0;
+		Vertex &v = triangle.vertex(0, state.vertexStride);
 
 		float pSize = v.builtins.pointSize;
 
@@ -1421,11 +1601,14 @@ namespace sw
 		P[3].y -= Y;
 		C[3] = clipper->computeClipFlags(P[3]);
 
-		triangle.v1 = triangle.v0;
-		triangle.v2 = triangle.v0;
+		Vertex &v1 = triangle.vertex(1, state.vertexStride);
+		Vertex &v2 = triangle.vertex(2, state.vertexStride);
 
-		triangle.v1.projected.x += iround(16 * 0.5f * pSize);
-		triangle.v2.projected.y -= iround(16 * 0.5f * pSize) * (data.Hx16[0] > 0.0f ? 1 : -1);   // Both Direct3D and OpenGL expect (0, 0) in the top-left corner
+		memcpy(&v1, &v, state.vertexStride);
+		memcpy(&v2, &v, state.vertexStride);
+
+		v1.projected.x += iround(16 * 0.5f * pSize);
+		v2.projected.y -= iround(16 * 0.5f * pSize) * (data.Hx16[0] > 0.0f ? 1 : -1);   // Both Direct3D and OpenGL expect (0, 0) in the top-left corner
 
 		Polygon polygon(P, 4);
 
@@ -1449,72 +1632,113 @@ namespace sw
 
 	void Renderer::initializeThreads()
 	{
-		unitCount = ceilPow2(threadCount);
-		clusterCount = ceilPow2(threadCount);
+		unitCount = threadCount;
+		clusterCount = threadCount;
+
+		triangleBatch.resize(unitCount);
+		primitiveBatch.resize(unitCount);
+		primitiveProgress.reset(new PrimitiveProgress[unitCount]);
 
 		for(int i = 0; i < unitCount; i++)
 		{
 			triangleBatch[i] = (Triangle*)allocate(batchSize * sizeof(Triangle));
 			primitiveBatch[i] = (Primitive*)allocate(batchSize * sizeof(Primitive));
+			primitiveProgress[i].init();
+		}
+
+		pixelProgress.reset(new PixelProgress[clusterCount]);
+
+		for(int cluster = 0; cluster < clusterCount; cluster++)
+		{
+			pixelProgress[cluster].init();
 		}
 
+		// Batches in flight use distinct units, and clusters look up at most one batch past them
+		int batchUnitCount = ceilPow2(unitCount + 1);
+		batchUnit.reset(new AtomicInt[batchUnitCount]);
+		batchUnitMask = batchUnitCount - 1;
+		nextBatch = 0;
+
+		freeUnits.clear();
+
+		for(int unit = unitCount - 1; unit >= 0; unit--)
+		{
+			freeUnits.push_back(unit);
+		}
+
+		// At most one task per unit and one per cluster exist at any time
+		int taskDequeSize = ceilPow2(unitCount + clusterCount);
+
+		taskDeque.resize(threadCount);
+		vertexTask.resize(threadCount);
+
 		for(int i = 0; i < threadCount; i++)
 		{
+			taskDeque[i].reset(new WorkStealingDeque<int>(taskDequeSize));
+
 			vertexTask[i] = (VertexTask*)allocate(sizeof(VertexTask));
 			vertexTask[i]->vertexCache.drawCall = -1;
+		}
 
-			task[i].type = Task::SUSPEND;
-
-			resume[i] = new Event();
-			suspend[i] = new Event();
+		exitThreads = false;
 
-			Parameters parameters;
-			parameters.threadIndex = i;
-			parameters.renderer = this;
+		#ifndef NDEBUG
+		if(threadCount == 1)
+		{
+			return;   // Draws are executed by the main thread
+		}
+		#endif
 
-			exitThreads = false;
-			worker[i] = new Thread(threadFunction, &parameters);
+		for(int i = 0; i < threadCount; i++)
+		{
+			Parameters *parameters = new Parameters;   // Deleted by the thread
+			parameters->threadIndex = i;
+			parameters->renderer = this;
 
-			suspend[i]->wait();
-			suspend[i]->signal();
+			worker.push_back(new Thread(threadFunction, parameters));
 		}
 	}
 
 	void Renderer::terminateThreads()
 	{
-		while(threadsAwake != 0)
+		// Once the draws in flight have completed, threads only look for tasks or are parked
+		while(!isCompleted(nextDraw))
 		{
 			Thread::sleep(1);
 		}
 
-		for(int thread = 0; thread < threadCount; thread++)
+		exitThreads = true;
+
 		{
-			if(worker[thread])
-			{
-				exitThreads = true;
-				resume[thread]->signal();
-				worker[thread]->join();
-
-				delete worker[thread];
-				worker[thread] = 0;
-				delete resume[thread];
-				resume[thread] = 0;
-				delete suspend[thread];
-				suspend[thread] = 0;
-			}
+			std::unique_lock<std::mutex> lock(parkMutex);
+		}
 
-			deallocate(vertexTask[thread]);
-			vertexTask[thread] = 0;
+		parkCondition.notify_all();
+
+		for(auto thread : worker)
+		{
+			thread->join();
+			delete thread;
 		}
 
-		for(int i = 0; i < 16; i++)
+		worker.clear();
+
+		for(auto task : vertexTask)
 		{
-			deallocate(triangleBatch[i]);
-			triangleBatch[i] = 0;
+			deallocate(task);
+		}
 
-			deallocate(primitiveBatch[i]);
-			primitiveBatch[i] = 0;
+		vertexTask.clear();
+		taskDeque.clear();
+
+		for(size_t unit = 0; unit < triangleBatch.size(); unit++)
+		{
+			deallocate(triangleBatch[unit]);
+			deallocate(primitiveBatch[unit]);
 		}
+
+		triangleBatch.clear();
+		primitiveBatch.clear();
 	}
 
 	void Renderer::setMultiSampleMask(unsigned int mask)
@@ -1557,14 +1781,51 @@ namespace sw
 		context->vertexShader = shader;
 	}
 
-	void Renderer::addQuery(Query *query)
+	void Renderer::addQuery(vk::Query *query)
 	{
 		queries.push_back(query);
+
+		updateQueryState();
 	}
 
-	void Renderer::removeQuery(Query *query)
+	void Renderer::removeQuery(vk::Query *query)
 	{
 		queries.remove(query);
+
+		updateQueryState();
+	}
+
+	void Renderer::updateQueryState()
+	{
+		// The pixel routines only gather the counters needed by the active queries
+		context->occlusionEnabled = false;
+		context->statisticsEnabled = false;
+
+		for(auto &query : queries)
+		{
+			switch(query->getType())
+			{
+			case VK_QUERY_TYPE_OCCLUSION:
+				context->occlusionEnabled = true;
+				break;
+			case VK_QUERY_TYPE_PIPELINE_STATISTICS:
+				context->statisticsEnabled = true;
+				break;
+			default:
+				break;
+			}
+		}
+	}
+
+	void Renderer::addComputeInvocations(int64_t invocations)
+	{
+		for(auto &query : queries)
+		{
+			if(query->getType() == VK_QUERY_TYPE_PIPELINE_STATISTICS)
+			{
+				query->addStatistic(vk::Query::COMPUTE_SHADER_INVOCATIONS, invocations);
+			}
+		}
 	}
 
 	#if PERF_HUD
@@ -1602,6 +1863,9 @@ namespace sw
 	void Renderer::setContext(const sw::Context& context)
 	{
 		*(this->context) = context;
+
+		// The query state belongs to the renderer, not to the pipeline's context
+		updateQueryState();
 	}
 
 	void Renderer::setViewport(const VkViewport &viewport)
@@ -1697,13 +1961,20 @@ namespace sw
 			default: transparencyAntialiasing = TRANSPARENCY_NONE;              break;
 			}
 
+			int threads = 1;
 			switch(configuration.threadCount)
 			{
-			case -1: threadCount = CPUID::coreCount();        break;
-			case 0:  threadCount = CPUID::processAffinity();  break;
-			default: threadCount = configuration.threadCount; break;
+			case -1: threads = CPUID::coreCount();        break;
+			case 0:  threads = CPUID::processAffinity();  break;
+			default: threads = configuration.threadCount; break;
 			}
 
+			threadCount = clamp(threads, 1, static_cast<int>(MAX_THREAD_COUNT));
+
+			// Tiles have to consist of whole pairs of rows
+			int tiles = configuration.tileSize;
+			tileSize = (tiles >= 2 && tiles <= 0x10000 && isPow2(tiles)) ? tiles : 0;
+
 			CPUID::setEnableSSE4_1(configuration.enableSSE4_1);
 			CPUID::setEnableSSSE3(configuration.enableSSSE3);
 			CPUID::setEnableSSE3(configuration.enableSSE3);
@@ -1726,7 +1997,7 @@ namespace sw
 		#endif
 		}
 
-		if(!initialUpdate && !worker[0])
+		if(!initialUpdate && taskDeque.empty())
 		{
 			initializeThreads();
 		}
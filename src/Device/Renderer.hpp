@@ -21,10 +21,19 @@
 #include "Plane.hpp"
 #include "Blitter.hpp"
 #include "System/MutexLock.hpp"
+#include "System/Synchronization.hpp"
 #include "System/Thread.hpp"
 #include "Device/Config.hpp"
 
 #include <list>
+#include <memory>
+#include <vector>
+
+namespace vk
+{
+	class Event;
+	class Query;
+}
 
 namespace sw
 {
@@ -35,6 +44,7 @@ namespace sw
 	class SwiftConfig;
 	struct Task;
 	class Resource;
+	class ThreadPool;
 	struct Constants;
 
 	enum TranscendentalPrecision
@@ -85,30 +95,16 @@ namespace sw
 		false,   // colorsDefaultToZero
 	};
 
-	struct Query
+	// A range of primitives drawn with the state of a draw call. Multi-draws
+	// submit all their ranges as one draw call, which shares the routines and
+	// the batching across them.
+	struct SubDraw
 	{
-		enum Type { FRAGMENTS_PASSED, TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN };
-
-		Query(Type type) : building(false), reference(0), data(0), type(type)
-		{
-		}
-
-		void begin()
-		{
-			building = true;
-			data = 0;
-		}
-
-		void end()
-		{
-			building = false;
-		}
-
-		bool building;
-		AtomicInt reference;
-		AtomicInt data;
-
-		const Type type;
+		const void *indices;          // Indexed draws only
+		int vertexOffset;             // Added to each vertex index
+		unsigned int count;           // Number of primitives per instance
+		unsigned int instanceCount;
+		unsigned int firstInstance;
 	};
 
 	struct DrawData
@@ -118,7 +114,6 @@ namespace sw
 		const void *input[MAX_VERTEX_INPUTS];
 		unsigned int stride[MAX_VERTEX_INPUTS];
 		Texture mipmap[TOTAL_IMAGE_UNITS];
-		const void *indices;
 
 		struct VS
 		{
@@ -144,16 +139,16 @@ namespace sw
 		VS vs;
 		PS ps;
 
-		int instanceID;
 		float lineWidth;
 
 		PixelProcessor::Stencil stencil[2];   // clockwise, counterclockwise
 		PixelProcessor::Stencil stencilCCW;
 		PixelProcessor::Factor factor;
-		unsigned int occlusion[16];   // Number of pixels passing depth test
+		unsigned int occlusion[MAX_THREAD_COUNT];   // Number of pixels passing depth test, per cluster
+		unsigned int fragments[MAX_THREAD_COUNT];   // Number of fragment shader invocations, per cluster
 
 		#if PERF_PROFILE
-			int64_t cycles[PERF_TIMERS][16];
+			int64_t cycles[PERF_TIMERS][MAX_THREAD_COUNT];
 		#endif
 
 		float4 Wx16;
@@ -193,52 +188,43 @@ namespace sw
 
 	class Renderer : public VertexProcessor, public PixelProcessor, public SetupProcessor
 	{
-		struct Task
-		{
-			enum Type
-			{
-				PRIMITIVES,
-				PIXELS,
-
-				RESUME,
-				SUSPEND
-			};
-
-			AtomicInt type;
-			AtomicInt primitiveUnit;
-			AtomicInt pixelCluster;
-		};
-
+		// Batches of primitives are numbered in the order they're assigned to units
 		struct PrimitiveProgress
 		{
 			void init()
 			{
 				drawCall = 0;
 				firstPrimitive = 0;
+				subDraw = 0;
+				instance = 0;
 				primitiveCount = 0;
 				visible = 0;
 				references = 0;
+				batch = -1;
+				ready = -1;
 			}
 
 			AtomicInt drawCall;
 			AtomicInt firstPrimitive;
+			AtomicInt subDraw;
+			AtomicInt instance;     // Relative to the sub-draw's first instance
 			AtomicInt primitiveCount;
 			AtomicInt visible;
-			AtomicInt references;
+			AtomicInt references;   // Clusters which have yet to render the primitives
+			AtomicInt batch;        // Batch assigned to the unit
+			AtomicInt ready;        // Last batch set up by the unit
 		};
 
 		struct PixelProgress
 		{
 			void init()
 			{
-				drawCall = 0;
-				processedPrimitives = 0;
+				batch = 0;
 				executing = false;
 			}
 
-			AtomicInt drawCall;
-			AtomicInt processedPrimitives;
-			AtomicInt executing;
+			AtomicInt batch;       // Next batch to render
+			AtomicInt executing;   // The cluster's task is queued or executing
 		};
 
 	public:
@@ -249,7 +235,8 @@ namespace sw
 		void *operator new(size_t size);
 		void operator delete(void * mem);
 
-		void draw(DrawType drawType, unsigned int count, bool update = true);
+		void draw(DrawType drawType, unsigned int count, unsigned int instanceCount = 1, bool update = true);
+		void draw(DrawType drawType, const SubDraw *subDraws, unsigned int subDrawCount, bool update = true);
 
 		void setContext(const sw::Context& context);
 
@@ -271,8 +258,24 @@ namespace sw
 		void setViewport(const VkViewport &viewport);
 		void setScissor(const VkRect2D &scissor);
 
-		void addQuery(Query *query);
-		void removeQuery(Query *query);
+		// Active queries accumulate the results of subsequent draws
+		void addQuery(vk::Query *query);
+		void removeQuery(vk::Query *query);
+
+		// Compute dispatches don't go through the renderer, but count towards its active pipeline statistics queries
+		void addComputeInvocations(int64_t invocations);
+
+		// Memory accessed by the next draw. Work executed outside of the renderer only
+		// has to wait for the draws in flight which access the same memory. Attachments,
+		// vertices and indices are accessed in draw order, unlike descriptor resources.
+		void addDrawAccess(const void *memory, size_t size, bool write, bool ordered);
+		void waitForAccess(const void *memory, size_t size, bool write);
+
+		// Sets or resets the event once the draws issued so far have completed
+		void setEventAfterDraws(vk::Event *event, bool set);
+
+		// Threads for splitting up transfers (copies and fills) and compute dispatches, which run outside of the renderer
+		ThreadPool &getTransferPool() { return *transferPool; }
 
 		void synchronize();
 
@@ -286,17 +289,43 @@ namespace sw
 		#endif
 
 		static int getClusterCount() { return clusterCount; }
+		static int getTileSize() { return tileSize; }   // Zero when clusters own interleaved scanlines
 
 	private:
 		static void threadFunction(void *parameters);
 		void threadLoop(int threadIndex);
-		void taskLoop(int threadIndex);
-		void findAvailableTasks();
-		void scheduleTask(int threadIndex);
-		void executeTask(int threadIndex);
-		void finishRendering(Task &pixelTask);
+		bool takeTask(int threadIndex, int &task);   // Returns false when the thread has to exit
+		bool tryTakeTask(int threadIndex, int &task);
+		void pushTask(int threadIndex, int task);   // Thread index -1 is the application thread
+		void assignBatches(int threadIndex);
+		void releaseUnit(int threadIndex, int unit);
+		bool pixelsReady(int cluster);
+		void dispatchPixels(int threadIndex, int cluster);
+		void executeTask(int threadIndex, int task);
+		void finishRendering(int threadIndex, int unit, int cluster);
+		void updateQueryState();
+
+		struct MemoryAccess
+		{
+			const uint8_t *begin;
+			const uint8_t *end;
+			bool write;
+			bool ordered;   // Ordered with the accesses of the other draws
+			int draw;   // Serial number of the accessing draw
+		};
 
-		void processPrimitiveVertices(int unit, unsigned int start, unsigned int count, unsigned int loop, int thread);
+		struct EventUpdate
+		{
+			vk::Event *event;
+			bool set;
+			int draw;   // Applied once this draw has completed
+		};
+
+		bool isCompleted(int draw) const;
+		void waitForConflicts(const MemoryAccess &access, bool drawOrdered);
+		void updateEvents();
+
+		void processPrimitiveVertices(int unit, const SubDraw &subDraw, unsigned int start, unsigned int count, unsigned int instanceID, int thread);
 
 		int setupTriangles(int batch, int count);
 		int setupLines(int batch, int count);
@@ -312,23 +341,33 @@ namespace sw
 		Context *context;
 		Clipper *clipper;
 		Blitter *blitter;
+		ThreadPool *transferPool;
 		VkViewport viewport;
 		VkRect2D scissor;
 		int clipFlags;
 
-		Triangle *triangleBatch[16];
-		Primitive *primitiveBatch[16];
+		// Sized by initializeThreads() for the configured number of threads,
+		// with one primitive unit and one pixel cluster per thread
+		std::vector<Triangle*> triangleBatch;
+		std::vector<Primitive*> primitiveBatch;
 
 		AtomicInt exitThreads;
-		AtomicInt threadsAwake;
-		Thread *worker[16];
-		Event *resume[16];         // Events for resuming threads
-		Event *suspend[16];        // Events for suspending threads
-		Event *resumeApp;          // Event for resuming the application thread
-
-		PrimitiveProgress primitiveProgress[16];
-		PixelProgress pixelProgress[16];
-		Task task[16];   // Current tasks for threads
+		std::vector<Thread*> worker;
+		Event *resumeApp;   // Event for resuming the application thread
+
+		std::unique_ptr<PrimitiveProgress[]> primitiveProgress;
+		std::unique_ptr<PixelProgress[]> pixelProgress;
+
+		// Task u < unitCount processes the vertices and sets up the primitives of unit u's
+		// batch. Task unitCount + c renders the next batch of cluster c. Threads take tasks
+		// from their own deque, then from the application thread's, then steal them from
+		// each other. Threads which find no tasks spin for a while, then park.
+		std::vector<std::unique_ptr<WorkStealingDeque<int>>> taskDeque;
+		Chan<int> injectedTasks;
+		std::mutex parkMutex;
+		std::condition_variable parkCondition;
+		std::atomic<int> parkedThreads;
+		std::atomic<int> taskEpoch;   // Incremented by each pushed task
 
 		enum {
 			DRAW_COUNT = 16,   // Number of draw calls buffered (must be power of 2)
@@ -339,31 +378,35 @@ namespace sw
 
 		AtomicInt currentDraw;
 		AtomicInt nextDraw;
+		AtomicInt completedDraws;   // Draws complete in the order they were issued
 
-		enum {
-			TASK_COUNT = 32,   // Size of the task queue (must be power of 2)
-			TASK_COUNT_BITS = TASK_COUNT - 1,
-		};
-		Task taskQueue[TASK_COUNT];
-		AtomicInt qHead;
-		AtomicInt qSize;
+		std::vector<MemoryAccess> drawAccesses;   // Accesses of the draws which may be in flight
+		std::vector<MemoryAccess> nextDrawAccesses;
+
+		MutexLock eventMutex;
+		std::vector<EventUpdate> eventUpdates;
+
+		MutexLock batchMutex;   // Guards assigning batches to units
+		std::vector<int> freeUnits;
+		int nextBatch;
+		std::unique_ptr<AtomicInt[]> batchUnit;   // Unit of each batch in flight, indexed by batch
+		int batchUnitMask;
 
 		static AtomicInt unitCount;
 		static AtomicInt clusterCount;
-
-		MutexLock schedulerMutex;
+		static AtomicInt tileSize;
 
 		#if PERF_HUD
-			int64_t vertexTime[16];
-			int64_t setupTime[16];
-			int64_t pixelTime[16];
+			int64_t vertexTime[MAX_THREAD_COUNT];
+			int64_t setupTime[MAX_THREAD_COUNT];
+			int64_t pixelTime[MAX_THREAD_COUNT];
 		#endif
 
-		VertexTask *vertexTask[16];
+		std::vector<VertexTask*> vertexTask;
 
 		SwiftConfig *swiftConfig;
 
-		std::list<Query*> queries;
+		std::list<vk::Query*> queries;
 		Resource *sync;
 
 		VertexProcessor::State vertexState;
@@ -399,11 +442,16 @@ namespace sw
 		vk::ImageView *depthBuffer;
 		vk::ImageView *stencilBuffer;
 
-		std::list<Query*> *queries;
+		std::list<vk::Query*> *queries;
 
-		AtomicInt primitive;    // Current primitive to enter pipeline
-		AtomicInt count;        // Number of primitives to render
-		AtomicInt references;   // Remaining references to this draw call, 0 when done drawing, -1 when resources unlocked and slot is free
+		// Sub-draws and their instances are drawn one after the other, and batches
+		// never straddle two instances. Progress is tracked per instance so that
+		// large instanced draws can't overflow a primitive index.
+		std::vector<SubDraw> subDraws;
+		AtomicInt subDraw;         // Current sub-draw
+		AtomicInt instance;        // Current instance, relative to the sub-draw's first instance
+		AtomicInt primitive;       // Current primitive of the current instance to enter pipeline
+		AtomicInt references;   // Batches in flight, plus one until all are assigned. 0 when done drawing, -1 when resources unlocked and slot is free
 
 		DrawData *data;
 	};
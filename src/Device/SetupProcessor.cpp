@@ -89,10 +89,15 @@ namespace sw
 
 		state.multiSample = context->sampleCount;
 		state.rasterizerDiscard = context->rasterizerDiscard;
+		state.vertexStride = Vertex::stride(context->vertexShader->getOutputComponentCount());
+
+		const auto &vertexOutputs = context->vertexShader->outputs;
 
 		for (int interpolant = 0; interpolant < MAX_INTERFACE_COMPONENTS; interpolant++)
 		{
 			state.gradient[interpolant] = context->pixelShader->inputs[interpolant];
+			state.vertexOutput[interpolant] = interpolant < static_cast<int>(vertexOutputs.size()) &&
+			                                  vertexOutputs[interpolant].Type != SpirvShader::ATTRIBTYPE_UNUSED;
 		}
 
 		state.hash = state.computeHash();
@@ -49,8 +49,10 @@ namespace sw
 			bool vFace                     : 1;
 			unsigned int multiSample       : 3;   // 1, 2 or 4
 			bool rasterizerDiscard         : 1;
+			int vertexStride;   // Vertex::stride() for the vertex shader's outputs
 
 			SpirvShader::InterfaceComponent gradient[MAX_INTERFACE_COMPONENTS];
+			bool vertexOutput[MAX_INTERFACE_COMPONENTS];   // Interface components which the vertex shader writes
 		};
 
 		struct State : States
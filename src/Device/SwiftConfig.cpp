@@ -392,6 +392,13 @@ namespace sw
 		html += "<option value='15'" + (config.threadCount == 15 ? selected : empty) + ">15</option>\n";
 		html += "<option value='16'" + (config.threadCount == 16 ? selected : empty) + ">16</option>\n";
 		html += "</select></td></tr>\n";
+		html += "<tr><td>Tile size:</td><td><select name='tileSize' title='The size of the screen tiles owned by each rendering thread, or interleaved scanlines.'>\n";
+		html += "<option value='0'"   + (config.tileSize == 0   ? selected : empty) + ">Interleaved scanlines (default)</option>\n";
+		html += "<option value='16'"  + (config.tileSize == 16  ? selected : empty) + ">16x16</option>\n";
+		html += "<option value='32'"  + (config.tileSize == 32  ? selected : empty) + ">32x32</option>\n";
+		html += "<option value='64'"  + (config.tileSize == 64  ? selected : empty) + ">64x64</option>\n";
+		html += "<option value='128'" + (config.tileSize == 128 ? selected : empty) + ">128x128</option>\n";
+		html += "</select></td></tr>\n";
 		html += "<tr><td>Enable SSE:</td><td><input name = 'enableSSE' type='checkbox'" + (config.enableSSE ? checked : empty) + " disabled='disabled' title='If checked enables the use of SSE instruction set extentions if supported by the CPU.'></td></tr>";
 		html += "<tr><td>Enable SSE2:</td><td><input name = 'enableSSE2' type='checkbox'" + (config.enableSSE2 ? checked : empty) + " title='If checked enables the use of SSE2 instruction set extentions if supported by the CPU.'></td></tr>";
 		html += "<tr><td>Enable SSE3:</td><td><input name = 'enableSSE3' type='checkbox'" + (config.enableSSE3 ? checked : empty) + " title='If checked enables the use of SSE3 instruction set extentions if supported by the CPU.'></td></tr>";
@@ -608,6 +615,10 @@ namespace sw
 			{
 				config.threadCount = integer;
 			}
+			else if(sscanf(post, "tileSize=%d", &integer))
+			{
+				config.tileSize = integer;
+			}
 			else if(sscanf(post, "frameBufferAPI=%d", &integer))
 			{
 				config.frameBufferAPI = integer;
@@ -725,6 +736,7 @@ namespace sw
 		config.transcendentalPrecision = ini.getInteger("Quality", "TranscendentalPrecision", 2);
 		config.transparencyAntialiasing = ini.getInteger("Quality", "TransparencyAntialiasing", 0);
 		config.threadCount = ini.getInteger("Processor", "ThreadCount", DEFAULT_THREAD_COUNT);
+		config.tileSize = ini.getInteger("Processor", "TileSize", 0);
 		config.enableSSE = ini.getBoolean("Processor", "EnableSSE", true);
 		config.enableSSE2 = ini.getBoolean("Processor", "EnableSSE2", true);
 		config.enableSSE3 = ini.getBoolean("Processor", "EnableSSE3", true);
@@ -782,6 +794,7 @@ namespace sw
 		ini.addValue("Quality", "TranscendentalPrecision", itoa(config.transcendentalPrecision));
 		ini.addValue("Quality", "TransparencyAntialiasing", itoa(config.transparencyAntialiasing));
 		ini.addValue("Processor", "ThreadCount", itoa(config.threadCount));
+		ini.addValue("Processor", "TileSize", itoa(config.tileSize));
 	//	ini.addValue("Processor", "EnableSSE", itoa(config.enableSSE));
 		ini.addValue("Processor", "EnableSSE2", itoa(config.enableSSE2));
 		ini.addValue("Processor", "EnableSSE3", itoa(config.enableSSE3));
@@ -43,6 +43,7 @@ namespace sw
 			bool perspectiveCorrection;
 			int transcendentalPrecision;
 			int threadCount;
+			int tileSize;
 			bool enableSSE;
 			bool enableSSE2;
 			bool enableSSE3;
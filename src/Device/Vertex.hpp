@@ -21,10 +21,10 @@
 
 namespace sw
 {
+	// Vertices are packed to the vertex shader's outputs: only the first components of v[]
+	// which it writes are stored, so vertex arrays must be addressed using stride().
 	ALIGN(16, struct Vertex
 	{
-		float v[MAX_INTERFACE_COMPONENTS];
-
 		struct
 		{
 			float4 position;
@@ -39,7 +39,15 @@ namespace sw
 		} projected;
 
 		int clipFlags;
-		int padding[2];
+		int padding[3];   // Aligns v[] to 16 bytes
+
+		float v[MAX_INTERFACE_COMPONENTS];
+
+		// Size of a vertex storing the first 'components' interface components
+		static int stride(int components)
+		{
+			return OFFSET(Vertex, v) + ((components + 3) & ~3) * sizeof(float);
+		}
 	});
 
 	static_assert((sizeof(Vertex) & 0x0000000F) == 0, "Vertex size not a multiple of 16 bytes (alignment requirement)");
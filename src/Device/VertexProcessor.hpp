@@ -28,8 +28,9 @@ namespace sw
 	{
 		void clear();
 
-		Vertex vertex[16][4];
+		Vertex vertex[16][4];   // Packed to the vertex stride, so small vertices only use the start
 		unsigned int tag[16];
+		unsigned int used[16];   // Mask of the vertices of each line used since it was shaded
 
 		int drawCall;
 	};
@@ -37,7 +38,9 @@ namespace sw
 	struct VertexTask
 	{
 		unsigned int vertexCount;
+		unsigned int invocations;   // Number of distinct vertices shaded, written by the routine
 		unsigned int primitiveStart;
+		unsigned int instanceID;
 		VertexCache vertexCache;
 	};
 
@@ -16,6 +16,9 @@
 
 #include "Vulkan/VkDebug.hpp"
 #include "Vulkan/VkPipelineLayout.hpp"
+#include "System/ThreadPool.hpp"
+
+#include <algorithm>
 
 namespace
 {
@@ -179,29 +182,80 @@ namespace sw
 
 	void ComputeProgram::run(
 		Routine *routine, void** descriptorSets, PushConstantStorage const &pushConstants,
-		uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ)
+		uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ, ThreadPool &pool)
 	{
-		auto runWorkgroup = (void(*)(void*))(routine->getEntry());
+		// Up to 65535^3 workgroups, which doesn't fit in 32 bits
+		const uint64_t groupCount = static_cast<uint64_t>(groupCountX) * groupCountY * groupCountZ;
+		if(groupCount == 0)
+		{
+			return;
+		}
+
+		Dispatch dispatch;
+		dispatch.runWorkgroup = (void(*)(void*))(routine->getEntry());
+		dispatch.descriptorSets = descriptorSets;
+		dispatch.pushConstants = &pushConstants;
+		dispatch.groupCount[X] = groupCountX;
+		dispatch.groupCount[Y] = groupCountY;
+		dispatch.groupCount[Z] = groupCountZ;
+		dispatch.totalGroupCount = groupCount;
+		dispatch.nextGroup = 0;
+
+		// Workgroups are independent of each other, so the flattened workgroup
+		// index range is handed out in batches to whichever thread asks next.
+		// Using several batches per thread balances the load when some
+		// workgroups take longer than others.
+		const uint64_t maxThreadCount = static_cast<uint64_t>(pool.getThreadCount());
+		dispatch.batchSize = std::max(groupCount / (maxThreadCount * BATCHES_PER_THREAD), uint64_t(1));
+
+		const uint64_t batchCount = (groupCount + dispatch.batchSize - 1) / dispatch.batchSize;
+		const int threadCount = static_cast<int>(std::min(maxThreadCount, batchCount));
+
+		// Each of the pool's threads, including the calling one, processes batches until none are left.
+		pool.parallelFor(threadCount, [&dispatch](int) { dispatch.runBatches(); });
+	}
 
+	void ComputeProgram::Dispatch::runBatches()
+	{
+		// Each thread needs its own Data since workgroupID differs per invocation.
 		Data data;
 		data.descriptorSets = descriptorSets;
-		data.numWorkgroups[X] = groupCountX;
-		data.numWorkgroups[Y] = groupCountY;
-		data.numWorkgroups[Z] = groupCountZ;
+		data.numWorkgroups[X] = groupCount[X];
+		data.numWorkgroups[Y] = groupCount[Y];
+		data.numWorkgroups[Z] = groupCount[Z];
 		data.numWorkgroups[3] = 0;
-		data.pushConstants = pushConstants;
+		data.workgroupID[3] = 0;
+		data.pushConstants = *pushConstants;
 
-		// TODO(bclayton): Split work across threads.
-		for (uint32_t groupZ = 0; groupZ < groupCountZ; groupZ++)
+		while(true)
 		{
-			data.workgroupID[Z] = groupZ;
-			for (uint32_t groupY = 0; groupY < groupCountY; groupY++)
+			uint64_t first = nextGroup.fetch_add(batchSize);
+			if(first >= totalGroupCount)
 			{
+				break;
+			}
+
+			uint64_t last = std::min(first + batchSize, totalGroupCount);
+
+			uint32_t groupX = static_cast<uint32_t>(first % groupCount[X]);
+			uint32_t groupY = static_cast<uint32_t>((first / groupCount[X]) % groupCount[Y]);
+			uint32_t groupZ = static_cast<uint32_t>(first / (static_cast<uint64_t>(groupCount[X]) * groupCount[Y]));
+
+			for(uint64_t group = first; group < last; group++)
+			{
+				data.workgroupID[X] = groupX;
 				data.workgroupID[Y] = groupY;
-				for (uint32_t groupX = 0; groupX < groupCountX; groupX++)
+				data.workgroupID[Z] = groupZ;
+				runWorkgroup(&data);
+
+				if(++groupX == groupCount[X])
 				{
-					data.workgroupID[X] = groupX;
-					runWorkgroup(&data);
+					groupX = 0;
+					if(++groupY == groupCount[Y])
+					{
+						groupY = 0;
+						groupZ++;
+					}
 				}
 			}
 		}
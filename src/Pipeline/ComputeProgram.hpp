@@ -20,6 +20,7 @@
 #include "Reactor/Reactor.hpp"
 #include "Device/Context.hpp"
 
+#include <atomic>
 #include <functional>
 
 namespace vk
@@ -33,6 +34,7 @@ namespace sw
 	using namespace rr;
 
 	class DescriptorSetsLayout;
+	class ThreadPool;
 
 	// ComputeProgram builds a SPIR-V compute shader.
 	class ComputeProgram : public Function<Void(Pointer<Byte>)>
@@ -46,10 +48,11 @@ namespace sw
 		void generate();
 
 		// run executes the compute shader routine for all workgroups.
+		// Workgroups are split across the threads of the pool.
 		// TODO(bclayton): This probably does not belong here. Consider moving.
 		static void run(
 			Routine *routine, void** descriptorSets, PushConstantStorage const &pushConstants,
-			uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ);
+			uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ, ThreadPool &pool);
 
 	protected:
 		void emit();
@@ -66,6 +69,23 @@ namespace sw
 			PushConstantStorage pushConstants;
 		};
 
+		// Number of batches each thread should get through in a dispatch, on average.
+		static constexpr uint32_t BATCHES_PER_THREAD = 8;
+
+		// Dispatch holds the state shared by all threads running a single dispatch.
+		struct Dispatch
+		{
+			void runBatches();
+
+			void (*runWorkgroup)(void*);
+			void** descriptorSets;
+			PushConstantStorage const *pushConstants;
+			uint32_t groupCount[3];
+			uint64_t totalGroupCount;
+			uint64_t batchSize;
+			std::atomic<uint64_t> nextGroup;
+		};
+
 		SpirvRoutine routine;
 		SpirvShader const * const shader;
 		vk::PipelineLayout const * const pipelineLayout;
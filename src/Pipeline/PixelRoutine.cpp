@@ -103,6 +103,19 @@ namespace sw
 
 		If(depthPass || Bool(!earlyDepthTest))
 		{
+			if(state.statisticsEnabled)
+			{
+				// One invocation for each covered pixel of the quad
+				Int coverage = cMask[0];
+
+				for(unsigned int q = 1; q < state.multiSample; q++)
+				{
+					coverage |= cMask[q];
+				}
+
+				fragments += *Pointer<UInt>(constants + OFFSET(Constants,occlusionCount) + 4 * coverage);
+			}
+
 			#if PERF_PROFILE
 				Long interpTime = Ticks();
 			#endif
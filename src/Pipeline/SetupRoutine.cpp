@@ -50,9 +50,10 @@ namespace sw
 			const bool line = state.isDrawLine;
 			const bool triangle = state.isDrawTriangle;
 
-			const int V0 = OFFSET(Triangle,v0);
-			const int V1 = (triangle || line) ? OFFSET(Triangle,v1) : OFFSET(Triangle,v0);
-			const int V2 = triangle ? OFFSET(Triangle,v2) : (line ? OFFSET(Triangle,v1) : OFFSET(Triangle,v0));
+			const int stride = state.vertexStride;
+			const int V0 = 0;
+			const int V1 = (triangle || line) ? stride : 0;
+			const int V2 = triangle ? 2 * stride : (line ? stride : 0);
 
 			Pointer<Byte> v0 = tri + V0;
 			Pointer<Byte> v1 = tri + V1;
@@ -192,8 +193,39 @@ namespace sw
 				Return(false);
 			}
 
-			yMin = Max(yMin, *Pointer<Int>(data + OFFSET(DrawData,scissorY0)));
-			yMax = Min(yMax, *Pointer<Int>(data + OFFSET(DrawData,scissorY1)));
+			// Horizontal range, widened by a pixel on each side to include any samples
+			Int xMin = X[0];
+			Int xMax = X[0];
+
+			i = 1;
+
+			Do
+			{
+				xMin = Min(X[i], xMin);
+				xMax = Max(X[i], xMax);
+
+				i++;
+			}
+			Until(i >= n)
+
+			xMin = (xMin >> 4) - 1;
+			xMax = (xMax >> 4) + 2;
+
+			Int scissorX0 = *Pointer<Int>(data + OFFSET(DrawData,scissorX0));
+			Int scissorX1 = *Pointer<Int>(data + OFFSET(DrawData,scissorX1));
+			Int scissorY0 = *Pointer<Int>(data + OFFSET(DrawData,scissorY0));
+			Int scissorY1 = *Pointer<Int>(data + OFFSET(DrawData,scissorY1));
+
+			// Quads straddling the scissor rectangle are masked by the rasterizer
+			xMin = Max(xMin, scissorX0);
+			xMax = Min(xMax, scissorX1);
+			yMin = Max(yMin, scissorY0);
+			yMax = Min(yMax, scissorY1);
+
+			If(xMin >= xMax || yMin >= yMax)
+			{
+				Return(false);
+			}
 
 			For(Int q = 0, q < state.multiSample, q++)
 			{
@@ -217,64 +249,38 @@ namespace sw
 				}
 				Until(i >= n)
 
-				Pointer<Byte> leftEdge = Pointer<Byte>(primitive + OFFSET(Primitive,outline->left)) + q * sizeof(Primitive);
-				Pointer<Byte> rightEdge = Pointer<Byte>(primitive + OFFSET(Primitive,outline->right)) + q * sizeof(Primitive);
-
-				if(state.multiSample > 1)
-				{
-					Int xMin = *Pointer<Int>(data + OFFSET(DrawData, scissorX0));
-					Int xMax = *Pointer<Int>(data + OFFSET(DrawData, scissorX1));
-					Short x = Short(Clamp((X[0] + 0xF) >> 4, xMin, xMax));
-
-					For(Int y = yMin - 1, y < yMax + 1, y++)
-					{
-						*Pointer<Short>(leftEdge + y * sizeof(Primitive::Span)) = x;
-						*Pointer<Short>(rightEdge + y * sizeof(Primitive::Span)) = x;
-					}
-				}
-
 				Xq[n] = Xq[0];
 				Yq[n] = Yq[0];
 
-				// Rasterize
+				Pointer<Byte> edges = primitive + q * sizeof(Primitive) + OFFSET(Primitive,edge);
+				Int edgeCount = 0;
+
+				// Polygon edges
 				{
 					Int i = 0;
 
 					Do
 					{
-						edge(primitive, data, Xq[i + 1 - d], Yq[i + 1 - d], Xq[i + d], Yq[i + d], q);
+						edge(edges, edgeCount, xMin, yMin, Xq[i + 1 - d], Yq[i + 1 - d], Xq[i + d], Yq[i + d]);
 
 						i++;
 					}
 					Until(i >= n)
 				}
 
-				if(state.multiSample == 1)
+				// Pad with always-covered edges up to the count the rasterizer unrolls
+				While(edgeCount < Primitive::unrolledEdges(triangle))
 				{
-					For(, yMin < yMax && *Pointer<Short>(leftEdge + yMin * sizeof(Primitive::Span)) == *Pointer<Short>(rightEdge + yMin * sizeof(Primitive::Span)), yMin++)
-					{
-						// Increments yMin
-					}
-
-					For(, yMax > yMin && *Pointer<Short>(leftEdge + (yMax - 1) * sizeof(Primitive::Span)) == *Pointer<Short>(rightEdge + (yMax - 1) * sizeof(Primitive::Span)), yMax--)
-					{
-						// Decrements yMax
-					}
-
-					If(yMin == yMax)
-					{
-						Return(false);
-					}
-
-					*Pointer<Short>(leftEdge + (yMin - 1) * sizeof(Primitive::Span)) = *Pointer<Short>(leftEdge + yMin * sizeof(Primitive::Span));
-					*Pointer<Short>(rightEdge + (yMin - 1) * sizeof(Primitive::Span)) = *Pointer<Short>(leftEdge + yMin * sizeof(Primitive::Span));
-					*Pointer<Short>(leftEdge + yMax * sizeof(Primitive::Span)) = *Pointer<Short>(leftEdge + (yMax - 1) * sizeof(Primitive::Span));
-					*Pointer<Short>(rightEdge + yMax * sizeof(Primitive::Span)) = *Pointer<Short>(leftEdge + (yMax - 1) * sizeof(Primitive::Span));
+					boundary(edges, edgeCount, 0, 0, 1);
 				}
+
+				*Pointer<Int>(primitive + q * sizeof(Primitive) + OFFSET(Primitive,edgeCount)) = edgeCount;
 			}
 
 			*Pointer<Int>(primitive + OFFSET(Primitive,yMin)) = yMin;
 			*Pointer<Int>(primitive + OFFSET(Primitive,yMax)) = yMax;
+			*Pointer<Int>(primitive + OFFSET(Primitive,xMin)) = xMin;
+			*Pointer<Int>(primitive + OFFSET(Primitive,xMax)) = xMax;
 
 			// Sort by minimum y
 			if(triangle)
@@ -453,13 +459,28 @@ namespace sw
 				// Note: `sprite` mode controls whether to replace this interpolant with the point sprite PointCoord value.
 				// This was an interesting thing to support for old GL because any texture coordinate could be replaced in this way.
 				// In modern GL and in Vulkan, the [gl_]PointCoord builtin variable to the fragment shader is used instead.
-				if (state.gradient[interpolant].Type != SpirvShader::ATTRIBTYPE_UNUSED)
+				if (state.gradient[interpolant].Type == SpirvShader::ATTRIBTYPE_UNUSED)
+					continue;
+
+				// Inputs which the vertex shader doesn't write are undefined, and may not be stored in its
+				// vertices. They're interpolated from zero planes, so that they read as zero.
+				if (state.vertexOutput[interpolant])
+				{
+					ASSERT(OFFSET(Vertex, v[interpolant]) < stride);
+
 					setupGradient(primitive, tri, w012, M, v0, v1, v2,
 							OFFSET(Vertex, v[interpolant]),
 							OFFSET(Primitive, V[interpolant]),
 							state.gradient[interpolant].Flat,
 							false /* is pointcoord */,
 							state.perspective, 0);
+				}
+				else
+				{
+					*Pointer<Float4>(primitive + OFFSET(Primitive, V[interpolant].A), 16) = Float4(0.0f);
+					*Pointer<Float4>(primitive + OFFSET(Primitive, V[interpolant].B), 16) = Float4(0.0f);
+					*Pointer<Float4>(primitive + OFFSET(Primitive, V[interpolant].C), 16) = Float4(0.0f);
+				}
 			}
 
 			Return(true);
@@ -522,7 +543,7 @@ namespace sw
 		}
 		else
 		{
-			int leadingVertex = leadingVertexFirst ? OFFSET(Triangle,v0) : OFFSET(Triangle,v2);
+			int leadingVertex = leadingVertexFirst ? 0 : 2 * state.vertexStride;
 			Float C = *Pointer<Float>(triangle + leadingVertex + attribute);
 
 			*Pointer<Float4>(primitive + planeEquation + 0, 16) = Float4(0, 0, 0, 0);
@@ -531,69 +552,40 @@ namespace sw
 		}
 	}
 
-	void SetupRoutine::edge(Pointer<Byte> &primitive, Pointer<Byte> &data, const Int &Xa, const Int &Ya, const Int &Xb, const Int &Yb, Int &q)
+	void SetupRoutine::edge(Pointer<Byte> &edges, Int &edgeCount, const Int &x0, const Int &y0, const Int &Xa, const Int &Ya, const Int &Xb, const Int &Yb)
 	{
-		If(Ya != Yb)
+		// Sample (16 * x, 16 * y) is on the inside of the edge from (Xa, Ya) to (Xb, Yb) when
+		// E = (16 * x - Xa) * DY - (16 * y - Ya) * DX > 0, or E == 0 for left and top edges,
+		// which go down and left respectively. E needs more than 32 bits, so it's split into
+		// 16 * L + c, where c only depends on the subpixel position of (Xa, Ya), and L is
+		// the value of the edge equation relative to pixel (x0, y0).
+		Int DX = Xb - Xa;
+		Int DY = Yb - Ya;
+
+		If(DX != 0 || DY != 0)
 		{
-			Bool swap = Yb < Ya;
-
-			Int X1 = IfThenElse(swap, Xb, Xa);
-			Int X2 = IfThenElse(swap, Xa, Xb);
-			Int Y1 = IfThenElse(swap, Yb, Ya);
-			Int Y2 = IfThenElse(swap, Ya, Yb);
-
-			Int y1 = Max((Y1 + 0x0000000F) >> 4, *Pointer<Int>(data + OFFSET(DrawData,scissorY0)));
-			Int y2 = Min((Y2 + 0x0000000F) >> 4, *Pointer<Int>(data + OFFSET(DrawData,scissorY1)));
-
-			If(y1 < y2)
-			{
-				Int xMin = *Pointer<Int>(data + OFFSET(DrawData,scissorX0));
-				Int xMax = *Pointer<Int>(data + OFFSET(DrawData,scissorX1));
-
-				Pointer<Byte> leftEdge = primitive + q * sizeof(Primitive) + OFFSET(Primitive,outline->left);
-				Pointer<Byte> rightEdge = primitive + q * sizeof(Primitive) + OFFSET(Primitive,outline->right);
-				Pointer<Byte> edge = IfThenElse(swap, rightEdge, leftEdge);
-
-				// Deltas
-				Int DX12 = X2 - X1;
-				Int DY12 = Y2 - Y1;
-
-				Int FDX12 = DX12 << 4;
-				Int FDY12 = DY12 << 4;
+			Int L = (x0 - (Xa >> 4)) * DY - (y0 - (Ya >> 4)) * DX;
+			Int c = (Ya & 0x0000000F) * DX - (Xa & 0x0000000F) * DY;
 
-				Int X = DX12 * ((y1 << 4) - Y1) + (X1 & 0x0000000F) * DY12;
-				Int x = (X1 >> 4) + X / FDY12;   // Edge
-				Int d = X % FDY12;               // Error-term
-				Int ceil = -d >> 31;             // Ceiling division: remainder <= 0
-				x -= ceil;
-				d -= ceil & FDY12;
+			Bool topLeft = DY > 0 || (DY == 0 && DX < 0);
+			Int bias = IfThenElse(topLeft, Int(1), Int(0));
 
-				Int Q = FDX12 / FDY12;   // Edge-step
-				Int R = FDX12 % FDY12;   // Error-step
-				Int floor = R >> 31;     // Flooring division: remainder >= 0
-				Q += floor;
-				R += floor & FDY12;
-
-				Int D = FDY12;   // Error-overflow
-				Int y = y1;
-
-				Do
-				{
-					*Pointer<Short>(edge + y * sizeof(Primitive::Span)) = Short(Clamp(x, xMin, xMax));
+			// E + bias > 0 when L >= ceil((1 - bias - c) / 16)
+			Int T = (16 - bias - c) >> 4;
 
-					x += Q;
-					d += R;
+			boundary(edges, edgeCount, DY, -DX, L - T + 1);
+		}
+	}
 
-					Int overflow = -d >> 31;
+	void SetupRoutine::boundary(Pointer<Byte> &edges, Int &edgeCount, const Int &A, const Int &B, const Int &C)
+	{
+		Pointer<Byte> edge = edges + edgeCount * sizeof(Primitive::Edge);
 
-					d -= D & overflow;
-					x -= overflow;
+		*Pointer<Int>(edge + OFFSET(Primitive::Edge,A)) = A;
+		*Pointer<Int>(edge + OFFSET(Primitive::Edge,B)) = B;
+		*Pointer<Int>(edge + OFFSET(Primitive::Edge,C)) = C;
 
-					y++;
-				}
-				Until(y >= y2)
-			}
-		}
+		edgeCount++;
 	}
 
 	void SetupRoutine::conditionalRotate1(Bool condition, Pointer<Byte> &v0, Pointer<Byte> &v1, Pointer<Byte> &v2)
@@ -312,6 +312,17 @@ namespace sw
 			return inputBuiltins.find(b) != inputBuiltins.end();
 		}
 
+		// Number of user-defined output components, up to the last one written
+		int getOutputComponentCount() const
+		{
+			int count = static_cast<int>(outputs.size());
+			while(count > 0 && outputs[count - 1].Type == ATTRIBTYPE_UNUSED)
+			{
+				count--;
+			}
+			return count;
+		}
+
 		struct Decorations
 		{
 			int32_t Location;
@@ -41,7 +41,7 @@ namespace sw
 			// TODO: we could do better here; we know InstanceIndex is uniform across all lanes
 			assert(it->second.SizeInComponents == 1);
 			routine.getValue(it->second.Id)[it->second.FirstComponent] =
-					As<Float4>(Int4((*Pointer<Int>(data + OFFSET(DrawData, instanceID)))));
+					As<Float4>(Int4((*Pointer<Int>(task + OFFSET(VertexTask, instanceID)))));
 		}
 
 		routine.pushConstants = data + OFFSET(DrawData, pushConstants);
@@ -30,7 +30,8 @@ namespace sw
 			SpirvShader const *spirvShader)
 		: routine(pipelineLayout),
 		  state(state),
-		  spirvShader(spirvShader)
+		  spirvShader(spirvShader),
+		  vertexStride(Vertex::stride(spirvShader->getOutputComponentCount()))
 	{
 	  	spirvShader->emitProlog(&routine);
 	}
@@ -46,8 +47,10 @@ namespace sw
 		Pointer<Byte> cache = task + OFFSET(VertexTask,vertexCache);
 		Pointer<Byte> vertexCache = cache + OFFSET(VertexCache,vertex);
 		Pointer<Byte> tagCache = cache + OFFSET(VertexCache,tag);
+		Pointer<Byte> usedCache = cache + OFFSET(VertexCache,used);
 
 		UInt vertexCount = *Pointer<UInt>(task + OFFSET(VertexTask,vertexCount));
+		UInt invocations = 0;
 
 		constants = *Pointer<Pointer<Byte>>(data + OFFSET(DrawData,constants));
 
@@ -65,20 +68,34 @@ namespace sw
 				program(indexQ);
 				computeClipFlags();
 
-				Pointer<Byte> cacheLine0 = vertexCache + tagIndex * UInt((int)sizeof(Vertex));
+				*Pointer<UInt>(usedCache + tagIndex) = 0;
+
+				Pointer<Byte> cacheLine0 = vertexCache + tagIndex * UInt(vertexStride);
 				writeCache(cacheLine0);
 			}
 
+			// The shader runs on a whole line of vertices, but only counts as being
+			// invoked for the ones which get used.
+			UInt usedMask = UInt(1) << (index & 0x00000003);
+			UInt used = *Pointer<UInt>(usedCache + tagIndex);
+			If((used & usedMask) == 0)
+			{
+				*Pointer<UInt>(usedCache + tagIndex) = used | usedMask;
+				invocations += 1;
+			}
+
 			UInt cacheIndex = index & 0x0000003F;
-			Pointer<Byte> cacheLine = vertexCache + cacheIndex * UInt((int)sizeof(Vertex));
+			Pointer<Byte> cacheLine = vertexCache + cacheIndex * UInt(vertexStride);
 			writeVertex(vertex, cacheLine);
 
-			vertex += sizeof(Vertex);
+			vertex += vertexStride;
 			batch += sizeof(unsigned int);
 			vertexCount--;
 		}
 		Until(vertexCount == 0)
 
+		*Pointer<UInt>(task + OFFSET(VertexTask,invocations)) = invocations;
+
 		Return();
 	}
 
@@ -509,17 +526,17 @@ namespace sw
 
 				transpose4x4(v.x, v.y, v.z, v.w);
 
-				*Pointer<Float4>(cacheLine + OFFSET(Vertex,v[i]) + sizeof(Vertex) * 0, 16) = v.x;
-				*Pointer<Float4>(cacheLine + OFFSET(Vertex,v[i]) + sizeof(Vertex) * 1, 16) = v.y;
-				*Pointer<Float4>(cacheLine + OFFSET(Vertex,v[i]) + sizeof(Vertex) * 2, 16) = v.z;
-				*Pointer<Float4>(cacheLine + OFFSET(Vertex,v[i]) + sizeof(Vertex) * 3, 16) = v.w;
+				*Pointer<Float4>(cacheLine + OFFSET(Vertex,v[i]) + vertexStride * 0, 16) = v.x;
+				*Pointer<Float4>(cacheLine + OFFSET(Vertex,v[i]) + vertexStride * 1, 16) = v.y;
+				*Pointer<Float4>(cacheLine + OFFSET(Vertex,v[i]) + vertexStride * 2, 16) = v.z;
+				*Pointer<Float4>(cacheLine + OFFSET(Vertex,v[i]) + vertexStride * 3, 16) = v.w;
 			}
 		}
 
-		*Pointer<Int>(cacheLine + OFFSET(Vertex,clipFlags) + sizeof(Vertex) * 0) = (clipFlags >> 0)  & 0x0000000FF;
-		*Pointer<Int>(cacheLine + OFFSET(Vertex,clipFlags) + sizeof(Vertex) * 1) = (clipFlags >> 8)  & 0x0000000FF;
-		*Pointer<Int>(cacheLine + OFFSET(Vertex,clipFlags) + sizeof(Vertex) * 2) = (clipFlags >> 16) & 0x0000000FF;
-		*Pointer<Int>(cacheLine + OFFSET(Vertex,clipFlags) + sizeof(Vertex) * 3) = (clipFlags >> 24) & 0x0000000FF;
+		*Pointer<Int>(cacheLine + OFFSET(Vertex,clipFlags) + vertexStride * 0) = (clipFlags >> 0)  & 0x0000000FF;
+		*Pointer<Int>(cacheLine + OFFSET(Vertex,clipFlags) + vertexStride * 1) = (clipFlags >> 8)  & 0x0000000FF;
+		*Pointer<Int>(cacheLine + OFFSET(Vertex,clipFlags) + vertexStride * 2) = (clipFlags >> 16) & 0x0000000FF;
+		*Pointer<Int>(cacheLine + OFFSET(Vertex,clipFlags) + vertexStride * 3) = (clipFlags >> 24) & 0x0000000FF;
 
 		// Viewport transform
 		auto it = spirvShader->outputBuiltins.find(spv::BuiltInPosition);
@@ -540,10 +557,10 @@ namespace sw
 		Vector4f v2 = v;
 		transpose4x4(v2.x, v2.y, v2.z, v2.w);
 
-		*Pointer<Float4>(cacheLine + OFFSET(Vertex,builtins.position) + sizeof(Vertex) * 0, 16) = v2.x;
-		*Pointer<Float4>(cacheLine + OFFSET(Vertex,builtins.position) + sizeof(Vertex) * 1, 16) = v2.y;
-		*Pointer<Float4>(cacheLine + OFFSET(Vertex,builtins.position) + sizeof(Vertex) * 2, 16) = v2.z;
-		*Pointer<Float4>(cacheLine + OFFSET(Vertex,builtins.position) + sizeof(Vertex) * 3, 16) = v2.w;
+		*Pointer<Float4>(cacheLine + OFFSET(Vertex,builtins.position) + vertexStride * 0, 16) = v2.x;
+		*Pointer<Float4>(cacheLine + OFFSET(Vertex,builtins.position) + vertexStride * 1, 16) = v2.y;
+		*Pointer<Float4>(cacheLine + OFFSET(Vertex,builtins.position) + vertexStride * 2, 16) = v2.z;
+		*Pointer<Float4>(cacheLine + OFFSET(Vertex,builtins.position) + vertexStride * 3, 16) = v2.w;
 
 		Float4 w = As<Float4>(As<Int4>(v.w) | (As<Int4>(CmpEQ(v.w, Float4(0.0f))) & As<Int4>(Float4(1.0f))));
 		Float4 rhw = Float4(1.0f) / w;
@@ -555,37 +572,29 @@ namespace sw
 
 		transpose4x4(v.x, v.y, v.z, v.w);
 
-		*Pointer<Float4>(cacheLine + OFFSET(Vertex,projected) + sizeof(Vertex) * 0, 16) = v.x;
-		*Pointer<Float4>(cacheLine + OFFSET(Vertex,projected) + sizeof(Vertex) * 1, 16) = v.y;
-		*Pointer<Float4>(cacheLine + OFFSET(Vertex,projected) + sizeof(Vertex) * 2, 16) = v.z;
-		*Pointer<Float4>(cacheLine + OFFSET(Vertex,projected) + sizeof(Vertex) * 3, 16) = v.w;
+		*Pointer<Float4>(cacheLine + OFFSET(Vertex,projected) + vertexStride * 0, 16) = v.x;
+		*Pointer<Float4>(cacheLine + OFFSET(Vertex,projected) + vertexStride * 1, 16) = v.y;
+		*Pointer<Float4>(cacheLine + OFFSET(Vertex,projected) + vertexStride * 2, 16) = v.z;
+		*Pointer<Float4>(cacheLine + OFFSET(Vertex,projected) + vertexStride * 3, 16) = v.w;
 
 		it = spirvShader->outputBuiltins.find(spv::BuiltInPointSize);
 		if (it != spirvShader->outputBuiltins.end())
 		{
 			assert(it->second.SizeInComponents == 1);
 			auto psize = routine.getValue(it->second.Id)[it->second.FirstComponent];
-			*Pointer<Float>(cacheLine + OFFSET(Vertex,builtins.pointSize) + sizeof(Vertex) * 0) = Extract(psize, 0);
-			*Pointer<Float>(cacheLine + OFFSET(Vertex,builtins.pointSize) + sizeof(Vertex) * 1) = Extract(psize, 1);
-			*Pointer<Float>(cacheLine + OFFSET(Vertex,builtins.pointSize) + sizeof(Vertex) * 2) = Extract(psize, 2);
-			*Pointer<Float>(cacheLine + OFFSET(Vertex,builtins.pointSize) + sizeof(Vertex) * 3) = Extract(psize, 3);
+			*Pointer<Float>(cacheLine + OFFSET(Vertex,builtins.pointSize) + vertexStride * 0) = Extract(psize, 0);
+			*Pointer<Float>(cacheLine + OFFSET(Vertex,builtins.pointSize) + vertexStride * 1) = Extract(psize, 1);
+			*Pointer<Float>(cacheLine + OFFSET(Vertex,builtins.pointSize) + vertexStride * 2) = Extract(psize, 2);
+			*Pointer<Float>(cacheLine + OFFSET(Vertex,builtins.pointSize) + vertexStride * 3) = Extract(psize, 3);
 		}
 	}
 
 	void VertexRoutine::writeVertex(const Pointer<Byte> &vertex, Pointer<Byte> &cache)
 	{
-		for(int i = 0; i < MAX_INTERFACE_COMPONENTS; i++)
+		// Vertices are packed, so they're copied whole
+		for(int i = 0; i < vertexStride; i += 16)
 		{
-			if(spirvShader->outputs[i].Type != SpirvShader::ATTRIBTYPE_UNUSED)
-			{
-				*Pointer<Int>(vertex + OFFSET(Vertex, v[i]), 4) = *Pointer<Int>(cache + OFFSET(Vertex, v[i]), 4);
-			}
+			*Pointer<Int4>(vertex + i, 16) = *Pointer<Int4>(cache + i, 16);
 		}
-
-		*Pointer<Int4>(vertex + OFFSET(Vertex,projected)) = *Pointer<Int4>(cache + OFFSET(Vertex,projected));
-		*Pointer<Int>(vertex + OFFSET(Vertex,clipFlags)) = *Pointer<Int>(cache + OFFSET(Vertex,clipFlags));
-		*Pointer<Int4>(vertex + OFFSET(Vertex,builtins.position)) = *Pointer<Int4>(cache + OFFSET(Vertex,builtins.position));
-		*Pointer<Int>(vertex + OFFSET(Vertex,builtins.pointSize)) = *Pointer<Int>(cache + OFFSET(Vertex,builtins.pointSize));
-
 	}
 }
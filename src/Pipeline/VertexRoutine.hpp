@@ -60,6 +60,7 @@ namespace sw
 
 		const VertexProcessor::State &state;
 		SpirvShader const * const spirvShader;
+		const int vertexStride;   // Vertex::stride() for the shader's outputs
 
 	private:
 		virtual void program(UInt &index) = 0;
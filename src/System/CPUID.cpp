@@ -38,6 +38,7 @@ namespace sw
 	bool CPUID::SSE4_1 = detectSSE4_1();
 	int CPUID::cores = detectCoreCount();
 	int CPUID::affinity = detectAffinity();
+	size_t CPUID::cacheSize = detectLastLevelCacheSize();
 
 	bool CPUID::enableMMX = true;
 	bool CPUID::enableCMOV = true;
@@ -251,7 +252,6 @@ namespace sw
 		#endif
 
 		if(cores < 1)  cores = 1;
-		if(cores > 16) cores = 16;
 
 		return cores;   // FIXME: Number of physical cores
 	}
@@ -280,11 +280,31 @@ namespace sw
 		#endif
 
 		if(cores < 1)  cores = 1;
-		if(cores > 16) cores = 16;
 
 		return cores;
 	}
 
+	size_t CPUID::detectLastLevelCacheSize()
+	{
+		long size = 0;
+
+		#if defined(_SC_LEVEL3_CACHE_SIZE)
+			size = sysconf(_SC_LEVEL3_CACHE_SIZE);
+
+			if(size <= 0)
+			{
+				size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+			}
+		#endif
+
+		if(size <= 0)
+		{
+			size = 8 * 1024 * 1024;   // FIXME: Query the cache hierarchy on other platforms
+		}
+
+		return static_cast<size_t>(size);
+	}
+
 	void CPUID::setFlushToZero(bool enable)
 	{
 		#if defined(_MSC_VER)
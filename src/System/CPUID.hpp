@@ -15,6 +15,8 @@
 #ifndef sw_CPUID_hpp
 #define sw_CPUID_hpp
 
+#include <stddef.h>
+
 namespace sw
 {
 	#if !defined(__i386__) && defined(_M_IX86)
@@ -38,6 +40,7 @@ namespace sw
 		static bool supportsSSE4_1();
 		static int coreCount();
 		static int processAffinity();
+		static size_t lastLevelCacheSize();   // In bytes
 
 		static void setEnableMMX(bool enable);
 		static void setEnableCMOV(bool enable);
@@ -60,6 +63,7 @@ namespace sw
 		static bool SSE4_1;
 		static int cores;
 		static int affinity;
+		static size_t cacheSize;
 
 		static bool enableMMX;
 		static bool enableCMOV;
@@ -78,6 +82,7 @@ namespace sw
 		static bool detectSSE4_1();
 		static int detectCoreCount();
 		static int detectAffinity();
+		static size_t detectLastLevelCacheSize();
 	};
 }
 
@@ -132,6 +137,11 @@ namespace sw
 	{
 		return affinity;
 	}
+
+	inline size_t CPUID::lastLevelCacheSize()
+	{
+		return cacheSize;
+	}
 }
 
 #endif   // sw_CPUID_hpp
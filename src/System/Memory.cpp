@@ -14,8 +14,10 @@
 
 #include "Memory.hpp"
 
+#include "CPUID.hpp"
 #include "Types.hpp"
 #include "Debug.hpp"
+#include "ThreadPool.hpp"
 
 #if defined(_WIN32)
 	#ifndef WIN32_LEAN_AND_MEAN
@@ -30,7 +32,9 @@
 	#include <unistd.h>
 #endif
 
+#include <algorithm>
 #include <cstring>
+#include <vector>
 
 #undef allocate
 #undef deallocate
@@ -39,10 +43,38 @@
 #define __x86__
 #endif
 
+#if defined(__x86__)
+	#include <emmintrin.h>
+#endif
+
 namespace sw
 {
 namespace
 {
+// Transparent huge pages are only requested for allocations spanning several of them,
+// since the alignment they require wastes address space.
+const size_t hugePageSize = 2 * 1024 * 1024;
+const size_t minHugePageAllocation = 4 * hugePageSize;
+
+// Copies are only split across threads when each one gets a sizeable amount of work
+const size_t minParallelBytes = 256 * 1024;
+const size_t minTaskBytes = 64 * 1024;
+const size_t streamingAlignment = 64;   // Cache line size
+
+// Number of tasks to split a transfer of the given size into. Returns 1 for serial execution.
+int taskCount(const ThreadPool &pool, size_t bytes)
+{
+	if(bytes < minParallelBytes || pool.getThreadCount() == 1)
+	{
+		return 1;
+	}
+
+	// More tasks than threads balances the load when some threads are busy elsewhere
+	size_t maxTasks = 4 * static_cast<size_t>(pool.getThreadCount());
+
+	return static_cast<int>(std::min(maxTasks, bytes / minTaskBytes));
+}
+
 struct Allocation
 {
 //	size_t bytes;
@@ -132,12 +164,103 @@ void deallocate(void *memory)
 	#endif
 }
 
+void *allocateUncommitted(size_t bytes)
+{
+	#if defined(_WIN32)
+		// Committed pages only get physical storage when first accessed
+		return VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+	#else
+		size_t pageSize = memoryPageSize();
+		bytes = (bytes + pageSize - 1) & ~(pageSize - 1);
+
+		#if defined(__linux__) && defined(MADV_HUGEPAGE)
+			if(bytes >= minHugePageAllocation)
+			{
+				// Reserve extra space to align the allocation to the huge page size, and release the excess.
+				size_t length = bytes + hugePageSize;
+				void *mapping = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+				if(mapping == MAP_FAILED)
+				{
+					return nullptr;
+				}
+
+				uintptr_t start = reinterpret_cast<uintptr_t>(mapping);
+				uintptr_t aligned = (start + hugePageSize - 1) & ~(uintptr_t)(hugePageSize - 1);
+				uintptr_t end = start + length;
+
+				if(aligned > start)
+				{
+					munmap(mapping, aligned - start);
+				}
+
+				if(end > aligned + bytes)
+				{
+					munmap(reinterpret_cast<void*>(aligned + bytes), end - (aligned + bytes));
+				}
+
+				// Failure just means huge pages aren't available
+				madvise(reinterpret_cast<void*>(aligned), bytes, MADV_HUGEPAGE);
+
+				return reinterpret_cast<void*>(aligned);
+			}
+		#endif
+
+		void *mapping = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+		return (mapping != MAP_FAILED) ? mapping : nullptr;
+	#endif
+}
+
+void deallocateUncommitted(void *memory, size_t bytes)
+{
+	if(!memory)
+	{
+		return;
+	}
+
+	#if defined(_WIN32)
+		VirtualFree(memory, 0, MEM_RELEASE);
+	#else
+		size_t pageSize = memoryPageSize();
+		munmap(memory, (bytes + pageSize - 1) & ~(pageSize - 1));
+	#endif
+}
+
+size_t committedBytes(const void *memory, size_t bytes)
+{
+	#if defined(_WIN32)
+		return bytes;
+	#else
+		size_t pageSize = memoryPageSize();
+		size_t pageCount = (bytes + pageSize - 1) / pageSize;
+
+		#if defined(__APPLE__)
+			std::vector<char> residency(pageCount);
+		#else
+			std::vector<unsigned char> residency(pageCount);
+		#endif
+
+		if(mincore(const_cast<void*>(memory), pageCount * pageSize, residency.data()) != 0)
+		{
+			return bytes;
+		}
+
+		size_t residentPages = 0;
+		for(size_t i = 0; i < pageCount; i++)
+		{
+			residentPages += residency[i] & 1;
+		}
+
+		return (residentPages * pageSize < bytes) ? residentPages * pageSize : bytes;
+	#endif
+}
+
 void clear(uint16_t *memory, uint16_t element, size_t count)
 {
 	#if defined(_MSC_VER) && defined(__x86__) && !defined(MEMORY_SANITIZER)
 		__stosw(memory, element, count);
 	#elif defined(__GNUC__) && defined(__x86__) && !defined(MEMORY_SANITIZER)
-		__asm__("rep stosw" : : "D"(memory), "a"(element), "c"(count));
+		__asm__ __volatile__("rep stosw" : "+D"(memory), "+c"(count) : "a"(element) : "memory");
 	#else
 		for(size_t i = 0; i < count; i++)
 		{
@@ -151,7 +274,7 @@ void clear(uint32_t *memory, uint32_t element, size_t count)
 	#if defined(_MSC_VER) && defined(__x86__) && !defined(MEMORY_SANITIZER)
 		__stosd((unsigned long*)memory, element, count);
 	#elif defined(__GNUC__) && defined(__x86__) && !defined(MEMORY_SANITIZER)
-		__asm__("rep stosl" : : "D"(memory), "a"(element), "c"(count));
+		__asm__ __volatile__("rep stosl" : "+D"(memory), "+c"(count) : "a"(element) : "memory");
 	#else
 		for(size_t i = 0; i < count; i++)
 		{
@@ -159,4 +282,179 @@ void clear(uint32_t *memory, uint32_t element, size_t count)
 		}
 	#endif
 }
+
+void copyStreaming(void *destination, const void *source, size_t bytes)
+{
+	#if defined(__x86__) && !defined(MEMORY_SANITIZER)
+		uint8_t *dst = static_cast<uint8_t*>(destination);
+		const uint8_t *src = static_cast<const uint8_t*>(source);
+
+		// Non-temporal stores require 16-byte aligned destinations
+		size_t head = (16 - (reinterpret_cast<uintptr_t>(dst) & 15)) & 15;
+		if(bytes < head + streamingAlignment)
+		{
+			memcpy(dst, src, bytes);
+			return;
+		}
+
+		memcpy(dst, src, head);
+		dst += head;
+		src += head;
+		bytes -= head;
+
+		for(; bytes >= 64; bytes -= 64, dst += 64, src += 64)
+		{
+			__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src) + 0);
+			__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src) + 1);
+			__m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src) + 2);
+			__m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src) + 3);
+
+			_mm_stream_si128(reinterpret_cast<__m128i*>(dst) + 0, a);
+			_mm_stream_si128(reinterpret_cast<__m128i*>(dst) + 1, b);
+			_mm_stream_si128(reinterpret_cast<__m128i*>(dst) + 2, c);
+			_mm_stream_si128(reinterpret_cast<__m128i*>(dst) + 3, d);
+		}
+
+		_mm_sfence();   // Order the non-temporal stores before subsequent ones
+
+		memcpy(dst, src, bytes);
+	#else
+		memcpy(destination, source, bytes);
+	#endif
+}
+
+void clearStreaming(uint32_t *memory, uint32_t element, size_t count)
+{
+	#if defined(__x86__) && !defined(MEMORY_SANITIZER)
+		for(; count > 0 && (reinterpret_cast<uintptr_t>(memory) & 15) != 0; count--)
+		{
+			*memory++ = element;
+		}
+
+		__m128i value = _mm_set1_epi32(static_cast<int>(element));
+
+		for(; count >= 16; count -= 16, memory += 16)
+		{
+			_mm_stream_si128(reinterpret_cast<__m128i*>(memory) + 0, value);
+			_mm_stream_si128(reinterpret_cast<__m128i*>(memory) + 1, value);
+			_mm_stream_si128(reinterpret_cast<__m128i*>(memory) + 2, value);
+			_mm_stream_si128(reinterpret_cast<__m128i*>(memory) + 3, value);
+		}
+
+		_mm_sfence();
+
+		clear(memory, element, count);
+	#else
+		clear(memory, element, count);
+	#endif
+}
+
+void copyRows(ThreadPool &pool, void *destination, const void *source,
+              size_t rowBytes, size_t rowCount, size_t sliceCount,
+              size_t destinationRowPitch, size_t sourceRowPitch,
+              size_t destinationSlicePitch, size_t sourceSlicePitch)
+{
+	uint8_t *dst = static_cast<uint8_t*>(destination);
+	const uint8_t *src = static_cast<const uint8_t*>(source);
+
+	size_t rows = rowCount * sliceCount;
+	size_t totalBytes = rowBytes * rows;
+
+	if(totalBytes == 0)
+	{
+		return;
+	}
+
+	// Destinations which don't fit in the cache would only evict useful data from it
+	bool streaming = totalBytes > CPUID::lastLevelCacheSize();
+	auto copyRow = [streaming](void *d, const void *s, size_t n)
+	{
+		if(streaming)
+		{
+			copyStreaming(d, s, n);
+		}
+		else
+		{
+			memcpy(d, s, n);
+		}
+	};
+
+	int tasks = taskCount(pool, totalBytes);
+
+	if(rows >= static_cast<size_t>(tasks))
+	{
+		// Each task copies a range of rows
+		pool.parallelFor(tasks, [&](int task)
+		{
+			size_t begin = rows * task / tasks;
+			size_t end = rows * (task + 1) / tasks;
+
+			for(size_t row = begin; row < end; row++)
+			{
+				size_t z = row / rowCount;
+				size_t y = row % rowCount;
+
+				copyRow(dst + z * destinationSlicePitch + y * destinationRowPitch,
+				        src + z * sourceSlicePitch + y * sourceRowPitch, rowBytes);
+			}
+		});
+	}
+	else
+	{
+		// Each task copies a range of a row, split on cache line boundaries
+		size_t rowTasks = (tasks + rows - 1) / rows;
+		size_t chunkBytes = (rowBytes / rowTasks + streamingAlignment - 1) & ~(streamingAlignment - 1);
+		rowTasks = (rowBytes + chunkBytes - 1) / chunkBytes;
+
+		pool.parallelFor(static_cast<int>(rows * rowTasks), [&](int task)
+		{
+			size_t row = task / rowTasks;
+			size_t begin = (task % rowTasks) * chunkBytes;
+			size_t bytes = std::min(chunkBytes, rowBytes - begin);
+
+			size_t z = row / rowCount;
+			size_t y = row % rowCount;
+
+			copyRow(dst + z * destinationSlicePitch + y * destinationRowPitch + begin,
+			        src + z * sourceSlicePitch + y * sourceRowPitch + begin, bytes);
+		});
+	}
+}
+
+void copy(ThreadPool &pool, void *destination, const void *source, size_t bytes)
+{
+	copyRows(pool, destination, source, bytes, 1, 1, 0, 0, 0, 0);
+}
+
+void clear(ThreadPool &pool, uint32_t *memory, uint32_t element, size_t count)
+{
+	if(count == 0)
+	{
+		return;
+	}
+
+	size_t totalBytes = count * sizeof(uint32_t);
+	bool streaming = totalBytes > CPUID::lastLevelCacheSize();
+	auto clearRange = [streaming](uint32_t *m, uint32_t e, size_t n)
+	{
+		if(streaming)
+		{
+			clearStreaming(m, e, n);
+		}
+		else
+		{
+			clear(m, e, n);
+		}
+	};
+
+	int tasks = taskCount(pool, totalBytes);
+	size_t chunk = (count / tasks + 15) & ~static_cast<size_t>(15);   // Multiple of 64 bytes
+	tasks = static_cast<int>((count + chunk - 1) / chunk);
+
+	pool.parallelFor(tasks, [&](int task)
+	{
+		size_t begin = task * chunk;
+		clearRange(memory + begin, element, std::min(chunk, count - begin));
+	});
+}
 }
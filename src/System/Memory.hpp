@@ -20,13 +20,35 @@
 
 namespace sw
 {
+class ThreadPool;
+
 size_t memoryPageSize();
 
 void *allocate(size_t bytes, size_t alignment = 16);
 void deallocate(void *memory);
 
+// Allocates page-aligned, zero-initialized memory whose pages are only committed
+// when first accessed. Large allocations are backed by huge pages when supported.
+void *allocateUncommitted(size_t bytes);
+void deallocateUncommitted(void *memory, size_t bytes);
+size_t committedBytes(const void *memory, size_t bytes);   // Of allocateUncommitted() memory
+
 void clear(uint16_t *memory, uint16_t element, size_t count);
 void clear(uint32_t *memory, uint32_t element, size_t count);
+
+// Same as memcpy() and clear(), but with non-temporal stores which bypass the cache
+void copyStreaming(void *destination, const void *source, size_t bytes);
+void clearStreaming(uint32_t *memory, uint32_t element, size_t count);
+
+// Copies sliceCount slices of rowCount rows of rowBytes each. Large copies are split
+// into row ranges run by the pool's threads, and use non-temporal stores when they
+// don't fit in the last level cache. Rows are split as well when there are few of them.
+void copyRows(ThreadPool &pool, void *destination, const void *source,
+              size_t rowBytes, size_t rowCount, size_t sliceCount,
+              size_t destinationRowPitch, size_t sourceRowPitch,
+              size_t destinationSlicePitch, size_t sourceSlicePitch);
+void copy(ThreadPool &pool, void *destination, const void *source, size_t bytes);
+void clear(ThreadPool &pool, uint32_t *memory, uint32_t element, size_t count);
 }
 
 #endif   // Memory_hpp
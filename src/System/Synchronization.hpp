@@ -0,0 +1,194 @@
+// Copyright 2019 The SwiftShader Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef sw_Synchronization_hpp
+#define sw_Synchronization_hpp
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <queue>
+
+namespace sw
+{
+	// WaitGroup is a counter of outstanding tasks. add() increments the
+	// counter, done() decrements it, and wait() blocks until it reaches zero.
+	class WaitGroup
+	{
+	public:
+		void add(unsigned int count = 1)
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			pending += count;
+		}
+
+		// Returns true when this call brought the counter back down to zero.
+		bool done()
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			pending--;
+			if(pending == 0)
+			{
+				condition.notify_all();
+				return true;
+			}
+			return false;
+		}
+
+		void wait()
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			condition.wait(lock, [this] { return pending == 0; });
+		}
+
+		// Returns false if the timeout expired before the counter reached zero.
+		template<class CLOCK, class DURATION>
+		bool wait(const std::chrono::time_point<CLOCK, DURATION>& timeout)
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			return condition.wait_until(lock, timeout, [this] { return pending == 0; });
+		}
+
+	private:
+		unsigned int pending = 0;
+		std::mutex mutex;
+		std::condition_variable condition;
+	};
+
+	// Chan is a thread-safe FIFO queue. take() blocks until an item is available.
+	template<typename T>
+	class Chan
+	{
+	public:
+		T take()
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			added.wait(lock, [this] { return !queue.empty(); });
+			T item = queue.front();
+			queue.pop();
+			return item;
+		}
+
+		void put(const T &item)
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			queue.push(item);
+			added.notify_one();
+		}
+
+		// Returns false instead of blocking when the queue is empty.
+		bool tryTake(T &item)
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			if(queue.empty())
+			{
+				return false;
+			}
+			item = queue.front();
+			queue.pop();
+			return true;
+		}
+
+		size_t count()
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			return queue.size();
+		}
+
+	private:
+		std::queue<T> queue;
+		std::mutex mutex;
+		std::condition_variable added;
+	};
+
+	// WorkStealingDeque is a bounded Chase-Lev deque. The thread which owns it
+	// pushes and pops items at the bottom, while other threads steal them from
+	// the top, without taking locks. Callers must not exceed its capacity, which
+	// is a power of two.
+	template<typename T>
+	class WorkStealingDeque
+	{
+	public:
+		explicit WorkStealingDeque(int capacity) : items(new std::atomic<T>[capacity]), mask(capacity - 1) {}
+
+		// Only called by the owner.
+		void push(const T &item)
+		{
+			int64_t b = bottom.load(std::memory_order_relaxed);
+			items[b & mask].store(item, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			bottom.store(b + 1, std::memory_order_relaxed);
+		}
+
+		// Only called by the owner. Returns false when the deque is empty.
+		bool pop(T &item)
+		{
+			int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+			bottom.store(b, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			int64_t t = top.load(std::memory_order_relaxed);
+
+			if(t > b)
+			{
+				bottom.store(b + 1, std::memory_order_relaxed);
+				return false;
+			}
+
+			item = items[b & mask].load(std::memory_order_relaxed);
+
+			if(t == b)   // Thieves compete for the last item
+			{
+				bool taken = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+				bottom.store(b + 1, std::memory_order_relaxed);
+				return taken;
+			}
+
+			return true;
+		}
+
+		// Returns false when the deque is empty.
+		bool steal(T &item)
+		{
+			while(true)
+			{
+				int64_t t = top.load(std::memory_order_acquire);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				int64_t b = bottom.load(std::memory_order_acquire);
+
+				if(t >= b)
+				{
+					return false;
+				}
+
+				item = items[t & mask].load(std::memory_order_relaxed);
+
+				if(top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				{
+					return true;
+				}
+			}
+		}
+
+	private:
+		std::unique_ptr<std::atomic<T>[]> items;
+		const int64_t mask;
+		std::atomic<int64_t> top = { 0 };
+		std::atomic<int64_t> bottom = { 0 };
+	};
+}
+
+#endif   // sw_Synchronization_hpp
@@ -310,6 +310,7 @@ namespace sw
 			inline int operator++(int) { return ai.fetch_add(1, std::memory_order_acq_rel) + 1; }
 			inline void operator-=(int i) { ai.fetch_sub(i, std::memory_order_acq_rel); }
 			inline void operator+=(int i) { ai.fetch_add(i, std::memory_order_acq_rel); }
+			inline int exchange(int i) { return ai.exchange(i, std::memory_order_acq_rel); }   // Returns the previous value
 		private:
 			std::atomic<int> ai;
 		};
@@ -329,6 +330,7 @@ namespace sw
 			inline int operator++(int) { return sw::atomicIncrement(&vi); }
 			inline void operator-=(int i) { sw::atomicAdd(&vi, -i); }
 			inline void operator+=(int i) { sw::atomicAdd(&vi, i); }
+			inline int exchange(int i) { return sw::atomicExchange(&vi, i); }   // Returns the previous value
 		private:
 			volatile int vi;
 		};
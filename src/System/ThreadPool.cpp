@@ -0,0 +1,132 @@
+// Copyright 2019 The SwiftShader Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "ThreadPool.hpp"
+
+#include "Thread.hpp"
+
+#include <algorithm>
+
+namespace sw
+{
+	// Loops are shared with the workers which take them, since a worker may only
+	// get to a loop after its last iteration has completed and the caller returned.
+	struct ThreadPool::Loop
+	{
+		const std::function<void(int)> *function;
+		int count;
+		AtomicInt next;
+
+		std::mutex mutex;
+		std::condition_variable condition;
+		int completed = 0;   // Guarded by mutex
+	};
+
+	ThreadPool::ThreadPool(int threadCount)
+	{
+		for(int i = 1; i < threadCount; i++)
+		{
+			workers.push_back(new Thread(WorkerLoop, this));
+		}
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		for(size_t i = 0; i < workers.size(); i++)
+		{
+			loops.put(nullptr);
+		}
+
+		for(auto worker : workers)
+		{
+			worker->join();
+			delete worker;
+		}
+	}
+
+	void ThreadPool::parallelFor(int count, const std::function<void(int)> &function)
+	{
+		if(count <= 0)
+		{
+			return;
+		}
+
+		if(count == 1 || workers.empty())
+		{
+			for(int i = 0; i < count; i++)
+			{
+				function(i);
+			}
+
+			return;
+		}
+
+		std::shared_ptr<Loop> loop(new Loop());
+		loop->function = &function;
+		loop->count = count;
+		loop->next = 0;
+
+		int helpers = std::min(count - 1, static_cast<int>(workers.size()));
+		for(int i = 0; i < helpers; i++)
+		{
+			loops.put(loop);
+		}
+
+		run(*loop);
+
+		std::unique_lock<std::mutex> lock(loop->mutex);
+		loop->condition.wait(lock, [&loop] { return loop->completed == loop->count; });
+	}
+
+	void ThreadPool::WorkerLoop(void *pool)
+	{
+		static_cast<ThreadPool*>(pool)->workerLoop();
+	}
+
+	void ThreadPool::workerLoop()
+	{
+		while(std::shared_ptr<Loop> loop = loops.take())
+		{
+			run(*loop);
+		}
+	}
+
+	void ThreadPool::run(Loop &loop)
+	{
+		int completed = 0;
+
+		while(true)
+		{
+			int i = loop.next++ - 1;   // Post-increment returns the incremented value
+			if(i >= loop.count)
+			{
+				break;
+			}
+
+			(*loop.function)(i);
+			completed++;
+		}
+
+		if(completed > 0)
+		{
+			std::unique_lock<std::mutex> lock(loop.mutex);
+			loop.completed += completed;
+
+			if(loop.completed == loop.count)
+			{
+				loop.condition.notify_all();
+			}
+		}
+	}
+}
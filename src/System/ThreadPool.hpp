@@ -0,0 +1,54 @@
+// Copyright 2019 The SwiftShader Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef sw_ThreadPool_hpp
+#define sw_ThreadPool_hpp
+
+#include "Synchronization.hpp"
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace sw
+{
+	class Thread;
+
+	// ThreadPool runs data-parallel loops on a set of worker threads. The calling
+	// thread takes part in each loop, so loops complete even when all the workers
+	// are busy, including when parallelFor() is called from a worker.
+	class ThreadPool
+	{
+	public:
+		explicit ThreadPool(int threadCount);   // Including the calling thread
+		~ThreadPool();
+
+		int getThreadCount() const { return static_cast<int>(workers.size()) + 1; }
+
+		// Calls function(i) for each i in [0, count), and returns once all calls have completed
+		void parallelFor(int count, const std::function<void(int)> &function);
+
+	private:
+		struct Loop;
+
+		static void WorkerLoop(void *pool);
+		void workerLoop();
+		static void run(Loop &loop);
+
+		std::vector<Thread*> workers;
+		Chan<std::shared_ptr<Loop>> loops;   // A null loop stops the worker taking it
+	};
+}
+
+#endif   // sw_ThreadPool_hpp
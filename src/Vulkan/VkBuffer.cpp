@@ -15,6 +15,7 @@
 #include "VkBuffer.hpp"
 #include "VkConfig.h"
 #include "VkDeviceMemory.hpp"
+#include "System/Memory.hpp"
 
 #include <cstring>
 
@@ -86,16 +87,27 @@ void Buffer::copyTo(void* dstMemory, VkDeviceSize pSize, VkDeviceSize pOffset) c
 	memcpy(dstMemory, getOffsetPointer(pOffset), pSize);
 }
 
-void Buffer::copyTo(Buffer* dstBuffer, const VkBufferCopy& pRegion) const
+void Buffer::copyTo(Buffer* dstBuffer, const VkBufferCopy& pRegion, sw::ThreadPool& pool) const
 {
-	copyTo(dstBuffer->getOffsetPointer(pRegion.dstOffset), pRegion.size, pRegion.srcOffset);
+	ASSERT((pRegion.size + pRegion.srcOffset) <= size);
+	ASSERT((pRegion.size + pRegion.dstOffset) <= dstBuffer->size);
+
+	sw::copy(pool, dstBuffer->getOffsetPointer(pRegion.dstOffset), getOffsetPointer(pRegion.srcOffset),
+	         static_cast<size_t>(pRegion.size));
 }
 
-void Buffer::fill(VkDeviceSize dstOffset, VkDeviceSize fillSize, uint32_t data)
+void Buffer::fill(VkDeviceSize dstOffset, VkDeviceSize fillSize, uint32_t data, sw::ThreadPool& pool)
 {
+	if(fillSize == VK_WHOLE_SIZE)
+	{
+		fillSize = (size - dstOffset) & ~static_cast<VkDeviceSize>(3);   // Whole words only
+	}
+
 	ASSERT((fillSize + dstOffset) <= size);
+	ASSERT((dstOffset % 4 == 0) && (fillSize % 4 == 0));
 
-	memset(getOffsetPointer(dstOffset), data, fillSize);
+	// The data is a 4-byte pattern, not a byte value
+	sw::clear(pool, static_cast<uint32_t*>(getOffsetPointer(dstOffset)), data, static_cast<size_t>(fillSize / 4));
 }
 
 void Buffer::update(VkDeviceSize dstOffset, VkDeviceSize dataSize, const void* pData)
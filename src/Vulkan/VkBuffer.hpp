@@ -17,6 +17,11 @@
 
 #include "VkObject.hpp"
 
+namespace sw
+{
+	class ThreadPool;
+}
+
 namespace vk
 {
 
@@ -33,8 +38,8 @@ public:
 	void bind(VkDeviceMemory pDeviceMemory, VkDeviceSize pMemoryOffset);
 	void copyFrom(const void* srcMemory, VkDeviceSize size, VkDeviceSize offset);
 	void copyTo(void* dstMemory, VkDeviceSize size, VkDeviceSize offset) const;
-	void copyTo(Buffer* dstBuffer, const VkBufferCopy& pRegion) const;
-	void fill(VkDeviceSize dstOffset, VkDeviceSize fillSize, uint32_t data);
+	void copyTo(Buffer* dstBuffer, const VkBufferCopy& pRegion, sw::ThreadPool& pool) const;
+	void fill(VkDeviceSize dstOffset, VkDeviceSize fillSize, uint32_t data, sw::ThreadPool& pool);
 	void update(VkDeviceSize dstOffset, VkDeviceSize dataSize, const void* pData);
 	void* getOffsetPointer(VkDeviceSize offset) const;
 	uint8_t* end() const;
@@ -35,6 +35,8 @@ public:
 		return 0;
 	}
 
+	VkBuffer getBuffer() const { return buffer; }
+
 private:
 	VkBuffer     buffer;
 	VkFormat     format;
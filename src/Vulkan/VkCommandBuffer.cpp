@@ -14,16 +14,20 @@
 
 #include "VkCommandBuffer.hpp"
 #include "VkBuffer.hpp"
+#include "VkDescriptorSetLayout.hpp"
 #include "VkEvent.hpp"
 #include "VkFramebuffer.hpp"
 #include "VkImage.hpp"
 #include "VkImageView.hpp"
 #include "VkPipeline.hpp"
 #include "VkPipelineLayout.hpp"
+#include "VkQueryPool.hpp"
 #include "VkRenderPass.hpp"
 #include "Device/Renderer.hpp"
 
 #include <cstring>
+#include <new>
+#include <vector>
 
 namespace vk
 {
@@ -34,6 +38,8 @@ public:
 	// FIXME (b/119421344): change the commandBuffer argument to a CommandBuffer state
 	virtual void play(CommandBuffer::ExecutionState& executionState) = 0;
 	virtual ~Command() {}
+
+	Command* next = nullptr;
 };
 
 class BeginRenderPass : public CommandBuffer::Command
@@ -42,16 +48,8 @@ public:
 	BeginRenderPass(VkRenderPass renderPass, VkFramebuffer framebuffer, VkRect2D renderArea,
 	                uint32_t clearValueCount, const VkClearValue* pClearValues) :
 		renderPass(Cast(renderPass)), framebuffer(Cast(framebuffer)), renderArea(renderArea),
-		clearValueCount(clearValueCount)
-	{
-		// FIXME (b/119409619): use an allocator here so we can control all memory allocations
-		clearValues = new VkClearValue[clearValueCount];
-		memcpy(clearValues, pClearValues, clearValueCount * sizeof(VkClearValue));
-	}
-
-	~BeginRenderPass() override
+		clearValueCount(clearValueCount), clearValues(pClearValues)
 	{
-		delete [] clearValues;
 	}
 
 protected:
@@ -59,7 +57,14 @@ protected:
 	{
 		executionState.renderPass = renderPass;
 		executionState.renderPassFramebuffer = framebuffer;
+		executionState.renderArea = renderArea;
 		renderPass->begin();
+
+		if(clearValueCount > 0)
+		{
+			executionState.waitForAttachments();
+		}
+
 		framebuffer->clear(clearValueCount, clearValues, renderArea);
 	}
 
@@ -68,7 +73,7 @@ private:
 	Framebuffer* framebuffer;
 	VkRect2D renderArea;
 	uint32_t clearValueCount;
-	VkClearValue* clearValues;
+	const VkClearValue* clearValues;   // Stored by the command buffer
 };
 
 class NextSubpass : public CommandBuffer::Command
@@ -81,6 +86,7 @@ public:
 protected:
 	void play(CommandBuffer::ExecutionState& executionState) override
 	{
+		executionState.resolveAttachments();
 		executionState.renderPass->nextSubpass();
 	}
 
@@ -97,6 +103,7 @@ public:
 protected:
 	void play(CommandBuffer::ExecutionState& executionState) override
 	{
+		executionState.resolveAttachments();
 		executionState.renderPass->end();
 		executionState.renderPass = nullptr;
 		executionState.renderPassFramebuffer = nullptr;
@@ -105,6 +112,23 @@ protected:
 private:
 };
 
+class ExecuteCommands : public CommandBuffer::Command
+{
+public:
+	ExecuteCommands(const CommandBuffer* commandBuffer) : commandBuffer(commandBuffer)
+	{
+	}
+
+protected:
+	void play(CommandBuffer::ExecutionState& executionState) override
+	{
+		commandBuffer->submitSecondary(executionState);
+	}
+
+private:
+	const CommandBuffer* commandBuffer;
+};
+
 class PipelineBind : public CommandBuffer::Command
 {
 public:
@@ -135,12 +159,19 @@ public:
 protected:
 	void play(CommandBuffer::ExecutionState& executionState) override
 	{
+		// The memory accessed through the descriptor sets isn't tracked
+		executionState.renderer->synchronize();
+
 		ComputePipeline* pipeline = static_cast<ComputePipeline*>(
 			executionState.pipelines[VK_PIPELINE_BIND_POINT_COMPUTE]);
 		pipeline->run(groupCountX, groupCountY, groupCountZ,
 			MAX_BOUND_DESCRIPTOR_SETS,
 			executionState.boundDescriptorSets[VK_PIPELINE_BIND_POINT_COMPUTE],
-			executionState.pushConstants);
+			executionState.pushConstants,
+			executionState.renderer->getTransferPool());
+
+		executionState.renderer->addComputeInvocations(
+			pipeline->computeInvocationCount(groupCountX, groupCountY, groupCountZ));
 	}
 
 private:
@@ -149,6 +180,46 @@ private:
 	uint32_t groupCountZ;
 };
 
+class DispatchIndirect : public CommandBuffer::Command
+{
+public:
+	DispatchIndirect(VkBuffer buffer, VkDeviceSize offset) :
+			buffer(buffer), offset(offset)
+	{
+	}
+
+protected:
+	void play(CommandBuffer::ExecutionState& executionState) override
+	{
+		// The group counts may have been written by earlier commands, so they are only read now
+		executionState.waitForAccess(Cast(buffer), false);
+
+		auto cmd = reinterpret_cast<const VkDispatchIndirectCommand*>(Cast(buffer)->getOffsetPointer(offset));
+		if((cmd->x == 0) || (cmd->y == 0) || (cmd->z == 0))
+		{
+			return;
+		}
+
+		// The memory accessed through the descriptor sets isn't tracked
+		executionState.renderer->synchronize();
+
+		ComputePipeline* pipeline = static_cast<ComputePipeline*>(
+			executionState.pipelines[VK_PIPELINE_BIND_POINT_COMPUTE]);
+		pipeline->run(cmd->x, cmd->y, cmd->z,
+			MAX_BOUND_DESCRIPTOR_SETS,
+			executionState.boundDescriptorSets[VK_PIPELINE_BIND_POINT_COMPUTE],
+			executionState.pushConstants,
+			executionState.renderer->getTransferPool());
+
+		executionState.renderer->addComputeInvocations(
+			pipeline->computeInvocationCount(cmd->x, cmd->y, cmd->z));
+	}
+
+private:
+	VkBuffer buffer;
+	VkDeviceSize offset;
+};
+
 struct VertexBufferBind : public CommandBuffer::Command
 {
 	VertexBufferBind(uint32_t pBinding, const VkBuffer pBuffer, const VkDeviceSize pOffset) :
@@ -217,46 +288,225 @@ void CommandBuffer::ExecutionState::bindAttachments()
 	}
 }
 
-struct Draw : public CommandBuffer::Command
+GraphicsPipeline* CommandBuffer::ExecutionState::bindGraphicsState()
 {
-	Draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance)
-		: vertexCount(vertexCount), instanceCount(instanceCount), firstVertex(firstVertex), firstInstance(firstInstance)
+	GraphicsPipeline* pipeline = static_cast<GraphicsPipeline*>(pipelines[VK_PIPELINE_BIND_POINT_GRAPHICS]);
+
+	// The pipeline's state is only loaded when another pipeline gets used, rather
+	// than for every draw, and the dynamic state is applied on top of it.
+	if(pipeline != contextPipeline)
 	{
+		renderer->setContext(pipeline->getContext());
+
+		if(!pipeline->hasDynamicState(VK_DYNAMIC_STATE_VIEWPORT))
+		{
+			renderer->setViewport(pipeline->getViewport());
+		}
+
+		if(!pipeline->hasDynamicState(VK_DYNAMIC_STATE_SCISSOR))
+		{
+			renderer->setScissor(pipeline->getScissor());
+		}
+
+		if(!pipeline->hasDynamicState(VK_DYNAMIC_STATE_BLEND_CONSTANTS))
+		{
+			renderer->setBlendConstant(pipeline->getBlendConstants());
+		}
+
+		contextPipeline = pipeline;
+		dirtyDynamicStates = ~0u;
 	}
 
-	void play(CommandBuffer::ExecutionState& executionState) override
+	uint32_t dirty = dirtyDynamicStates & pipeline->getDynamicStates();
+	dirtyDynamicStates = 0;
+
+	if(dirty & (1 << VK_DYNAMIC_STATE_VIEWPORT))
 	{
-		GraphicsPipeline* pipeline = static_cast<GraphicsPipeline*>(
-			executionState.pipelines[VK_PIPELINE_BIND_POINT_GRAPHICS]);
+		renderer->setViewport(dynamicState.viewport);
+	}
 
-		sw::Context context = pipeline->getContext();
-		for(uint32_t i = 0; i < MAX_VERTEX_INPUT_BINDINGS; i++)
+	if(dirty & (1 << VK_DYNAMIC_STATE_SCISSOR))
+	{
+		renderer->setScissor(dynamicState.scissor);
+	}
+
+	if(dirty & (1 << VK_DYNAMIC_STATE_BLEND_CONSTANTS))
+	{
+		const float* blendConstants = dynamicState.blendConstants;
+		renderer->setBlendConstant(sw::Color<float>(blendConstants[0], blendConstants[1], blendConstants[2], blendConstants[3]));
+	}
+
+	if(dirty & (1 << VK_DYNAMIC_STATE_LINE_WIDTH))
+	{
+		renderer->setLineWidth(dynamicState.lineWidth);
+	}
+
+	if(dirty & (1 << VK_DYNAMIC_STATE_DEPTH_BIAS))
+	{
+		renderer->setDepthBias(dynamicState.depthBiasConstantFactor);
+		renderer->setSlopeDepthBias(dynamicState.depthBiasSlopeFactor);
+	}
+
+	if(dirty & (1 << VK_DYNAMIC_STATE_STENCIL_COMPARE_MASK))
+	{
+		context->frontStencil.compareMask = dynamicState.stencilCompareMask[0];
+		context->backStencil.compareMask = dynamicState.stencilCompareMask[1];
+	}
+
+	if(dirty & (1 << VK_DYNAMIC_STATE_STENCIL_WRITE_MASK))
+	{
+		context->frontStencil.writeMask = dynamicState.stencilWriteMask[0];
+		context->backStencil.writeMask = dynamicState.stencilWriteMask[1];
+	}
+
+	if(dirty & (1 << VK_DYNAMIC_STATE_STENCIL_REFERENCE))
+	{
+		context->frontStencil.reference = dynamicState.stencilReference[0];
+		context->backStencil.reference = dynamicState.stencilReference[1];
+	}
+
+	return pipeline;
+}
+
+void CommandBuffer::ExecutionState::bindVertexInputs(int32_t firstVertex)
+{
+	for(uint32_t i = 0; i < MAX_VERTEX_INPUT_BINDINGS; i++)
+	{
+		auto &attrib = context->input[i];
+		if (attrib.count)
+		{
+			const auto &vertexInput = vertexInputBindings[attrib.binding];
+			Buffer *buffer = Cast(vertexInput.buffer);
+			attrib.buffer = buffer ? buffer->getOffsetPointer(
+					attrib.offset + vertexInput.offset + attrib.stride * firstVertex) : nullptr;
+		}
+	}
+}
+
+sw::DrawType CommandBuffer::ExecutionState::bindIndexBuffer(uint32_t firstIndex)
+{
+	const uint32_t indexSize = (indexType == VK_INDEX_TYPE_UINT16) ? 2 : 4;
+	context->indexBuffer = Cast(indexBufferBinding.buffer)->getOffsetPointer(
+			indexBufferBinding.offset + firstIndex * indexSize);
+
+	return static_cast<sw::DrawType>(context->drawType |
+			((indexType == VK_INDEX_TYPE_UINT16) ? sw::DRAW_INDEXED16 : sw::DRAW_INDEXED32));
+}
+
+void CommandBuffer::ExecutionState::addDrawAccesses(bool indexed)
+{
+	// Draws write their attachments, read their vertex and index buffers, and
+	// access the resources bound to their descriptor sets
+	const VkSubpassDescription& subpass = renderPass->getCurrentSubpass();
+
+	for(uint32_t i = 0; i < subpass.colorAttachmentCount; i++)
+	{
+		if(subpass.pColorAttachments[i].attachment != VK_ATTACHMENT_UNUSED)
+		{
+			const Image* image = renderPassFramebuffer->getAttachment(subpass.pColorAttachments[i].attachment)->getImage();
+			renderer->addDrawAccess(image->getMemory(), static_cast<size_t>(image->getMemoryRequirements().size), true, true);
+		}
+	}
+
+	if(subpass.pDepthStencilAttachment && (subpass.pDepthStencilAttachment->attachment != VK_ATTACHMENT_UNUSED))
+	{
+		const Image* image = renderPassFramebuffer->getAttachment(subpass.pDepthStencilAttachment->attachment)->getImage();
+		renderer->addDrawAccess(image->getMemory(), static_cast<size_t>(image->getMemoryRequirements().size), true, true);
+	}
+
+	bool bindingUsed[MAX_VERTEX_INPUT_BINDINGS] = {};
+	for(uint32_t i = 0; i < MAX_VERTEX_INPUT_BINDINGS; i++)
+	{
+		const auto &attrib = context->input[i];
+		if(attrib.count && !bindingUsed[attrib.binding])
 		{
-			auto &attrib = context.input[i];
-			if (attrib.count)
+			bindingUsed[attrib.binding] = true;
+
+			const Buffer* buffer = Cast(vertexInputBindings[attrib.binding].buffer);
+			if(buffer)
 			{
-				const auto &vertexInput = executionState.vertexInputBindings[attrib.binding];
-				Buffer *buffer = Cast(vertexInput.buffer);
-				attrib.buffer = buffer ? buffer->getOffsetPointer(
-						attrib.offset + vertexInput.offset + attrib.stride * firstVertex) : nullptr;
+				renderer->addDrawAccess(buffer->getOffsetPointer(0), static_cast<size_t>(buffer->getMemoryRequirements().size), false, true);
 			}
 		}
+	}
+
+	if(indexed)
+	{
+		const Buffer* buffer = Cast(indexBufferBinding.buffer);
+		renderer->addDrawAccess(buffer->getOffsetPointer(0), static_cast<size_t>(buffer->getMemoryRequirements().size), false, true);
+	}
+
+	// Shaders can access the resources of all the descriptor sets of the pipeline's layout
+	const PipelineLayout* layout = pipelines[VK_PIPELINE_BIND_POINT_GRAPHICS]->getLayout();
+	std::vector<DescriptorSetLayout::ResourceAccess> descriptorAccesses;
+
+	for(size_t i = 0; i < layout->getNumDescriptorSets(); i++)
+	{
+		VkDescriptorSet descriptorSet = boundDescriptorSets[VK_PIPELINE_BIND_POINT_GRAPHICS][i];
+		if(descriptorSet != VK_NULL_HANDLE)
+		{
+			DescriptorSetLayout::GetResourceAccesses(descriptorSet, descriptorAccesses);
+		}
+	}
+
+	for(const auto& access : descriptorAccesses)
+	{
+		renderer->addDrawAccess(access.memory, access.size, access.write, false);
+	}
+}
+
+void CommandBuffer::ExecutionState::waitForAccess(const Image* image, bool write)
+{
+	renderer->waitForAccess(image->getMemory(), static_cast<size_t>(image->getMemoryRequirements().size), write);
+}
+
+void CommandBuffer::ExecutionState::waitForAccess(const Buffer* buffer, bool write)
+{
+	renderer->waitForAccess(buffer->getOffsetPointer(0), static_cast<size_t>(buffer->getMemoryRequirements().size), write);
+}
+
+void CommandBuffer::ExecutionState::waitForAttachments()
+{
+	for(uint32_t i = 0; i < renderPassFramebuffer->getAttachmentCount(); i++)
+	{
+		waitForAccess(renderPassFramebuffer->getAttachment(i)->getImage(), true);
+	}
+}
+
+void CommandBuffer::ExecutionState::resolveAttachments()
+{
+	if(renderPass->getCurrentSubpass().pResolveAttachments)
+	{
+		// The multisample attachments are read and the resolve attachments written
+		waitForAttachments();
+		renderPassFramebuffer->resolve(renderPass, renderArea, renderer->getTransferPool());
+	}
+}
+
+struct Draw : public CommandBuffer::Command
+{
+	Draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance)
+		: vertexCount(vertexCount), instanceCount(instanceCount), firstVertex(firstVertex), firstInstance(firstInstance)
+	{
+	}
 
-		context.pushConstants = executionState.pushConstants;
+	void play(CommandBuffer::ExecutionState& executionState) override
+	{
+		GraphicsPipeline* pipeline = executionState.bindGraphicsState();
+		sw::Context* context = executionState.context;
 
-		executionState.renderer->setContext(context);
-		executionState.renderer->setScissor(pipeline->getScissor());
-		executionState.renderer->setViewport(pipeline->getViewport());
-		executionState.renderer->setBlendConstant(pipeline->getBlendConstants());
+		executionState.bindVertexInputs(0);
+		context->pushConstants = executionState.pushConstants;
 
 		executionState.bindAttachments();
 
 		const uint32_t primitiveCount = pipeline->computePrimitiveCount(vertexCount);
-		const uint32_t lastInstance = firstInstance + instanceCount - 1;
-		for(uint32_t instance = firstInstance; instance <= lastInstance; instance++)
+		if((primitiveCount > 0) && (instanceCount > 0))
 		{
-			executionState.renderer->setInstanceID(instance);
-			executionState.renderer->draw(context.drawType, primitiveCount);
+			const sw::SubDraw subDraw = { nullptr, static_cast<int>(firstVertex), primitiveCount, instanceCount, firstInstance };
+
+			executionState.addDrawAccesses(false);
+			executionState.renderer->draw(context->drawType, &subDraw, 1);
 		}
 	}
 
@@ -275,51 +525,249 @@ struct DrawIndexed : public CommandBuffer::Command
 
 	void play(CommandBuffer::ExecutionState& executionState) override
 	{
-		GraphicsPipeline* pipeline = static_cast<GraphicsPipeline*>(
-				executionState.pipelines[VK_PIPELINE_BIND_POINT_GRAPHICS]);
+		GraphicsPipeline* pipeline = executionState.bindGraphicsState();
+		sw::Context* context = executionState.context;
+
+		executionState.bindVertexInputs(0);
+		context->pushConstants = executionState.pushConstants;
 
-		sw::Context context = pipeline->getContext();
-		for(uint32_t i = 0; i < MAX_VERTEX_INPUT_BINDINGS; i++)
+		sw::DrawType drawType = executionState.bindIndexBuffer(firstIndex);
+
+		executionState.bindAttachments();
+
+		const uint32_t primitiveCount = pipeline->computePrimitiveCount(indexCount);
+		if((primitiveCount > 0) && (instanceCount > 0))
 		{
-			auto &attrib = context.input[i];
-			if (attrib.count)
+			const sw::SubDraw subDraw = { context->indexBuffer, vertexOffset, primitiveCount, instanceCount, firstInstance };
+
+			executionState.addDrawAccesses(true);
+			executionState.renderer->draw(drawType, &subDraw, 1);
+		}
+	}
+
+	uint32_t indexCount;
+	uint32_t instanceCount;
+	uint32_t firstIndex;
+	int32_t vertexOffset;
+	uint32_t firstInstance;
+};
+
+// The indirect draws read their parameters when they are played back, since
+// the buffer may be written by earlier commands of the same submission.
+// All the sub-draws are submitted to the renderer as a single draw call, which
+// resolves the pipeline state and routines once. Empty sub-draws are skipped.
+struct DrawIndirect : public CommandBuffer::Command
+{
+	DrawIndirect(VkBuffer buffer, VkDeviceSize offset, uint32_t drawCount, uint32_t stride)
+			: buffer(buffer), offset(offset), drawCount(drawCount), stride(stride)
+	{
+	}
+
+	void play(CommandBuffer::ExecutionState& executionState) override
+	{
+		GraphicsPipeline* pipeline = executionState.bindGraphicsState();
+		sw::Context* context = executionState.context;
+
+		executionState.bindVertexInputs(0);
+		context->pushConstants = executionState.pushConstants;
+
+		executionState.bindAttachments();
+
+		executionState.waitForAccess(Cast(buffer), false);
+		const uint8_t* args = static_cast<const uint8_t*>(Cast(buffer)->getOffsetPointer(offset));
+
+		std::vector<sw::SubDraw> subDraws;
+		subDraws.reserve(drawCount);
+
+		for(uint32_t i = 0; i < drawCount; i++)
+		{
+			const VkDrawIndirectCommand& cmd = *reinterpret_cast<const VkDrawIndirectCommand*>(args + i * stride);
+
+			const uint32_t primitiveCount = pipeline->computePrimitiveCount(cmd.vertexCount);
+			if((primitiveCount > 0) && (cmd.instanceCount > 0))
 			{
-				const auto &vertexInput = executionState.vertexInputBindings[attrib.binding];
-				Buffer *buffer = Cast(vertexInput.buffer);
-				attrib.buffer = buffer ? buffer->getOffsetPointer(
-						attrib.offset + vertexInput.offset + attrib.stride * vertexOffset) : nullptr;
+				subDraws.push_back({ nullptr, static_cast<int>(cmd.firstVertex), primitiveCount, cmd.instanceCount, cmd.firstInstance });
 			}
 		}
 
-		context.pushConstants = executionState.pushConstants;
+		if(!subDraws.empty())
+		{
+			executionState.addDrawAccesses(false);
+			executionState.renderer->draw(context->drawType, subDraws.data(), static_cast<uint32_t>(subDraws.size()));
+		}
+	}
 
-		context.indexBuffer = Cast(executionState.indexBufferBinding.buffer)->getOffsetPointer(
-				executionState.indexBufferBinding.offset + firstIndex * (executionState.indexType == VK_INDEX_TYPE_UINT16 ? 2 : 4));
+	VkBuffer buffer;
+	VkDeviceSize offset;
+	uint32_t drawCount;
+	uint32_t stride;
+};
 
-		executionState.renderer->setContext(context);
-		executionState.renderer->setScissor(pipeline->getScissor());
-		executionState.renderer->setViewport(pipeline->getViewport());
-		executionState.renderer->setBlendConstant(pipeline->getBlendConstants());
+struct DrawIndexedIndirect : public CommandBuffer::Command
+{
+	DrawIndexedIndirect(VkBuffer buffer, VkDeviceSize offset, uint32_t drawCount, uint32_t stride)
+			: buffer(buffer), offset(offset), drawCount(drawCount), stride(stride)
+	{
+	}
+
+	void play(CommandBuffer::ExecutionState& executionState) override
+	{
+		GraphicsPipeline* pipeline = executionState.bindGraphicsState();
+		sw::Context* context = executionState.context;
+
+		executionState.bindVertexInputs(0);
+		context->pushConstants = executionState.pushConstants;
+
+		sw::DrawType drawType = executionState.bindIndexBuffer(0);
+		const uint8_t* indices = static_cast<const uint8_t*>(context->indexBuffer);
+		const uint32_t indexSize = (executionState.indexType == VK_INDEX_TYPE_UINT16) ? 2 : 4;
 
 		executionState.bindAttachments();
 
-		auto drawType = executionState.indexType == VK_INDEX_TYPE_UINT16
-				? (context.drawType | sw::DRAW_INDEXED16) : (context.drawType | sw::DRAW_INDEXED32);
+		executionState.waitForAccess(Cast(buffer), false);
+		const uint8_t* args = static_cast<const uint8_t*>(Cast(buffer)->getOffsetPointer(offset));
 
-		const uint32_t primitiveCount = pipeline->computePrimitiveCount(indexCount);
-		const uint32_t lastInstance = firstInstance + instanceCount - 1;
-		for(uint32_t instance = firstInstance; instance <= lastInstance; instance++)
+		std::vector<sw::SubDraw> subDraws;
+		subDraws.reserve(drawCount);
+
+		for(uint32_t i = 0; i < drawCount; i++)
 		{
-			executionState.renderer->setInstanceID(instance);
-			executionState.renderer->draw(static_cast<sw::DrawType>(drawType), primitiveCount);
+			const VkDrawIndexedIndirectCommand& cmd = *reinterpret_cast<const VkDrawIndexedIndirectCommand*>(args + i * stride);
+
+			const uint32_t primitiveCount = pipeline->computePrimitiveCount(cmd.indexCount);
+			if((primitiveCount > 0) && (cmd.instanceCount > 0))
+			{
+				subDraws.push_back({ indices + cmd.firstIndex * indexSize, cmd.vertexOffset, primitiveCount, cmd.instanceCount, cmd.firstInstance });
+			}
+		}
+
+		if(!subDraws.empty())
+		{
+			executionState.addDrawAccesses(true);
+			executionState.renderer->draw(drawType, subDraws.data(), static_cast<uint32_t>(subDraws.size()));
 		}
 	}
 
-	uint32_t indexCount;
-	uint32_t instanceCount;
-	uint32_t firstIndex;
-	int32_t vertexOffset;
-	uint32_t firstInstance;
+	VkBuffer buffer;
+	VkDeviceSize offset;
+	uint32_t drawCount;
+	uint32_t stride;
+};
+
+struct SetViewport : public CommandBuffer::Command
+{
+	SetViewport(const VkViewport& viewport) : viewport(viewport)
+	{
+	}
+
+	void play(CommandBuffer::ExecutionState& executionState) override
+	{
+		executionState.dynamicState.viewport = viewport;
+		executionState.dirtyDynamicStates |= (1 << VK_DYNAMIC_STATE_VIEWPORT);
+	}
+
+private:
+	const VkViewport viewport;
+};
+
+struct SetScissor : public CommandBuffer::Command
+{
+	SetScissor(const VkRect2D& scissor) : scissor(scissor)
+	{
+	}
+
+	void play(CommandBuffer::ExecutionState& executionState) override
+	{
+		executionState.dynamicState.scissor = scissor;
+		executionState.dirtyDynamicStates |= (1 << VK_DYNAMIC_STATE_SCISSOR);
+	}
+
+private:
+	const VkRect2D scissor;
+};
+
+struct SetLineWidth : public CommandBuffer::Command
+{
+	SetLineWidth(float lineWidth) : lineWidth(lineWidth)
+	{
+	}
+
+	void play(CommandBuffer::ExecutionState& executionState) override
+	{
+		executionState.dynamicState.lineWidth = lineWidth;
+		executionState.dirtyDynamicStates |= (1 << VK_DYNAMIC_STATE_LINE_WIDTH);
+	}
+
+private:
+	float lineWidth;
+};
+
+struct SetDepthBias : public CommandBuffer::Command
+{
+	SetDepthBias(float depthBiasConstantFactor, float depthBiasSlopeFactor)
+		: depthBiasConstantFactor(depthBiasConstantFactor), depthBiasSlopeFactor(depthBiasSlopeFactor)
+	{
+	}
+
+	void play(CommandBuffer::ExecutionState& executionState) override
+	{
+		executionState.dynamicState.depthBiasConstantFactor = depthBiasConstantFactor;
+		executionState.dynamicState.depthBiasSlopeFactor = depthBiasSlopeFactor;
+		executionState.dirtyDynamicStates |= (1 << VK_DYNAMIC_STATE_DEPTH_BIAS);
+	}
+
+private:
+	float depthBiasConstantFactor;
+	float depthBiasSlopeFactor;
+};
+
+struct SetBlendConstants : public CommandBuffer::Command
+{
+	SetBlendConstants(const float blendConstants[4])
+	{
+		memcpy(this->blendConstants, blendConstants, sizeof(this->blendConstants));
+	}
+
+	void play(CommandBuffer::ExecutionState& executionState) override
+	{
+		memcpy(executionState.dynamicState.blendConstants, blendConstants, sizeof(blendConstants));
+		executionState.dirtyDynamicStates |= (1 << VK_DYNAMIC_STATE_BLEND_CONSTANTS);
+	}
+
+private:
+	float blendConstants[4];
+};
+
+// Sets the front and/or back face value of one of the stencil dynamic states.
+struct SetStencilValue : public CommandBuffer::Command
+{
+	typedef uint32_t (CommandBuffer::ExecutionState::DynamicState::*Values)[2];
+
+	SetStencilValue(VkDynamicState state, Values values, VkStencilFaceFlags faceMask, uint32_t value)
+		: state(state), values(values), faceMask(faceMask), value(value)
+	{
+	}
+
+	void play(CommandBuffer::ExecutionState& executionState) override
+	{
+		if(faceMask & VK_STENCIL_FACE_FRONT_BIT)
+		{
+			(executionState.dynamicState.*values)[0] = value;
+		}
+
+		if(faceMask & VK_STENCIL_FACE_BACK_BIT)
+		{
+			(executionState.dynamicState.*values)[1] = value;
+		}
+
+		executionState.dirtyDynamicStates |= (1 << state);
+	}
+
+private:
+	VkDynamicState state;
+	Values values;
+	VkStencilFaceFlags faceMask;
+	uint32_t value;
 };
 
 struct ImageToImageCopy : public CommandBuffer::Command
@@ -331,7 +779,9 @@ struct ImageToImageCopy : public CommandBuffer::Command
 
 	void play(CommandBuffer::ExecutionState& executionState) override
 	{
-		Cast(srcImage)->copyTo(dstImage, region);
+		executionState.waitForAccess(Cast(srcImage), false);
+		executionState.waitForAccess(Cast(dstImage), true);
+		Cast(srcImage)->copyTo(dstImage, region, executionState.renderer->getTransferPool());
 	}
 
 private:
@@ -349,7 +799,9 @@ struct BufferToBufferCopy : public CommandBuffer::Command
 
 	void play(CommandBuffer::ExecutionState& executionState) override
 	{
-		Cast(srcBuffer)->copyTo(Cast(dstBuffer), region);
+		executionState.waitForAccess(Cast(srcBuffer), false);
+		executionState.waitForAccess(Cast(dstBuffer), true);
+		Cast(srcBuffer)->copyTo(Cast(dstBuffer), region, executionState.renderer->getTransferPool());
 	}
 
 private:
@@ -367,7 +819,9 @@ struct ImageToBufferCopy : public CommandBuffer::Command
 
 	void play(CommandBuffer::ExecutionState& executionState) override
 	{
-		Cast(srcImage)->copyTo(dstBuffer, region);
+		executionState.waitForAccess(Cast(srcImage), false);
+		executionState.waitForAccess(Cast(dstBuffer), true);
+		Cast(srcImage)->copyTo(dstBuffer, region, executionState.renderer->getTransferPool());
 	}
 
 private:
@@ -385,7 +839,9 @@ struct BufferToImageCopy : public CommandBuffer::Command
 
 	void play(CommandBuffer::ExecutionState& executionState) override
 	{
-		Cast(dstImage)->copyFrom(srcBuffer, region);
+		executionState.waitForAccess(Cast(srcBuffer), false);
+		executionState.waitForAccess(Cast(dstImage), true);
+		Cast(dstImage)->copyFrom(srcBuffer, region, executionState.renderer->getTransferPool());
 	}
 
 private:
@@ -403,7 +859,8 @@ struct FillBuffer : public CommandBuffer::Command
 
 	void play(CommandBuffer::ExecutionState& executionState) override
 	{
-		Cast(dstBuffer)->fill(dstOffset, size, data);
+		executionState.waitForAccess(Cast(dstBuffer), true);
+		Cast(dstBuffer)->fill(dstOffset, size, data, executionState.renderer->getTransferPool());
 	}
 
 private:
@@ -422,6 +879,7 @@ struct UpdateBuffer : public CommandBuffer::Command
 
 	void play(CommandBuffer::ExecutionState& executionState) override
 	{
+		executionState.waitForAccess(Cast(dstBuffer), true);
 		Cast(dstBuffer)->update(dstOffset, dataSize, pData);
 	}
 
@@ -429,7 +887,7 @@ private:
 	VkBuffer dstBuffer;
 	VkDeviceSize dstOffset;
 	VkDeviceSize dataSize;
-	const void* pData;
+	const void* pData;   // Stored by the command buffer
 };
 
 struct ClearColorImage : public CommandBuffer::Command
@@ -441,6 +899,7 @@ struct ClearColorImage : public CommandBuffer::Command
 
 	void play(CommandBuffer::ExecutionState& executionState) override
 	{
+		executionState.waitForAccess(Cast(image), true);
 		Cast(image)->clear(color, range);
 	}
 
@@ -459,6 +918,7 @@ struct ClearDepthStencilImage : public CommandBuffer::Command
 
 	void play(CommandBuffer::ExecutionState& executionState) override
 	{
+		executionState.waitForAccess(Cast(image), true);
 		Cast(image)->clear(depthStencil, range);
 	}
 
@@ -477,6 +937,7 @@ struct ClearAttachment : public CommandBuffer::Command
 
 	void play(CommandBuffer::ExecutionState& executionState) override
 	{
+		executionState.waitForAttachments();
 		executionState.renderPassFramebuffer->clear(attachment, rect);
 	}
 
@@ -494,6 +955,8 @@ struct BlitImage : public CommandBuffer::Command
 
 	void play(CommandBuffer::ExecutionState& executionState) override
 	{
+		executionState.waitForAccess(Cast(srcImage), false);
+		executionState.waitForAccess(Cast(dstImage), true);
 		Cast(srcImage)->blit(dstImage, region, filter);
 	}
 
@@ -504,6 +967,26 @@ private:
 	VkFilter filter;
 };
 
+struct ResolveImage : public CommandBuffer::Command
+{
+	ResolveImage(VkImage srcImage, VkImage dstImage, const VkImageResolve& region) :
+		srcImage(srcImage), dstImage(dstImage), region(region)
+	{
+	}
+
+	void play(CommandBuffer::ExecutionState& executionState) override
+	{
+		executionState.waitForAccess(Cast(srcImage), false);
+		executionState.waitForAccess(Cast(dstImage), true);
+		Cast(srcImage)->resolve(dstImage, region, executionState.renderer->getTransferPool());
+	}
+
+private:
+	VkImage srcImage;
+	VkImage dstImage;
+	VkImageResolve region;
+};
+
 struct PipelineBarrier : public CommandBuffer::Command
 {
 	PipelineBarrier()
@@ -512,12 +995,10 @@ struct PipelineBarrier : public CommandBuffer::Command
 
 	void play(CommandBuffer::ExecutionState& executionState) override
 	{
-		// This is a very simple implementation that simply calls sw::Renderer::synchronize(),
-		// since the driver is free to move the source stage towards the bottom of the pipe
-		// and the target stage towards the top, so a full pipeline sync is spec compliant.
-		executionState.renderer->synchronize();
-
-		// Right now all buffers are read-only in drawcalls but a similar mechanism will be required once we support SSBOs.
+		// Draws are the only work which is still in flight when the next command starts, and
+		// commands wait for the draws which access the same memory, including through their
+		// descriptor sets (see addDrawAccesses() and waitForAccess()), so barriers themselves
+		// don't have to wait. Layout transitions don't change the memory.
 
 		// Also note that this would be a good moment to update cube map borders or decompress compressed textures, if necessary.
 	}
@@ -525,6 +1006,12 @@ struct PipelineBarrier : public CommandBuffer::Command
 private:
 };
 
+// Stages which can still be executing for the draws in flight. Other commands have
+// completed all their stages by the time the next command is executed.
+static const VkPipelineStageFlags DrawStages = ~static_cast<VkPipelineStageFlags>(
+	VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+	VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_HOST_BIT);
+
 struct SignalEvent : public CommandBuffer::Command
 {
 	SignalEvent(VkEvent ev, VkPipelineStageFlags stageMask) : ev(ev), stageMask(stageMask)
@@ -533,12 +1020,19 @@ struct SignalEvent : public CommandBuffer::Command
 
 	void play(CommandBuffer::ExecutionState& executionState) override
 	{
-		Cast(ev)->signal();
+		if(stageMask & DrawStages)
+		{
+			executionState.renderer->setEventAfterDraws(Cast(ev), true);
+		}
+		else
+		{
+			Cast(ev)->signal();
+		}
 	}
 
 private:
 	VkEvent ev;
-	VkPipelineStageFlags stageMask; // FIXME(b/117835459) : We currently ignore the flags and signal the event at the last stage
+	VkPipelineStageFlags stageMask;
 };
 
 struct ResetEvent : public CommandBuffer::Command
@@ -549,12 +1043,35 @@ struct ResetEvent : public CommandBuffer::Command
 
 	void play(CommandBuffer::ExecutionState& executionState) override
 	{
-		Cast(ev)->reset();
+		if(stageMask & DrawStages)
+		{
+			executionState.renderer->setEventAfterDraws(Cast(ev), false);
+		}
+		else
+		{
+			Cast(ev)->reset();
+		}
+	}
+
+private:
+	VkEvent ev;
+	VkPipelineStageFlags stageMask;
+};
+
+struct WaitEvent : public CommandBuffer::Command
+{
+	WaitEvent(VkEvent ev) : ev(ev)
+	{
+	}
+
+	void play(CommandBuffer::ExecutionState& executionState) override
+	{
+		// The memory dependencies are handled like those of pipeline barriers
+		Cast(ev)->wait();
 	}
 
 private:
 	VkEvent ev;
-	VkPipelineStageFlags stageMask; // FIXME(b/117835459) : We currently ignore the flags and reset the event at the last stage
 };
 
 struct BindDescriptorSet : public CommandBuffer::Command
@@ -578,13 +1095,11 @@ private:
 
 struct SetPushConstants : public CommandBuffer::Command
 {
-	SetPushConstants(uint32_t offset, uint32_t size, void const *pValues)
-		: offset(offset), size(size)
+	SetPushConstants(uint32_t offset, uint32_t size, const uint8_t* data)
+		: offset(offset), size(size), data(data)
 	{
 		ASSERT(offset < MAX_PUSH_CONSTANT_SIZE);
 		ASSERT(offset + size <= MAX_PUSH_CONSTANT_SIZE);
-
-		memcpy(data, pValues, size);
 	}
 
 	void play(CommandBuffer::ExecutionState& executionState)
@@ -595,41 +1110,205 @@ struct SetPushConstants : public CommandBuffer::Command
 private:
 	uint32_t offset;
 	uint32_t size;
-	unsigned char data[MAX_PUSH_CONSTANT_SIZE];
+	const uint8_t* data;   // Stored by the command buffer
 };
 
-CommandBuffer::CommandBuffer(VkCommandBufferLevel pLevel) : level(pLevel)
+struct BeginQuery : public CommandBuffer::Command
+{
+	BeginQuery(QueryPool* queryPool, uint32_t query) : queryPool(queryPool), query(query)
+	{
+	}
+
+	void play(CommandBuffer::ExecutionState& executionState) override
+	{
+		Query* activeQuery = queryPool->getQuery(query);
+		activeQuery->begin();
+		executionState.renderer->addQuery(activeQuery);
+	}
+
+private:
+	QueryPool* queryPool;
+	uint32_t query;
+};
+
+struct EndQuery : public CommandBuffer::Command
+{
+	EndQuery(QueryPool* queryPool, uint32_t query) : queryPool(queryPool), query(query)
+	{
+	}
+
+	void play(CommandBuffer::ExecutionState& executionState) override
+	{
+		// The results become available when the draws accumulating into the query retire
+		Query* activeQuery = queryPool->getQuery(query);
+		executionState.renderer->removeQuery(activeQuery);
+		activeQuery->end();
+	}
+
+private:
+	QueryPool* queryPool;
+	uint32_t query;
+};
+
+struct ResetQueryPool : public CommandBuffer::Command
+{
+	ResetQueryPool(QueryPool* queryPool, uint32_t firstQuery, uint32_t queryCount)
+		: queryPool(queryPool), firstQuery(firstQuery), queryCount(queryCount)
+	{
+	}
+
+	void play(CommandBuffer::ExecutionState& executionState) override
+	{
+		queryPool->reset(firstQuery, queryCount);
+	}
+
+private:
+	QueryPool* queryPool;
+	uint32_t firstQuery;
+	uint32_t queryCount;
+};
+
+struct WriteTimestamp : public CommandBuffer::Command
+{
+	WriteTimestamp(VkPipelineStageFlagBits stage, QueryPool* queryPool, uint32_t query)
+		: stage(stage), queryPool(queryPool), query(query)
+	{
+	}
+
+	void play(CommandBuffer::ExecutionState& executionState) override
+	{
+		// Any later stage is only reached once previous work has retired
+		if(stage != VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT)
+		{
+			executionState.renderer->synchronize();
+		}
+
+		queryPool->writeTimestamp(query);
+	}
+
+private:
+	VkPipelineStageFlagBits stage;
+	QueryPool* queryPool;
+	uint32_t query;
+};
+
+struct CopyQueryPoolResults : public CommandBuffer::Command
+{
+	CopyQueryPoolResults(QueryPool* queryPool, uint32_t firstQuery, uint32_t queryCount,
+	                     Buffer* dstBuffer, VkDeviceSize dstOffset, VkDeviceSize stride, VkQueryResultFlags flags)
+		: queryPool(queryPool), firstQuery(firstQuery), queryCount(queryCount),
+		  dstBuffer(dstBuffer), dstOffset(dstOffset), stride(stride), flags(flags)
+	{
+	}
+
+	void play(CommandBuffer::ExecutionState& executionState) override
+	{
+		executionState.waitForAccess(dstBuffer, true);
+
+		uint8_t* data = static_cast<uint8_t*>(dstBuffer->getOffsetPointer(dstOffset));
+		queryPool->getResults(firstQuery, queryCount, dstBuffer->end() - data, data, stride, flags);
+	}
+
+private:
+	QueryPool* queryPool;
+	uint32_t firstQuery;
+	uint32_t queryCount;
+	Buffer* dstBuffer;
+	VkDeviceSize dstOffset;
+	VkDeviceSize stride;
+	VkQueryResultFlags flags;
+};
+
+CommandBuffer::CommandBuffer(VkCommandBufferLevel pLevel, CommandPool* pool) : level(pLevel), pool(pool)
 {
-	// FIXME (b/119409619): replace this vector by an allocator so we can control all memory allocations
-	commands = new std::vector<std::unique_ptr<Command> >();
 }
 
 void CommandBuffer::destroy(const VkAllocationCallbacks* pAllocator)
 {
-	delete commands;
+	resetState();
 }
 
 void CommandBuffer::resetState()
 {
-	// FIXME (b/119409619): replace this vector by an allocator so we can control all memory allocations
-	commands->clear();
+	for(Command* command = firstCommand; command != nullptr;)
+	{
+		Command* next = command->next;
+		command->~Command();
+		command = next;
+	}
+
+	if(currentChunk)
+	{
+		pool->releaseChunks(currentChunk, firstChunk);
+	}
+
+	currentChunk = nullptr;
+	firstChunk = nullptr;
+	chunkOffset = 0;
+	firstCommand = nullptr;
+	lastCommand = nullptr;
+	outOfMemory = false;
 
 	state = INITIAL;
 }
 
+void* CommandBuffer::allocate(size_t size, size_t alignment)
+{
+	size_t offset = (chunkOffset + alignment - 1) & ~(alignment - 1);
+
+	if(!currentChunk || (offset + size > currentChunk->size))
+	{
+		ASSERT(alignment <= REQUIRED_MEMORY_ALIGNMENT);
+
+		CommandPool::Chunk* chunk = pool->acquireChunk(size);
+		if(!chunk)
+		{
+			outOfMemory = true;
+			return nullptr;
+		}
+
+		if(currentChunk)
+		{
+			chunk->next = currentChunk;
+		}
+		else
+		{
+			firstChunk = chunk;
+		}
+
+		currentChunk = chunk;
+		offset = 0;
+	}
+
+	chunkOffset = offset + size;
+
+	return currentChunk->data() + offset;
+}
+
+template<typename T>
+const T* CommandBuffer::copyData(const T* data, size_t count)
+{
+	void* memory = allocate(count * sizeof(T), alignof(T));
+	if(memory)
+	{
+		memcpy(memory, data, count * sizeof(T));
+	}
+
+	return static_cast<const T*>(memory);
+}
+
 VkResult CommandBuffer::begin(VkCommandBufferUsageFlags flags, const VkCommandBufferInheritanceInfo* pInheritanceInfo)
 {
 	ASSERT((state != RECORDING) && (state != PENDING));
 
 	// Nothing interesting to do based on flags. We don't have any optimizations
-	// to apply for ONE_TIME_SUBMIT or (lack of) SIMULTANEOUS_USE. RENDER_PASS_CONTINUE
-	// must also provide a non-null pInheritanceInfo, which we don't implement yet, but is caught below.
+	// to apply for ONE_TIME_SUBMIT or (lack of) SIMULTANEOUS_USE.
 	(void) flags;
 
-	if(pInheritanceInfo)
-	{
-		UNIMPLEMENTED("pInheritanceInfo");
-	}
+	// Secondary command buffers are played back within the execution state of the
+	// primary command buffer, which holds the current render pass and framebuffer,
+	// so nothing needs to be inherited at record time. Primaries ignore this.
+	(void) pInheritanceInfo;
 
 	if(state != INITIAL)
 	{
@@ -648,7 +1327,7 @@ VkResult CommandBuffer::end()
 
 	state = EXECUTABLE;
 
-	return VK_SUCCESS;
+	return outOfMemory ? VK_ERROR_OUT_OF_HOST_MEMORY : VK_SUCCESS;
 }
 
 VkResult CommandBuffer::reset(VkCommandPoolResetFlags flags)
@@ -663,7 +1342,24 @@ VkResult CommandBuffer::reset(VkCommandPoolResetFlags flags)
 template<typename T, typename... Args>
 void CommandBuffer::addCommand(Args&&... args)
 {
-	commands->push_back(std::unique_ptr<T>(new T(std::forward<Args>(args)...)));
+	void* memory = allocate(sizeof(T), alignof(T));
+	if(!memory)
+	{
+		return;
+	}
+
+	T* command = new (memory) T(std::forward<Args>(args)...);
+
+	if(lastCommand)
+	{
+		lastCommand->next = command;
+	}
+	else
+	{
+		firstCommand = command;
+	}
+
+	lastCommand = command;
 }
 
 void CommandBuffer::beginRenderPass(VkRenderPass renderPass, VkFramebuffer framebuffer, VkRect2D renderArea,
@@ -671,12 +1367,11 @@ void CommandBuffer::beginRenderPass(VkRenderPass renderPass, VkFramebuffer frame
 {
 	ASSERT(state == RECORDING);
 
-	if(contents != VK_SUBPASS_CONTENTS_INLINE)
-	{
-		UNIMPLEMENTED("VK_SUBPASS_CONTENTS_INLINE");
-	}
+	// Inline commands and secondary command buffers are played back the same way,
+	// so the contents don't require any special handling.
+	(void) contents;
 
-	addCommand<BeginRenderPass>(renderPass, framebuffer, renderArea, clearValueCount, clearValues);
+	addCommand<BeginRenderPass>(renderPass, framebuffer, renderArea, clearValueCount, copyData(clearValues, clearValueCount));
 }
 
 void CommandBuffer::nextSubpass(VkSubpassContents contents)
@@ -693,7 +1388,16 @@ void CommandBuffer::endRenderPass()
 
 void CommandBuffer::executeCommands(uint32_t commandBufferCount, const VkCommandBuffer* pCommandBuffers)
 {
-	UNIMPLEMENTED("executeCommands");
+	ASSERT(state == RECORDING);
+	ASSERT(level == VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+
+	for(uint32_t i = 0; i < commandBufferCount; i++)
+	{
+		const CommandBuffer* commandBuffer = Cast(pCommandBuffers[i]);
+		ASSERT(commandBuffer->level == VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+
+		addCommand<ExecuteCommands>(commandBuffer);
+	}
 }
 
 void CommandBuffer::setDeviceMask(uint32_t deviceMask)
@@ -740,46 +1444,67 @@ void CommandBuffer::bindVertexBuffers(uint32_t firstBinding, uint32_t bindingCou
 
 void CommandBuffer::beginQuery(VkQueryPool queryPool, uint32_t query, VkQueryControlFlags flags)
 {
-	UNIMPLEMENTED("beginQuery");
+	ASSERT(state == RECORDING);
+
+	// Occlusion queries always count the exact number of samples passing the
+	// depth and stencil tests, so VK_QUERY_CONTROL_PRECISE_BIT has no effect.
+
+	addCommand<BeginQuery>(Cast(queryPool), query);
 }
 
 void CommandBuffer::endQuery(VkQueryPool queryPool, uint32_t query)
 {
-	UNIMPLEMENTED("endQuery");
+	ASSERT(state == RECORDING);
+
+	addCommand<EndQuery>(Cast(queryPool), query);
 }
 
 void CommandBuffer::resetQueryPool(VkQueryPool queryPool, uint32_t firstQuery, uint32_t queryCount)
 {
-	UNIMPLEMENTED("resetQueryPool");
+	ASSERT(state == RECORDING);
+
+	addCommand<ResetQueryPool>(Cast(queryPool), firstQuery, queryCount);
 }
 
 void CommandBuffer::writeTimestamp(VkPipelineStageFlagBits pipelineStage, VkQueryPool queryPool, uint32_t query)
 {
-	UNIMPLEMENTED("writeTimestamp");
+	ASSERT(state == RECORDING);
+
+	addCommand<WriteTimestamp>(pipelineStage, Cast(queryPool), query);
 }
 
 void CommandBuffer::copyQueryPoolResults(VkQueryPool queryPool, uint32_t firstQuery, uint32_t queryCount,
 	VkBuffer dstBuffer, VkDeviceSize dstOffset, VkDeviceSize stride, VkQueryResultFlags flags)
 {
-	UNIMPLEMENTED("copyQueryPoolResults");
+	ASSERT(state == RECORDING);
+
+	addCommand<CopyQueryPoolResults>(Cast(queryPool), firstQuery, queryCount, Cast(dstBuffer), dstOffset, stride, flags);
 }
 
 void CommandBuffer::pushConstants(VkPipelineLayout layout, VkShaderStageFlags stageFlags,
 	uint32_t offset, uint32_t size, const void* pValues)
 {
-	addCommand<SetPushConstants>(offset, size, pValues);
+	addCommand<SetPushConstants>(offset, size, copyData(static_cast<const uint8_t*>(pValues), size));
 }
 
 void CommandBuffer::setViewport(uint32_t firstViewport, uint32_t viewportCount, const VkViewport* pViewports)
 {
 	// Note: The bound graphics pipeline must have been created with the VK_DYNAMIC_STATE_VIEWPORT dynamic state enabled
-	UNIMPLEMENTED("setViewport");
+
+	// If the multiple viewports feature is not enabled, firstViewport must be 0 and viewportCount must be 1
+	ASSERT((firstViewport == 0) && (viewportCount == 1));
+
+	addCommand<SetViewport>(pViewports[0]);
 }
 
 void CommandBuffer::setScissor(uint32_t firstScissor, uint32_t scissorCount, const VkRect2D* pScissors)
 {
 	// Note: The bound graphics pipeline must have been created with the VK_DYNAMIC_STATE_SCISSOR dynamic state enabled
-	UNIMPLEMENTED("setScissor");
+
+	// If the multiple viewports feature is not enabled, firstScissor must be 0 and scissorCount must be 1
+	ASSERT((firstScissor == 0) && (scissorCount == 1));
+
+	addCommand<SetScissor>(pScissors[0]);
 }
 
 void CommandBuffer::setLineWidth(float lineWidth)
@@ -789,7 +1514,7 @@ void CommandBuffer::setLineWidth(float lineWidth)
 	// If the wide lines feature is not enabled, lineWidth must be 1.0
 	ASSERT(lineWidth == 1.0f);
 
-	UNIMPLEMENTED("setLineWidth");
+	addCommand<SetLineWidth>(lineWidth);
 }
 
 void CommandBuffer::setDepthBias(float depthBiasConstantFactor, float depthBiasClamp, float depthBiasSlopeFactor)
@@ -799,7 +1524,7 @@ void CommandBuffer::setDepthBias(float depthBiasConstantFactor, float depthBiasC
 	// If the depth bias clamping feature is not enabled, depthBiasClamp must be 0.0
 	ASSERT(depthBiasClamp == 0.0f);
 
-	UNIMPLEMENTED("setDepthBias");
+	addCommand<SetDepthBias>(depthBiasConstantFactor, depthBiasSlopeFactor);
 }
 
 void CommandBuffer::setBlendConstants(const float blendConstants[4])
@@ -809,7 +1534,7 @@ void CommandBuffer::setBlendConstants(const float blendConstants[4])
 	// blendConstants is an array of four values specifying the R, G, B, and A components
 	// of the blend constant color used in blending, depending on the blend factor.
 
-	UNIMPLEMENTED("setBlendConstants");
+	addCommand<SetBlendConstants>(blendConstants);
 }
 
 void CommandBuffer::setDepthBounds(float minDepthBounds, float maxDepthBounds)
@@ -830,7 +1555,7 @@ void CommandBuffer::setStencilCompareMask(VkStencilFaceFlags faceMask, uint32_t
 	// faceMask must not be 0
 	ASSERT(faceMask != 0);
 
-	UNIMPLEMENTED("setStencilCompareMask");
+	addCommand<SetStencilValue>(VK_DYNAMIC_STATE_STENCIL_COMPARE_MASK, &ExecutionState::DynamicState::stencilCompareMask, faceMask, compareMask);
 }
 
 void CommandBuffer::setStencilWriteMask(VkStencilFaceFlags faceMask, uint32_t writeMask)
@@ -840,7 +1565,7 @@ void CommandBuffer::setStencilWriteMask(VkStencilFaceFlags faceMask, uint32_t wr
 	// faceMask must not be 0
 	ASSERT(faceMask != 0);
 
-	UNIMPLEMENTED("setStencilWriteMask");
+	addCommand<SetStencilValue>(VK_DYNAMIC_STATE_STENCIL_WRITE_MASK, &ExecutionState::DynamicState::stencilWriteMask, faceMask, writeMask);
 }
 
 void CommandBuffer::setStencilReference(VkStencilFaceFlags faceMask, uint32_t reference)
@@ -850,7 +1575,7 @@ void CommandBuffer::setStencilReference(VkStencilFaceFlags faceMask, uint32_t re
 	// faceMask must not be 0
 	ASSERT(faceMask != 0);
 
-	UNIMPLEMENTED("setStencilReference");
+	addCommand<SetStencilValue>(VK_DYNAMIC_STATE_STENCIL_REFERENCE, &ExecutionState::DynamicState::stencilReference, faceMask, reference);
 }
 
 void CommandBuffer::bindDescriptorSets(VkPipelineBindPoint pipelineBindPoint, VkPipelineLayout layout,
@@ -882,7 +1607,7 @@ void CommandBuffer::dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_
 
 void CommandBuffer::dispatchIndirect(VkBuffer buffer, VkDeviceSize offset)
 {
-	UNIMPLEMENTED("dispatchIndirect");
+	addCommand<DispatchIndirect>(buffer, offset);
 }
 
 void CommandBuffer::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, uint32_t regionCount, const VkBufferCopy* pRegions)
@@ -952,7 +1677,7 @@ void CommandBuffer::updateBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, VkD
 {
 	ASSERT(state == RECORDING);
 
-	addCommand<UpdateBuffer>(dstBuffer, dstOffset, dataSize, pData);
+	addCommand<UpdateBuffer>(dstBuffer, dstOffset, dataSize, copyData(static_cast<const uint8_t*>(pData), dataSize));
 }
 
 void CommandBuffer::fillBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, VkDeviceSize size, uint32_t data)
@@ -1001,7 +1726,16 @@ void CommandBuffer::clearAttachments(uint32_t attachmentCount, const VkClearAtta
 void CommandBuffer::resolveImage(VkImage srcImage, VkImageLayout srcImageLayout, VkImage dstImage, VkImageLayout dstImageLayout,
 	uint32_t regionCount, const VkImageResolve* pRegions)
 {
-	UNIMPLEMENTED("resolveImage");
+	ASSERT(state == RECORDING);
+	ASSERT(srcImageLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL ||
+	       srcImageLayout == VK_IMAGE_LAYOUT_GENERAL);
+	ASSERT(dstImageLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL ||
+	       dstImageLayout == VK_IMAGE_LAYOUT_GENERAL);
+
+	for(uint32_t i = 0; i < regionCount; i++)
+	{
+		addCommand<ResolveImage>(srcImage, dstImage, pRegions[i]);
+	}
 }
 
 void CommandBuffer::setEvent(VkEvent event, VkPipelineStageFlags stageMask)
@@ -1023,7 +1757,13 @@ void CommandBuffer::waitEvents(uint32_t eventCount, const VkEvent* pEvents, VkPi
 	uint32_t bufferMemoryBarrierCount, const VkBufferMemoryBarrier* pBufferMemoryBarriers,
 	uint32_t imageMemoryBarrierCount, const VkImageMemoryBarrier* pImageMemoryBarriers)
 {
-	UNIMPLEMENTED("waitEvents");
+	ASSERT(state == RECORDING);
+
+	// Wait for all events to be signaled
+	for(uint32_t i = 0; i < eventCount; i++)
+	{
+		addCommand<WaitEvent>(pEvents[i]);
+	}
 }
 
 void CommandBuffer::draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance)
@@ -1038,12 +1778,12 @@ void CommandBuffer::drawIndexed(uint32_t indexCount, uint32_t instanceCount, uin
 
 void CommandBuffer::drawIndirect(VkBuffer buffer, VkDeviceSize offset, uint32_t drawCount, uint32_t stride)
 {
-	UNIMPLEMENTED("drawIndirect");
+	addCommand<DrawIndirect>(buffer, offset, drawCount, stride);
 }
 
 void CommandBuffer::drawIndexedIndirect(VkBuffer buffer, VkDeviceSize offset, uint32_t drawCount, uint32_t stride)
 {
-	UNIMPLEMENTED("drawIndexedIndirect");
+	addCommand<DrawIndexedIndirect>(buffer, offset, drawCount, stride);
 }
 
 void CommandBuffer::submit(CommandBuffer::ExecutionState& executionState)
@@ -1051,7 +1791,7 @@ void CommandBuffer::submit(CommandBuffer::ExecutionState& executionState)
 	// Perform recorded work
 	state = PENDING;
 
-	for(auto& command : *commands)
+	for(Command* command = firstCommand; command != nullptr; command = command->next)
 	{
 		command->play(executionState);
 	}
@@ -1060,4 +1800,14 @@ void CommandBuffer::submit(CommandBuffer::ExecutionState& executionState)
 	state = EXECUTABLE;
 }
 
+void CommandBuffer::submitSecondary(CommandBuffer::ExecutionState& executionState) const
+{
+	// The commands are played straight from the secondary command buffer's own
+	// storage, so the primary doesn't copy them when recording.
+	for(Command* command = firstCommand; command != nullptr; command = command->next)
+	{
+		command->play(executionState);
+	}
+}
+
 } // namespace vk
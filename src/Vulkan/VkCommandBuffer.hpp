@@ -15,11 +15,10 @@
 #ifndef VK_COMMAND_BUFFER_HPP_
 #define VK_COMMAND_BUFFER_HPP_
 
+#include "VkCommandPool.hpp"
 #include "VkConfig.h"
 #include "VkObject.hpp"
 #include "Device/Context.hpp"
-#include <memory>
-#include <vector>
 
 namespace sw
 {
@@ -29,7 +28,10 @@ namespace sw
 namespace vk
 {
 
+class Buffer;
 class Framebuffer;
+class GraphicsPipeline;
+class Image;
 class Pipeline;
 class RenderPass;
 
@@ -38,7 +40,7 @@ class CommandBuffer
 public:
 	static constexpr VkSystemAllocationScope GetAllocationScope() { return VK_SYSTEM_ALLOCATION_SCOPE_OBJECT; }
 
-	CommandBuffer(VkCommandBufferLevel pLevel);
+	CommandBuffer(VkCommandBufferLevel pLevel, CommandPool* pool);
 
 	void destroy(const VkAllocationCallbacks* pAllocator);
 
@@ -123,8 +125,10 @@ public:
 	struct ExecutionState
 	{
 		sw::Renderer* renderer = nullptr;
+		sw::Context* context = nullptr;   // The renderer's context
 		RenderPass* renderPass = nullptr;
 		Framebuffer* renderPassFramebuffer = nullptr;
+		VkRect2D renderArea = {};
 		Pipeline* pipelines[VK_PIPELINE_BIND_POINT_RANGE_SIZE] = {};
 		VkDescriptorSet boundDescriptorSets[VK_PIPELINE_BIND_POINT_RANGE_SIZE][MAX_BOUND_DESCRIPTOR_SETS] = { { VK_NULL_HANDLE } };
 		sw::PushConstantStorage pushConstants;
@@ -138,22 +142,64 @@ public:
 		VertexInputBinding indexBufferBinding;
 		VkIndexType indexType;
 
+		// State set by the vkCmdSet* commands, which overrides the state of
+		// pipelines created with the corresponding VkDynamicState.
+		struct DynamicState
+		{
+			VkViewport viewport = {};
+			VkRect2D scissor = {};
+			float blendConstants[4] = {};
+			float lineWidth = 1.0f;
+			float depthBiasConstantFactor = 0.0f;
+			float depthBiasSlopeFactor = 0.0f;
+			uint32_t stencilCompareMask[2] = {};   // Front and back faces
+			uint32_t stencilWriteMask[2] = {};
+			uint32_t stencilReference[2] = {};
+		};
+		DynamicState dynamicState;
+		uint32_t dirtyDynamicStates = 0;   // Bit (1 << VkDynamicState) set for each modified state
+
+		// The pipeline whose state is currently loaded into the renderer
+		GraphicsPipeline* contextPipeline = nullptr;
+
 		void bindAttachments();
+		GraphicsPipeline* bindGraphicsState();
+		void bindVertexInputs(int32_t firstVertex);
+		sw::DrawType bindIndexBuffer(uint32_t firstIndex);   // Returns the indexed draw type
+
+		// Commands executed on the queue thread only wait for the draws in flight
+		// which access the same memory, rather than for all of them.
+		void addDrawAccesses(bool indexed);   // Records the memory accessed by the next draw
+		void waitForAccess(const Image* image, bool write);
+		void waitForAccess(const Buffer* buffer, bool write);
+		void waitForAttachments();
+
+		void resolveAttachments();   // Resolves the multisample attachments of the current subpass
 	};
 
 	void submit(CommandBuffer::ExecutionState& executionState);
+	void submitSecondary(CommandBuffer::ExecutionState& executionState) const;
 
 	class Command;
 private:
 	void resetState();
+	void* allocate(size_t size, size_t alignment);
+	template<typename T> const T* copyData(const T* data, size_t count);
 	template<typename T, typename... Args> void addCommand(Args&&... args);
 
 	enum State { INITIAL, RECORDING, EXECUTABLE, PENDING, INVALID };
 	State state = INITIAL;
 	VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
 
-	// FIXME (b/119409619): replace this vector by an allocator so we can control all memory allocations
-	std::vector<std::unique_ptr<Command>>* commands;
+	// Recorded commands form a linked list, allocated from chunks of the pool.
+	// Chunks are linked from the most recently acquired one, which is being filled.
+	CommandPool* pool = nullptr;
+	CommandPool::Chunk* currentChunk = nullptr;
+	CommandPool::Chunk* firstChunk = nullptr;
+	size_t chunkOffset = 0;
+	Command* firstCommand = nullptr;
+	Command* lastCommand = nullptr;
+	bool outOfMemory = false;
 };
 
 using DispatchableCommandBuffer = DispatchableObject<CommandBuffer, VkCommandBuffer>;
@@ -36,6 +36,8 @@ void CommandPool::destroy(const VkAllocationCallbacks* pAllocator)
 
 	// FIXME (b/119409619): use an allocator here so we can control all memory allocations
 	delete commandBuffers;
+
+	freeChunks();
 }
 
 size_t CommandPool::ComputeRequiredAllocationSize(const VkCommandPoolCreateInfo* pCreateInfo)
@@ -47,7 +49,7 @@ VkResult CommandPool::allocateCommandBuffers(VkCommandBufferLevel level, uint32_
 {
 	for(uint32_t i = 0; i < commandBufferCount; i++)
 	{
-		DispatchableCommandBuffer* commandBuffer = new (DEVICE_MEMORY) DispatchableCommandBuffer(level);
+		DispatchableCommandBuffer* commandBuffer = new (DEVICE_MEMORY) DispatchableCommandBuffer(level, this);
 		if(commandBuffer)
 		{
 			pCommandBuffers[i] = *commandBuffer;
@@ -94,14 +96,57 @@ VkResult CommandPool::reset(VkCommandPoolResetFlags flags)
 	// "Resetting a command pool recycles all of the
 	//  resources from all of the command buffers allocated
 	//  from the command pool back to the command pool."
-	commandBuffers->clear();
+	// The command buffers themselves remain allocated.
+	if(flags & VK_COMMAND_POOL_RESET_RELEASE_RESOURCES_BIT)
+	{
+		freeChunks();
+	}
 
 	return VK_SUCCESS;
 }
 
 void CommandPool::trim(VkCommandPoolTrimFlags flags)
 {
-	// TODO (b/119827933): Optimize memory usage here
+	freeChunks();
+}
+
+CommandPool::Chunk* CommandPool::acquireChunk(size_t minSize)
+{
+	// Chunks are never smaller than CHUNK_SIZE, so only oversized requests can
+	// miss the head of the free list.
+	if(freeList && (freeList->size >= minSize))
+	{
+		Chunk* chunk = freeList;
+		freeList = chunk->next;
+		chunk->next = nullptr;
+		return chunk;
+	}
+
+	size_t size = (minSize > CHUNK_SIZE) ? minSize : CHUNK_SIZE;
+	Chunk* chunk = reinterpret_cast<Chunk*>(vk::allocate(Chunk::HeaderSize + size, REQUIRED_MEMORY_ALIGNMENT, DEVICE_MEMORY));
+	if(chunk)
+	{
+		chunk->next = nullptr;
+		chunk->size = size;
+	}
+
+	return chunk;
+}
+
+void CommandPool::releaseChunks(Chunk* first, Chunk* last)
+{
+	last->next = freeList;
+	freeList = first;
+}
+
+void CommandPool::freeChunks()
+{
+	while(freeList)
+	{
+		Chunk* chunk = freeList;
+		freeList = chunk->next;
+		vk::deallocate(chunk, DEVICE_MEMORY);
+	}
 }
 
 } // namespace vk
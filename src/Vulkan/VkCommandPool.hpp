@@ -35,8 +35,31 @@ public:
 	VkResult reset(VkCommandPoolResetFlags flags);
 	void trim(VkCommandPoolTrimFlags flags);
 
+	// Commands recorded into the pool's command buffers are placement-constructed
+	// into chunks of memory owned by the pool. Command buffers return their chunks
+	// on reset, so that recording only allocates while the pool is warming up.
+	struct Chunk
+	{
+		Chunk* next;
+		size_t size;   // Usable bytes following the header
+
+		uint8_t* data() { return reinterpret_cast<uint8_t*>(this) + HeaderSize; }
+
+		static constexpr size_t HeaderSize = (sizeof(Chunk*) + sizeof(size_t) + REQUIRED_MEMORY_ALIGNMENT - 1) & ~(REQUIRED_MEMORY_ALIGNMENT - 1);
+	};
+
+	// Returns a chunk of at least minSize bytes, or nullptr when out of memory.
+	Chunk* acquireChunk(size_t minSize);
+	// Returns the chunks linked from first to last to the pool.
+	void releaseChunks(Chunk* first, Chunk* last);
+
 private:
+	void freeChunks();
+
+	static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
 	std::set<VkCommandBuffer>* commandBuffers;
+	Chunk* freeList = nullptr;
 };
 
 static inline CommandPool* Cast(VkCommandPool object)
@@ -42,6 +42,7 @@ enum
 	MIN_UNIFORM_BUFFER_OFFSET_ALIGNMENT = 256,
 	MIN_STORAGE_BUFFER_OFFSET_ALIGNMENT = 256,
 	MEMORY_TYPE_GENERIC_BIT = 0x1, // Generic system memory.
+	MIN_UNCOMMITTED_DEVICE_MEMORY_SIZE = 256 * 1024, // Larger device memory allocations only commit pages on first access
 };
 
 enum
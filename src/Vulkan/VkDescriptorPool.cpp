@@ -14,32 +14,43 @@
 
 #include "VkDescriptorPool.hpp"
 #include "VkDescriptorSetLayout.hpp"
-#include <algorithm>
 #include <memory>
 
 namespace vk
 {
 
 DescriptorPool::DescriptorPool(const VkDescriptorPoolCreateInfo* pCreateInfo, void* mem) :
-	pool(reinterpret_cast<VkDescriptorSet>(mem)),
-	poolSize(ComputeRequiredAllocationSize(pCreateInfo))
+	pool(reinterpret_cast<uint8_t*>(mem)),
+	poolSize(ComputeRequiredAllocationSize(pCreateInfo)),
+	headerSize(GetHeaderSize(pCreateInfo))
 {
+	if(headerSize > 0)
+	{
+		freeLists = new std::unordered_map<size_t, FreeSet*>();
+	}
 }
 
 void DescriptorPool::destroy(const VkAllocationCallbacks* pAllocator)
 {
+	delete freeLists;
+
 	vk::deallocate(pool, pAllocator);
 }
 
+size_t DescriptorPool::GetHeaderSize(const VkDescriptorPoolCreateInfo* pCreateInfo)
+{
+	return (pCreateInfo->flags & VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT) ? sizeof(size_t) : 0;
+}
+
 size_t DescriptorPool::ComputeRequiredAllocationSize(const VkDescriptorPoolCreateInfo* pCreateInfo)
 {
-	size_t size = 0;
+	// Each set starts with a pointer to its layout
+	size_t size = pCreateInfo->maxSets * (GetHeaderSize(pCreateInfo) + sizeof(DescriptorSetLayout*));
 
 	for(uint32_t i = 0; i < pCreateInfo->poolSizeCount; i++)
 	{
 		size += pCreateInfo->pPoolSizes[i].descriptorCount *
-		        (sizeof(DescriptorSetLayout*) +
-		         DescriptorSetLayout::GetDescriptorSize(pCreateInfo->pPoolSizes[i].type));
+		        DescriptorSetLayout::GetDescriptorSize(pCreateInfo->pPoolSizes[i].type);
 	}
 
 	return size;
@@ -47,163 +58,141 @@ size_t DescriptorPool::ComputeRequiredAllocationSize(const VkDescriptorPoolCreat
 
 VkResult DescriptorPool::allocateSets(uint32_t descriptorSetCount, const VkDescriptorSetLayout* pSetLayouts, VkDescriptorSet* pDescriptorSets)
 {
-	std::unique_ptr<size_t[]> layoutSizes(new size_t[descriptorSetCount]);
+	const size_t initialUsedSize = usedSize;
+
 	for(uint32_t i = 0; i < descriptorSetCount; i++)
 	{
-		pDescriptorSets[i] = VK_NULL_HANDLE;
-		layoutSizes[i] = Cast(pSetLayouts[i])->getSize();
-	}
+		size_t size = headerSize + sizeof(DescriptorSetLayout*) + Cast(pSetLayouts[i])->getSize();
 
-	VkResult result = allocateSets(&(layoutSizes[0]), descriptorSetCount, pDescriptorSets);
-	if(result == VK_SUCCESS)
-	{
-		for(uint32_t i = 0; i < descriptorSetCount; i++)
+		pDescriptorSets[i] = allocateSet(size);
+		if(pDescriptorSets[i] == VK_NULL_HANDLE)
 		{
-			Cast(pSetLayouts[i])->initialize(pDescriptorSets[i]);
-		}
-	}
-	return result;
-}
+			// Only pools which have freed sets can be fragmented
+			VkResult result = (freeSize >= size) ? VK_ERROR_FRAGMENTED_POOL : VK_ERROR_OUT_OF_POOL_MEMORY;
 
-VkDescriptorSet DescriptorPool::findAvailableMemory(size_t size)
-{
-	if(nodes.empty())
-	{
-		return pool;
-	}
+			// vkAllocateDescriptorSets can be used to create multiple descriptor sets. If the
+			// creation of any of those descriptor sets fails, then the implementation must
+			// destroy all successfully created descriptor set objects from this command, set
+			// all entries of the pDescriptorSets array to VK_NULL_HANDLE and return the error.
+			for(uint32_t j = 0; j < descriptorSetCount; j++)
+			{
+				if((j < i) && (headerSize > 0))
+				{
+					freeSet(pDescriptorSets[j]);
+				}
+				pDescriptorSets[j] = VK_NULL_HANDLE;
+			}
 
-	// First, look for space at the end of the pool
-	const auto itLast = nodes.rbegin();
-	ptrdiff_t itemStart = reinterpret_cast<char*>(itLast->set) - reinterpret_cast<char*>(pool);
-	ptrdiff_t nextItemStart = itemStart + itLast->size;
-	size_t freeSpace = poolSize - nextItemStart;
-	if(freeSpace >= size)
-	{
-		return reinterpret_cast<VkDescriptorSet>(nextItemStart);
-	}
+			if(headerSize == 0)
+			{
+				usedSize = initialUsedSize;
+			}
 
-	// Second, look for space at the beginning of the pool
-	const auto itBegin = nodes.end();
-	freeSpace = reinterpret_cast<char*>(itBegin->set) - reinterpret_cast<char*>(pool);
-	if(freeSpace >= size)
-	{
-		return pool;
+			return result;
+		}
 	}
 
-	// Finally, look between existing pool items
-	const auto itEnd = nodes.end();
-	auto nextIt = itBegin;
-	++nextIt;
-	for(auto it = itBegin; nextIt != itEnd; ++it, ++nextIt)
+	for(uint32_t i = 0; i < descriptorSetCount; i++)
 	{
-		VkDescriptorSet freeSpaceStart = reinterpret_cast<VkDescriptorSet>(reinterpret_cast<char*>(it->set) + it->size);
-		freeSpace = reinterpret_cast<char*>(nextIt->set) - reinterpret_cast<char*>(freeSpaceStart);
-		if(freeSpace >= size)
-		{
-			return freeSpaceStart;
-		}
+		Cast(pSetLayouts[i])->initialize(pDescriptorSets[i]);
 	}
 
-	return VK_NULL_HANDLE;
+	return VK_SUCCESS;
 }
 
-VkResult DescriptorPool::allocateSets(size_t* sizes, uint32_t numAllocs, VkDescriptorSet* pDescriptorSets)
+VkDescriptorSet DescriptorPool::allocateSet(size_t size)
 {
-	size_t totalSize = 0;
-	for(uint32_t i = 0; i < numAllocs; i++)
+	if(freeLists)
 	{
-		totalSize += sizes[i];
-	}
+		auto it = freeLists->find(size);
+		if((it != freeLists->end()) && it->second)
+		{
+			FreeSet* freeSet = it->second;
+			it->second = freeSet->next;
+			freeSize -= size;
 
-	if(totalSize > poolSize)
-	{
-		return VK_ERROR_OUT_OF_POOL_MEMORY;
+			return reinterpret_cast<VkDescriptorSet>(freeSet);
+		}
 	}
 
-	// Attempt to allocate single chunk of memory
-	VkDescriptorSet memory = findAvailableMemory(totalSize);
-	if(memory != VK_NULL_HANDLE)
+	if(usedSize + size <= poolSize)
 	{
-		pDescriptorSets[0] = memory;
-		for(uint32_t i = 1; i < numAllocs; i++)
+		uint8_t* memory = pool + usedSize;
+		usedSize += size;
+
+		if(headerSize > 0)
 		{
-			pDescriptorSets[i] =
-				reinterpret_cast<VkDescriptorSet>(reinterpret_cast<char*>(memory) + sizes[i - 1]);
-			nodes.insert(Node(pDescriptorSets[i], sizes[i]));
+			*reinterpret_cast<size_t*>(memory) = size;
 		}
-		return VK_SUCCESS;
+
+		return reinterpret_cast<VkDescriptorSet>(memory + headerSize);
 	}
 
-	// Atttempt to allocate each descriptor set separately
-	for(uint32_t i = 0; i < numAllocs; i++)
+	if(freeSize >= size)
 	{
-		pDescriptorSets[i] = findAvailableMemory(sizes[i]);
-		if(pDescriptorSets[i] == VK_NULL_HANDLE)
+		// Fall back to the smallest free set which is large enough. It keeps
+		// its size, so it returns to its own free list when freed again.
+		auto best = freeLists->end();
+		for(auto it = freeLists->begin(); it != freeLists->end(); ++it)
 		{
-			// vkAllocateDescriptorSets can be used to create multiple descriptor sets. If the
-			// creation of any of those descriptor sets fails, then the implementation must
-			// destroy all successfully created descriptor set objects from this command, set
-			// all entries of the pDescriptorSets array to VK_NULL_HANDLE and return the error.
-			for(uint32_t j = 0; j < i; j++)
+			if(it->second && (it->first > size) && ((best == freeLists->end()) || (it->first < best->first)))
 			{
-				freeSet(pDescriptorSets[j]);
-				pDescriptorSets[j] = VK_NULL_HANDLE;
+				best = it;
 			}
-			return (computeTotalFreeSize() > totalSize) ? VK_ERROR_FRAGMENTED_POOL : VK_ERROR_OUT_OF_POOL_MEMORY;
 		}
-		nodes.insert(Node(pDescriptorSets[i], sizes[i]));
+
+		if(best != freeLists->end())
+		{
+			FreeSet* freeSet = best->second;
+			best->second = freeSet->next;
+			freeSize -= best->first;
+
+			return reinterpret_cast<VkDescriptorSet>(freeSet);
+		}
 	}
 
-	return VK_SUCCESS;
+	return VK_NULL_HANDLE;
 }
 
 void DescriptorPool::freeSets(uint32_t descriptorSetCount, const VkDescriptorSet* pDescriptorSets)
 {
+	// Sets can only be freed individually if the pool was created with
+	// VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT
+	ASSERT(headerSize > 0);
+
 	for(uint32_t i = 0; i < descriptorSetCount; i++)
 	{
-		freeSet(pDescriptorSets[i]);
+		if(pDescriptorSets[i] != VK_NULL_HANDLE)
+		{
+			freeSet(pDescriptorSets[i]);
+		}
 	}
 }
 
 void DescriptorPool::freeSet(const VkDescriptorSet descriptorSet)
 {
-	const auto itEnd = nodes.end();
-	auto it = std::find(nodes.begin(), itEnd, descriptorSet);
-	if(it != itEnd)
-	{
-		nodes.erase(it);
-	}
-}
+	// The set's size is stored in the header preceding it
+	size_t size = *reinterpret_cast<const size_t*>(reinterpret_cast<uint8_t*>(descriptorSet) - headerSize);
 
-VkResult DescriptorPool::reset()
-{
-	nodes.clear();
+	FreeSet*& head = (*freeLists)[size];
+	FreeSet* freeSet = reinterpret_cast<FreeSet*>(descriptorSet);
+	freeSet->next = head;
+	head = freeSet;
 
-	return VK_SUCCESS;
+	freeSize += size;
 }
 
-size_t DescriptorPool::computeTotalFreeSize() const
+VkResult DescriptorPool::reset()
 {
-	size_t totalFreeSize = 0;
-
-	// Compute space at the end of the pool
-	const auto itLast = nodes.rbegin();
-	totalFreeSize += poolSize - ((reinterpret_cast<char*>(itLast->set) - reinterpret_cast<char*>(pool)) + itLast->size);
+	usedSize = 0;
+	freeSize = 0;
 
-	// Compute space at the beginning of the pool
-	const auto itBegin = nodes.end();
-	totalFreeSize += reinterpret_cast<char*>(itBegin->set) - reinterpret_cast<char*>(pool);
-
-	// Finally, look between existing pool items
-	const auto itEnd = nodes.end();
-	auto nextIt = itBegin;
-	++nextIt;
-	for(auto it = itBegin; nextIt != itEnd; ++it, ++nextIt)
+	if(freeLists)
 	{
-		totalFreeSize += (reinterpret_cast<char*>(nextIt->set) - reinterpret_cast<char*>(it->set)) - it->size;
+		freeLists->clear();
 	}
 
-	return totalFreeSize;
+	return VK_SUCCESS;
 }
 
-} // namespace vk
\ No newline at end of file
+} // namespace vk
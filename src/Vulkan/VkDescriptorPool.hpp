@@ -16,10 +16,16 @@
 #define VK_DESCRIPTOR_POOL_HPP_
 
 #include "VkObject.hpp"
-#include <set>
+#include <unordered_map>
 
 namespace vk
 {
+	// Descriptor sets are allocated from the unused end of the pool's memory.
+	// Pools created without VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT
+	// can only be reset as a whole, so they are a plain bump allocator. Pools
+	// which can free individual sets prefix each set with its size, and keep
+	// freed sets in free lists of their exact size, since applications tend to
+	// allocate sets of the same few layouts over and over.
 	class DescriptorPool : public Object<DescriptorPool, VkDescriptorPool>
 	{
 	public:
@@ -34,24 +40,25 @@ namespace vk
 		VkResult reset();
 
 	private:
-		VkResult allocateSets(size_t* sizes, uint32_t numAllocs, VkDescriptorSet* pDescriptorSets);
-		VkDescriptorSet findAvailableMemory(size_t size);
+		static size_t GetHeaderSize(const VkDescriptorPoolCreateInfo* pCreateInfo);
+
+		VkDescriptorSet allocateSet(size_t size);
 		void freeSet(const VkDescriptorSet descriptorSet);
-		size_t computeTotalFreeSize() const;
 
-		struct Node
+		// Freed sets are linked through their own memory
+		struct FreeSet
 		{
-			Node(VkDescriptorSet set, size_t size) : set(set), size(size) {}
-			bool operator<(const Node& node) const { return this->set < node.set; }
-			bool operator==(VkDescriptorSet set) const { return this->set == set; }
-
-			VkDescriptorSet set;
-			size_t size;
+			FreeSet* next;
 		};
-		std::set<Node> nodes;
 
-		VkDescriptorSet pool = nullptr;
+		uint8_t* pool = nullptr;
 		size_t poolSize = 0;
+		size_t headerSize = 0;   // Size of the per-set header holding the set's size, if sets can be freed
+		size_t usedSize = 0;     // Offset of the unused end of the pool
+		size_t freeSize = 0;     // Total size of the sets in the free lists
+
+		// FIXME (b/119409619): use an allocator here so we can control all memory allocations
+		std::unordered_map<size_t, FreeSet*>* freeLists = nullptr;   // Keyed on the set size, including the header
 	};
 
 	static inline DescriptorPool* Cast(VkDescriptorPool object)
@@ -13,10 +13,15 @@
 // limitations under the License.
 
 #include "VkDescriptorSetLayout.hpp"
+#include "VkBuffer.hpp"
+#include "VkBufferView.hpp"
+#include "VkImage.hpp"
+#include "VkImageView.hpp"
 #include "System/Types.hpp"
 
 #include <algorithm>
 #include <cstring>
+#include <vector>
 
 namespace
 {
@@ -149,6 +154,9 @@ void DescriptorSetLayout::initialize(VkDescriptorSet vkDescriptorSet)
 	descriptorSet->layout = this;
 	uint8_t* mem = descriptorSet->data;
 
+	// Descriptors which are never written stay null, so the resources of a set can be enumerated
+	memset(mem, 0, getSize());
+
 	for(uint32_t i = 0; i < bindingCount; i++)
 	{
 		size_t typeSize = GetDescriptorSize(bindings[i].descriptorType);
@@ -174,6 +182,19 @@ size_t DescriptorSetLayout::getBindingOffset(uint32_t binding) const
 	return bindingOffsets[index] + OFFSET(DescriptorSet, data[0]);
 }
 
+void DescriptorSetLayout::appendKey(std::vector<uint64_t>& key) const
+{
+	// Everything which affects how shaders access this layout's descriptors
+	key.push_back(bindingCount);
+	for(uint32_t i = 0; i < bindingCount; i++)
+	{
+		key.push_back(bindings[i].binding);
+		key.push_back(bindings[i].descriptorType);
+		key.push_back(bindings[i].descriptorCount);
+		key.push_back(bindingOffsets[i]);
+	}
+}
+
 uint8_t* DescriptorSetLayout::getOffsetPointer(VkDescriptorSet descriptorSet, uint32_t binding, uint32_t arrayElement, uint32_t count, size_t* typeSize) const
 {
 	uint32_t index = getBindingIndex(binding);
@@ -183,6 +204,69 @@ uint8_t* DescriptorSetLayout::getOffsetPointer(VkDescriptorSet descriptorSet, ui
 	return &(::Cast(descriptorSet)->data[byteOffset]);
 }
 
+void DescriptorSetLayout::GetResourceAccesses(VkDescriptorSet vkDescriptorSet, std::vector<ResourceAccess>& accesses)
+{
+	const DescriptorSet* descriptorSet = ::Cast(vkDescriptorSet);
+	const DescriptorSetLayout* layout = descriptorSet->layout;
+	const uint8_t* mem = descriptorSet->data;
+
+	for(uint32_t i = 0; i < layout->bindingCount; i++)
+	{
+		const VkDescriptorType type = layout->bindings[i].descriptorType;
+		const size_t typeSize = GetDescriptorSize(type);
+
+		for(uint32_t j = 0; j < layout->bindings[i].descriptorCount; j++, mem += typeSize)
+		{
+			switch(type)
+			{
+			case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+			case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+			case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+			case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+				{
+					auto imageInfo = reinterpret_cast<const VkDescriptorImageInfo*>(mem);
+					if(imageInfo->imageView != VK_NULL_HANDLE)
+					{
+						const Image* image = vk::Cast(imageInfo->imageView)->getImage();
+						accesses.push_back({ image->getMemory(), static_cast<size_t>(image->getMemoryRequirements().size),
+						                     type == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE });
+					}
+				}
+				break;
+			case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
+			case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
+				{
+					auto bufferView = *reinterpret_cast<const VkBufferView*>(mem);
+					if(bufferView != VK_NULL_HANDLE)
+					{
+						const Buffer* buffer = vk::Cast(vk::Cast(bufferView)->getBuffer());
+						accesses.push_back({ buffer->getOffsetPointer(0), static_cast<size_t>(buffer->getMemoryRequirements().size),
+						                     type == VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER });
+					}
+				}
+				break;
+			case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+			case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+			case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+			case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
+				{
+					auto bufferInfo = reinterpret_cast<const VkDescriptorBufferInfo*>(mem);
+					if(bufferInfo->buffer != VK_NULL_HANDLE)
+					{
+						// Dynamic offsets can move the range, so the whole buffer is accessed
+						const Buffer* buffer = vk::Cast(bufferInfo->buffer);
+						accesses.push_back({ buffer->getOffsetPointer(0), static_cast<size_t>(buffer->getMemoryRequirements().size),
+						                     (type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER) || (type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC) });
+					}
+				}
+				break;
+			default:
+				break;   // Samplers don't access memory
+			}
+		}
+	}
+}
+
 const uint8_t* DescriptorSetLayout::GetInputData(const VkWriteDescriptorSet& descriptorWrites)
 {
 	switch(descriptorWrites.descriptorType)
@@ -17,6 +17,8 @@
 
 #include "VkObject.hpp"
 
+#include <vector>
+
 namespace vk
 {
 
@@ -33,9 +35,20 @@ public:
 	static void WriteDescriptorSet(const VkWriteDescriptorSet& descriptorWrites);
 	static void CopyDescriptorSet(const VkCopyDescriptorSet& descriptorCopies);
 
+	// Memory of a resource bound to a descriptor set, which shaders can write
+	// when it's bound as a storage resource
+	struct ResourceAccess
+	{
+		const void* memory;
+		size_t size;
+		bool write;
+	};
+	static void GetResourceAccesses(VkDescriptorSet descriptorSet, std::vector<ResourceAccess>& accesses);
+
 	void initialize(VkDescriptorSet descriptorSet);
 	size_t getSize() const;
 	size_t getBindingOffset(uint32_t binding) const;
+	void appendKey(std::vector<uint64_t>& key) const;
 	uint8_t* getOffsetPointer(VkDescriptorSet descriptorSet, uint32_t binding, uint32_t arrayElement, uint32_t count, size_t* typeSize) const;
 
 private:
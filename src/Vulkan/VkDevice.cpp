@@ -17,11 +17,24 @@
 #include "VkConfig.h"
 #include "VkDebug.hpp"
 #include "VkDescriptorSetLayout.hpp"
+#include "VkFence.hpp"
 #include "VkQueue.hpp"
+#include "VkShaderCache.hpp"
 #include "Device/Blitter.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <climits>
 #include <new> // Must #include this to use "placement new"
 
+namespace
+{
+	std::chrono::time_point<std::chrono::steady_clock, std::chrono::nanoseconds> now()
+	{
+		return std::chrono::time_point_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now());
+	}
+}
+
 namespace vk
 {
 
@@ -53,6 +66,7 @@ Device::Device(const Device::CreateInfo* info, void* mem)
 	}
 
 	blitter = new sw::Blitter();
+	shaderCache = new ShaderCache();
 }
 
 void Device::destroy(const VkAllocationCallbacks* pAllocator)
@@ -65,6 +79,7 @@ void Device::destroy(const VkAllocationCallbacks* pAllocator)
 	vk::deallocate(queues, pAllocator);
 
 	delete blitter;
+	delete shaderCache;
 }
 
 size_t Device::ComputeRequiredAllocationSize(const Device::CreateInfo* info)
@@ -85,9 +100,31 @@ VkQueue Device::getQueue(uint32_t queueFamilyIndex, uint32_t queueIndex) const
 	return queues[queueIndex];
 }
 
-void Device::waitForFences(uint32_t fenceCount, const VkFence* pFences, VkBool32 waitAll, uint64_t timeout)
+VkResult Device::waitForFences(uint32_t fenceCount, const VkFence* pFences, VkBool32 waitAll, uint64_t timeout)
 {
-	// FIXME(b/117835459) : noop
+	const auto start = now();
+	const uint64_t maxTimeout = static_cast<uint64_t>(LLONG_MAX - start.time_since_epoch().count());
+	const bool infiniteTimeout = (timeout > maxTimeout);
+	const auto deadline = start + std::chrono::nanoseconds(std::min(maxTimeout, timeout));
+
+	if(waitAll)
+	{
+		for(uint32_t i = 0; i < fenceCount; i++)
+		{
+			if(infiniteTimeout)
+			{
+				Cast(pFences[i])->wait();
+			}
+			else if(Cast(pFences[i])->wait(deadline) != VK_SUCCESS)
+			{
+				return VK_TIMEOUT;
+			}
+		}
+
+		return VK_SUCCESS;
+	}
+
+	return Fence::waitAny(fenceCount, pFences, infiniteTimeout ? nullptr : &deadline);
 }
 
 void Device::waitIdle()
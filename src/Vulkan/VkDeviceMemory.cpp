@@ -15,6 +15,7 @@
 #include "VkDeviceMemory.hpp"
 
 #include "VkConfig.h"
+#include "System/Memory.hpp"
 
 namespace vk
 {
@@ -27,7 +28,19 @@ DeviceMemory::DeviceMemory(const VkMemoryAllocateInfo* pCreateInfo, void* mem) :
 
 void DeviceMemory::destroy(const VkAllocationCallbacks* pAllocator)
 {
-	vk::deallocate(buffer, DEVICE_MEMORY);
+	if(imported)
+	{
+		return;
+	}
+
+	if(isUncommitted())
+	{
+		sw::deallocateUncommitted(buffer, static_cast<size_t>(size));
+	}
+	else
+	{
+		vk::deallocate(buffer, DEVICE_MEMORY);
+	}
 }
 
 size_t DeviceMemory::ComputeRequiredAllocationSize(const VkMemoryAllocateInfo* pCreateInfo)
@@ -40,7 +53,16 @@ VkResult DeviceMemory::allocate()
 {
 	if(!buffer)
 	{
-		buffer = vk::allocate(size, REQUIRED_MEMORY_ALIGNMENT, DEVICE_MEMORY);
+		// Large allocations are often only partially used, so rather than zeroing
+		// them up front, their pages are committed when they're first accessed.
+		if(isUncommitted())
+		{
+			buffer = sw::allocateUncommitted(static_cast<size_t>(size));
+		}
+		else
+		{
+			buffer = vk::allocate(size, REQUIRED_MEMORY_ALIGNMENT, DEVICE_MEMORY);
+		}
 	}
 
 	if(!buffer)
@@ -51,6 +73,15 @@ VkResult DeviceMemory::allocate()
 	return VK_SUCCESS;
 }
 
+// Uses host memory which outlives this object instead of allocating it
+void DeviceMemory::import(void* hostMemory)
+{
+	ASSERT(!buffer && hostMemory);
+
+	buffer = hostMemory;
+	imported = true;
+}
+
 VkResult DeviceMemory::map(VkDeviceSize pOffset, VkDeviceSize pSize, void** ppData)
 {
 	*ppData = getOffsetPointer(pOffset);
@@ -60,9 +91,19 @@ VkResult DeviceMemory::map(VkDeviceSize pOffset, VkDeviceSize pSize, void** ppDa
 
 VkDeviceSize DeviceMemory::getCommittedMemoryInBytes() const
 {
+	if(isUncommitted() && buffer && !imported)
+	{
+		return sw::committedBytes(buffer, static_cast<size_t>(size));
+	}
+
 	return size;
 }
 
+bool DeviceMemory::isUncommitted() const
+{
+	return size >= MIN_UNCOMMITTED_DEVICE_MEMORY_SIZE;
+}
+
 void* DeviceMemory::getOffsetPointer(VkDeviceSize pOffset)
 {
 	ASSERT(buffer);
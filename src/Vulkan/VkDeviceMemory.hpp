@@ -30,13 +30,18 @@ public:
 
 	void destroy(const VkAllocationCallbacks* pAllocator);
 	VkResult allocate();
+	void import(void* hostMemory);
 	VkResult map(VkDeviceSize offset, VkDeviceSize size, void** ppData);
 	VkDeviceSize getCommittedMemoryInBytes() const;
+	VkDeviceSize getSize() const { return size; }
 	void* getOffsetPointer(VkDeviceSize pOffset);
 	uint32_t getMemoryTypeIndex() const { return memoryTypeIndex; }
 
 private:
+	bool isUncommitted() const;
+
 	void*        buffer = nullptr;
+	bool         imported = false;   // The buffer is owned by someone else
 	VkDeviceSize size = 0;
 	uint32_t     memoryTypeIndex = 0;
 };
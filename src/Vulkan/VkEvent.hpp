@@ -17,6 +17,9 @@
 
 #include "VkObject.hpp"
 
+#include <condition_variable>
+#include <mutex>
+
 namespace vk
 {
 
@@ -34,23 +37,36 @@ public:
 		return 0;
 	}
 
+	// Events can be set and reset by the device or the host, from any thread
 	void signal()
 	{
+		std::unique_lock<std::mutex> lock(mutex);
 		status = VK_EVENT_SET;
+		condition.notify_all();
 	}
 
 	void reset()
 	{
+		std::unique_lock<std::mutex> lock(mutex);
 		status = VK_EVENT_RESET;
 	}
 
-	VkResult getStatus() const
+	VkResult getStatus()
 	{
+		std::unique_lock<std::mutex> lock(mutex);
 		return status;
 	}
 
+	void wait()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		condition.wait(lock, [this] { return status == VK_EVENT_SET; });
+	}
+
 private:
 	VkResult status = VK_EVENT_RESET;
+	std::mutex mutex;
+	std::condition_variable condition;
 };
 
 static inline Event* Cast(VkEvent object)
@@ -17,6 +17,10 @@
 
 #include "VkObject.hpp"
 
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
 namespace vk
 {
 
@@ -24,7 +28,7 @@ class Fence : public Object<Fence, VkFence>
 {
 public:
 	Fence(const VkFenceCreateInfo* pCreateInfo, void* mem) :
-		status((pCreateInfo->flags & VK_FENCE_CREATE_SIGNALED_BIT) ? VK_SUCCESS : VK_NOT_READY)
+		signaled((pCreateInfo->flags & VK_FENCE_CREATE_SIGNALED_BIT) != 0)
 	{
 	}
 
@@ -37,21 +41,66 @@ public:
 
 	void signal()
 	{
-		status = VK_SUCCESS;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			signaled = true;
+			condition.notify_all();
+		}
+
+		// Taking the shared mutex after setting the flag ensures waitAny() callers either
+		// observe it, or are already waiting to be notified.
+		std::unique_lock<std::mutex> anyLock(anyMutex());
+		anyCondition().notify_all();
 	}
 
 	void reset()
 	{
-		status = VK_NOT_READY;
+		std::unique_lock<std::mutex> lock(mutex);
+		signaled = false;
 	}
 
-	VkResult getStatus() const
+	VkResult getStatus()
 	{
-		return status;
+		std::unique_lock<std::mutex> lock(mutex);
+		return signaled ? VK_SUCCESS : VK_NOT_READY;
 	}
 
+	void wait()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		condition.wait(lock, [this] { return signaled; });
+	}
+
+	// Returns VK_TIMEOUT if the fence wasn't signaled before the timeout expired
+	template<class CLOCK, class DURATION>
+	VkResult wait(const std::chrono::time_point<CLOCK, DURATION>& timeout)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		return condition.wait_until(lock, timeout, [this] { return signaled; }) ? VK_SUCCESS : VK_TIMEOUT;
+	}
+
+	// Blocks until any of the fences is signaled. Returns VK_TIMEOUT if none were signaled
+	// before the timeout expired, or waits indefinitely if timeout is null.
+	template<class CLOCK, class DURATION>
+	static VkResult waitAny(uint32_t fenceCount, const VkFence* pFences, const std::chrono::time_point<CLOCK, DURATION>* timeout);
+
 private:
-	VkResult status = VK_NOT_READY;
+	// Shared by all fences, so waitAny() can block on a single condition variable
+	static std::mutex& anyMutex()
+	{
+		static std::mutex mutex;
+		return mutex;
+	}
+
+	static std::condition_variable& anyCondition()
+	{
+		static std::condition_variable condition;
+		return condition;
+	}
+
+	bool signaled = false;
+	std::mutex mutex;
+	std::condition_variable condition;
 };
 
 static inline Fence* Cast(VkFence object)
@@ -59,6 +108,33 @@ static inline Fence* Cast(VkFence object)
 	return reinterpret_cast<Fence*>(object);
 }
 
+template<class CLOCK, class DURATION>
+VkResult Fence::waitAny(uint32_t fenceCount, const VkFence* pFences, const std::chrono::time_point<CLOCK, DURATION>* timeout)
+{
+	auto anySignaled = [fenceCount, pFences]
+	{
+		for(uint32_t i = 0; i < fenceCount; i++)
+		{
+			if(vk::Cast(pFences[i])->getStatus() == VK_SUCCESS)
+			{
+				return true;
+			}
+		}
+
+		return false;
+	};
+
+	std::unique_lock<std::mutex> lock(anyMutex());
+
+	if(!timeout)
+	{
+		anyCondition().wait(lock, anySignaled);
+		return VK_SUCCESS;
+	}
+
+	return anyCondition().wait_until(lock, *timeout, anySignaled) ? VK_SUCCESS : VK_TIMEOUT;
+}
+
 } // namespace vk
 
 #endif // VK_FENCE_HPP_
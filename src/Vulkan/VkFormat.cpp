@@ -120,11 +120,6 @@ bool Format::isDepth() const
 	}
 }
 
-bool Format::hasQuadLayout() const
-{
-	return false;
-}
-
 bool Format::isSRGBformat() const
 {
 	switch(format)
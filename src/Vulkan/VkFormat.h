@@ -37,7 +37,6 @@ public:
 
 	bool isStencil() const;
 	bool isDepth() const;
-	bool hasQuadLayout() const;
 
 	bool isSRGBformat() const;
 	bool isSRGBwritable() const;
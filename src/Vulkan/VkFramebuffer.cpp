@@ -94,6 +94,24 @@ void Framebuffer::clear(const VkClearAttachment& attachment, const VkClearRect&
 	}
 }
 
+void Framebuffer::resolve(const RenderPass* activeRenderPass, const VkRect2D& renderArea, sw::ThreadPool& pool)
+{
+	// The framebuffer may be used with any render pass compatible with the one it was created for
+	VkSubpassDescription subpass = activeRenderPass->getCurrentSubpass();
+
+	if(subpass.pResolveAttachments)
+	{
+		for(uint32_t i = 0; i < subpass.colorAttachmentCount; i++)
+		{
+			uint32_t resolveAttachment = subpass.pResolveAttachments[i].attachment;
+			if(resolveAttachment != VK_ATTACHMENT_UNUSED)
+			{
+				attachments[subpass.pColorAttachments[i].attachment]->resolve(attachments[resolveAttachment], renderArea, pool);
+			}
+		}
+	}
+}
+
 ImageView *Framebuffer::getAttachment(uint32_t index) const
 {
 	return attachments[index];
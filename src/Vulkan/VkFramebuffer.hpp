@@ -17,6 +17,11 @@
 
 #include "VkObject.hpp"
 
+namespace sw
+{
+	class ThreadPool;
+}
+
 namespace vk
 {
 
@@ -32,9 +37,11 @@ public:
 
 	void clear(uint32_t clearValueCount, const VkClearValue* pClearValues, const VkRect2D& renderArea);
 	void clear(const VkClearAttachment& attachment, const VkClearRect& rect);
+	void resolve(const RenderPass* activeRenderPass, const VkRect2D& renderArea, sw::ThreadPool& pool);
 
 	static size_t ComputeRequiredAllocationSize(const VkFramebufferCreateInfo* pCreateInfo);
 	ImageView *getAttachment(uint32_t index) const;
+	uint32_t getAttachmentCount() const { return attachmentCount; }
 
 private:
 	RenderPass* renderPass;
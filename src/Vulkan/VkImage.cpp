@@ -17,6 +17,9 @@
 #include "VkDevice.hpp"
 #include "VkImage.hpp"
 #include "Device/Blitter.hpp"
+#include "System/Memory.hpp"
+#include "System/ThreadPool.hpp"
+#include <algorithm>
 #include <cstring>
 
 namespace
@@ -36,6 +39,70 @@ namespace
 		if (!aspects) aspects |= VK_IMAGE_ASPECT_COLOR_BIT;
 		return aspects;
 	}
+
+	// Offset of texel (x, y) in a slice which stores each 2x2 quad contiguously, top
+	// row first. Each pair of rows occupies two row pitches.
+	VkDeviceSize QuadOffset(int x, int y, int rowPitchBytes, int bytesPerTexel)
+	{
+		return static_cast<VkDeviceSize>(y & ~1) * rowPitchBytes + ((y & 1) * 2 + x * 2 - (x & 1)) * bytesPerTexel;
+	}
+
+	// Texels taking part in a copy, in an image aspect or in a buffer
+	struct TexelRegion
+	{
+		uint8_t* slice;   // Texel (0, 0) of the first slice
+		int x;            // Offset of the region within the slices
+		int y;
+		int rowPitchBytes;
+		int slicePitchBytes;
+		bool quadLayout;
+
+		uint8_t* texel(int i, int j, int k, int bytesPerTexel) const
+		{
+			uint8_t* s = slice + static_cast<VkDeviceSize>(k) * slicePitchBytes;
+
+			return s + (quadLayout ? QuadOffset(x + i, y + j, rowPitchBytes, bytesPerTexel) :
+			                         static_cast<VkDeviceSize>(y + j) * rowPitchBytes + (x + i) * bytesPerTexel);
+		}
+
+		// Whether texels i and i + 1 of a row are adjacent in memory
+		bool isPair(int i) const
+		{
+			return !quadLayout || (((x + i) & 1) == 0);
+		}
+	};
+
+	// Copies texels between regions of which at least one stores 2x2 quads contiguously,
+	// so rows are not contiguous. Texel pairs which are adjacent in both are copied together.
+	void CopyTexels(sw::ThreadPool& pool, const TexelRegion& dst, const TexelRegion& src,
+	                int bytesPerTexel, int width, int height, int depth)
+	{
+		const size_t minTaskBytes = 0x10000;
+
+		size_t rows = static_cast<size_t>(height) * depth;
+		size_t bytes = rows * width * bytesPerTexel;
+		size_t tasks = std::min(std::min(rows, 4 * static_cast<size_t>(pool.getThreadCount())),
+		                        std::max(bytes / minTaskBytes, static_cast<size_t>(1)));
+
+		pool.parallelFor(static_cast<int>(tasks), [&](int task)
+		{
+			size_t begin = rows * task / tasks;
+			size_t end = rows * (task + 1) / tasks;
+
+			for(size_t row = begin; row < end; row++)
+			{
+				int j = static_cast<int>(row % height);
+				int k = static_cast<int>(row / height);
+
+				for(int i = 0; i < width;)
+				{
+					int count = ((i + 1) < width && dst.isPair(i) && src.isPair(i)) ? 2 : 1;
+					memcpy(dst.texel(i, j, k, bytesPerTexel), src.texel(i, j, k, bytesPerTexel), count * bytesPerTexel);
+					i += count;
+				}
+			}
+		});
+	}
 }
 
 namespace vk
@@ -52,9 +119,9 @@ Image::Image(const Image::CreateInfo* pCreateInfo, void* mem) :
 	samples(pCreateInfo->pCreateInfo->samples),
 	tiling(pCreateInfo->pCreateInfo->tiling)
 {
-	if (samples != VK_SAMPLE_COUNT_1_BIT)
+	if((samples != VK_SAMPLE_COUNT_1_BIT) && (samples != VK_SAMPLE_COUNT_4_BIT))
 	{
-		UNIMPLEMENTED("Multisample images not yet supported");
+		UNIMPLEMENTED("samples");
 	}
 }
 
@@ -99,7 +166,7 @@ void Image::getSubresourceLayout(const VkImageSubresource* pSubresource, VkSubre
 	pLayout->arrayPitch = getLayerSize(aspect);
 }
 
-void Image::copyTo(VkImage dstImage, const VkImageCopy& pRegion)
+void Image::copyTo(VkImage dstImage, const VkImageCopy& pRegion, sw::ThreadPool& pool)
 {
 	// Image copy does not perform any conversion, it simply copies memory from
 	// an image to another image that has the same number of bytes per pixel.
@@ -137,11 +204,29 @@ void Image::copyTo(VkImage dstImage, const VkImageCopy& pRegion)
 	int dstRowPitchBytes = dst->rowPitchBytes(dstAspect, pRegion.dstSubresource.mipLevel);
 	int dstSlicePitchBytes = dst->slicePitchBytes(dstAspect, pRegion.dstSubresource.mipLevel);
 
+	ASSERT(samples == dst->samples);
+
+	if(hasQuadLayout(srcAspect) || dst->hasQuadLayout(dstAspect))
+	{
+		// The samples of multisample images are consecutive planes
+		VkOffset3D srcSlice = { 0, 0, pRegion.srcOffset.z };
+		VkOffset3D dstSlice = { 0, 0, pRegion.dstOffset.z };
+
+		TexelRegion srcRegion = { static_cast<uint8_t*>(getTexelPointer(srcSlice, pRegion.srcSubresource)),
+		                          pRegion.srcOffset.x, pRegion.srcOffset.y,
+		                          srcRowPitchBytes, srcSlicePitchBytes, hasQuadLayout(srcAspect) };
+		TexelRegion dstRegion = { static_cast<uint8_t*>(dst->getTexelPointer(dstSlice, pRegion.dstSubresource)),
+		                          pRegion.dstOffset.x, pRegion.dstOffset.y,
+		                          dstRowPitchBytes, dstSlicePitchBytes, dst->hasQuadLayout(dstAspect) };
+
+		CopyTexels(pool, dstRegion, srcRegion, srcBytesPerTexel,
+		           pRegion.extent.width, pRegion.extent.height, pRegion.extent.depth * samples);
+		return;
+	}
+
 	VkExtent3D srcExtent = getMipLevelExtent(pRegion.srcSubresource.mipLevel);
 	VkExtent3D dstExtent = dst->getMipLevelExtent(pRegion.dstSubresource.mipLevel);
 
-	bool isSinglePlane = (pRegion.extent.depth == 1);
-	bool isSingleLine  = (pRegion.extent.height == 1) && isSinglePlane;
 	// In order to copy multiple lines using a single memcpy call, we
 	// have to make sure that we need to copy the entire line and that
 	// both source and destination lines have the same length in bytes
@@ -156,55 +241,35 @@ void Image::copyTo(VkImage dstImage, const VkImageCopy& pRegion)
 	                     (pRegion.extent.height == dstExtent.height) &&
 	                     (srcSlicePitchBytes == dstSlicePitchBytes);
 
-	if(isSingleLine) // Copy one line
-	{
-		size_t copySize = pRegion.extent.width * srcBytesPerTexel;
-		ASSERT((srcMem + copySize) < end());
-		ASSERT((dstMem + copySize) < dst->end());
-		memcpy(dstMem, srcMem, copySize);
-	}
-	else if(isEntireLine && isSinglePlane) // Copy one plane
-	{
-		size_t copySize = pRegion.extent.height * srcRowPitchBytes;
-		ASSERT((srcMem + copySize) < end());
-		ASSERT((dstMem + copySize) < dst->end());
-		memcpy(dstMem, srcMem, copySize);
-	}
-	else if(isEntirePlane) // Copy multiple planes
+	// The region is copied as slices of rows, where contiguous
+	// lines and planes are merged into fewer and longer rows.
+	// The samples of multisample images are consecutive planes.
+	size_t rowSize = pRegion.extent.width * srcBytesPerTexel;
+	size_t rowCount = pRegion.extent.height;
+	size_t sliceCount = pRegion.extent.depth * samples;
+
+	if(isEntirePlane) // Copy all planes at once
 	{
-		size_t copySize = pRegion.extent.depth * srcSlicePitchBytes;
-		ASSERT((srcMem + copySize) < end());
-		ASSERT((dstMem + copySize) < dst->end());
-		memcpy(dstMem, srcMem, copySize);
+		rowSize = sliceCount * srcSlicePitchBytes;
+		rowCount = 1;
+		sliceCount = 1;
 	}
 	else if(isEntireLine) // Copy plane by plane
 	{
-		size_t copySize = pRegion.extent.height * srcRowPitchBytes;
-
-		for(uint32_t z = 0; z < pRegion.extent.depth; z++, dstMem += dstSlicePitchBytes, srcMem += srcSlicePitchBytes)
-		{
-			ASSERT((srcMem + copySize) < end());
-			ASSERT((dstMem + copySize) < dst->end());
-			memcpy(dstMem, srcMem, copySize);
-		}
+		rowSize = pRegion.extent.height * srcRowPitchBytes;
+		rowCount = 1;
 	}
-	else // Copy line by line
-	{
-		size_t copySize = pRegion.extent.width * srcBytesPerTexel;
 
-		for(uint32_t z = 0; z < pRegion.extent.depth; z++)
-		{
-			for(uint32_t y = 0; y < pRegion.extent.height; y++, dstMem += dstRowPitchBytes, srcMem += srcRowPitchBytes)
-			{
-				ASSERT((srcMem + copySize) < end());
-				ASSERT((dstMem + copySize) < dst->end());
-				memcpy(dstMem, srcMem, copySize);
-			}
-		}
-	}
+	size_t lastSrcRow = (sliceCount - 1) * srcSlicePitchBytes + (rowCount - 1) * srcRowPitchBytes;
+	size_t lastDstRow = (sliceCount - 1) * dstSlicePitchBytes + (rowCount - 1) * dstRowPitchBytes;
+	ASSERT((srcMem + lastSrcRow + rowSize) <= end());
+	ASSERT((dstMem + lastDstRow + rowSize) <= dst->end());
+
+	sw::copyRows(pool, dstMem, srcMem, rowSize, rowCount, sliceCount,
+	             dstRowPitchBytes, srcRowPitchBytes, dstSlicePitchBytes, srcSlicePitchBytes);
 }
 
-void Image::copy(VkBuffer buf, const VkBufferImageCopy& region, bool bufferIsSource)
+void Image::copy(VkBuffer buf, const VkBufferImageCopy& region, bool bufferIsSource, sw::ThreadPool& pool)
 {
 	if(!((region.imageSubresource.aspectMask == VK_IMAGE_ASPECT_COLOR_BIT) ||
 	     (region.imageSubresource.aspectMask == VK_IMAGE_ASPECT_DEPTH_BIT) ||
@@ -239,6 +304,30 @@ void Image::copy(VkBuffer buf, const VkBufferImageCopy& region, bool bufferIsSou
 
 	Buffer* buffer = Cast(buf);
 	uint8_t* bufferMemory = static_cast<uint8_t*>(buffer->getOffsetPointer(region.bufferOffset));
+
+	if(hasQuadLayout(aspect))
+	{
+		VkOffset3D slice = { 0, 0, region.imageOffset.z };
+		VkImageSubresourceLayers subresource = region.imageSubresource;
+
+		TexelRegion bufferRegion = { bufferMemory, 0, 0, bufferRowPitchBytes, bufferSlicePitchBytes, false };
+		TexelRegion imageRegion = { nullptr, region.imageOffset.x, region.imageOffset.y,
+		                            imageRowPitchBytes, imageSlicePitchBytes, true };
+
+		for(uint32_t i = 0; i < region.imageSubresource.layerCount; i++)
+		{
+			subresource.baseArrayLayer = region.imageSubresource.baseArrayLayer + i;
+			imageRegion.slice = static_cast<uint8_t*>(getTexelPointer(slice, subresource));
+
+			CopyTexels(pool, bufferIsSource ? imageRegion : bufferRegion, bufferIsSource ? bufferRegion : imageRegion,
+			           imageBytesPerTexel, region.imageExtent.width, region.imageExtent.height, region.imageExtent.depth);
+
+			bufferRegion.slice += static_cast<VkDeviceSize>(bufferSlicePitchBytes) * region.imageExtent.depth;
+		}
+
+		return;
+	}
+
 	uint8_t* imageMemory = static_cast<uint8_t*>(deviceMemory->getOffsetPointer(
 	                       getMemoryOffset(aspect, region.imageSubresource.mipLevel,
 	                                       region.imageSubresource.baseArrayLayer) +
@@ -278,61 +367,43 @@ void Image::copy(VkBuffer buf, const VkBufferImageCopy& region, bool bufferIsSou
 	VkDeviceSize srcLayerSize = bufferIsSource ? bufferLayerSize : imageLayerSize;
 	VkDeviceSize dstLayerSize = bufferIsSource ? imageLayerSize : bufferLayerSize;
 
+	// Lines and planes which are contiguous in both the image and the buffer are copied as a single row
+	size_t rowCount = region.imageExtent.height;
+	size_t sliceCount = region.imageExtent.depth;
+	if(isSingleLine || (isEntireLine && isSinglePlane) || isEntirePlane)
+	{
+		rowCount = 1;
+		sliceCount = 1;
+	}
+	else if(isEntireLine) // Copy plane by plane
+	{
+		rowCount = 1;
+	}
+
+	size_t lastSrcRow = (sliceCount - 1) * srcSlicePitchBytes + (rowCount - 1) * srcRowPitchBytes;
+	size_t lastDstRow = (sliceCount - 1) * dstSlicePitchBytes + (rowCount - 1) * dstRowPitchBytes;
+
 	for(uint32_t i = 0; i < region.imageSubresource.layerCount; i++)
 	{
-		if(isSingleLine || (isEntireLine && isSinglePlane) || isEntirePlane)
-		{
-			ASSERT(((bufferIsSource ? dstMemory : srcMemory) + copySize) < end());
-			ASSERT(((bufferIsSource ? srcMemory : dstMemory) + copySize) < buffer->end());
-			memcpy(dstMemory, srcMemory, copySize);
-		}
-		else if(isEntireLine) // Copy plane by plane
-		{
-			uint8_t* srcPlaneMemory = srcMemory;
-			uint8_t* dstPlaneMemory = dstMemory;
-			for(uint32_t z = 0; z < region.imageExtent.depth; z++)
-			{
-				ASSERT(((bufferIsSource ? dstPlaneMemory : srcPlaneMemory) + copySize) < end());
-				ASSERT(((bufferIsSource ? srcPlaneMemory : dstPlaneMemory) + copySize) < buffer->end());
-				memcpy(dstPlaneMemory, srcPlaneMemory, copySize);
-				srcPlaneMemory += srcSlicePitchBytes;
-				dstPlaneMemory += dstSlicePitchBytes;
-			}
-		}
-		else // Copy line by line
-		{
-			uint8_t* srcLayerMemory = srcMemory;
-			uint8_t* dstLayerMemory = dstMemory;
-			for(uint32_t z = 0; z < region.imageExtent.depth; z++)
-			{
-				uint8_t* srcPlaneMemory = srcLayerMemory;
-				uint8_t* dstPlaneMemory = dstLayerMemory;
-				for(uint32_t y = 0; y < region.imageExtent.height; y++)
-				{
-					ASSERT(((bufferIsSource ? dstPlaneMemory : srcPlaneMemory) + copySize) < end());
-					ASSERT(((bufferIsSource ? srcPlaneMemory : dstPlaneMemory) + copySize) < buffer->end());
-					memcpy(dstPlaneMemory, srcPlaneMemory, copySize);
-					srcPlaneMemory += srcRowPitchBytes;
-					dstPlaneMemory += dstRowPitchBytes;
-				}
-				srcLayerMemory += srcSlicePitchBytes;
-				dstLayerMemory += dstSlicePitchBytes;
-			}
-		}
+		ASSERT(((bufferIsSource ? dstMemory + lastDstRow : srcMemory + lastSrcRow) + copySize) <= end());
+		ASSERT(((bufferIsSource ? srcMemory + lastSrcRow : dstMemory + lastDstRow) + copySize) <= buffer->end());
+
+		sw::copyRows(pool, dstMemory, srcMemory, static_cast<size_t>(copySize), rowCount, sliceCount,
+		             dstRowPitchBytes, srcRowPitchBytes, dstSlicePitchBytes, srcSlicePitchBytes);
 
 		srcMemory += srcLayerSize;
 		dstMemory += dstLayerSize;
 	}
 }
 
-void Image::copyTo(VkBuffer dstBuffer, const VkBufferImageCopy& region)
+void Image::copyTo(VkBuffer dstBuffer, const VkBufferImageCopy& region, sw::ThreadPool& pool)
 {
-	copy(dstBuffer, region, false);
+	copy(dstBuffer, region, false, pool);
 }
 
-void Image::copyFrom(VkBuffer srcBuffer, const VkBufferImageCopy& region)
+void Image::copyFrom(VkBuffer srcBuffer, const VkBufferImageCopy& region, sw::ThreadPool& pool)
 {
-	copy(srcBuffer, region, true);
+	copy(srcBuffer, region, true, pool);
 }
 
 void* Image::getTexelPointer(const VkOffset3D& offset, const VkImageSubresourceLayers& subresource) const
@@ -345,7 +416,14 @@ void* Image::getTexelPointer(const VkOffset3D& offset, const VkImageSubresourceL
 VkDeviceSize Image::texelOffsetBytesInStorage(const VkOffset3D& offset, const VkImageSubresourceLayers& subresource) const
 {
 	VkImageAspectFlagBits aspect = static_cast<VkImageAspectFlagBits>(subresource.aspectMask);
-	return offset.z * slicePitchBytes(aspect, subresource.mipLevel) +
+	VkDeviceSize sliceOffset = offset.z * slicePitchBytes(aspect, subresource.mipLevel);
+
+	if(hasQuadLayout(aspect))
+	{
+		return sliceOffset + QuadOffset(offset.x, offset.y, rowPitchBytes(aspect, subresource.mipLevel), bytesPerTexel(aspect));
+	}
+
+	return sliceOffset +
 	       (offset.y + (isCube() ? 1 : 0)) * rowPitchBytes(aspect, subresource.mipLevel) +
 	       (offset.x + (isCube() ? 1 : 0)) * bytesPerTexel(aspect);
 }
@@ -432,6 +510,15 @@ Format Image::getFormat(VkImageAspectFlagBits aspect) const
 	return format;
 }
 
+bool Image::hasQuadLayout(VkImageAspectFlagBits aspect) const
+{
+	// Optimally tiled depth and stencil aspects store each 2x2 quad of texels
+	// contiguously, in the order the pixel routines test and write them. Only
+	// linear images are host-accessible, so nothing else observes the layout.
+	return (tiling == VK_IMAGE_TILING_OPTIMAL) && !isCube() &&
+	       ((aspect == VK_IMAGE_ASPECT_DEPTH_BIT) || (aspect == VK_IMAGE_ASPECT_STENCIL_BIT));
+}
+
 bool Image::isCube() const
 {
 	return (flags & VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT) && (imageType == VK_IMAGE_TYPE_2D);
@@ -439,7 +526,12 @@ bool Image::isCube() const
 
 uint8_t* Image::end() const
 {
-	return reinterpret_cast<uint8_t*>(deviceMemory->getOffsetPointer(deviceMemory->getCommittedMemoryInBytes() + 1));
+	return reinterpret_cast<uint8_t*>(deviceMemory->getOffsetPointer(deviceMemory->getSize() + 1));
+}
+
+const void* Image::getMemory() const
+{
+	return deviceMemory->getOffsetPointer(memoryOffset);
 }
 
 VkDeviceSize Image::getMemoryOffset(VkImageAspectFlagBits aspect) const
@@ -479,7 +571,7 @@ VkDeviceSize Image::getMemoryOffset(VkImageAspectFlagBits aspect, uint32_t mipLe
 
 VkDeviceSize Image::getMipLevelSize(VkImageAspectFlagBits aspect, uint32_t mipLevel) const
 {
-	return getMipLevelExtent(mipLevel).depth * slicePitchBytes(aspect, mipLevel);
+	return getMipLevelExtent(mipLevel).depth * slicePitchBytes(aspect, mipLevel) * samples;
 }
 
 VkDeviceSize Image::getLayerSize(VkImageAspectFlagBits aspect) const
@@ -508,6 +600,11 @@ void Image::blit(VkImage dstImage, const VkImageBlit& region, VkFilter filter)
 	device->getBlitter()->blit(this, Cast(dstImage), region, filter);
 }
 
+void Image::resolve(VkImage dstImage, const VkImageResolve& region, sw::ThreadPool& pool)
+{
+	device->getBlitter()->resolve(this, Cast(dstImage), region, pool);
+}
+
 VkFormat Image::getClearFormat() const
 {
 	// Set the proper format for the clear value, as described here:
@@ -18,6 +18,11 @@
 #include "VkObject.hpp"
 #include "VkFormat.h"
 
+namespace sw
+{
+	class ThreadPool;
+}
+
 namespace vk
 {
 
@@ -42,11 +47,12 @@ public:
 	const VkMemoryRequirements getMemoryRequirements() const;
 	void getSubresourceLayout(const VkImageSubresource* pSubresource, VkSubresourceLayout* pLayout) const;
 	void bind(VkDeviceMemory pDeviceMemory, VkDeviceSize pMemoryOffset);
-	void copyTo(VkImage dstImage, const VkImageCopy& pRegion);
-	void copyTo(VkBuffer dstBuffer, const VkBufferImageCopy& region);
-	void copyFrom(VkBuffer srcBuffer, const VkBufferImageCopy& region);
+	void copyTo(VkImage dstImage, const VkImageCopy& pRegion, sw::ThreadPool& pool);
+	void copyTo(VkBuffer dstBuffer, const VkBufferImageCopy& region, sw::ThreadPool& pool);
+	void copyFrom(VkBuffer srcBuffer, const VkBufferImageCopy& region, sw::ThreadPool& pool);
 
 	void blit(VkImage dstImage, const VkImageBlit& region, VkFilter filter);
+	void resolve(VkImage dstImage, const VkImageResolve& region, sw::ThreadPool& pool);
 	void clear(const VkClearValue& clearValue, const VkRect2D& renderArea, const VkImageSubresourceRange& subresourceRange);
 	void clear(const VkClearColorValue& color, const VkImageSubresourceRange& subresourceRange);
 	void clear(const VkClearDepthStencilValue& color, const VkImageSubresourceRange& subresourceRange);
@@ -64,10 +70,12 @@ public:
 	int                      slicePitchBytes(VkImageAspectFlagBits aspect, uint32_t mipLevel) const;
 	void*                    getTexelPointer(const VkOffset3D& offset, const VkImageSubresourceLayers& subresource) const;
 	bool                     isCube() const;
+	bool                     hasQuadLayout(VkImageAspectFlagBits aspect) const;
 	uint8_t*                 end() const;
+	const void*              getMemory() const;   // Start of the memory bound to the image
 
 private:
-	void copy(VkBuffer buffer, const VkBufferImageCopy& region, bool bufferIsSource);
+	void copy(VkBuffer buffer, const VkBufferImageCopy& region, bool bufferIsSource, sw::ThreadPool& pool);
 	VkDeviceSize getStorageSize(VkImageAspectFlags flags) const;
 	VkDeviceSize getMipLevelSize(VkImageAspectFlagBits aspect, uint32_t mipLevel) const;
 	VkDeviceSize getLayerSize(VkImageAspectFlagBits aspect) const;
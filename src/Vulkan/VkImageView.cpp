@@ -121,6 +121,38 @@ void ImageView::clear(const VkClearValue& clearValue, const VkImageAspectFlags a
 	image->clear(clearValue, renderArea.rect, sr);
 }
 
+void ImageView::resolve(ImageView* resolveAttachment, const VkRect2D& renderArea, sw::ThreadPool& pool)
+{
+	if((subresourceRange.levelCount != 1) || (resolveAttachment->subresourceRange.levelCount != 1))
+	{
+		UNIMPLEMENTED("levelCount");
+	}
+
+	uint32_t layerCount = image->getLastLayerIndex(subresourceRange) - subresourceRange.baseArrayLayer + 1;
+
+	VkImageResolve region;
+	region.srcSubresource =
+	{
+		subresourceRange.aspectMask,
+		subresourceRange.baseMipLevel,
+		subresourceRange.baseArrayLayer,
+		layerCount
+	};
+	// Only the render area gets resolved, the rest of the resolve attachment is preserved
+	region.srcOffset = { renderArea.offset.x, renderArea.offset.y, 0 };
+	region.dstSubresource =
+	{
+		resolveAttachment->subresourceRange.aspectMask,
+		resolveAttachment->subresourceRange.baseMipLevel,
+		resolveAttachment->subresourceRange.baseArrayLayer,
+		layerCount
+	};
+	region.dstOffset = region.srcOffset;
+	region.extent = { renderArea.extent.width, renderArea.extent.height, 1 };
+
+	image->resolve(*(resolveAttachment->image), region, pool);
+}
+
 void *ImageView::getOffsetPointer(const VkOffset3D& offset, VkImageAspectFlagBits aspect) const
 {
 	VkImageSubresourceLayers imageSubresourceLayers =
@@ -14,6 +14,7 @@
 
 #include "VkPhysicalDevice.hpp"
 #include "VkConfig.h"
+#include "VkFormat.h"
 
 #include "Pipeline/SpirvShader.hpp" // sw::SIMD::Width
 
@@ -53,8 +54,8 @@ const VkPhysicalDeviceFeatures& PhysicalDevice::getFeatures() const
 		true,  // textureCompressionETC2
 		false, // textureCompressionASTC_LDR
 		false, // textureCompressionBC
-		false, // occlusionQueryPrecise
-		false, // pipelineStatisticsQuery
+		true,  // occlusionQueryPrecise
+		true,  // pipelineStatisticsQuery
 		false, // vertexPipelineStoresAndAtomics
 		false, // fragmentStoresAndAtomics
 		false, // shaderTessellationAndGeometryPointSize
@@ -230,8 +231,8 @@ const VkPhysicalDeviceLimits& PhysicalDevice::getLimits() const
 		sampleCounts, // sampledImageStencilSampleCounts
 		VK_SAMPLE_COUNT_1_BIT, // storageImageSampleCounts (unsupported)
 		1, // maxSampleMaskWords
-		false, // timestampComputeAndGraphics
-		60, // timestampPeriod
+		true,  // timestampComputeAndGraphics
+		1, // timestampPeriod
 		8, // maxClipDistances
 		8, // maxCullDistances
 		8, // maxCombinedClipAndCullDistances
@@ -639,11 +640,24 @@ void PhysicalDevice::getImageFormatProperties(VkFormat format, VkImageType type,
 
 			VkFormatProperties props;
 			getFormatProperties(format, &props);
-			auto features = tiling == VK_IMAGE_TILING_LINEAR ? props.linearTilingFeatures : props.optimalTilingFeatures;
-			if (features & (VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT | VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT))
+			auto features = props.optimalTilingFeatures;
+			if((tiling == VK_IMAGE_TILING_OPTIMAL) &&
+			   (features & (VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT | VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT)))
 			{
 				// Only renderable formats make sense for multisample
 				pImageFormatProperties->sampleCounts = getSampleCounts();
+
+				const VkPhysicalDeviceLimits& limits = getLimits();
+				if((usage & VK_IMAGE_USAGE_SAMPLED_BIT) && (features & VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT) &&
+				   vk::Format(format).isNonNormalizedInteger())
+				{
+					pImageFormatProperties->sampleCounts &= limits.sampledImageIntegerSampleCounts;
+				}
+
+				if(usage & VK_IMAGE_USAGE_STORAGE_BIT)
+				{
+					pImageFormatProperties->sampleCounts &= limits.storageImageSampleCounts;
+				}
 			}
 		}
 		break;
@@ -677,7 +691,7 @@ void PhysicalDevice::getQueueFamilyProperties(uint32_t pQueueFamilyPropertyCount
 		pQueueFamilyProperties[i].minImageTransferGranularity.depth = 1;
 		pQueueFamilyProperties[i].queueCount = 1;
 		pQueueFamilyProperties[i].queueFlags = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT;
-		pQueueFamilyProperties[i].timestampValidBits = 0; // No support for time stamps
+		pQueueFamilyProperties[i].timestampValidBits = 64;
 	}
 }
 
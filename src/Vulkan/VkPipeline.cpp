@@ -13,7 +13,9 @@
 // limitations under the License.
 
 #include "VkPipeline.hpp"
+#include "VkPipelineCache.hpp"
 #include "VkPipelineLayout.hpp"
+#include "VkShaderCache.hpp"
 #include "VkShaderModule.hpp"
 #include "Pipeline/ComputeProgram.hpp"
 #include "Pipeline/SpirvShader.hpp"
@@ -244,6 +246,30 @@ std::vector<uint32_t> preprocessSpirv(
 	return optimized;
 }
 
+// getPreprocessedSpirv returns the preprocessed code for the given stage, from
+// the pipeline cache when possible.
+std::vector<uint32_t> getPreprocessedSpirv(
+		vk::PipelineCache *pipelineCache,
+		VkPipelineShaderStageCreateInfo const &stage,
+		const vk::PipelineCache::Key &spirvKey)
+{
+	std::vector<uint32_t> code;
+
+	if(pipelineCache && pipelineCache->findSpirv(spirvKey, &code))
+	{
+		return code;
+	}
+
+	code = preprocessSpirv(vk::Cast(stage.module)->getCode(), stage.pSpecializationInfo);
+
+	if(pipelineCache && (code.size() > 0))
+	{
+		pipelineCache->insertSpirv(spirvKey, code);
+	}
+
+	return code;
+}
+
 } // anonymous namespace
 
 namespace vk
@@ -257,7 +283,6 @@ GraphicsPipeline::GraphicsPipeline(const VkGraphicsPipelineCreateInfo* pCreateIn
 	if((pCreateInfo->flags != 0) ||
 	   (pCreateInfo->stageCount != 2) ||
 	   (pCreateInfo->pTessellationState != nullptr) ||
-	   (pCreateInfo->pDynamicState != nullptr) ||
 	   (pCreateInfo->subpass != 0) ||
 	   (pCreateInfo->basePipelineHandle != VK_NULL_HANDLE) ||
 	   (pCreateInfo->basePipelineIndex != 0))
@@ -265,6 +290,35 @@ GraphicsPipeline::GraphicsPipeline(const VkGraphicsPipelineCreateInfo* pCreateIn
 		UNIMPLEMENTED("pCreateInfo settings");
 	}
 
+	const VkPipelineDynamicStateCreateInfo* dynamicState = pCreateInfo->pDynamicState;
+	if(dynamicState)
+	{
+		if(dynamicState->flags != 0)
+		{
+			UNIMPLEMENTED("dynamicState->flags");
+		}
+
+		for(uint32_t i = 0; i < dynamicState->dynamicStateCount; i++)
+		{
+			VkDynamicState state = dynamicState->pDynamicStates[i];
+			switch(state)
+			{
+			case VK_DYNAMIC_STATE_VIEWPORT:
+			case VK_DYNAMIC_STATE_SCISSOR:
+			case VK_DYNAMIC_STATE_LINE_WIDTH:
+			case VK_DYNAMIC_STATE_DEPTH_BIAS:
+			case VK_DYNAMIC_STATE_BLEND_CONSTANTS:
+			case VK_DYNAMIC_STATE_STENCIL_COMPARE_MASK:
+			case VK_DYNAMIC_STATE_STENCIL_WRITE_MASK:
+			case VK_DYNAMIC_STATE_STENCIL_REFERENCE:
+				dynamicStates |= (1 << state);
+				break;
+			default:
+				UNIMPLEMENTED("dynamicState->pDynamicStates[%d]", i);
+			}
+		}
+	}
+
 	const VkPipelineVertexInputStateCreateInfo* vertexInputState = pCreateInfo->pVertexInputState;
 	if(vertexInputState->flags != 0)
 	{
@@ -318,8 +372,16 @@ GraphicsPipeline::GraphicsPipeline(const VkGraphicsPipelineCreateInfo* pCreateIn
 			UNIMPLEMENTED("pCreateInfo->pViewportState settings");
 		}
 
-		scissor = viewportState->pScissors[0];
-		viewport = viewportState->pViewports[0];
+		// Dynamic viewports and scissors are ignored here, and may be null.
+		if(!hasDynamicState(VK_DYNAMIC_STATE_SCISSOR))
+		{
+			scissor = viewportState->pScissors[0];
+		}
+
+		if(!hasDynamicState(VK_DYNAMIC_STATE_VIEWPORT))
+		{
+			viewport = viewportState->pViewports[0];
+		}
 	}
 
 	const VkPipelineRasterizationStateCreateInfo* rasterizationState = pCreateInfo->pRasterizationState;
@@ -335,6 +397,16 @@ GraphicsPipeline::GraphicsPipeline(const VkGraphicsPipelineCreateInfo* pCreateIn
 	context.frontFacingCCW = rasterizationState->frontFace == VK_FRONT_FACE_COUNTER_CLOCKWISE;
 	context.depthBias = (rasterizationState->depthBiasEnable ? rasterizationState->depthBiasConstantFactor : 0.0f);
 	context.slopeDepthBias = (rasterizationState->depthBiasEnable ? rasterizationState->depthBiasSlopeFactor : 0.0f);
+	if(!hasDynamicState(VK_DYNAMIC_STATE_LINE_WIDTH))
+	{
+		context.lineWidth = rasterizationState->lineWidth;
+	}
+
+	// Dynamic depth bias factors only apply when depth bias is enabled.
+	if(!rasterizationState->depthBiasEnable)
+	{
+		dynamicStates &= ~(1 << VK_DYNAMIC_STATE_DEPTH_BIAS);
+	}
 
 	const VkPipelineMultisampleStateCreateInfo* multisampleState = pCreateInfo->pMultisampleState;
 	if(multisampleState)
@@ -426,8 +498,8 @@ GraphicsPipeline::GraphicsPipeline(const VkGraphicsPipelineCreateInfo* pCreateIn
 
 void GraphicsPipeline::destroyPipeline(const VkAllocationCallbacks* pAllocator)
 {
-	delete vertexShader;
-	delete fragmentShader;
+	vertexShader.reset();
+	fragmentShader.reset();
 }
 
 size_t GraphicsPipeline::ComputeRequiredAllocationSize(const VkGraphicsPipelineCreateInfo* pCreateInfo)
@@ -435,7 +507,7 @@ size_t GraphicsPipeline::ComputeRequiredAllocationSize(const VkGraphicsPipelineC
 	return 0;
 }
 
-void GraphicsPipeline::compileShaders(const VkAllocationCallbacks* pAllocator, const VkGraphicsPipelineCreateInfo* pCreateInfo)
+void GraphicsPipeline::compileShaders(const VkAllocationCallbacks* pAllocator, const VkGraphicsPipelineCreateInfo* pCreateInfo, PipelineCache* pipelineCache, ShaderCache* shaderCache)
 {
 	for (auto pStage = pCreateInfo->pStages; pStage != pCreateInfo->pStages + pCreateInfo->stageCount; pStage++)
 	{
@@ -444,20 +516,30 @@ void GraphicsPipeline::compileShaders(const VkAllocationCallbacks* pAllocator, c
 			UNIMPLEMENTED("pStage->flags");
 		}
 
-		auto module = Cast(pStage->module);
-		auto code = preprocessSpirv(module->getCode(), pStage->pSpecializationInfo);
+		// The layout is part of the key because the renderer's routine caches are
+		// keyed on the shader's serial ID, and the routines depend on the layout.
+		PipelineCache::Key spirvKey = PipelineCache::ComputeSpirvKey(*pStage);
+		PipelineCache::Key shaderKey = PipelineCache::ComputeRoutineKey(spirvKey, layout);
 
-		// TODO: also pass in any pipeline state which will affect shader compilation
-		auto spirvShader = new sw::SpirvShader{code};
+		auto spirvShader = shaderCache->findShader(shaderKey);
+		if(!spirvShader)
+		{
+			auto code = getPreprocessedSpirv(pipelineCache, *pStage, spirvKey);
+
+			// TODO: also pass in any pipeline state which will affect shader compilation
+			spirvShader = shaderCache->insertShader(shaderKey, std::make_shared<sw::SpirvShader>(code));
+		}
 
 		switch (pStage->stage)
 		{
 		case VK_SHADER_STAGE_VERTEX_BIT:
-			context.vertexShader = vertexShader = spirvShader;
+			vertexShader = spirvShader;
+			context.vertexShader = vertexShader.get();
 			break;
 
 		case VK_SHADER_STAGE_FRAGMENT_BIT:
-			context.pixelShader = fragmentShader = spirvShader;
+			fragmentShader = spirvShader;
+			context.pixelShader = fragmentShader.get();
 			break;
 
 		default:
@@ -475,13 +557,13 @@ uint32_t GraphicsPipeline::computePrimitiveCount(uint32_t vertexCount) const
 	case sw::DRAW_LINELIST:
 		return vertexCount / 2;
 	case sw::DRAW_LINESTRIP:
-		return vertexCount - 1;
+		return (vertexCount > 1) ? vertexCount - 1 : 0;
 	case sw::DRAW_TRIANGLELIST:
 		return vertexCount / 3;
 	case sw::DRAW_TRIANGLESTRIP:
-		return vertexCount - 2;
+		return (vertexCount > 2) ? vertexCount - 2 : 0;
 	case sw::DRAW_TRIANGLEFAN:
-		return vertexCount - 2;
+		return (vertexCount > 2) ? vertexCount - 2 : 0;
 	default:
 		UNIMPLEMENTED("drawType");
 	}
@@ -489,6 +571,11 @@ uint32_t GraphicsPipeline::computePrimitiveCount(uint32_t vertexCount) const
 	return 0;
 }
 
+bool GraphicsPipeline::hasDynamicState(VkDynamicState dynamicState) const
+{
+	return (dynamicStates & (1 << dynamicState)) != 0;
+}
+
 const sw::Context& GraphicsPipeline::getContext() const
 {
 	return context;
@@ -516,7 +603,8 @@ ComputePipeline::ComputePipeline(const VkComputePipelineCreateInfo* pCreateInfo,
 
 void ComputePipeline::destroyPipeline(const VkAllocationCallbacks* pAllocator)
 {
-	delete shader;
+	shader.reset();
+	routine.reset();
 }
 
 size_t ComputePipeline::ComputeRequiredAllocationSize(const VkComputePipelineCreateInfo* pCreateInfo)
@@ -524,34 +612,65 @@ size_t ComputePipeline::ComputeRequiredAllocationSize(const VkComputePipelineCre
 	return 0;
 }
 
-void ComputePipeline::compileShaders(const VkAllocationCallbacks* pAllocator, const VkComputePipelineCreateInfo* pCreateInfo)
+void ComputePipeline::compileShaders(const VkAllocationCallbacks* pAllocator, const VkComputePipelineCreateInfo* pCreateInfo, PipelineCache* pipelineCache, ShaderCache* shaderCache)
 {
-	auto module = Cast(pCreateInfo->stage.module);
+	ASSERT((shader == nullptr) && (routine == nullptr));
+
+	PipelineCache::Key spirvKey = PipelineCache::ComputeSpirvKey(pCreateInfo->stage);
+	PipelineCache::Key routineKey = PipelineCache::ComputeRoutineKey(spirvKey, layout);
+
+	shader = shaderCache->findShader(routineKey);
+	if(!shader)
+	{
+		auto code = getPreprocessedSpirv(pipelineCache, pCreateInfo->stage, spirvKey);
 
-	auto code = preprocessSpirv(module->getCode(), pCreateInfo->stage.pSpecializationInfo);
+		ASSERT_OR_RETURN(code.size() > 0);
 
-	ASSERT_OR_RETURN(code.size() > 0);
+		// FIXME (b/119409619): use allocator.
+		shader = shaderCache->insertShader(routineKey, std::make_shared<sw::SpirvShader>(code));
+	}
 
-	ASSERT(shader == nullptr);
+	routine = shaderCache->findRoutine(routineKey);
+	if(routine)
+	{
+		return;
+	}
 
-	// FIXME (b/119409619): use allocator.
-	shader = new sw::SpirvShader(code);
+	rr::Routine* compiled = pipelineCache ? pipelineCache->findRoutine(routineKey) : nullptr;
+	if(!compiled)
+	{
+		sw::ComputeProgram program(shader.get(), layout);
 
-	sw::ComputeProgram program(shader, layout);
+		program.generate();
 
-	program.generate();
+		compiled = program("ComputeRoutine");
+		compiled->bind();
 
-	// TODO(bclayton): Cache program
-	routine = program("ComputeRoutine");
+		if(pipelineCache)
+		{
+			pipelineCache->insertRoutine(routineKey, compiled);
+		}
+	}
+
+	routine = shaderCache->insertRoutine(routineKey, ShaderCache::AdoptRoutine(compiled));
 }
 
 void ComputePipeline::run(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ,
-	size_t numDescriptorSets, VkDescriptorSet *descriptorSets, sw::PushConstantStorage const &pushConstants)
+	size_t numDescriptorSets, VkDescriptorSet *descriptorSets, sw::PushConstantStorage const &pushConstants,
+	sw::ThreadPool &pool)
 {
 	ASSERT_OR_RETURN(routine != nullptr);
 	sw::ComputeProgram::run(
-		routine, reinterpret_cast<void**>(descriptorSets), pushConstants,
-		groupCountX, groupCountY, groupCountZ);
+		routine.get(), reinterpret_cast<void**>(descriptorSets), pushConstants,
+		groupCountX, groupCountY, groupCountZ, pool);
+}
+
+uint64_t ComputePipeline::computeInvocationCount(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ) const
+{
+	auto &modes = shader->getModes();
+	uint64_t workgroupSize = static_cast<uint64_t>(modes.WorkgroupSizeX) * modes.WorkgroupSizeY * modes.WorkgroupSizeZ;
+
+	return workgroupSize * groupCountX * groupCountY * groupCountZ;
 }
 
 } // namespace vk
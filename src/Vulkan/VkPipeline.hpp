@@ -18,12 +18,16 @@
 #include "VkObject.hpp"
 #include "Device/Renderer.hpp"
 
+#include <memory>
+
 namespace sw { class SpirvShader; }
 
 namespace vk
 {
 
+class PipelineCache;
 class PipelineLayout;
+class ShaderCache;
 
 class Pipeline
 {
@@ -67,19 +71,22 @@ public:
 
 	static size_t ComputeRequiredAllocationSize(const VkGraphicsPipelineCreateInfo* pCreateInfo);
 
-	void compileShaders(const VkAllocationCallbacks* pAllocator, const VkGraphicsPipelineCreateInfo* pCreateInfo);
+	void compileShaders(const VkAllocationCallbacks* pAllocator, const VkGraphicsPipelineCreateInfo* pCreateInfo, PipelineCache* pipelineCache, ShaderCache* shaderCache);
 
 	uint32_t computePrimitiveCount(uint32_t vertexCount) const;
+	bool hasDynamicState(VkDynamicState dynamicState) const;
+	uint32_t getDynamicStates() const { return dynamicStates; }
 	const sw::Context& getContext() const;
 	const VkRect2D& getScissor() const;
 	const VkViewport& getViewport() const;
 	const sw::Color<float>& getBlendConstants() const;
 
 private:
-	sw::SpirvShader *vertexShader = nullptr;
-	sw::SpirvShader *fragmentShader = nullptr;
+	std::shared_ptr<sw::SpirvShader> vertexShader;
+	std::shared_ptr<sw::SpirvShader> fragmentShader;
 
 	sw::Context context;
+	uint32_t dynamicStates = 0;   // Bit (1 << VkDynamicState) set for each dynamic state
 	VkRect2D scissor;
 	VkViewport viewport;
 	sw::Color<float> blendConstants;
@@ -101,14 +108,17 @@ public:
 
 	static size_t ComputeRequiredAllocationSize(const VkComputePipelineCreateInfo* pCreateInfo);
 
-	void compileShaders(const VkAllocationCallbacks* pAllocator, const VkComputePipelineCreateInfo* pCreateInfo);
+	void compileShaders(const VkAllocationCallbacks* pAllocator, const VkComputePipelineCreateInfo* pCreateInfo, PipelineCache* pipelineCache, ShaderCache* shaderCache);
 
 	void run(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ,
-		size_t numDescriptorSets, VkDescriptorSet *descriptorSets, sw::PushConstantStorage const &pushConstants);
+		size_t numDescriptorSets, VkDescriptorSet *descriptorSets, sw::PushConstantStorage const &pushConstants,
+		sw::ThreadPool &pool);
+
+	uint64_t computeInvocationCount(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ) const;
 
 protected:
-	sw::SpirvShader *shader = nullptr;
-	rr::Routine *routine = nullptr;
+	std::shared_ptr<sw::SpirvShader> shader;
+	std::shared_ptr<rr::Routine> routine;
 };
 
 static inline Pipeline* Cast(VkPipeline object)
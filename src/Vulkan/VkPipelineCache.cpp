@@ -0,0 +1,282 @@
+// Copyright 2019 The SwiftShader Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "VkPipelineCache.hpp"
+#include "VkPipelineLayout.hpp"
+#include "VkShaderModule.hpp"
+#include "Reactor/Routine.hpp"
+#include "System/Math.hpp"
+
+#include <cstring>
+
+namespace
+{
+
+template<typename T>
+void append(std::vector<uint8_t>& bytes, const T* data, size_t count)
+{
+	const uint8_t* begin = reinterpret_cast<const uint8_t*>(data);
+	bytes.insert(bytes.end(), begin, begin + count * sizeof(T));
+}
+
+template<typename T>
+void append(std::vector<uint8_t>& bytes, const T& value)
+{
+	append(bytes, &value, 1);
+}
+
+} // anonymous namespace
+
+namespace vk
+{
+
+PipelineCache::PipelineCache(const VkPipelineCacheCreateInfo* pCreateInfo, void* mem)
+{
+	spirv = new std::unordered_map<Key, std::vector<uint32_t>, Key::Hash>();
+	routines = new std::unordered_map<Key, rr::Routine*, Key::Hash>();
+
+	if(pCreateInfo->initialDataSize > 0)
+	{
+		loadData(static_cast<const uint8_t*>(pCreateInfo->pInitialData), pCreateInfo->initialDataSize);
+	}
+}
+
+void PipelineCache::destroy(const VkAllocationCallbacks* pAllocator)
+{
+	for(auto& entry : *routines)
+	{
+		entry.second->unbind();
+	}
+
+	delete routines;
+	delete spirv;
+}
+
+size_t PipelineCache::ComputeRequiredAllocationSize(const VkPipelineCacheCreateInfo* pCreateInfo)
+{
+	return 0;
+}
+
+PipelineCache::Key::Key(std::vector<uint8_t>&& data) :
+	data(std::move(data)),
+	hash(sw::FNV_1a(this->data.data(), static_cast<int>(this->data.size())))
+{
+}
+
+PipelineCache::Key PipelineCache::ComputeSpirvKey(const VkPipelineShaderStageCreateInfo& stage)
+{
+	std::vector<uint8_t> bytes;
+
+	auto code = Cast(stage.module)->getCode();
+	append(bytes, code.data(), code.size());
+	append(bytes, stage.stage);
+	append(bytes, stage.pName, strlen(stage.pName));
+
+	const VkSpecializationInfo* specializationInfo = stage.pSpecializationInfo;
+	if(specializationInfo)
+	{
+		append(bytes, specializationInfo->pMapEntries, specializationInfo->mapEntryCount);
+		append(bytes, static_cast<const uint8_t*>(specializationInfo->pData), specializationInfo->dataSize);
+	}
+
+	return Key(std::move(bytes));
+}
+
+PipelineCache::Key PipelineCache::ComputeRoutineKey(const Key& spirvKey, const PipelineLayout* layout)
+{
+	std::vector<uint64_t> layoutKey;
+	layout->appendKey(layoutKey);
+
+	std::vector<uint8_t> bytes(spirvKey.data);
+	append(bytes, layoutKey.data(), layoutKey.size());
+
+	return Key(std::move(bytes));
+}
+
+void PipelineCache::loadData(const uint8_t* data, size_t dataSize)
+{
+	// Data from another implementation, device or driver version is silently ignored,
+	// as required by the spec.
+	CacheHeader header;
+	if(dataSize < sizeof(CacheHeader))
+	{
+		return;
+	}
+
+	memcpy(&header, data, sizeof(CacheHeader));
+	if((header.headerSize != sizeof(CacheHeader)) ||
+	   (header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE) ||
+	   (header.vendorID != VENDOR_ID) ||
+	   (header.deviceID != DEVICE_ID) ||
+	   (memcmp(header.pipelineCacheUUID, SWIFTSHADER_UUID, VK_UUID_SIZE) != 0))
+	{
+		return;
+	}
+
+	size_t offset = sizeof(CacheHeader);
+	while(offset + sizeof(SpirvEntryHeader) <= dataSize)
+	{
+		SpirvEntryHeader entry;
+		memcpy(&entry, data + offset, sizeof(SpirvEntryHeader));
+		offset += sizeof(SpirvEntryHeader);
+
+		size_t size = static_cast<size_t>(entry.wordCount) * sizeof(uint32_t);
+		if((entry.keySize > dataSize - offset) || (size > dataSize - offset - entry.keySize))
+		{
+			break;   // Truncated entry
+		}
+
+		std::vector<uint8_t> key(data + offset, data + offset + entry.keySize);
+		offset += entry.keySize;
+
+		std::vector<uint32_t> code(entry.wordCount);
+		memcpy(code.data(), data + offset, size);
+		offset += size;
+
+		(*spirv)[Key(std::move(key))] = std::move(code);
+	}
+}
+
+VkResult PipelineCache::getData(size_t* pDataSize, void* pData)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	size_t totalSize = sizeof(CacheHeader);
+	for(auto& entry : *spirv)
+	{
+		totalSize += sizeof(SpirvEntryHeader) + entry.first.data.size() + entry.second.size() * sizeof(uint32_t);
+	}
+
+	if(!pData)
+	{
+		*pDataSize = totalSize;
+		return VK_SUCCESS;
+	}
+
+	if(*pDataSize < sizeof(CacheHeader))
+	{
+		*pDataSize = 0;
+		return VK_INCOMPLETE;
+	}
+
+	CacheHeader header;
+	header.headerSize = sizeof(CacheHeader);
+	header.headerVersion = VK_PIPELINE_CACHE_HEADER_VERSION_ONE;
+	header.vendorID = VENDOR_ID;
+	header.deviceID = DEVICE_ID;
+	memcpy(header.pipelineCacheUUID, SWIFTSHADER_UUID, VK_UUID_SIZE);
+
+	uint8_t* data = static_cast<uint8_t*>(pData);
+	memcpy(data, &header, sizeof(CacheHeader));
+	size_t offset = sizeof(CacheHeader);
+
+	// Only whole entries are written, so that truncated data remains valid initial data.
+	for(auto& entry : *spirv)
+	{
+		size_t keySize = entry.first.data.size();
+		size_t size = entry.second.size() * sizeof(uint32_t);
+		if(offset + sizeof(SpirvEntryHeader) + keySize + size > *pDataSize)
+		{
+			*pDataSize = offset;
+			return VK_INCOMPLETE;
+		}
+
+		SpirvEntryHeader entryHeader;
+		entryHeader.keySize = static_cast<uint32_t>(keySize);
+		entryHeader.wordCount = static_cast<uint32_t>(entry.second.size());
+		memcpy(data + offset, &entryHeader, sizeof(SpirvEntryHeader));
+		offset += sizeof(SpirvEntryHeader);
+
+		memcpy(data + offset, entry.first.data.data(), keySize);
+		offset += keySize;
+
+		memcpy(data + offset, entry.second.data(), size);
+		offset += size;
+	}
+
+	*pDataSize = offset;
+	return VK_SUCCESS;
+}
+
+VkResult PipelineCache::merge(uint32_t srcCacheCount, const VkPipelineCache* pSrcCaches)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	for(uint32_t i = 0; i < srcCacheCount; i++)
+	{
+		PipelineCache* srcCache = Cast(pSrcCaches[i]);
+		std::unique_lock<std::mutex> srcLock(srcCache->mutex);
+
+		spirv->insert(srcCache->spirv->begin(), srcCache->spirv->end());
+
+		for(auto& entry : *srcCache->routines)
+		{
+			if(routines->find(entry.first) == routines->end())
+			{
+				entry.second->bind();
+				(*routines)[entry.first] = entry.second;
+			}
+		}
+	}
+
+	return VK_SUCCESS;
+}
+
+bool PipelineCache::findSpirv(const Key& key, std::vector<uint32_t>* code)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	auto it = spirv->find(key);
+	if(it == spirv->end())
+	{
+		return false;
+	}
+
+	*code = it->second;
+	return true;
+}
+
+void PipelineCache::insertSpirv(const Key& key, const std::vector<uint32_t>& code)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	(*spirv)[key] = code;
+}
+
+rr::Routine* PipelineCache::findRoutine(const Key& key)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	auto it = routines->find(key);
+	if(it == routines->end())
+	{
+		return nullptr;
+	}
+
+	it->second->bind();
+	return it->second;
+}
+
+void PipelineCache::insertRoutine(const Key& key, rr::Routine* routine)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	if(routines->find(key) == routines->end())
+	{
+		routine->bind();
+		(*routines)[key] = routine;
+	}
+}
+
+} // namespace vk
@@ -17,24 +17,92 @@
 
 #include "VkObject.hpp"
 
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace rr
+{
+	class Routine;
+}
+
 namespace vk
 {
 
+class PipelineLayout;
+
+// PipelineCache holds two kinds of entries:
+// - Preprocessed SPIR-V, keyed on the shader module's code, entry point and
+//   specialization constants. These are serialized by vkGetPipelineCacheData()
+//   so that a later run can skip the spirv-tools passes.
+// - Compiled compute routines, keyed on the preprocessed SPIR-V and the
+//   pipeline layout. Reactor routines contain absolute addresses, so these
+//   only live for the lifetime of the cache and are never serialized.
 class PipelineCache : public Object<PipelineCache, VkPipelineCache>
 {
 public:
-	PipelineCache(const VkPipelineCacheCreateInfo* pCreateInfo, void* mem)
+	// Keys hold everything the entries depend on, and are compared in full on
+	// lookup, since different keys may have the same hash.
+	struct Key
 	{
-	}
+		Key() = default;
+		Key(std::vector<uint8_t>&& data);
 
+		bool operator==(const Key& other) const
+		{
+			return (hash == other.hash) && (data == other.data);
+		}
+
+		struct Hash
+		{
+			size_t operator()(const Key& key) const { return static_cast<size_t>(key.hash); }
+		};
+
+		std::vector<uint8_t> data;
+		uint64_t hash = 0;
+	};
+
+	PipelineCache(const VkPipelineCacheCreateInfo* pCreateInfo, void* mem);
 	~PipelineCache() = delete;
+	void destroy(const VkAllocationCallbacks* pAllocator);
 
-	static size_t ComputeRequiredAllocationSize(const VkPipelineCacheCreateInfo* pCreateInfo)
-	{
-		return 0;
-	}
+	static size_t ComputeRequiredAllocationSize(const VkPipelineCacheCreateInfo* pCreateInfo);
+
+	static Key ComputeSpirvKey(const VkPipelineShaderStageCreateInfo& stage);
+	static Key ComputeRoutineKey(const Key& spirvKey, const PipelineLayout* layout);
+
+	VkResult getData(size_t* pDataSize, void* pData);
+	VkResult merge(uint32_t srcCacheCount, const VkPipelineCache* pSrcCaches);
+
+	bool findSpirv(const Key& key, std::vector<uint32_t>* code);
+	void insertSpirv(const Key& key, const std::vector<uint32_t>& code);
+
+	// Returns a routine with a reference held for the caller, or nullptr.
+	rr::Routine* findRoutine(const Key& key);
+	void insertRoutine(const Key& key, rr::Routine* routine);
 
 private:
+	struct CacheHeader
+	{
+		uint32_t headerSize;
+		uint32_t headerVersion;
+		uint32_t vendorID;
+		uint32_t deviceID;
+		uint8_t  pipelineCacheUUID[VK_UUID_SIZE];
+	};
+
+	struct SpirvEntryHeader   // Followed by the key's bytes, then the code
+	{
+		uint32_t keySize;
+		uint32_t wordCount;
+	};
+
+	void loadData(const uint8_t* data, size_t dataSize);
+
+	std::mutex mutex;
+	// FIXME (b/119409619): use an allocator here so we can control all memory allocations
+	std::unordered_map<Key, std::vector<uint32_t>, Key::Hash>* spirv = nullptr;
+	std::unordered_map<Key, rr::Routine*, Key::Hash>* routines = nullptr;
 };
 
 static inline PipelineCache* Cast(VkPipelineCache object)
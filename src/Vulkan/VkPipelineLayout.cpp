@@ -55,4 +55,14 @@ size_t PipelineLayout::getBindingOffset(size_t descriptorSet, size_t binding) co
 	return setLayouts[descriptorSet]->getBindingOffset(binding);
 }
 
+void PipelineLayout::appendKey(std::vector<uint64_t>& key) const
+{
+	// Only the descriptor set layouts affect the generated code
+	key.push_back(setLayoutCount);
+	for(uint32_t i = 0; i < setLayoutCount; i++)
+	{
+		setLayouts[i]->appendKey(key);
+	}
+}
+
 } // namespace vk
@@ -31,6 +31,7 @@ public:
 
 	size_t getNumDescriptorSets() const;
 	size_t getBindingOffset(size_t descriptorSet, size_t binding) const;
+	void appendKey(std::vector<uint64_t>& key) const;
 
 private:
 	uint32_t              setLayoutCount = 0;
@@ -14,41 +14,252 @@
 
 #include "VkQueryPool.hpp"
 
+#include <chrono>
+#include <new>
+
+namespace
+{
+	void WriteResult(uint8_t* data, uint32_t index, int64_t value, VkQueryResultFlags flags)
+	{
+		if(flags & VK_QUERY_RESULT_64_BIT)
+		{
+			reinterpret_cast<uint64_t*>(data)[index] = static_cast<uint64_t>(value);
+		}
+		else
+		{
+			reinterpret_cast<uint32_t*>(data)[index] = static_cast<uint32_t>(value);
+		}
+	}
+}
+
 namespace vk
 {
+	Query::Query(VkQueryType type) : type(type), value(0)
+	{
+		for(auto& statistic : statistics)
+		{
+			statistic = 0;
+		}
+	}
+
+	Query::State Query::getState()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		return state;
+	}
+
+	void Query::wait()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		finished.wait(lock, [this] { return state == FINISHED; });
+	}
+
+	void Query::reset()
+	{
+		// An ended query can be reset before the work accumulating into it has retired
+		references.wait();
+
+		std::unique_lock<std::mutex> lock(mutex);
+		value = 0;
+		for(auto& statistic : statistics)
+		{
+			statistic = 0;
+		}
+		state = UNAVAILABLE;
+	}
+
+	void Query::begin()
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			ASSERT(state == UNAVAILABLE);
+			state = ACTIVE;
+		}
+
+		// Released by end()
+		references.add();
+	}
+
+	void Query::end()
+	{
+		releaseReference();
+	}
+
+	void Query::addReference()
+	{
+		references.add();
+	}
+
+	void Query::releaseReference()
+	{
+		if(references.done())
+		{
+			finish();
+		}
+	}
+
+	void Query::set(int64_t v)
+	{
+		value = v;
+		finish();
+	}
+
+	void Query::add(int64_t v)
+	{
+		value += v;
+	}
+
+	void Query::addStatistic(Statistic statistic, int64_t count)
+	{
+		statistics[statistic] += count;
+	}
+
+	int64_t Query::getValue() const
+	{
+		return value;
+	}
+
+	int64_t Query::getStatistic(Statistic statistic) const
+	{
+		return statistics[statistic];
+	}
+
+	void Query::finish()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		state = FINISHED;
+		finished.notify_all();
+	}
+
 	QueryPool::QueryPool(const VkQueryPoolCreateInfo* pCreateInfo, void* mem) :
-		queryCount(pCreateInfo->queryCount)
+		queries(reinterpret_cast<Query*>(mem)), type(pCreateInfo->queryType),
+		queryCount(pCreateInfo->queryCount), pipelineStatistics(pCreateInfo->pipelineStatistics)
+	{
+		switch(type)
+		{
+		case VK_QUERY_TYPE_OCCLUSION:
+		case VK_QUERY_TYPE_PIPELINE_STATISTICS:
+		case VK_QUERY_TYPE_TIMESTAMP:
+			break;
+		default:
+			UNIMPLEMENTED("pCreateInfo->queryType %d", int(type));
+			break;
+		}
+
+		// Queries hold synchronization primitives, so they're constructed individually
+		for(uint32_t i = 0; i < queryCount; i++)
+		{
+			new (&queries[i]) Query(type);
+		}
+	}
+
+	void QueryPool::destroy(const VkAllocationCallbacks* pAllocator)
 	{
-		// According to the Vulkan spec, section 34.1. Features:
-		// "pipelineStatisticsQuery specifies whether the pipeline statistics
-		//  queries are supported. If this feature is not enabled, queries of
-		//  type VK_QUERY_TYPE_PIPELINE_STATISTICS cannot be created, and
-		//  none of the VkQueryPipelineStatisticFlagBits bits can be set in the
-		//  pipelineStatistics member of the VkQueryPoolCreateInfo structure."
-		if(pCreateInfo->queryType == VK_QUERY_TYPE_PIPELINE_STATISTICS)
+		for(uint32_t i = 0; i < queryCount; i++)
 		{
-			UNIMPLEMENTED("pCreateInfo->queryType");
+			queries[i].~Query();
 		}
+
+		vk::deallocate(queries, pAllocator);
 	}
 
 	size_t QueryPool::ComputeRequiredAllocationSize(const VkQueryPoolCreateInfo* pCreateInfo)
 	{
-		return 0;
+		return sizeof(Query) * pCreateInfo->queryCount;
 	}
 
-	void QueryPool::getResults(uint32_t pFirstQuery, uint32_t pQueryCount, size_t pDataSize,
-	                           void* pData, VkDeviceSize pStride, VkQueryResultFlags pFlags) const
+	Query* QueryPool::getQuery(uint32_t query) const
 	{
-		// dataSize must be large enough to contain the result of each query
-		ASSERT(static_cast<size_t>(pStride * pQueryCount) <= pDataSize);
+		ASSERT(query < queryCount);
 
+		return &queries[query];
+	}
+
+	VkResult QueryPool::getResults(uint32_t pFirstQuery, uint32_t pQueryCount, size_t pDataSize,
+	                               void* pData, VkDeviceSize pStride, VkQueryResultFlags pFlags) const
+	{
 		// The sum of firstQuery and queryCount must be less than or equal to the number of queries
 		ASSERT((pFirstQuery + pQueryCount) <= queryCount);
 
-		char* data = static_cast<char*>(pData);
+		// Pipeline statistics queries return one value per enabled statistic, in bit order
+		uint32_t valueCount = 1;
+		if(type == VK_QUERY_TYPE_PIPELINE_STATISTICS)
+		{
+			valueCount = 0;
+			for(uint32_t i = 0; i < Query::STATISTIC_COUNT; i++)
+			{
+				valueCount += (pipelineStatistics >> i) & 1;
+			}
+		}
+
+		// dataSize must be large enough to contain the result of each query
+		size_t resultSize = ((pFlags & VK_QUERY_RESULT_64_BIT) ? sizeof(uint64_t) : sizeof(uint32_t)) *
+		                    (valueCount + ((pFlags & VK_QUERY_RESULT_WITH_AVAILABILITY_BIT) ? 1 : 0));
+		ASSERT((pQueryCount == 0) || (static_cast<size_t>(pStride * (pQueryCount - 1)) + resultSize <= pDataSize));
+
+		VkResult result = VK_SUCCESS;
+		uint8_t* data = static_cast<uint8_t*>(pData);
 		for(uint32_t i = 0; i < pQueryCount; i++, data += pStride)
 		{
-			UNIMPLEMENTED("queries");
+			Query& query = queries[pFirstQuery + i];
+
+			if(pFlags & VK_QUERY_RESULT_WAIT_BIT)
+			{
+				query.wait();
+			}
+
+			bool available = (query.getState() == Query::FINISHED);
+			if(!available)
+			{
+				result = VK_NOT_READY;
+			}
+
+			// Values of unavailable queries are only written when partial results are requested
+			if(available || (pFlags & VK_QUERY_RESULT_PARTIAL_BIT))
+			{
+				if(type == VK_QUERY_TYPE_PIPELINE_STATISTICS)
+				{
+					uint32_t index = 0;
+					for(uint32_t j = 0; j < Query::STATISTIC_COUNT; j++)
+					{
+						if(pipelineStatistics & (1 << j))
+						{
+							WriteResult(data, index++, query.getStatistic(static_cast<Query::Statistic>(j)), pFlags);
+						}
+					}
+				}
+				else
+				{
+					WriteResult(data, 0, query.getValue(), pFlags);
+				}
+			}
+
+			if(pFlags & VK_QUERY_RESULT_WITH_AVAILABILITY_BIT)
+			{
+				WriteResult(data, valueCount, available ? 1 : 0, pFlags);
+			}
 		}
+
+		return result;
+	}
+
+	void QueryPool::reset(uint32_t pFirstQuery, uint32_t pQueryCount)
+	{
+		ASSERT((pFirstQuery + pQueryCount) <= queryCount);
+
+		for(uint32_t i = 0; i < pQueryCount; i++)
+		{
+			queries[pFirstQuery + i].reset();
+		}
+	}
+
+	void QueryPool::writeTimestamp(uint32_t query)
+	{
+		ASSERT(query < queryCount);
+		ASSERT(type == VK_QUERY_TYPE_TIMESTAMP);
+
+		// Timestamps are in nanoseconds, see VkPhysicalDeviceLimits::timestampPeriod
+		queries[query].set(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count());
 	}
 } // namespace vk
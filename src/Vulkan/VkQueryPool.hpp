@@ -16,23 +16,105 @@
 #define VK_QUERY_POOL_HPP_
 
 #include "VkObject.hpp"
+#include "System/Synchronization.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
 
 namespace vk
 {
 
+class Query
+{
+public:
+	// Pipeline statistics counters, in the order of VkQueryPipelineStatisticFlagBits
+	enum Statistic
+	{
+		INPUT_ASSEMBLY_VERTICES,
+		INPUT_ASSEMBLY_PRIMITIVES,
+		VERTEX_SHADER_INVOCATIONS,
+		GEOMETRY_SHADER_INVOCATIONS,
+		GEOMETRY_SHADER_PRIMITIVES,
+		CLIPPING_INVOCATIONS,
+		CLIPPING_PRIMITIVES,
+		FRAGMENT_SHADER_INVOCATIONS,
+		TESSELLATION_CONTROL_SHADER_PATCHES,
+		TESSELLATION_EVALUATION_SHADER_INVOCATIONS,
+		COMPUTE_SHADER_INVOCATIONS,
+		STATISTIC_COUNT
+	};
+
+	enum State
+	{
+		UNAVAILABLE,
+		ACTIVE,
+		FINISHED
+	};
+
+	Query(VkQueryType type);
+
+	VkQueryType getType() const { return type; }
+	State getState();
+
+	// Blocks until the results are available
+	void wait();
+
+	// Makes the query unavailable and clears its results
+	void reset();
+
+	// Queries are active between begin() and end(). Work which accumulates into
+	// an active query holds a reference until it retires, and the results only
+	// become available once the query has ended and all references are released.
+	void begin();
+	void end();
+	void addReference();
+	void releaseReference();
+
+	// Writes a result which is available immediately
+	void set(int64_t value);
+
+	void add(int64_t value);
+	void addStatistic(Statistic statistic, int64_t count);
+
+	int64_t getValue() const;
+	int64_t getStatistic(Statistic statistic) const;
+
+private:
+	void finish();
+
+	const VkQueryType type;
+
+	std::mutex mutex;
+	std::condition_variable finished;
+	State state = UNAVAILABLE;
+	sw::WaitGroup references;
+
+	std::atomic<int64_t> value;
+	std::atomic<int64_t> statistics[STATISTIC_COUNT];
+};
+
 class QueryPool : public Object<QueryPool, VkQueryPool>
 {
 public:
 	QueryPool(const VkQueryPoolCreateInfo* pCreateInfo, void* mem);
 	~QueryPool() = delete;
+	void destroy(const VkAllocationCallbacks* pAllocator);
 
 	static size_t ComputeRequiredAllocationSize(const VkQueryPoolCreateInfo* pCreateInfo);
 
-	void getResults(uint32_t pFirstQuery, uint32_t pQueryCount, size_t pDataSize,
-		            void* pData, VkDeviceSize pStride, VkQueryResultFlags pFlags) const;
+	Query* getQuery(uint32_t query) const;
+
+	VkResult getResults(uint32_t pFirstQuery, uint32_t pQueryCount, size_t pDataSize,
+	                    void* pData, VkDeviceSize pStride, VkQueryResultFlags pFlags) const;
+	void reset(uint32_t pFirstQuery, uint32_t pQueryCount);
+	void writeTimestamp(uint32_t query);
 
 private:
-	uint32_t queryCount;
+	Query* const queries;
+	const VkQueryType type;
+	const uint32_t queryCount;
+	const VkQueryPipelineStatisticFlags pipelineStatistics;
 };
 
 static inline QueryPool* Cast(VkQueryPool object)
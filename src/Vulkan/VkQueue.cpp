@@ -17,8 +17,111 @@
 #include "VkQueue.hpp"
 #include "VkSemaphore.hpp"
 #include "Device/Renderer.hpp"
+#include "System/Thread.hpp"
 #include "WSI/VkSwapchainKHR.hpp"
 
+#include <cstring>
+
+namespace
+{
+
+VkSubmitInfo* DeepCopySubmitInfo(uint32_t submitCount, const VkSubmitInfo* pSubmits)
+{
+	// The application is free to reuse the VkSubmitInfo arrays as soon as vkQueueSubmit()
+	// returns, so the queue thread works from a single allocation holding a copy of them.
+	// All 8 byte handles are stored ahead of the 4 byte stage masks to keep them aligned.
+	size_t submitSize = sizeof(VkSubmitInfo) * submitCount;
+	size_t handlesSize = 0;
+	size_t stageMasksSize = 0;
+	for(uint32_t i = 0; i < submitCount; i++)
+	{
+		handlesSize += sizeof(VkSemaphore) * (pSubmits[i].waitSemaphoreCount + pSubmits[i].signalSemaphoreCount);
+		handlesSize += sizeof(VkCommandBuffer) * pSubmits[i].commandBufferCount;
+		stageMasksSize += sizeof(VkPipelineStageFlags) * pSubmits[i].waitSemaphoreCount;
+	}
+
+	uint8_t* mem = static_cast<uint8_t*>(
+		vk::allocate(submitSize + handlesSize + stageMasksSize, vk::REQUIRED_MEMORY_ALIGNMENT,
+		             vk::DEVICE_MEMORY, VK_SYSTEM_ALLOCATION_SCOPE_DEVICE));
+	if(!mem)
+	{
+		return nullptr;
+	}
+
+	auto submits = reinterpret_cast<VkSubmitInfo*>(mem);
+	memcpy(submits, pSubmits, submitSize);
+
+	uint8_t* handles = mem + submitSize;
+	uint8_t* stageMasks = handles + handlesSize;
+	for(uint32_t i = 0; i < submitCount; i++)
+	{
+		size_t size = sizeof(VkSemaphore) * pSubmits[i].waitSemaphoreCount;
+		submits[i].pWaitSemaphores = reinterpret_cast<const VkSemaphore*>(handles);
+		memcpy(handles, pSubmits[i].pWaitSemaphores, size);
+		handles += size;
+
+		size = sizeof(VkCommandBuffer) * pSubmits[i].commandBufferCount;
+		submits[i].pCommandBuffers = reinterpret_cast<const VkCommandBuffer*>(handles);
+		memcpy(handles, pSubmits[i].pCommandBuffers, size);
+		handles += size;
+
+		size = sizeof(VkSemaphore) * pSubmits[i].signalSemaphoreCount;
+		submits[i].pSignalSemaphores = reinterpret_cast<const VkSemaphore*>(handles);
+		memcpy(handles, pSubmits[i].pSignalSemaphores, size);
+		handles += size;
+
+		size = sizeof(VkPipelineStageFlags) * pSubmits[i].waitSemaphoreCount;
+		submits[i].pWaitDstStageMask = reinterpret_cast<const VkPipelineStageFlags*>(stageMasks);
+		memcpy(stageMasks, pSubmits[i].pWaitDstStageMask, size);
+		stageMasks += size;
+	}
+
+	return submits;
+}
+
+VkPresentInfoKHR* DeepCopyPresentInfo(const VkPresentInfoKHR* pPresentInfo)
+{
+	// Same as above, for the arrays of the present info. pResults gets its own
+	// array, which holds each swapchain's result once the present is queued.
+	size_t handlesSize = sizeof(VkSemaphore) * pPresentInfo->waitSemaphoreCount +
+	                     sizeof(VkSwapchainKHR) * pPresentInfo->swapchainCount;
+	size_t resultsSize = sizeof(VkResult) * pPresentInfo->swapchainCount;
+	size_t indicesSize = sizeof(uint32_t) * pPresentInfo->swapchainCount;
+
+	uint8_t* mem = static_cast<uint8_t*>(
+		vk::allocate(sizeof(VkPresentInfoKHR) + handlesSize + resultsSize + indicesSize, vk::REQUIRED_MEMORY_ALIGNMENT,
+		             vk::DEVICE_MEMORY, VK_SYSTEM_ALLOCATION_SCOPE_DEVICE));
+	if(!mem)
+	{
+		return nullptr;
+	}
+
+	auto presentInfo = reinterpret_cast<VkPresentInfoKHR*>(mem);
+	*presentInfo = *pPresentInfo;
+
+	uint8_t* handles = mem + sizeof(VkPresentInfoKHR);
+	size_t size = sizeof(VkSemaphore) * pPresentInfo->waitSemaphoreCount;
+	presentInfo->pWaitSemaphores = reinterpret_cast<const VkSemaphore*>(handles);
+	memcpy(handles, pPresentInfo->pWaitSemaphores, size);
+	handles += size;
+
+	size = sizeof(VkSwapchainKHR) * pPresentInfo->swapchainCount;
+	presentInfo->pSwapchains = reinterpret_cast<const VkSwapchainKHR*>(handles);
+	memcpy(handles, pPresentInfo->pSwapchains, size);
+	handles += size;
+
+	presentInfo->pResults = reinterpret_cast<VkResult*>(handles);
+	handles += resultsSize;
+
+	size = sizeof(uint32_t) * pPresentInfo->swapchainCount;
+	presentInfo->pImageIndices = reinterpret_cast<const uint32_t*>(handles);
+	memcpy(handles, pPresentInfo->pImageIndices, size);
+
+	return presentInfo;
+}
+
+} // anonymous namespace
+
 namespace vk
 {
 
@@ -26,19 +129,76 @@ Queue::Queue(uint32_t pFamilyIndex, float pPriority) : familyIndex(pFamilyIndex)
 {
 	context = new sw::Context();
 	renderer = new sw::Renderer(context, sw::OpenGL, true);
+	queueThread = new sw::Thread(TaskLoop, this);
 }
 
 void Queue::destroy()
 {
+	Task task;
+	task.type = Task::KILL_THREAD;
+	pending.put(task);
+
+	queueThread->join();
+	delete queueThread;
+
 	delete context;
 	delete renderer;
 }
 
-void Queue::submit(uint32_t submitCount, const VkSubmitInfo* pSubmits, VkFence fence)
+VkResult Queue::submit(uint32_t submitCount, const VkSubmitInfo* pSubmits, VkFence fence)
 {
-	for(uint32_t i = 0; i < submitCount; i++)
+	Task task;
+	task.submitCount = submitCount;
+	task.pSubmits = DeepCopySubmitInfo(submitCount, pSubmits);
+	task.fence = vk::Cast(fence);
+
+	if(submitCount && !task.pSubmits)
 	{
-		auto& submitInfo = pSubmits[i];
+		return VK_ERROR_OUT_OF_HOST_MEMORY;
+	}
+
+	inFlight.add();
+	pending.put(task);
+
+	return VK_SUCCESS;
+}
+
+void Queue::TaskLoop(void* queue)
+{
+	reinterpret_cast<Queue*>(queue)->taskLoop();
+}
+
+void Queue::taskLoop()
+{
+	while(true)
+	{
+		Task task = pending.take();
+
+		switch(task.type)
+		{
+		case Task::KILL_THREAD:
+			ASSERT(pending.count() == 0);
+			return;
+		case Task::SUBMIT_QUEUE:
+			submitQueue(task);
+			inFlight.done();
+			break;
+		case Task::PRESENT:
+			presentQueue(task);
+			inFlight.done();
+			break;
+		default:
+			UNIMPLEMENTED("task.type %d", static_cast<int>(task.type));
+			break;
+		}
+	}
+}
+
+void Queue::submitQueue(const Task& task)
+{
+	for(uint32_t i = 0; i < task.submitCount; i++)
+	{
+		auto& submitInfo = task.pSubmits[i];
 		for(uint32_t j = 0; j < submitInfo.waitSemaphoreCount; j++)
 		{
 			vk::Cast(submitInfo.pWaitSemaphores[j])->wait(submitInfo.pWaitDstStageMask[j]);
@@ -47,44 +207,108 @@ void Queue::submit(uint32_t submitCount, const VkSubmitInfo* pSubmits, VkFence f
 		{
 			CommandBuffer::ExecutionState executionState;
 			executionState.renderer = renderer;
+			executionState.context = context;
 			for(uint32_t j = 0; j < submitInfo.commandBufferCount; j++)
 			{
 				vk::Cast(submitInfo.pCommandBuffers[j])->submit(executionState);
 			}
 		}
 
-		for(uint32_t j = 0; j < submitInfo.signalSemaphoreCount; j++)
+		if(submitInfo.signalSemaphoreCount > 0)
 		{
-			vk::Cast(submitInfo.pSignalSemaphores[j])->signal();
+			// Draws are still in flight on the renderer's worker threads
+			renderer->synchronize();
+
+			for(uint32_t j = 0; j < submitInfo.signalSemaphoreCount; j++)
+			{
+				vk::Cast(submitInfo.pSignalSemaphores[j])->signal();
+			}
 		}
 	}
 
-	// FIXME (b/117835459): signal the fence only once the work is completed
-	if(fence != VK_NULL_HANDLE)
+	if(task.pSubmits)
 	{
-		vk::Cast(fence)->signal();
+		vk::deallocate(task.pSubmits, DEVICE_MEMORY);
+	}
+
+	// Only report the work as completed once it has retired
+	renderer->synchronize();
+
+	if(task.fence)
+	{
+		task.fence->signal();
 	}
 }
 
 void Queue::waitIdle()
 {
-	// equivalent to submitting a fence to a queue and waiting
+	// Equivalent to submitting a fence to a queue and waiting
 	// with an infinite timeout for that fence to signal
+	inFlight.wait();
+}
+
+VkResult Queue::present(const VkPresentInfoKHR* presentInfo)
+{
+	// Presents are ordered after the work submitted before them, and waiting for
+	// their semaphores on the queue thread lets the application carry on meanwhile.
+	Task task;
+	task.type = Task::PRESENT;
+	task.pPresentInfo = DeepCopyPresentInfo(presentInfo);
 
-	// FIXME (b/117835459): implement once we have working fences
+	if(!task.pPresentInfo)
+	{
+		return VK_ERROR_OUT_OF_HOST_MEMORY;
+	}
+
+	// The most severe of the swapchains' results is returned
+	VkResult result = VK_SUCCESS;
+
+	for(uint32_t i = 0; i < presentInfo->swapchainCount; i++)
+	{
+		VkResult swapchainResult = vk::Cast(presentInfo->pSwapchains[i])->queuePresent();
+		task.pPresentInfo->pResults[i] = swapchainResult;
+
+		if(presentInfo->pResults)
+		{
+			presentInfo->pResults[i] = swapchainResult;
+		}
+
+		if((result == VK_SUCCESS) || ((result > VK_SUCCESS) && (swapchainResult < VK_SUCCESS)))
+		{
+			result = swapchainResult;
+		}
+	}
+
+	inFlight.add();
+	pending.put(task);
+
+	return result;
 }
 
-void Queue::present(const VkPresentInfoKHR* presentInfo)
+void Queue::presentQueue(const Task& task)
 {
+	const VkPresentInfoKHR* presentInfo = task.pPresentInfo;
+
 	for(uint32_t i = 0; i < presentInfo->waitSemaphoreCount; i++)
 	{
 		vk::Cast(presentInfo->pWaitSemaphores[i])->wait();
 	}
 
+	// Hands the images to each swapchain's present thread. Rejected images are
+	// only given back, now that the work rendering to them has completed.
 	for(uint32_t i = 0; i < presentInfo->swapchainCount; i++)
 	{
-		vk::Cast(presentInfo->pSwapchains[i])->present(presentInfo->pImageIndices[i]);
+		if(presentInfo->pResults[i] >= VK_SUCCESS)
+		{
+			vk::Cast(presentInfo->pSwapchains[i])->present(presentInfo->pImageIndices[i]);
+		}
+		else
+		{
+			vk::Cast(presentInfo->pSwapchains[i])->discard(presentInfo->pImageIndices[i]);
+		}
 	}
+
+	vk::deallocate(task.pPresentInfo, DEVICE_MEMORY);
 }
 
-} // namespace vk
\ No newline at end of file
+} // namespace vk
@@ -16,17 +16,21 @@
 #define VK_QUEUE_HPP_
 
 #include "VkObject.hpp"
+#include "System/Synchronization.hpp"
 #include <vulkan/vk_icd.h>
 
 namespace sw
 {
 	class Context;
 	class Renderer;
+	class Thread;
 }
 
 namespace vk
 {
 
+class Fence;
+
 class Queue
 {
 	VK_LOADER_DATA loaderData = { ICD_LOADER_MAGIC };
@@ -41,13 +45,32 @@ public:
 	}
 
 	void destroy();
-	void submit(uint32_t submitCount, const VkSubmitInfo* pSubmits, VkFence fence);
+	VkResult submit(uint32_t submitCount, const VkSubmitInfo* pSubmits, VkFence fence);
 	void waitIdle();
-	void present(const VkPresentInfoKHR* presentInfo);
+	VkResult present(const VkPresentInfoKHR* presentInfo);
 
 private:
+	struct Task
+	{
+		enum Type { KILL_THREAD, SUBMIT_QUEUE, PRESENT };
+
+		Type type = SUBMIT_QUEUE;
+		uint32_t submitCount = 0;
+		VkSubmitInfo* pSubmits = nullptr;   // Deep copy owned by the task
+		Fence* fence = nullptr;
+		VkPresentInfoKHR* pPresentInfo = nullptr;   // Deep copy owned by the task
+	};
+
+	static void TaskLoop(void* queue);
+	void taskLoop();
+	void submitQueue(const Task& task);
+	void presentQueue(const Task& task);
+
 	sw::Context* context = nullptr;
 	sw::Renderer* renderer = nullptr;
+	sw::Thread* queueThread = nullptr;
+	sw::Chan<Task> pending;
+	sw::WaitGroup inFlight;
 	uint32_t familyIndex = 0;
 	float    priority = 0.0f;
 };
@@ -17,6 +17,9 @@
 
 #include "VkObject.hpp"
 
+#include <condition_variable>
+#include <mutex>
+
 namespace vk
 {
 
@@ -34,22 +37,32 @@ public:
 
 	void wait()
 	{
-		// Semaphores are noop for now
+		std::unique_lock<std::mutex> lock(mutex);
+		condition.wait(lock, [this] { return signaled; });
+		signaled = false;   // Waiting on a binary semaphore unsignals it
 	}
 
 	void wait(const VkPipelineStageFlags& flag)
 	{
-		// VkPipelineStageFlags is the pipeline stage at which the semaphore wait will occur
+		// VkPipelineStageFlags is the pipeline stage at which the semaphore wait will occur.
+		// Submissions are executed one at a time by the queue thread, so waiting before
+		// any of the work starts is a valid, if conservative, implementation.
+		(void)flag;
 
-		// Semaphores are noop for now
+		wait();
 	}
 
 	void signal()
 	{
-		// Semaphores are noop for now
+		std::unique_lock<std::mutex> lock(mutex);
+		signaled = true;
+		condition.notify_one();
 	}
 
 private:
+	bool signaled = false;
+	std::mutex mutex;
+	std::condition_variable condition;
 };
 
 static inline Semaphore* Cast(VkSemaphore object)
@@ -0,0 +1,84 @@
+// Copyright 2019 The SwiftShader Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "VkShaderCache.hpp"
+#include "Pipeline/SpirvShader.hpp"
+#include "Reactor/Routine.hpp"
+
+namespace vk
+{
+
+std::shared_ptr<sw::SpirvShader> ShaderCache::findShader(const Key& key)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	return find(shaders, key);
+}
+
+std::shared_ptr<rr::Routine> ShaderCache::findRoutine(const Key& key)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	return find(routines, key);
+}
+
+std::shared_ptr<sw::SpirvShader> ShaderCache::insertShader(const Key& key, const std::shared_ptr<sw::SpirvShader>& shader)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	return insert(shaders, key, shader);
+}
+
+std::shared_ptr<rr::Routine> ShaderCache::insertRoutine(const Key& key, const std::shared_ptr<rr::Routine>& routine)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	return insert(routines, key, routine);
+}
+
+std::shared_ptr<rr::Routine> ShaderCache::AdoptRoutine(rr::Routine* routine)
+{
+	return std::shared_ptr<rr::Routine>(routine, [](rr::Routine* r) { r->unbind(); });
+}
+
+template<typename T>
+std::shared_ptr<T> ShaderCache::find(Map<T>& map, const Key& key)
+{
+	auto it = map.find(key);
+	if(it == map.end())
+	{
+		return nullptr;
+	}
+
+	std::shared_ptr<T> value = it->second.lock();
+	if(!value)
+	{
+		map.erase(it);   // The last user of this entry has been destroyed
+	}
+
+	return value;
+}
+
+template<typename T>
+std::shared_ptr<T> ShaderCache::insert(Map<T>& map, const Key& key, const std::shared_ptr<T>& value)
+{
+	std::weak_ptr<T>& entry = map[key];
+
+	std::shared_ptr<T> existing = entry.lock();
+	if(existing)
+	{
+		return existing;
+	}
+
+	entry = value;
+	return value;
+}
+
+} // namespace vk
@@ -0,0 +1,73 @@
+// Copyright 2019 The SwiftShader Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef VK_SHADER_CACHE_HPP_
+#define VK_SHADER_CACHE_HPP_
+
+#include "VkPipelineCache.hpp"
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace rr
+{
+	class Routine;
+}
+
+namespace sw
+{
+	class SpirvShader;
+}
+
+namespace vk
+{
+
+// ShaderCache lets all the pipelines of a device share parsed shaders and
+// compiled compute routines. Keys are built by PipelineCache::ComputeRoutineKey()
+// from the shader stage and the pipeline layout. The cache only holds weak
+// references, so entries are released along with the last pipeline using them.
+class ShaderCache
+{
+public:
+	using Key = PipelineCache::Key;
+
+	std::shared_ptr<sw::SpirvShader> findShader(const Key& key);
+	std::shared_ptr<rr::Routine> findRoutine(const Key& key);
+
+	// The insert functions return the entry already cached for the key, if another
+	// thread added one in the meantime, or the given entry otherwise.
+	std::shared_ptr<sw::SpirvShader> insertShader(const Key& key, const std::shared_ptr<sw::SpirvShader>& shader);
+	std::shared_ptr<rr::Routine> insertRoutine(const Key& key, const std::shared_ptr<rr::Routine>& routine);
+
+	// Takes over a reference the caller holds on the routine (see rr::Routine::bind()).
+	static std::shared_ptr<rr::Routine> AdoptRoutine(rr::Routine* routine);
+
+private:
+	template<typename T>
+	using Map = std::unordered_map<Key, std::weak_ptr<T>, Key::Hash>;
+
+	template<typename T>
+	static std::shared_ptr<T> find(Map<T>& map, const Key& key);
+	template<typename T>
+	static std::shared_ptr<T> insert(Map<T>& map, const Key& key, const std::shared_ptr<T>& value);
+
+	std::mutex mutex;
+	Map<sw::SpirvShader> shaders;
+	Map<rr::Routine> routines;
+};
+
+} // namespace vk
+
+#endif // VK_SHADER_CACHE_HPP_
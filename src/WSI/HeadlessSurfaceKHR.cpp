@@ -0,0 +1,218 @@
+// Copyright 2019 The SwiftShader Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "HeadlessSurfaceKHR.hpp"
+
+#include "Vulkan/VkConfig.h"
+#include "Vulkan/VkDebug.hpp"
+#include "Vulkan/VkDeviceMemory.hpp"
+#include "Vulkan/VkImage.hpp"
+#include "System/Thread.hpp"
+
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+const char* const Y4M_EXTENSION = ".y4m";
+
+// Presented frames have no timing information, so Y4M streams are tagged with a nominal rate
+const int Y4M_FRAME_RATE = 60;
+
+bool hasSuffix(const char* string, const char* suffix)
+{
+	size_t length = strlen(string);
+	size_t suffixLength = strlen(suffix);
+
+	return (length >= suffixLength) && (strcmp(string + length - suffixLength, suffix) == 0);
+}
+
+}
+
+namespace vk {
+
+HeadlessSurfaceKHR::HeadlessSurfaceKHR(const VkHeadlessSurfaceCreateInfoEXT *pCreateInfo, void *mem)
+{
+	const char* path = getenv("SWIFTSHADER_HEADLESS_DUMP");
+	if(!path || !*path)
+	{
+		return;
+	}
+
+	file = fopen(path, "wb");
+	if(!file)
+	{
+		WARN("Could not open '%s' for dumping frames", path);
+		return;
+	}
+
+	fileFormat = hasSuffix(path, Y4M_EXTENSION) ? Y4M : RAW;
+
+	frames = new Frame[FRAME_RING_SIZE];
+	for(int i = 0; i < FRAME_RING_SIZE; i++)
+	{
+		freeFrames.put(i);
+	}
+
+	writerThread = new sw::Thread(WriterLoop, this);
+}
+
+void HeadlessSurfaceKHR::destroySurface(const VkAllocationCallbacks *pAllocator)
+{
+	if(writerThread)
+	{
+		// Frames already presented are written before the thread exits
+		pendingFrames.put(KILL_THREAD);
+
+		writerThread->join();
+		delete writerThread;
+	}
+
+	if(file)
+	{
+		fclose(file);
+	}
+
+	delete[] frames;
+}
+
+size_t HeadlessSurfaceKHR::ComputeRequiredAllocationSize(const VkHeadlessSurfaceCreateInfoEXT *pCreateInfo)
+{
+	return 0;
+}
+
+void HeadlessSurfaceKHR::getSurfaceCapabilities(VkSurfaceCapabilitiesKHR *pSurfaceCapabilities) const
+{
+	SurfaceKHR::getSurfaceCapabilities(pSurfaceCapabilities);
+
+	// There is no window, so the swapchain determines the extent
+	pSurfaceCapabilities->currentExtent = { 0xFFFFFFFF, 0xFFFFFFFF };
+	pSurfaceCapabilities->minImageExtent = { 1, 1 };
+	pSurfaceCapabilities->maxImageExtent = { 1 << (vk::MAX_IMAGE_LEVELS_2D - 1), 1 << (vk::MAX_IMAGE_LEVELS_2D - 1) };
+}
+
+void HeadlessSurfaceKHR::attachImage(PresentImage* image)
+{
+}
+
+void HeadlessSurfaceKHR::detachImage(PresentImage* image)
+{
+}
+
+void HeadlessSurfaceKHR::present(PresentImage* image)
+{
+	if(!writerThread)
+	{
+		return;   // Nothing observes the presented images
+	}
+
+	// The application may render to the image again as soon as it has been presented,
+	// so it's copied into the ring. This blocks when the writer is FRAME_RING_SIZE frames
+	// behind, rather than dropping frames.
+	int index = freeFrames.take();
+	Frame& frame = frames[index];
+
+	const vk::Image* presentImage = vk::Cast(image->image);
+	VkExtent3D extent = presentImage->getMipLevelExtent(0);
+	size_t rowPitch = presentImage->rowPitchBytes(VK_IMAGE_ASPECT_COLOR_BIT, 0);
+	size_t rowSize = extent.width * 4;
+
+	frame.width = extent.width;
+	frame.height = extent.height;
+	frame.pixels.resize(rowSize * extent.height);
+
+	const uint8_t* source = static_cast<const uint8_t*>(vk::Cast(image->imageMemory)->getOffsetPointer(0));
+	uint8_t* destination = frame.pixels.data();
+
+	for(uint32_t y = 0; y < extent.height; y++)
+	{
+		memcpy(destination, source, rowSize);
+		source += rowPitch;
+		destination += rowSize;
+	}
+
+	pendingFrames.put(index);
+}
+
+void HeadlessSurfaceKHR::WriterLoop(void* surface)
+{
+	static_cast<HeadlessSurfaceKHR*>(surface)->writerLoop();
+}
+
+void HeadlessSurfaceKHR::writerLoop()
+{
+	while(true)
+	{
+		int index = pendingFrames.take();
+		if(index == KILL_THREAD)
+		{
+			break;
+		}
+
+		writeFrame(frames[index]);
+
+		freeFrames.put(index);
+	}
+
+	fflush(file);
+}
+
+void HeadlessSurfaceKHR::writeFrame(const Frame& frame)
+{
+	if(fileFormat == RAW)
+	{
+		fwrite(frame.pixels.data(), 1, frame.pixels.size(), file);
+		return;
+	}
+
+	// A Y4M stream has a single size, given by the header written for the first frame
+	if(streamWidth == 0)
+	{
+		streamWidth = frame.width;
+		streamHeight = frame.height;
+
+		fprintf(file, "YUV4MPEG2 W%u H%u F%d:1 Ip A1:1 C444\n", streamWidth, streamHeight, Y4M_FRAME_RATE);
+	}
+
+	if(frame.width != streamWidth || frame.height != streamHeight)
+	{
+		WARN("Skipping %ux%u frame in %ux%u Y4M stream", frame.width, frame.height, streamWidth, streamHeight);
+		return;
+	}
+
+	// Convert B8G8R8A8 to planar 4:4:4 BT.601 limited range YCbCr
+	size_t pixelCount = static_cast<size_t>(frame.width) * frame.height;
+	planes.resize(pixelCount * 3);
+
+	uint8_t* Y = planes.data();
+	uint8_t* Cb = Y + pixelCount;
+	uint8_t* Cr = Cb + pixelCount;
+	const uint8_t* bgra = frame.pixels.data();
+
+	for(size_t i = 0; i < pixelCount; i++, bgra += 4)
+	{
+		int B = bgra[0];
+		int G = bgra[1];
+		int R = bgra[2];
+
+		Y[i] = static_cast<uint8_t>(((66 * R + 129 * G + 25 * B + 128) >> 8) + 16);
+		Cb[i] = static_cast<uint8_t>(((-38 * R - 74 * G + 112 * B + 128) >> 8) + 128);
+		Cr[i] = static_cast<uint8_t>(((112 * R - 94 * G - 18 * B + 128) >> 8) + 128);
+	}
+
+	fputs("FRAME\n", file);
+	fwrite(planes.data(), 1, planes.size(), file);
+}
+
+}
@@ -0,0 +1,87 @@
+// Copyright 2019 The SwiftShader Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SWIFTSHADER_HEADLESSSURFACEKHR_HPP
+#define SWIFTSHADER_HEADLESSSURFACEKHR_HPP
+
+#include "Vulkan/VkObject.hpp"
+#include "VkSurfaceKHR.hpp"
+#include "System/Synchronization.hpp"
+
+#include <cstdio>
+#include <vector>
+
+namespace sw
+{
+	class Thread;
+}
+
+namespace vk {
+
+// Surface which isn't displayed anywhere (VK_EXT_headless_surface). When the
+// SWIFTSHADER_HEADLESS_DUMP environment variable names a file, presented frames
+// are copied into a ring of host buffers and appended to that file by a writer
+// thread, as Y4M video if the name ends in ".y4m", or as raw BGRA pixels otherwise.
+class HeadlessSurfaceKHR : public SurfaceKHR, public ObjectBase<HeadlessSurfaceKHR, VkSurfaceKHR> {
+public:
+	HeadlessSurfaceKHR(const VkHeadlessSurfaceCreateInfoEXT *pCreateInfo, void *mem);
+
+	~HeadlessSurfaceKHR() = delete;
+
+	void destroySurface(const VkAllocationCallbacks *pAllocator) override;
+
+	static size_t ComputeRequiredAllocationSize(const VkHeadlessSurfaceCreateInfoEXT *pCreateInfo);
+
+	void getSurfaceCapabilities(VkSurfaceCapabilitiesKHR *pSurfaceCapabilities) const override;
+
+	void attachImage(PresentImage* image) override;
+	void detachImage(PresentImage* image) override;
+	void present(PresentImage* image) override;
+
+private:
+	enum FileFormat { RAW, Y4M };
+
+	struct Frame
+	{
+		uint32_t width = 0;
+		uint32_t height = 0;
+		std::vector<uint8_t> pixels;   // Tightly packed B8G8R8A8 rows
+	};
+
+	enum
+	{
+		FRAME_RING_SIZE = 3,
+		KILL_THREAD = -1,
+	};
+
+	static void WriterLoop(void* surface);
+	void writerLoop();
+	void writeFrame(const Frame& frame);
+
+	FILE* file = nullptr;
+	FileFormat fileFormat = RAW;
+	uint32_t streamWidth = 0;    // Dimensions of the Y4M stream, set by its first frame
+	uint32_t streamHeight = 0;
+	std::vector<uint8_t> planes;   // Y4M conversion scratch space, only used by the writer
+
+	// FIXME (b/119409619): use an allocator here so we can control all memory allocations
+	Frame* frames = nullptr;   // Ring of FRAME_RING_SIZE frames
+	sw::Chan<int> freeFrames;      // Indices of frames which can be presented into
+	sw::Chan<int> pendingFrames;   // Indices of frames waiting to be written, or KILL_THREAD
+	sw::Thread* writerThread = nullptr;
+};
+
+}
+
+#endif //SWIFTSHADER_HEADLESSSURFACEKHR_HPP
@@ -27,7 +27,7 @@ enum PresentImageStatus
 	NONEXISTENT, //  Image wasn't made
 	AVAILABLE,
 	DRAWING,
-	PRESENTING,
+	PRESENTING,  //  Queued for presentation, or being presented
 };
 
 struct PresentImage
@@ -60,6 +60,10 @@ public:
 	uint32_t getPresentModeCount() const;
 	VkResult getPresentModes(uint32_t* pPresentModeCount, VkPresentModeKHR* pPresentModes) const;
 
+	// Surfaces which share image memory with the presentation engine return it here,
+	// to present without copying. Otherwise the swapchain allocates device memory.
+	virtual void* allocateImageMemory(PresentImage* image, size_t size) { return nullptr; }
+
 	virtual void attachImage(PresentImage* image) = 0;
 	virtual void detachImage(PresentImage* image) = 0;
 	virtual void present(PresentImage* image) = 0;
@@ -80,6 +84,7 @@ private:
 	const std::vector<VkPresentModeKHR> presentModes =
 	{
 		VK_PRESENT_MODE_FIFO_KHR,
+		VK_PRESENT_MODE_MAILBOX_KHR,
 	};
 };
 
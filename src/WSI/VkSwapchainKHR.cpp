@@ -17,8 +17,13 @@
 #include "Vulkan/VkImage.hpp"
 #include "Vulkan/VkDeviceMemory.hpp"
 #include "Vulkan/VkDestroy.h"
+#include "Vulkan/VkFence.hpp"
+#include "Vulkan/VkSemaphore.hpp"
+#include "System/Thread.hpp"
 
 #include <algorithm>
+#include <chrono>
+#include <climits>
 
 namespace vk
 {
@@ -29,10 +34,24 @@ SwapchainKHR::SwapchainKHR(const VkSwapchainCreateInfoKHR *pCreateInfo, void *me
 {
 	images.resize(pCreateInfo->minImageCount);
 	resetImages();
+
+	presentThread = new sw::Thread(PresentLoop, this);
 }
 
 void SwapchainKHR::destroy(const VkAllocationCallbacks *pAllocator)
 {
+	queuedPresents.wait();
+
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		terminating = true;
+		imageQueued.notify_one();
+	}
+
+	// Images already queued are presented before the thread exits
+	presentThread->join();
+	delete presentThread;
+
 	for(auto& currentImage : images)
 	{
 		if (currentImage.imageStatus != NONEXISTENT)
@@ -58,6 +77,8 @@ size_t SwapchainKHR::ComputeRequiredAllocationSize(const VkSwapchainCreateInfoKH
 
 void SwapchainKHR::retire()
 {
+	std::unique_lock<std::mutex> lock(mutex);
+
 	if(!retired)
 	{
 		retired = true;
@@ -74,6 +95,8 @@ void SwapchainKHR::retire()
 				currentImage.imageStatus = NONEXISTENT;
 			}
 		}
+
+		imageAvailable.notify_all();
 	}
 }
 
@@ -135,12 +158,28 @@ VkResult SwapchainKHR::createImages(VkDevice device)
 		allocInfo.allocationSize = memRequirements.size;
 		allocInfo.memoryTypeIndex = 0;
 
-		status = vkAllocateMemory(device, &allocInfo, nullptr, &currentImage.imageMemory);
+		status = vk::DeviceMemory::Create(nullptr, &allocInfo, &currentImage.imageMemory);
 		if(status != VK_SUCCESS)
 		{
 			return status;
 		}
 
+		void* sharedMemory = vk::Cast(createInfo.surface)->allocateImageMemory(&currentImage, static_cast<size_t>(memRequirements.size));
+		if(sharedMemory)
+		{
+			vk::Cast(currentImage.imageMemory)->import(sharedMemory);
+		}
+		else
+		{
+			status = vk::Cast(currentImage.imageMemory)->allocate();
+			if(status != VK_SUCCESS)
+			{
+				vk::destroy(currentImage.imageMemory, nullptr);
+				currentImage.imageMemory = VK_NULL_HANDLE;
+				return status;
+			}
+		}
+
 		vkBindImageMemory(device, currentImage.image, currentImage.imageMemory, 0);
 
 		currentImage.imageStatus = AVAILABLE;
@@ -178,38 +217,133 @@ VkResult SwapchainKHR::getImages(uint32_t *pSwapchainImageCount, VkImage *pSwapc
 
 VkResult SwapchainKHR::getNextImage(uint64_t timeout, VkSemaphore semaphore, VkFence fence, uint32_t *pImageIndex)
 {
-	for(uint32_t i = 0; i < getImageCount(); i++)
+	std::unique_lock<std::mutex> lock(mutex);
+
+	// Retired swapchains destroy their images instead of making them available
+	uint32_t index = getImageCount();
+	auto findAvailableImage = [this, &index]
 	{
-		PresentImage& currentImage = images[i];
-		if(currentImage.imageStatus == AVAILABLE)
+		if(retired)
 		{
-			currentImage.imageStatus = DRAWING;
-			*pImageIndex = i;
+			return true;
+		}
 
-			if(semaphore)
+		for(index = 0; index < getImageCount(); index++)
+		{
+			if(images[index].imageStatus == AVAILABLE)
 			{
-				vk::Cast(semaphore)->signal();
+				return true;
 			}
+		}
 
-			if(fence)
-			{
-				vk::Cast(fence)->signal();
-			}
+		return false;
+	};
 
-			return VK_SUCCESS;
+	if(timeout == 0)
+	{
+		if(!findAvailableImage())
+		{
+			return VK_NOT_READY;
 		}
 	}
+	else
+	{
+		const auto start = std::chrono::steady_clock::now();
+		const uint64_t maxTimeout = static_cast<uint64_t>(LLONG_MAX - std::chrono::duration_cast<std::chrono::nanoseconds>(start.time_since_epoch()).count());
+
+		if(timeout > maxTimeout)
+		{
+			imageAvailable.wait(lock, findAvailableImage);
+		}
+		else if(!imageAvailable.wait_until(lock, start + std::chrono::nanoseconds(timeout), findAvailableImage))
+		{
+			return VK_TIMEOUT;
+		}
+	}
+
+	if(retired)
+	{
+		return VK_ERROR_OUT_OF_DATE_KHR;
+	}
+
+	images[index].imageStatus = DRAWING;
+	*pImageIndex = index;
+
+	// Images only become available once the surface is done reading them,
+	// so they can be rendered to as soon as they are acquired.
+	if(semaphore)
+	{
+		vk::Cast(semaphore)->signal();
+	}
+
+	if(fence)
+	{
+		vk::Cast(fence)->signal();
+	}
 
-	return VK_NOT_READY;
+	return VK_SUCCESS;
+}
+
+// Called by vkQueuePresentKHR, ahead of present() or discard() being called
+// once the queue has executed the work submitted before it. The image is only
+// presented when a success code is returned.
+VkResult SwapchainKHR::queuePresent()
+{
+	queuedPresents.add();
+
+	// The images no longer fit a window which was resized
+	VkSurfaceCapabilitiesKHR capabilities;
+	vk::Cast(createInfo.surface)->getSurfaceCapabilities(&capabilities);
+	const VkExtent2D& extent = capabilities.currentExtent;
+
+	if((extent.width != 0xFFFFFFFF) &&
+	   ((extent.width != createInfo.imageExtent.width) || (extent.height != createInfo.imageExtent.height)))
+	{
+		return VK_ERROR_OUT_OF_DATE_KHR;
+	}
+
+	std::unique_lock<std::mutex> lock(mutex);
+
+	return retired ? VK_ERROR_OUT_OF_DATE_KHR : VK_SUCCESS;
 }
 
 void SwapchainKHR::present(uint32_t index)
 {
-	auto & image = images[index];
-	image.imageStatus = PRESENTING;
-	vk::Cast(createInfo.surface)->present(&image);
-	image.imageStatus = AVAILABLE;
+	std::unique_lock<std::mutex> lock(mutex);
+
+	if(createInfo.presentMode == VK_PRESENT_MODE_MAILBOX_KHR)
+	{
+		// Only the newest image waits to be presented. The one it replaces is
+		// never shown, and can be acquired again right away.
+		for(uint32_t replaced : presentQueue)
+		{
+			releaseImage(images[replaced]);
+		}
+
+		presentQueue.clear();
+		imageAvailable.notify_all();
+	}
+
+	images[index].imageStatus = PRESENTING;
+	presentQueue.push_back(index);
+	imageQueued.notify_one();
+
+	queuedPresents.done();
+}
+
+// Gives back an image whose presentation was rejected by queuePresent()
+void SwapchainKHR::discard(uint32_t index)
+{
+	std::unique_lock<std::mutex> lock(mutex);
 
+	releaseImage(images[index]);
+	imageAvailable.notify_all();
+
+	queuedPresents.done();
+}
+
+void SwapchainKHR::releaseImage(PresentImage& image)
+{
 	if(retired)
 	{
 		vk::Cast(createInfo.surface)->detachImage(&image);
@@ -218,6 +352,41 @@ void SwapchainKHR::present(uint32_t index)
 
 		image.imageStatus = NONEXISTENT;
 	}
+	else
+	{
+		image.imageStatus = AVAILABLE;
+	}
+}
+
+void SwapchainKHR::PresentLoop(void* swapchain)
+{
+	static_cast<SwapchainKHR*>(swapchain)->presentLoop();
+}
+
+void SwapchainKHR::presentLoop()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	while(true)
+	{
+		imageQueued.wait(lock, [this] { return !presentQueue.empty() || terminating; });
+
+		if(presentQueue.empty())
+		{
+			break;   // Terminating, with nothing left to present
+		}
+
+		PresentImage& image = images[presentQueue.front()];
+		presentQueue.pop_front();
+
+		// The application can keep acquiring and queueing other images meanwhile
+		lock.unlock();
+		vk::Cast(createInfo.surface)->present(&image);
+		lock.lock();
+
+		releaseImage(image);
+		imageAvailable.notify_all();
+	}
 }
 
 }
\ No newline at end of file
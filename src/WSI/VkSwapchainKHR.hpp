@@ -19,9 +19,18 @@
 #include "Vulkan/VkObject.hpp"
 #include "Vulkan/VkImage.hpp"
 #include "VkSurfaceKHR.hpp"
+#include "System/Synchronization.hpp"
 
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include <vector>
 
+namespace sw
+{
+	class Thread;
+}
+
 namespace vk
 {
 
@@ -44,7 +53,9 @@ public:
 
 	VkResult getNextImage(uint64_t timeout, VkSemaphore semaphore, VkFence fence, uint32_t* pImageIndex);
 
+	VkResult queuePresent();
 	void present(uint32_t index);
+	void discard(uint32_t index);
 
 private:
 	VkSwapchainCreateInfoKHR createInfo;
@@ -52,6 +63,20 @@ private:
 	bool retired;
 
 	void resetImages();
+	void releaseImage(PresentImage& image);
+
+	static void PresentLoop(void* swapchain);
+	void presentLoop();
+
+	// Images are handed to the surface by a dedicated thread, in the order they
+	// were queued for presentation. The mutex guards image states and the queue.
+	std::mutex mutex;
+	std::condition_variable imageAvailable;
+	std::condition_variable imageQueued;
+	std::deque<uint32_t> presentQueue;
+	bool terminating = false;
+	sw::Thread* presentThread = nullptr;
+	sw::WaitGroup queuedPresents;   // Presents which haven't reached this swapchain yet
 };
 
 static inline SwapchainKHR* Cast(VkSwapchainKHR object)
@@ -14,6 +14,29 @@
 #include "Vulkan/VkDeviceMemory.hpp"
 
 #include <string.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+namespace {
+
+int (*PreviousXErrorHandler)(Display *display, XErrorEvent *event) = nullptr;
+bool shmBadAccess = false;
+
+// Catches BadAccess errors so we can fall back to not using MIT-SHM
+int XShmErrorHandler(Display *display, XErrorEvent *event)
+{
+	if(event->error_code == BadAccess)
+	{
+		shmBadAccess = true;
+		return 0;
+	}
+	else
+	{
+		return PreviousXErrorHandler(display, event);
+	}
+}
+
+}
 
 namespace vk {
 
@@ -21,18 +44,32 @@ XlibSurfaceKHR::XlibSurfaceKHR(const VkXlibSurfaceCreateInfoKHR *pCreateInfo, vo
 		pDisplay(pCreateInfo->dpy),
 		window(pCreateInfo->window)
 {
-	int screen = DefaultScreen(pDisplay);
-	gc = libX11->XDefaultGC(pDisplay, screen);
+	// Swapchains present from their own threads, while the application keeps using
+	// its display connection. Xlib connections aren't thread-safe unless XInitThreads()
+	// was called first, so presentation uses a separate connection to the same server.
+	presentDisplay = libX11->XOpenDisplay(DisplayString(pDisplay));
+	if(!presentDisplay)
+	{
+		presentDisplay = pDisplay;
+	}
+
+	int screen = DefaultScreen(presentDisplay);
+	gc = libX11->XDefaultGC(presentDisplay, screen);
 
 	XVisualInfo xVisual;
-	Status status = libX11->XMatchVisualInfo(pDisplay, screen, 32, TrueColor, &xVisual);
+	Status status = libX11->XMatchVisualInfo(presentDisplay, screen, 32, TrueColor, &xVisual);
 	bool match = (status != 0 && xVisual.blue_mask ==0xFF);
-	visual = match ? xVisual.visual : libX11->XDefaultVisual(pDisplay, screen);
+	visual = match ? xVisual.visual : libX11->XDefaultVisual(presentDisplay, screen);
+
+	mitShm = (libX11->XShmQueryExtension && libX11->XShmQueryExtension(presentDisplay) == True);
 }
 
 void XlibSurfaceKHR::destroySurface(const VkAllocationCallbacks *pAllocator)
 {
-
+	if(presentDisplay != pDisplay)
+	{
+		libX11->XCloseDisplay(presentDisplay);
+	}
 }
 
 size_t XlibSurfaceKHR::ComputeRequiredAllocationSize(const VkXlibSurfaceCreateInfoKHR *pCreateInfo)
@@ -53,44 +90,142 @@ void XlibSurfaceKHR::getSurfaceCapabilities(VkSurfaceCapabilitiesKHR *pSurfaceCa
 	pSurfaceCapabilities->maxImageExtent = extent;
 }
 
+void* XlibSurfaceKHR::allocateImageMemory(PresentImage* image, size_t size)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	// Rendering directly into a segment shared with the X server means presenting
+	// doesn't have to send the image through the connection.
+	if(!mitShm)
+	{
+		return nullptr;
+	}
+
+	XShmSegmentInfo& shmInfo = imageMap[image].shmInfo;
+	shmInfo.shmid = shmget(IPC_PRIVATE, size, IPC_CREAT | SHM_R | SHM_W);
+	if(shmInfo.shmid < 0)
+	{
+		imageMap.erase(image);
+		return nullptr;
+	}
+
+	shmInfo.shmaddr = static_cast<char*>(shmat(shmInfo.shmid, 0, 0));
+	shmInfo.readOnly = False;
+
+	if(shmInfo.shmaddr == reinterpret_cast<char*>(-1))
+	{
+		shmctl(shmInfo.shmid, IPC_RMID, 0);
+		imageMap.erase(image);
+		return nullptr;
+	}
+
+	PreviousXErrorHandler = libX11->XSetErrorHandler(XShmErrorHandler);
+	libX11->XShmAttach(presentDisplay, &shmInfo);   // May produce a BadAccess error, e.g. for remote displays
+	libX11->XSync(presentDisplay, False);
+	libX11->XSetErrorHandler(PreviousXErrorHandler);
+
+	// The segment is destroyed once both the X server and this process detach from it
+	shmctl(shmInfo.shmid, IPC_RMID, 0);
+
+	if(shmBadAccess)
+	{
+		shmBadAccess = false;
+		mitShm = false;
+
+		shmdt(shmInfo.shmaddr);
+		imageMap.erase(image);
+		return nullptr;
+	}
+
+	imageMap[image].shared = true;
+
+	return shmInfo.shmaddr;
+}
+
 void XlibSurfaceKHR::attachImage(PresentImage* image)
 {
+	std::lock_guard<std::mutex> lock(mutex);
+
 	XWindowAttributes attr;
-	libX11->XGetWindowAttributes(pDisplay, window, &attr);
+	libX11->XGetWindowAttributes(presentDisplay, window, &attr);
 
 	VkExtent3D extent = vk::Cast(image->image)->getMipLevelExtent(0);
 
 	int bytes_per_line = vk::Cast(image->image)->rowPitchBytes(VK_IMAGE_ASPECT_COLOR_BIT, 0);
 	char* buffer = static_cast<char*>(vk::Cast(image->imageMemory)->getOffsetPointer(0));
 
-	XImage* xImage = libX11->XCreateImage(pDisplay, visual, attr.depth, ZPixmap, 0, buffer, extent.width, extent.height, 32, bytes_per_line);
+	ImageData& imageData = imageMap[image];
+
+	if(imageData.shared)
+	{
+		imageData.xImage = libX11->XShmCreateImage(presentDisplay, visual, attr.depth, ZPixmap, buffer, &imageData.shmInfo, extent.width, extent.height);
 
-	imageMap[image] = xImage;
+		if(imageData.xImage)
+		{
+			imageData.xImage->bytes_per_line = bytes_per_line;
+		}
+	}
+	else
+	{
+		imageData.xImage = libX11->XCreateImage(presentDisplay, visual, attr.depth, ZPixmap, 0, buffer, extent.width, extent.height, 32, bytes_per_line);
+	}
 }
 
 void XlibSurfaceKHR::detachImage(PresentImage* image)
 {
+	std::lock_guard<std::mutex> lock(mutex);
+
 	auto it = imageMap.find(image);
 	if(it != imageMap.end())
 	{
-		XImage* xImage = it->second;
-		xImage->data = nullptr; // the XImage does not actually own the buffer
-		XDestroyImage(xImage);
-		imageMap.erase(image);
+		ImageData& imageData = it->second;
+
+		if(imageData.xImage)
+		{
+			imageData.xImage->data = nullptr; // the XImage does not actually own the buffer
+			XDestroyImage(imageData.xImage);
+		}
+
+		if(imageData.shared)
+		{
+			libX11->XShmDetach(presentDisplay, &imageData.shmInfo);
+			libX11->XSync(presentDisplay, False);
+			shmdt(imageData.shmInfo.shmaddr);
+		}
+
+		imageMap.erase(it);
 	}
 }
 
 void XlibSurfaceKHR::present(PresentImage* image)
 {
+	std::lock_guard<std::mutex> lock(mutex);
+
 	auto it = imageMap.find(image);
 	if(it != imageMap.end())
 	{
-		XImage* xImage = it->second;
+		XImage* xImage = it->second.xImage;
 
-		if(xImage->data)
+		if(xImage && xImage->data)
 		{
 			VkExtent3D extent = vk::Cast(image->image)->getMipLevelExtent(0);
-			libX11->XPutImage(pDisplay, window, gc, xImage, 0, 0, 0, 0, extent.width, extent.height);
+
+			if(it->second.shared)
+			{
+				libX11->XShmPutImage(presentDisplay, window, gc, xImage, 0, 0, 0, 0, extent.width, extent.height, False);
+
+				// The X server reads the shared memory while processing the request,
+				// which must be done before the image can be rendered to again.
+				libX11->XSync(presentDisplay, False);
+			}
+			else
+			{
+				libX11->XPutImage(presentDisplay, window, gc, xImage, 0, 0, 0, 0, extent.width, extent.height);
+
+				// The application doesn't flush our private connection, so the
+				// request would otherwise stay in the output buffer.
+				libX11->XSync(presentDisplay, False);
+			}
 		}
 	}
 }
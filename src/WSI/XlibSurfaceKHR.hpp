@@ -21,6 +21,7 @@
 #include "VkSurfaceKHR.hpp"
 
 #include <map>
+#include <mutex>
 
 namespace vk {
 
@@ -36,16 +37,27 @@ public:
 
 	void getSurfaceCapabilities(VkSurfaceCapabilitiesKHR *pSurfaceCapabilities) const override;
 
+	void* allocateImageMemory(PresentImage* image, size_t size) override;
 	virtual void attachImage(PresentImage* image) override;
 	virtual void detachImage(PresentImage* image) override;
 	void present(PresentImage* image) override;
 
 private:
+	struct ImageData
+	{
+		XImage* xImage = nullptr;
+		XShmSegmentInfo shmInfo = {};   // Referenced by xImage, so must not move
+		bool shared = false;            // The image memory is shared with the X server
+	};
+
 	Display *pDisplay;
+	Display *presentDisplay;   // Connection used for the swapchain images, guarded by the mutex
+	std::mutex mutex;
 	Window window;
 	GC gc;
 	Visual *visual = nullptr;
-	std::map<PresentImage*, XImage*> imageMap;
+	bool mitShm = false;
+	std::map<PresentImage*, ImageData> imageMap;
 };
 
 }
@@ -31,8 +31,15 @@ Device::Device(
 
 bool Device::IsValid() const { return device != nullptr; }
 
+void Device::Destroy()
+{
+	driver->vkDestroyDevice(device, 0);
+	device = nullptr;
+}
+
 VkResult Device::CreateComputeDevice(
-		Driver const *driver, VkInstance instance, Device *out)
+		Driver const *driver, VkInstance instance, Device *out,
+		const std::vector<const char*> &extensions)
 {
     VkResult result;
 
@@ -71,8 +78,8 @@ VkResult Device::CreateComputeDevice(
             &deviceQueueCreateInfo,                // pQueueCreateInfos
             0,                                     // enabledLayerCount
             nullptr,                               // ppEnabledLayerNames
-            0,                                     // enabledExtensionCount
-            nullptr,                               // ppEnabledExtensionNames
+            (uint32_t)extensions.size(),           // enabledExtensionCount
+            extensions.data(),                     // ppEnabledExtensionNames
             nullptr,                               // pEnabledFeatures
         };
 
@@ -133,13 +140,20 @@ VkResult Device::GetPhysicalDevices(
 VkResult Device::CreateStorageBuffer(
 		VkDeviceMemory memory, VkDeviceSize size,
 		VkDeviceSize offset, VkBuffer* out) const
+{
+	return CreateBuffer(memory, size, offset, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, out);
+}
+
+VkResult Device::CreateBuffer(
+		VkDeviceMemory memory, VkDeviceSize size,
+		VkDeviceSize offset, VkBufferUsageFlags usage, VkBuffer* out) const
 {
 	const VkBufferCreateInfo info = {
 		VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, // sType
 		nullptr,                              // pNext
 		0,                                    // flags
 		size,                                 // size
-		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,   // usage
+		usage,                                // usage
 		VK_SHARING_MODE_EXCLUSIVE,            // sharingMode
 		0,                                    // queueFamilyIndexCount
 		nullptr,                              // pQueueFamilyIndices
@@ -162,6 +176,123 @@ VkResult Device::CreateStorageBuffer(
 	return VK_SUCCESS;
 }
 
+VkResult Device::CreateImage(
+		const VkImageCreateInfo& info, VkImage* out,
+		VkDeviceMemory* memory) const
+{
+	VkImage image;
+	VkResult result = driver->vkCreateImage(device, &info, 0, &image);
+	if (result != VK_SUCCESS)
+	{
+		return result;
+	}
+
+	VkMemoryRequirements requirements;
+	driver->vkGetImageMemoryRequirements(device, image, &requirements);
+
+	result = AllocateMemory(requirements.size, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, memory);
+	if (result != VK_SUCCESS)
+	{
+		return result;
+	}
+
+	result = driver->vkBindImageMemory(device, image, *memory, 0);
+	if (result != VK_SUCCESS)
+	{
+		return result;
+	}
+
+	*out = image;
+	return VK_SUCCESS;
+}
+
+VkResult Device::CreateImageView(
+		VkImage image, VkFormat format, VkImageView* out) const
+{
+	VkImageViewCreateInfo info = {
+		VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO, // sType
+		nullptr,                                  // pNext
+		0,                                        // flags
+		image,                                    // image
+		VK_IMAGE_VIEW_TYPE_2D,                    // viewType
+		format,                                   // format
+		{
+			// components
+			VK_COMPONENT_SWIZZLE_IDENTITY, // r
+			VK_COMPONENT_SWIZZLE_IDENTITY, // g
+			VK_COMPONENT_SWIZZLE_IDENTITY, // b
+			VK_COMPONENT_SWIZZLE_IDENTITY, // a
+		},
+		{
+			// subresourceRange
+			VK_IMAGE_ASPECT_COLOR_BIT, // aspectMask
+			0,                         // baseMipLevel
+			1,                         // levelCount
+			0,                         // baseArrayLayer
+			1,                         // layerCount
+		},
+	};
+
+	return driver->vkCreateImageView(device, &info, 0, out);
+}
+
+VkResult Device::CreateRenderPass(
+		const VkRenderPassCreateInfo& info, VkRenderPass* out) const
+{
+	return driver->vkCreateRenderPass(device, &info, 0, out);
+}
+
+VkResult Device::CreateFramebuffer(
+		VkRenderPass renderPass, const std::vector<VkImageView>& attachments,
+		uint32_t width, uint32_t height, VkFramebuffer* out) const
+{
+	VkFramebufferCreateInfo info = {
+		VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO, // sType
+		nullptr,                                   // pNext
+		0,                                         // flags
+		renderPass,                                // renderPass
+		(uint32_t)attachments.size(),              // attachmentCount
+		attachments.data(),                        // pAttachments
+		width,                                     // width
+		height,                                    // height
+		1,                                         // layers
+	};
+
+	return driver->vkCreateFramebuffer(device, &info, 0, out);
+}
+
+VkResult Device::CreateGraphicsPipeline(
+		const VkGraphicsPipelineCreateInfo& info, VkPipeline* out) const
+{
+	return driver->vkCreateGraphicsPipelines(device, 0, 1, &info, 0, out);
+}
+
+VkResult Device::CreateQueryPool(
+		VkQueryType type, uint32_t queryCount,
+		VkQueryPipelineStatisticFlags pipelineStatistics,
+		VkQueryPool* out) const
+{
+	VkQueryPoolCreateInfo info = {
+		VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO, // sType
+		nullptr,                                  // pNext
+		0,                                        // flags
+		type,                                     // queryType
+		queryCount,                               // queryCount
+		pipelineStatistics,                       // pipelineStatistics
+	};
+
+	return driver->vkCreateQueryPool(device, &info, 0, out);
+}
+
+VkResult Device::GetQueryPoolResults(
+		VkQueryPool queryPool, uint32_t firstQuery, uint32_t queryCount,
+		size_t dataSize, void* data, VkDeviceSize stride,
+		VkQueryResultFlags flags) const
+{
+	return driver->vkGetQueryPoolResults(device, queryPool, firstQuery, queryCount,
+	                                     dataSize, data, stride, flags);
+}
+
 VkResult Device::CreateShaderModule(
 		const std::vector<uint32_t>& spirv, VkShaderModule* out) const
 {
@@ -395,3 +526,144 @@ VkResult Device::QueueSubmitAndWait(VkCommandBuffer commandBuffer) const
 
     return driver->vkQueueWaitIdle(queue);
 }
+
+VkResult Device::QueueSubmit(VkCommandBuffer commandBuffer, VkFence fence) const
+{
+    VkQueue queue;
+    driver->vkGetDeviceQueue(device, queueFamilyIndex, 0, &queue);
+
+    VkSubmitInfo info = {
+        VK_STRUCTURE_TYPE_SUBMIT_INFO,  // sType
+        nullptr,                        // pNext
+        0,                              // waitSemaphoreCount
+        nullptr,                        // pWaitSemaphores
+        nullptr,                        // pWaitDstStageMask
+        1,                              // commandBufferCount
+        &commandBuffer,                 // pCommandBuffers
+        0,                              // signalSemaphoreCount
+        nullptr,                        // pSignalSemaphores
+    };
+
+    return driver->vkQueueSubmit(queue, 1, &info, fence);
+}
+
+VkResult Device::CreateFence(bool signaled, VkFence *out) const
+{
+    VkFenceCreateInfo info = {
+        VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,                 // sType
+        nullptr,                                             // pNext
+        signaled ? VK_FENCE_CREATE_SIGNALED_BIT : 0u,        // flags
+    };
+    return driver->vkCreateFence(device, &info, 0, out);
+}
+
+void Device::DestroyFence(VkFence fence) const
+{
+    driver->vkDestroyFence(device, fence, 0);
+}
+
+VkResult Device::GetFenceStatus(VkFence fence) const
+{
+    return driver->vkGetFenceStatus(device, fence);
+}
+
+VkResult Device::WaitForFences(const std::vector<VkFence> &fences, bool waitAll,
+		uint64_t timeout) const
+{
+    return driver->vkWaitForFences(device, static_cast<uint32_t>(fences.size()), fences.data(),
+                                   waitAll ? VK_TRUE : VK_FALSE, timeout);
+}
+
+VkResult Device::GetSurfaceCapabilities(VkSurfaceKHR surface,
+		VkSurfaceCapabilitiesKHR *out) const
+{
+	return driver->vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, surface, out);
+}
+
+VkResult Device::GetSurfaceFormats(VkSurfaceKHR surface,
+		std::vector<VkSurfaceFormatKHR> *out) const
+{
+	uint32_t count = 0;
+	VkResult result = driver->vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, surface, &count, nullptr);
+	if (result != VK_SUCCESS)
+	{
+		return result;
+	}
+
+	out->resize(count);
+	return driver->vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, surface, &count, out->data());
+}
+
+VkResult Device::CreateSwapchain(VkSurfaceKHR surface, uint32_t imageCount,
+		VkSurfaceFormatKHR format, VkExtent2D extent,
+		VkSwapchainKHR oldSwapchain, VkSwapchainKHR *out) const
+{
+	VkSwapchainCreateInfoKHR info = {
+		VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR, // sType
+		nullptr,                                     // pNext
+		0,                                           // flags
+		surface,                                     // surface
+		imageCount,                                  // minImageCount
+		format.format,                               // imageFormat
+		format.colorSpace,                           // imageColorSpace
+		extent,                                      // imageExtent
+		1,                                           // imageArrayLayers
+		VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+		VK_IMAGE_USAGE_TRANSFER_DST_BIT,             // imageUsage
+		VK_SHARING_MODE_EXCLUSIVE,                   // imageSharingMode
+		0,                                           // queueFamilyIndexCount
+		nullptr,                                     // pQueueFamilyIndices
+		VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR,       // preTransform
+		VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,           // compositeAlpha
+		VK_PRESENT_MODE_FIFO_KHR,                    // presentMode
+		VK_TRUE,                                     // clipped
+		oldSwapchain,                                // oldSwapchain
+	};
+
+	return driver->vkCreateSwapchainKHR(device, &info, 0, out);
+}
+
+void Device::DestroySwapchain(VkSwapchainKHR swapchain) const
+{
+	driver->vkDestroySwapchainKHR(device, swapchain, 0);
+}
+
+VkResult Device::GetSwapchainImages(VkSwapchainKHR swapchain,
+		std::vector<VkImage> *out) const
+{
+	uint32_t count = 0;
+	VkResult result = driver->vkGetSwapchainImagesKHR(device, swapchain, &count, nullptr);
+	if (result != VK_SUCCESS)
+	{
+		return result;
+	}
+
+	out->resize(count);
+	return driver->vkGetSwapchainImagesKHR(device, swapchain, &count, out->data());
+}
+
+VkResult Device::AcquireNextImage(VkSwapchainKHR swapchain, VkFence fence,
+		uint32_t *imageIndex) const
+{
+	return driver->vkAcquireNextImageKHR(device, swapchain, UINT64_MAX, VK_NULL_HANDLE, fence, imageIndex);
+}
+
+VkResult Device::QueuePresent(VkSwapchainKHR swapchain, uint32_t imageIndex,
+		VkResult *result) const
+{
+	VkQueue queue;
+	driver->vkGetDeviceQueue(device, queueFamilyIndex, 0, &queue);
+
+	VkPresentInfoKHR info = {
+		VK_STRUCTURE_TYPE_PRESENT_INFO_KHR, // sType
+		nullptr,                            // pNext
+		0,                                  // waitSemaphoreCount
+		nullptr,                            // pWaitSemaphores
+		1,                                  // swapchainCount
+		&swapchain,                         // pSwapchains
+		&imageIndex,                        // pImageIndices
+		result,                             // pResults
+	};
+
+	return driver->vkQueuePresentKHR(queue, &info);
+}
@@ -32,18 +32,67 @@ public:
 	// If a compatible physical device is not found, VK_SUCCESS will still be
 	// returned (as there was no Vulkan error), but calling Device::IsValid()
 	// on this device will return false.
+	// The device extensions named in extensions are enabled.
 	static VkResult CreateComputeDevice(
-			Driver const *driver, VkInstance instance, Device *out);
+			Driver const *driver, VkInstance instance, Device *out,
+			const std::vector<const char*> &extensions = {});
 
 	// IsValid returns true if the Device is initialized and can be used.
 	bool IsValid() const;
 
+	// Destroy destroys the device, once all its queues are idle. The Device
+	// is no longer valid afterwards.
+	void Destroy();
+
 	// CreateBuffer creates a new buffer with the
 	// VK_BUFFER_USAGE_STORAGE_BUFFER_BIT usage, and
 	// VK_SHARING_MODE_EXCLUSIVE sharing mode.
 	VkResult CreateStorageBuffer(VkDeviceMemory memory, VkDeviceSize size,
 			VkDeviceSize offset, VkBuffer *out) const;
 
+	// CreateBuffer creates a new buffer with the given usage, and
+	// VK_SHARING_MODE_EXCLUSIVE sharing mode.
+	VkResult CreateBuffer(VkDeviceMemory memory, VkDeviceSize size,
+			VkDeviceSize offset, VkBufferUsageFlags usage, VkBuffer *out) const;
+
+	// CreateImage creates a new image, and binds it to newly allocated device
+	// memory, which is assigned to memory.
+	VkResult CreateImage(const VkImageCreateInfo &info, VkImage *out,
+			VkDeviceMemory *memory) const;
+
+	// CreateImageView creates a new 2D view of the first mip level and array
+	// layer of a color image.
+	VkResult CreateImageView(VkImage image, VkFormat format,
+			VkImageView *out) const;
+
+	// CreateRenderPass wraps vkCreateRenderPass, supplying the first VkDevice
+	// parameter.
+	VkResult CreateRenderPass(const VkRenderPassCreateInfo &info,
+			VkRenderPass *out) const;
+
+	// CreateFramebuffer creates a new single layer framebuffer with the given
+	// attachments.
+	VkResult CreateFramebuffer(VkRenderPass renderPass,
+			const std::vector<VkImageView> &attachments,
+			uint32_t width, uint32_t height, VkFramebuffer *out) const;
+
+	// CreateGraphicsPipeline creates a new graphics pipeline, without a
+	// pipeline cache.
+	VkResult CreateGraphicsPipeline(const VkGraphicsPipelineCreateInfo &info,
+			VkPipeline *out) const;
+
+	// CreateQueryPool creates a new pool of queryCount queries of the given
+	// type. pipelineStatistics is only used by pipeline statistics queries.
+	VkResult CreateQueryPool(VkQueryType type, uint32_t queryCount,
+			VkQueryPipelineStatisticFlags pipelineStatistics,
+			VkQueryPool *out) const;
+
+	// GetQueryPoolResults wraps vkGetQueryPoolResults, supplying the first
+	// VkDevice parameter.
+	VkResult GetQueryPoolResults(VkQueryPool queryPool, uint32_t firstQuery,
+			uint32_t queryCount, size_t dataSize, void *data,
+			VkDeviceSize stride, VkQueryResultFlags flags) const;
+
 	// CreateShaderModule creates a new shader module with the given SPIR-V
 	// code.
 	VkResult CreateShaderModule(const std::vector<uint32_t> &spirv,
@@ -107,6 +156,61 @@ public:
 	// complete.
 	VkResult QueueSubmitAndWait(VkCommandBuffer commandBuffer) const;
 
+	// QueueSubmit submits the given command buffer, signaling fence once it
+	// completes. fence may be VK_NULL_HANDLE.
+	VkResult QueueSubmit(VkCommandBuffer commandBuffer, VkFence fence) const;
+
+	// CreateFence creates a new fence, which is initially signaled if
+	// signaled is true.
+	VkResult CreateFence(bool signaled, VkFence *out) const;
+
+	// DestroyFence wraps vkDestroyFence, supplying the first VkDevice
+	// parameter.
+	void DestroyFence(VkFence fence) const;
+
+	// GetFenceStatus wraps vkGetFenceStatus, supplying the first VkDevice
+	// parameter.
+	VkResult GetFenceStatus(VkFence fence) const;
+
+	// WaitForFences wraps vkWaitForFences, supplying the first VkDevice
+	// parameter.
+	VkResult WaitForFences(const std::vector<VkFence> &fences, bool waitAll,
+			uint64_t timeout) const;
+
+	// GetSurfaceCapabilities wraps vkGetPhysicalDeviceSurfaceCapabilitiesKHR,
+	// supplying the first VkPhysicalDevice parameter.
+	VkResult GetSurfaceCapabilities(VkSurfaceKHR surface,
+			VkSurfaceCapabilitiesKHR *out) const;
+
+	// GetSurfaceFormats returns all the formats supported by the surface.
+	VkResult GetSurfaceFormats(VkSurfaceKHR surface,
+			std::vector<VkSurfaceFormatKHR> *out) const;
+
+	// CreateSwapchain creates a new FIFO swapchain of imageCount color images
+	// of the given format and extent, presenting to surface. oldSwapchain, if
+	// not VK_NULL_HANDLE, gets retired.
+	VkResult CreateSwapchain(VkSurfaceKHR surface, uint32_t imageCount,
+			VkSurfaceFormatKHR format, VkExtent2D extent,
+			VkSwapchainKHR oldSwapchain, VkSwapchainKHR *out) const;
+
+	// DestroySwapchain wraps vkDestroySwapchainKHR, supplying the first
+	// VkDevice parameter.
+	void DestroySwapchain(VkSwapchainKHR swapchain) const;
+
+	// GetSwapchainImages returns all the images of the swapchain.
+	VkResult GetSwapchainImages(VkSwapchainKHR swapchain,
+			std::vector<VkImage> *out) const;
+
+	// AcquireNextImage wraps vkAcquireNextImageKHR, supplying the first
+	// VkDevice parameter, and waiting without a timeout.
+	VkResult AcquireNextImage(VkSwapchainKHR swapchain, VkFence fence,
+			uint32_t *imageIndex) const;
+
+	// QueuePresent presents the image at imageIndex of the swapchain. The
+	// result of the presentation on that swapchain is assigned to result.
+	VkResult QueuePresent(VkSwapchainKHR swapchain, uint32_t imageIndex,
+			VkResult *result) const;
+
 private:
 	Device(Driver const *driver, VkDevice device, VkPhysicalDevice physicalDevice, uint32_t queueFamilyIndex);
 
@@ -17,16 +17,36 @@
 // TODO: Generate this list.
 
 // VK_INSTANCE(<function name>, <return type>, <arguments>...)
+VK_INSTANCE(vkAcquireNextImageKHR, VkResult, VkDevice, VkSwapchainKHR, uint64_t, VkSemaphore, VkFence, uint32_t*);
 VK_INSTANCE(vkAllocateCommandBuffers, VkResult, VkDevice, const VkCommandBufferAllocateInfo*, VkCommandBuffer*);
 VK_INSTANCE(vkAllocateDescriptorSets, VkResult, VkDevice, const VkDescriptorSetAllocateInfo*, VkDescriptorSet*);
 VK_INSTANCE(vkAllocateMemory, VkResult, VkDevice, const VkMemoryAllocateInfo*, const VkAllocationCallbacks*,
             VkDeviceMemory*);
 VK_INSTANCE(vkBeginCommandBuffer, VkResult, VkCommandBuffer, const VkCommandBufferBeginInfo*);
 VK_INSTANCE(vkBindBufferMemory, VkResult, VkDevice, VkBuffer, VkDeviceMemory, VkDeviceSize);
+VK_INSTANCE(vkBindImageMemory, VkResult, VkDevice, VkImage, VkDeviceMemory, VkDeviceSize);
+VK_INSTANCE(vkCmdBeginQuery, void, VkCommandBuffer, VkQueryPool, uint32_t, VkQueryControlFlags);
+VK_INSTANCE(vkCmdBeginRenderPass, void, VkCommandBuffer, const VkRenderPassBeginInfo*, VkSubpassContents);
 VK_INSTANCE(vkCmdBindDescriptorSets, void, VkCommandBuffer, VkPipelineBindPoint, VkPipelineLayout, uint32_t, uint32_t,
             const VkDescriptorSet*, uint32_t, const uint32_t*);
+VK_INSTANCE(vkCmdBindIndexBuffer, void, VkCommandBuffer, VkBuffer, VkDeviceSize, VkIndexType);
 VK_INSTANCE(vkCmdBindPipeline, void, VkCommandBuffer, VkPipelineBindPoint, VkPipeline);
+VK_INSTANCE(vkCmdBindVertexBuffers, void, VkCommandBuffer, uint32_t, uint32_t, const VkBuffer*, const VkDeviceSize*);
+VK_INSTANCE(vkCmdClearColorImage, void, VkCommandBuffer, VkImage, VkImageLayout, const VkClearColorValue*, uint32_t,
+            const VkImageSubresourceRange*);
+VK_INSTANCE(vkCmdCopyImageToBuffer, void, VkCommandBuffer, VkImage, VkImageLayout, VkBuffer, uint32_t,
+            const VkBufferImageCopy*);
 VK_INSTANCE(vkCmdDispatch, void, VkCommandBuffer, uint32_t, uint32_t, uint32_t);
+VK_INSTANCE(vkCmdDraw, void, VkCommandBuffer, uint32_t, uint32_t, uint32_t, uint32_t);
+VK_INSTANCE(vkCmdDrawIndexed, void, VkCommandBuffer, uint32_t, uint32_t, uint32_t, int32_t, uint32_t);
+VK_INSTANCE(vkCmdDrawIndexedIndirect, void, VkCommandBuffer, VkBuffer, VkDeviceSize, uint32_t, uint32_t);
+VK_INSTANCE(vkCmdDrawIndirect, void, VkCommandBuffer, VkBuffer, VkDeviceSize, uint32_t, uint32_t);
+VK_INSTANCE(vkCmdEndQuery, void, VkCommandBuffer, VkQueryPool, uint32_t);
+VK_INSTANCE(vkCmdEndRenderPass, void, VkCommandBuffer);
+VK_INSTANCE(vkCmdPipelineBarrier, void, VkCommandBuffer, VkPipelineStageFlags, VkPipelineStageFlags, VkDependencyFlags,
+            uint32_t, const VkMemoryBarrier*, uint32_t, const VkBufferMemoryBarrier*, uint32_t,
+            const VkImageMemoryBarrier*);
+VK_INSTANCE(vkCmdResetQueryPool, void, VkCommandBuffer, VkQueryPool, uint32_t, uint32_t);
 VK_INSTANCE(vkCreateBuffer, VkResult, VkDevice, const VkBufferCreateInfo*, const VkAllocationCallbacks*, VkBuffer*);
 VK_INSTANCE(vkCreateCommandPool, VkResult, VkDevice, const VkCommandPoolCreateInfo*, const VkAllocationCallbacks*,
             VkCommandPool*);
@@ -38,19 +58,53 @@ VK_INSTANCE(vkCreateDescriptorSetLayout, VkResult, VkDevice, const VkDescriptorS
             const VkAllocationCallbacks*, VkDescriptorSetLayout*);
 VK_INSTANCE(vkCreateDevice, VkResult, VkPhysicalDevice, const VkDeviceCreateInfo*, const VkAllocationCallbacks*,
             VkDevice*);
+VK_INSTANCE(vkCreateFence, VkResult, VkDevice, const VkFenceCreateInfo*, const VkAllocationCallbacks*, VkFence*);
+VK_INSTANCE(vkCreateFramebuffer, VkResult, VkDevice, const VkFramebufferCreateInfo*, const VkAllocationCallbacks*,
+            VkFramebuffer*);
+VK_INSTANCE(vkCreateGraphicsPipelines, VkResult, VkDevice, VkPipelineCache, uint32_t,
+            const VkGraphicsPipelineCreateInfo*, const VkAllocationCallbacks*, VkPipeline*);
+VK_INSTANCE(vkCreateHeadlessSurfaceEXT, VkResult, VkInstance, const VkHeadlessSurfaceCreateInfoEXT*,
+            const VkAllocationCallbacks*, VkSurfaceKHR*);
+VK_INSTANCE(vkCreateImage, VkResult, VkDevice, const VkImageCreateInfo*, const VkAllocationCallbacks*, VkImage*);
+VK_INSTANCE(vkCreateImageView, VkResult, VkDevice, const VkImageViewCreateInfo*, const VkAllocationCallbacks*,
+            VkImageView*);
 VK_INSTANCE(vkCreatePipelineLayout, VkResult, VkDevice, const VkPipelineLayoutCreateInfo*, const VkAllocationCallbacks*,
             VkPipelineLayout*);
+VK_INSTANCE(vkCreateQueryPool, VkResult, VkDevice, const VkQueryPoolCreateInfo*, const VkAllocationCallbacks*,
+            VkQueryPool*);
+VK_INSTANCE(vkCreateRenderPass, VkResult, VkDevice, const VkRenderPassCreateInfo*, const VkAllocationCallbacks*,
+            VkRenderPass*);
 VK_INSTANCE(vkCreateShaderModule, VkResult, VkDevice, const VkShaderModuleCreateInfo*, const VkAllocationCallbacks*,
             VkShaderModule*);
+VK_INSTANCE(vkCreateSwapchainKHR, VkResult, VkDevice, const VkSwapchainCreateInfoKHR*, const VkAllocationCallbacks*,
+            VkSwapchainKHR*);
+VK_INSTANCE(vkDestroyDevice, void, VkDevice, const VkAllocationCallbacks*);
+VK_INSTANCE(vkDestroyFence, void, VkDevice, VkFence, const VkAllocationCallbacks*);
+VK_INSTANCE(vkDestroyInstance, void, VkInstance, const VkAllocationCallbacks*);
+VK_INSTANCE(vkDestroySurfaceKHR, void, VkInstance, VkSurfaceKHR, const VkAllocationCallbacks*);
+VK_INSTANCE(vkDestroySwapchainKHR, void, VkDevice, VkSwapchainKHR, const VkAllocationCallbacks*);
 VK_INSTANCE(vkEndCommandBuffer, VkResult, VkCommandBuffer);
 VK_INSTANCE(vkEnumeratePhysicalDevices, VkResult, VkInstance, uint32_t*, VkPhysicalDevice*)
 VK_INSTANCE(vkGetDeviceQueue, void, VkDevice, uint32_t, uint32_t, VkQueue*);
+VK_INSTANCE(vkGetFenceStatus, VkResult, VkDevice, VkFence);
+VK_INSTANCE(vkGetImageMemoryRequirements, void, VkDevice, VkImage, VkMemoryRequirements*);
+VK_INSTANCE(vkGetPhysicalDeviceImageFormatProperties, VkResult, VkPhysicalDevice, VkFormat, VkImageType, VkImageTiling,
+            VkImageUsageFlags, VkImageCreateFlags, VkImageFormatProperties*);
 VK_INSTANCE(vkGetPhysicalDeviceMemoryProperties, void, VkPhysicalDevice, VkPhysicalDeviceMemoryProperties*);
 VK_INSTANCE(vkGetPhysicalDeviceProperties, void, VkPhysicalDevice, VkPhysicalDeviceProperties*)
 VK_INSTANCE(vkGetPhysicalDeviceQueueFamilyProperties, void, VkPhysicalDevice, uint32_t*, VkQueueFamilyProperties*);
+VK_INSTANCE(vkGetPhysicalDeviceSurfaceCapabilitiesKHR, VkResult, VkPhysicalDevice, VkSurfaceKHR,
+            VkSurfaceCapabilitiesKHR*);
+VK_INSTANCE(vkGetPhysicalDeviceSurfaceFormatsKHR, VkResult, VkPhysicalDevice, VkSurfaceKHR, uint32_t*,
+            VkSurfaceFormatKHR*);
+VK_INSTANCE(vkGetQueryPoolResults, VkResult, VkDevice, VkQueryPool, uint32_t, uint32_t, size_t, void*, VkDeviceSize,
+            VkQueryResultFlags);
+VK_INSTANCE(vkGetSwapchainImagesKHR, VkResult, VkDevice, VkSwapchainKHR, uint32_t*, VkImage*);
 VK_INSTANCE(vkMapMemory, VkResult, VkDevice, VkDeviceMemory, VkDeviceSize, VkDeviceSize, VkMemoryMapFlags, void**);
+VK_INSTANCE(vkQueuePresentKHR, VkResult, VkQueue, const VkPresentInfoKHR*);
 VK_INSTANCE(vkUnmapMemory, void, VkDevice, VkDeviceMemory);
 VK_INSTANCE(vkUpdateDescriptorSets, void, VkDevice, uint32_t, const VkWriteDescriptorSet*, uint32_t,
             const VkCopyDescriptorSet*);
 VK_INSTANCE(vkQueueSubmit, VkResult, VkQueue, uint32_t, const VkSubmitInfo*, VkFence);
-VK_INSTANCE(vkQueueWaitIdle, VkResult, VkQueue);
\ No newline at end of file
+VK_INSTANCE(vkQueueWaitIdle, VkResult, VkQueue);
+VK_INSTANCE(vkWaitForFences, VkResult, VkDevice, uint32_t, const VkFence*, VkBool32, uint64_t);
@@ -26,6 +26,12 @@
 #include <sstream>
 #include <cstring>
 
+#if defined(__linux__)
+#include <X11/Xlib.h>
+#include <vulkan/vulkan_xlib.h>
+#include <dlfcn.h>
+#endif
+
 class SwiftShaderVulkanTest : public testing::Test
 {
 };
@@ -97,6 +103,60 @@ TEST_F(SwiftShaderVulkanTest, Version)
     EXPECT_EQ(strncmp(physicalDeviceProperties.deviceName, "SwiftShader Device", VK_MAX_PHYSICAL_DEVICE_NAME_SIZE), 0);
 }
 
+TEST_F(SwiftShaderVulkanTest, ImageSampleCounts)
+{
+    Driver driver;
+    ASSERT_TRUE(driver.loadSwiftShader());
+
+    const VkInstanceCreateInfo createInfo = {
+        VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,  // sType
+        nullptr,                                 // pNext
+        0,                                       // flags
+        nullptr,                                 // pApplicationInfo
+        0,                                       // enabledLayerCount
+        nullptr,                                 // ppEnabledLayerNames
+        0,                                       // enabledExtensionCount
+        nullptr,                                 // ppEnabledExtensionNames
+    };
+    VkInstance instance = VK_NULL_HANDLE;
+    ASSERT_EQ(driver.vkCreateInstance(&createInfo, nullptr, &instance), VK_SUCCESS);
+
+    ASSERT_TRUE(driver.resolve(instance));
+
+    uint32_t physicalDeviceCount = 1;
+    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    ASSERT_EQ(driver.vkEnumeratePhysicalDevices(instance, &physicalDeviceCount, &physicalDevice), VK_SUCCESS);
+
+    struct Case
+    {
+        VkFormat format;
+        VkImageType type;
+        VkImageTiling tiling;
+        VkImageUsageFlags usage;
+        VkImageCreateFlags flags;
+        VkSampleCountFlags expected;
+    };
+
+    const VkSampleCountFlags multisample = VK_SAMPLE_COUNT_1_BIT | VK_SAMPLE_COUNT_4_BIT;
+    const Case cases[] = {
+        { VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TYPE_2D, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, 0, multisample },
+        { VK_FORMAT_D32_SFLOAT, VK_IMAGE_TYPE_2D, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, 0, multisample },
+        { VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TYPE_1D, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, 0, VK_SAMPLE_COUNT_1_BIT },
+        { VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TYPE_3D, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, 0, VK_SAMPLE_COUNT_1_BIT },
+        { VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TYPE_2D, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT, VK_SAMPLE_COUNT_1_BIT },
+        { VK_FORMAT_R8G8B8A8_UINT, VK_IMAGE_TYPE_2D, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, 0, VK_SAMPLE_COUNT_1_BIT },
+    };
+
+    for(const Case& c : cases)
+    {
+        VkImageFormatProperties properties = {};
+        EXPECT_EQ(driver.vkGetPhysicalDeviceImageFormatProperties(physicalDevice, c.format, c.type, c.tiling, c.usage, c.flags, &properties), VK_SUCCESS);
+        EXPECT_EQ(properties.sampleCounts, c.expected) << "format " << c.format << ", type " << c.type << ", tiling " << c.tiling;
+    }
+
+    driver.vkDestroyInstance(instance, nullptr);
+}
+
 std::vector<uint32_t> compileSpirv(const char* assembly)
 {
     spvtools::SpirvTools core(SPV_ENV_VULKAN_1_0);
@@ -341,6 +401,11 @@ void SwiftShaderVulkanBufferToBufferComputeTest::test(
 
     device.UnmapMemory(memory);
     buffers = nullptr;
+
+    // The driver gets unloaded when the test completes, so its threads must
+    // have exited by then.
+    device.Destroy();
+    driver.vkDestroyInstance(instance, nullptr);
 }
 
 INSTANTIATE_TEST_CASE_P(ComputeParams, SwiftShaderVulkanBufferToBufferComputeTest, testing::Values(
@@ -581,4 +646,1387 @@ TEST_P(SwiftShaderVulkanBufferToBufferComputeTest, BranchDeclareSSA)
               "OpFunctionEnd\n";
 
     test(src.str(), [](uint32_t i) { return i; }, [](uint32_t i) { return i * 2; });
-}
\ No newline at end of file
+}
+
+// Base class for tests which need a device, but build their own pipelines.
+class SwiftShaderVulkanDeviceTest : public testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        ASSERT_TRUE(driver.loadSwiftShader());
+
+        const VkInstanceCreateInfo createInfo = {
+            VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,  // sType
+            nullptr,                                 // pNext
+            0,                                       // flags
+            nullptr,                                 // pApplicationInfo
+            0,                                       // enabledLayerCount
+            nullptr,                                 // ppEnabledLayerNames
+            0,                                       // enabledExtensionCount
+            nullptr,                                 // ppEnabledExtensionNames
+        };
+
+        VK_ASSERT(driver.vkCreateInstance(&createInfo, nullptr, &instance));
+
+        ASSERT_TRUE(driver.resolve(instance));
+
+        VK_ASSERT(Device::CreateComputeDevice(&driver, instance, &device));
+        ASSERT_TRUE(device.IsValid());
+    }
+
+    // The driver gets unloaded when the test completes, so its threads must
+    // have exited by then.
+    void TearDown() override
+    {
+        if(device.IsValid())
+        {
+            device.Destroy();
+        }
+
+        if(instance != VK_NULL_HANDLE)
+        {
+            driver.vkDestroyInstance(instance, nullptr);
+        }
+    }
+
+    // Records and submits an empty command buffer, which signals fence.
+    void submitEmpty(VkFence fence)
+    {
+        VkCommandPool commandPool;
+        VK_ASSERT(device.CreateCommandPool(&commandPool));
+
+        VkCommandBuffer commandBuffer;
+        VK_ASSERT(device.AllocateCommandBuffer(commandPool, &commandBuffer));
+
+        VK_ASSERT(device.BeginCommandBuffer(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, commandBuffer));
+        VK_ASSERT(driver.vkEndCommandBuffer(commandBuffer));
+
+        VK_ASSERT(device.QueueSubmit(commandBuffer, fence));
+    }
+
+    Driver driver;
+    VkInstance instance = VK_NULL_HANDLE;
+    Device device;
+};
+
+TEST_F(SwiftShaderVulkanDeviceTest, WaitForAnyFence)
+{
+    static constexpr uint64_t oneMillisecond = 1000000;
+
+    VkFence unsignaled;
+    VK_ASSERT(device.CreateFence(false, &unsignaled));
+
+    VkFence signaled;
+    VK_ASSERT(device.CreateFence(true, &signaled));
+
+    VkFence submitted;
+    VK_ASSERT(device.CreateFence(false, &submitted));
+
+    EXPECT_EQ(device.WaitForFences({ unsignaled, submitted }, false, oneMillisecond), VK_TIMEOUT);
+    EXPECT_EQ(device.WaitForFences({ unsignaled, signaled }, false, 0), VK_SUCCESS);
+    EXPECT_EQ(device.WaitForFences({ unsignaled, signaled }, true, 0), VK_TIMEOUT);
+
+    // The queue thread signals the fence while this thread is blocked on it.
+    submitEmpty(submitted);
+
+    EXPECT_EQ(device.WaitForFences({ unsignaled, submitted }, false, UINT64_MAX), VK_SUCCESS);
+    EXPECT_EQ(device.GetFenceStatus(submitted), VK_SUCCESS);
+    EXPECT_EQ(device.GetFenceStatus(unsignaled), VK_NOT_READY);
+
+    device.DestroyFence(unsignaled);
+    device.DestroyFence(signaled);
+    device.DestroyFence(submitted);
+}
+
+// Base class for tests which draw to a color attachment, and read it back.
+// Vertex buffers hold vec4 positions, which are bound to location 0.
+class SwiftShaderVulkanGraphicsTest : public SwiftShaderVulkanDeviceTest
+{
+protected:
+    static constexpr uint32_t width = 16;
+    static constexpr uint32_t height = 16;
+    static constexpr VkFormat colorFormat = VK_FORMAT_R8G8B8A8_UNORM;
+
+    void SetUp() override
+    {
+        SwiftShaderVulkanDeviceTest::SetUp();
+        ASSERT_FALSE(HasFatalFailure());
+
+        createImage(VK_SAMPLE_COUNT_1_BIT, &colorImage);
+        VK_ASSERT(device.CreateImageView(colorImage, colorFormat, &colorView));
+
+        createRenderPass(VK_SAMPLE_COUNT_1_BIT, false, &renderPass);
+        VK_ASSERT(device.CreateFramebuffer(renderPass, { colorView }, width, height, &framebuffer));
+
+        VkDescriptorSetLayout descriptorSetLayout;
+        VK_ASSERT(device.CreateDescriptorSetLayout({}, &descriptorSetLayout));
+        VK_ASSERT(device.CreatePipelineLayout(descriptorSetLayout, &pipelineLayout));
+
+        VK_ASSERT(device.AllocateMemory(width * height * 4,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                &readbackMemory));
+        VK_ASSERT(device.CreateBuffer(readbackMemory, width * height * 4, 0,
+                VK_BUFFER_USAGE_TRANSFER_DST_BIT, &readbackBuffer));
+
+        VK_ASSERT(device.CreateCommandPool(&commandPool));
+    }
+
+    // Creates a color image of the test's size, which can be rendered to,
+    // sampled, cleared and copied from.
+    void createImage(VkSampleCountFlagBits samples, VkImage *out)
+    {
+        const VkImageCreateInfo info = {
+            VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,  // sType
+            nullptr,                              // pNext
+            0,                                    // flags
+            VK_IMAGE_TYPE_2D,                     // imageType
+            colorFormat,                          // format
+            { width, height, 1 },                 // extent
+            1,                                    // mipLevels
+            1,                                    // arrayLayers
+            samples,                              // samples
+            VK_IMAGE_TILING_OPTIMAL,              // tiling
+            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+            VK_IMAGE_USAGE_SAMPLED_BIT |
+            VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+            VK_IMAGE_USAGE_TRANSFER_DST_BIT,      // usage
+            VK_SHARING_MODE_EXCLUSIVE,            // sharingMode
+            0,                                    // queueFamilyIndexCount
+            nullptr,                              // pQueueFamilyIndices
+            VK_IMAGE_LAYOUT_UNDEFINED,            // initialLayout
+        };
+
+        VkDeviceMemory memory;
+        VK_ASSERT(device.CreateImage(info, out, &memory));
+    }
+
+    // Creates a render pass with one color attachment, which is cleared, and
+    // left in the transfer source layout. With resolve, the color attachment
+    // is resolved to a single sample second attachment, which is loaded from
+    // the color attachment layout.
+    void createRenderPass(VkSampleCountFlagBits samples, bool resolve, VkRenderPass *out)
+    {
+        const VkAttachmentDescription attachments[2] = {
+            {
+                0,                                     // flags
+                colorFormat,                           // format
+                samples,                               // samples
+                VK_ATTACHMENT_LOAD_OP_CLEAR,           // loadOp
+                VK_ATTACHMENT_STORE_OP_STORE,          // storeOp
+                VK_ATTACHMENT_LOAD_OP_DONT_CARE,       // stencilLoadOp
+                VK_ATTACHMENT_STORE_OP_DONT_CARE,      // stencilStoreOp
+                VK_IMAGE_LAYOUT_UNDEFINED,             // initialLayout
+                VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,  // finalLayout
+            },
+            {
+                0,                                     // flags
+                colorFormat,                           // format
+                VK_SAMPLE_COUNT_1_BIT,                     // samples
+                VK_ATTACHMENT_LOAD_OP_LOAD,                // loadOp
+                VK_ATTACHMENT_STORE_OP_STORE,              // storeOp
+                VK_ATTACHMENT_LOAD_OP_DONT_CARE,           // stencilLoadOp
+                VK_ATTACHMENT_STORE_OP_DONT_CARE,          // stencilStoreOp
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,  // initialLayout
+                VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,  // finalLayout
+            },
+        };
+
+        const VkAttachmentReference colorReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+        const VkAttachmentReference resolveReference = { 1, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+
+        const VkSubpassDescription subpass = {
+            0,                                            // flags
+            VK_PIPELINE_BIND_POINT_GRAPHICS,              // pipelineBindPoint
+            0,                                            // inputAttachmentCount
+            nullptr,                                      // pInputAttachments
+            1,                                            // colorAttachmentCount
+            &colorReference,                              // pColorAttachments
+            resolve ? &resolveReference : nullptr,        // pResolveAttachments
+            nullptr,                                      // pDepthStencilAttachment
+            0,                                            // preserveAttachmentCount
+            nullptr,                                      // pPreserveAttachments
+        };
+
+        const VkRenderPassCreateInfo info = {
+            VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,  // sType
+            nullptr,                                    // pNext
+            0,                                          // flags
+            resolve ? 2u : 1u,                          // attachmentCount
+            attachments,                                // pAttachments
+            1,                                          // subpassCount
+            &subpass,                                   // pSubpasses
+            0,                                          // dependencyCount
+            nullptr,                                    // pDependencies
+        };
+
+        VK_ASSERT(device.CreateRenderPass(info, out));
+    }
+
+    // Creates a pipeline for the main render pass, or for pass when given.
+    // With accumulate, fragments add a quarter of their color to the color
+    // attachment, so that pixels which are drawn more than once stand out.
+    void createPipeline(const std::vector<uint32_t> &vertexShader,
+                        const std::vector<uint32_t> &fragmentShader,
+                        VkPrimitiveTopology topology, VkPipeline *out,
+                        VkRenderPass pass = VK_NULL_HANDLE,
+                        VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT,
+                        VkPipelineLayout layout = VK_NULL_HANDLE,
+                        bool accumulate = false)
+    {
+        VkShaderModule vertexModule;
+        VK_ASSERT(device.CreateShaderModule(vertexShader, &vertexModule));
+
+        VkShaderModule fragmentModule;
+        VK_ASSERT(device.CreateShaderModule(fragmentShader, &fragmentModule));
+
+        const VkPipelineShaderStageCreateInfo stages[2] = {
+            {
+                VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,  // sType
+                nullptr,                                              // pNext
+                0,                                                    // flags
+                VK_SHADER_STAGE_VERTEX_BIT,                           // stage
+                vertexModule,                                         // module
+                "main",                                               // pName
+                nullptr,                                              // pSpecializationInfo
+            },
+            {
+                VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,  // sType
+                nullptr,                                              // pNext
+                0,                                                    // flags
+                VK_SHADER_STAGE_FRAGMENT_BIT,                         // stage
+                fragmentModule,                                       // module
+                "main",                                               // pName
+                nullptr,                                              // pSpecializationInfo
+            },
+        };
+
+        const VkVertexInputBindingDescription binding = { 0, 16, VK_VERTEX_INPUT_RATE_VERTEX };
+        const VkVertexInputAttributeDescription attribute = { 0, 0, VK_FORMAT_R32G32B32A32_SFLOAT, 0 };
+
+        VkPipelineVertexInputStateCreateInfo vertexInputState = { VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO };
+        vertexInputState.vertexBindingDescriptionCount = 1;
+        vertexInputState.pVertexBindingDescriptions = &binding;
+        vertexInputState.vertexAttributeDescriptionCount = 1;
+        vertexInputState.pVertexAttributeDescriptions = &attribute;
+
+        VkPipelineInputAssemblyStateCreateInfo inputAssemblyState = { VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO };
+        inputAssemblyState.topology = topology;
+
+        const VkViewport viewport = { 0.0f, 0.0f, float(width), float(height), 0.0f, 1.0f };
+        const VkRect2D scissor = { { 0, 0 }, { width, height } };
+
+        VkPipelineViewportStateCreateInfo viewportState = { VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO };
+        viewportState.viewportCount = 1;
+        viewportState.pViewports = &viewport;
+        viewportState.scissorCount = 1;
+        viewportState.pScissors = &scissor;
+
+        VkPipelineRasterizationStateCreateInfo rasterizationState = { VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO };
+        rasterizationState.polygonMode = VK_POLYGON_MODE_FILL;
+        rasterizationState.cullMode = VK_CULL_MODE_NONE;
+        rasterizationState.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+        rasterizationState.lineWidth = 1.0f;
+
+        VkPipelineMultisampleStateCreateInfo multisampleState = { VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO };
+        multisampleState.rasterizationSamples = samples;
+
+        VkPipelineColorBlendAttachmentState blendAttachment = {};
+        blendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+                                         VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+        if(accumulate)
+        {
+            blendAttachment.blendEnable = VK_TRUE;
+            blendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_CONSTANT_COLOR;
+            blendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+            blendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+            blendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_CONSTANT_ALPHA;
+            blendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+            blendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+        }
+
+        VkPipelineColorBlendStateCreateInfo colorBlendState = { VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO };
+        colorBlendState.attachmentCount = 1;
+        colorBlendState.pAttachments = &blendAttachment;
+
+        for(float &constant : colorBlendState.blendConstants)
+        {
+            constant = 0.25f;
+        }
+
+        VkGraphicsPipelineCreateInfo info = { VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
+        info.stageCount = 2;
+        info.pStages = stages;
+        info.pVertexInputState = &vertexInputState;
+        info.pInputAssemblyState = &inputAssemblyState;
+        info.pViewportState = &viewportState;
+        info.pRasterizationState = &rasterizationState;
+        info.pMultisampleState = &multisampleState;
+        info.pColorBlendState = &colorBlendState;
+        info.layout = layout ? layout : pipelineLayout;
+        info.renderPass = pass ? pass : renderPass;
+
+        VK_ASSERT(device.CreateGraphicsPipeline(info, out));
+    }
+
+    // Creates a host visible buffer, initialized with size bytes of data.
+    void createBuffer(const void *data, size_t size, VkBufferUsageFlags usage, VkBuffer *out)
+    {
+        VkDeviceMemory memory;
+        VK_ASSERT(device.AllocateMemory(size,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                &memory));
+
+        void *mapped;
+        VK_ASSERT(device.MapMemory(memory, 0, size, 0, &mapped));
+        memcpy(mapped, data, size);
+        device.UnmapMemory(memory);
+
+        VK_ASSERT(device.CreateBuffer(memory, size, 0, usage, out));
+    }
+
+    void beginCommandBuffer(VkCommandBuffer *out)
+    {
+        VK_ASSERT(device.AllocateCommandBuffer(commandPool, out));
+        VK_ASSERT(device.BeginCommandBuffer(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, *out));
+    }
+
+    // Begins the main render pass, or pass when given, clearing its
+    // attachments to transparent black within the render area.
+    void beginRenderPass(VkCommandBuffer commandBuffer,
+                         VkRenderPass pass = VK_NULL_HANDLE,
+                         VkFramebuffer target = VK_NULL_HANDLE,
+                         VkRect2D renderArea = { { 0, 0 }, { width, height } })
+    {
+        const VkClearValue clearValues[2] = {};
+
+        const VkRenderPassBeginInfo info = {
+            VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,  // sType
+            nullptr,                                   // pNext
+            pass ? pass : renderPass,                  // renderPass
+            target ? target : framebuffer,             // framebuffer
+            renderArea,                                // renderArea
+            2,                                         // clearValueCount
+            clearValues,                               // pClearValues
+        };
+
+        driver.vkCmdBeginRenderPass(commandBuffer, &info, VK_SUBPASS_CONTENTS_INLINE);
+    }
+
+    // Copies image, in the transfer source layout, to the readback buffer.
+    void copyToReadback(VkCommandBuffer commandBuffer, VkImage image)
+    {
+        VkBufferImageCopy region = {};
+        region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+        region.imageExtent = { width, height, 1 };
+
+        driver.vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                      readbackBuffer, 1, &region);
+    }
+
+    // Records a barrier between the given accesses of a color image, which
+    // transitions it from oldLayout to newLayout.
+    void imageBarrier(VkCommandBuffer commandBuffer, VkImage image,
+                      VkImageLayout oldLayout, VkImageLayout newLayout,
+                      VkPipelineStageFlags srcStageMask, VkAccessFlags srcAccessMask,
+                      VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask)
+    {
+        const VkImageMemoryBarrier barrier = {
+            VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,     // sType
+            nullptr,                                    // pNext
+            srcAccessMask,                              // srcAccessMask
+            dstAccessMask,                              // dstAccessMask
+            oldLayout,                                  // oldLayout
+            newLayout,                                  // newLayout
+            VK_QUEUE_FAMILY_IGNORED,                    // srcQueueFamilyIndex
+            VK_QUEUE_FAMILY_IGNORED,                    // dstQueueFamilyIndex
+            image,                                      // image
+            { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 },  // subresourceRange
+        };
+
+        driver.vkCmdPipelineBarrier(commandBuffer, srcStageMask, dstStageMask, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    }
+
+    void submitAndWait(VkCommandBuffer commandBuffer)
+    {
+        VK_ASSERT(driver.vkEndCommandBuffer(commandBuffer));
+        VK_ASSERT(device.QueueSubmitAndWait(commandBuffer));
+    }
+
+    // Returns the readback buffer's pixel at (x, y), as packed R8G8B8A8.
+    uint32_t getPixel(uint32_t x, uint32_t y)
+    {
+        uint32_t *pixels;
+        EXPECT_EQ(device.MapMemory(readbackMemory, 0, width * height * 4, 0, (void**)&pixels), VK_SUCCESS);
+        uint32_t pixel = pixels[y * width + x];
+        device.UnmapMemory(readbackMemory);
+
+        return pixel;
+    }
+
+    VkImage colorImage = VK_NULL_HANDLE;
+    VkImageView colorView = VK_NULL_HANDLE;
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    VkFramebuffer framebuffer = VK_NULL_HANDLE;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    VkDeviceMemory readbackMemory = VK_NULL_HANDLE;
+    VkBuffer readbackBuffer = VK_NULL_HANDLE;
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+};
+
+// Passes the vec4 at location 0 through to the position.
+static const char *passthroughVertexShader =
+              "OpCapability Shader\n"
+              "OpMemoryModel Logical GLSL450\n"
+              "OpEntryPoint Vertex %1 \"main\" %2 %3\n"
+              "OpDecorate %2 Location 0\n"
+              "OpDecorate %3 BuiltIn Position\n"
+         "%4 = OpTypeVoid\n"
+         "%5 = OpTypeFunction %4\n"             // void()
+         "%6 = OpTypeFloat 32\n"                // float
+         "%7 = OpTypeVector %6 4\n"             // vec4
+         "%8 = OpTypePointer Input %7\n"        // vec4*
+         "%2 = OpVariable %8 Input\n"           // position in
+         "%9 = OpTypePointer Output %7\n"       // vec4*
+         "%3 = OpVariable %9 Output\n"          // gl_Position
+         "%1 = OpFunction %4 None %5\n"         // -- Function begin --
+        "%10 = OpLabel\n"
+        "%11 = OpLoad %7 %2\n"
+              "OpStore %3 %11\n"
+              "OpReturn\n"
+              "OpFunctionEnd\n";
+
+// Outputs opaque red, which reads back as 0xFF0000FF.
+static const char *redFragmentShader =
+              "OpCapability Shader\n"
+              "OpMemoryModel Logical GLSL450\n"
+              "OpEntryPoint Fragment %1 \"main\" %2\n"
+              "OpExecutionMode %1 OriginUpperLeft\n"
+              "OpDecorate %2 Location 0\n"
+         "%3 = OpTypeVoid\n"
+         "%4 = OpTypeFunction %3\n"             // void()
+         "%5 = OpTypeFloat 32\n"                // float
+         "%6 = OpTypeVector %5 4\n"             // vec4
+         "%7 = OpTypePointer Output %6\n"       // vec4*
+         "%2 = OpVariable %7 Output\n"          // color out
+         "%8 = OpConstant %5 0\n"               // 0.0
+         "%9 = OpConstant %5 1\n"               // 1.0
+        "%10 = OpConstantComposite %6 %9 %8 %8 %9\n"  // vec4(1, 0, 0, 1)
+         "%1 = OpFunction %3 None %4\n"         // -- Function begin --
+        "%11 = OpLabel\n"
+              "OpStore %2 %10\n"
+              "OpReturn\n"
+              "OpFunctionEnd\n";
+
+TEST_F(SwiftShaderVulkanGraphicsTest, OcclusionQueryAcrossPipelines)
+{
+    // Binding another pipeline loads its state into the renderer, which must
+    // leave the query active.
+    VkPipeline listPipeline;
+    createPipeline(compileSpirv(passthroughVertexShader), compileSpirv(redFragmentShader),
+                   VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, &listPipeline);
+
+    VkPipeline stripPipeline;
+    createPipeline(compileSpirv(passthroughVertexShader), compileSpirv(redFragmentShader),
+                   VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP, &stripPipeline);
+
+    const float vertices[][4] = {
+        // Left half, as a list
+        { -1, -1, 0, 1 }, { 0, -1, 0, 1 }, { -1, 1, 0, 1 },
+        { 0, -1, 0, 1 }, { 0, 1, 0, 1 }, { -1, 1, 0, 1 },
+        // Right half, as a strip
+        { 0, -1, 0, 1 }, { 1, -1, 0, 1 }, { 0, 1, 0, 1 }, { 1, 1, 0, 1 },
+    };
+
+    VkBuffer vertexBuffer;
+    createBuffer(vertices, sizeof(vertices), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, &vertexBuffer);
+
+    VkQueryPool queryPool;
+    VK_ASSERT(device.CreateQueryPool(VK_QUERY_TYPE_OCCLUSION, 1, 0, &queryPool));
+
+    VkCommandBuffer commandBuffer;
+    beginCommandBuffer(&commandBuffer);
+    driver.vkCmdResetQueryPool(commandBuffer, queryPool, 0, 1);
+    beginRenderPass(commandBuffer);
+
+    driver.vkCmdBeginQuery(commandBuffer, queryPool, 0, VK_QUERY_CONTROL_PRECISE_BIT);
+
+    VkDeviceSize offset = 0;
+    driver.vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &offset);
+    driver.vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, listPipeline);
+    driver.vkCmdDraw(commandBuffer, 6, 1, 0, 0);
+    driver.vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, stripPipeline);
+    driver.vkCmdDraw(commandBuffer, 4, 1, 6, 0);
+
+    driver.vkCmdEndQuery(commandBuffer, queryPool, 0);
+    driver.vkCmdEndRenderPass(commandBuffer);
+    submitAndWait(commandBuffer);
+
+    uint64_t samples = 0;
+    VK_ASSERT(device.GetQueryPoolResults(queryPool, 0, 1, sizeof(samples), &samples, sizeof(samples),
+                                         VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+
+    EXPECT_EQ(samples, width * height);
+}
+
+TEST_F(SwiftShaderVulkanGraphicsTest, PipelineStatisticsQuery)
+{
+    VkPipeline listPipeline;
+    createPipeline(compileSpirv(passthroughVertexShader), compileSpirv(redFragmentShader),
+                   VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, &listPipeline);
+
+    VkPipeline stripPipeline;
+    createPipeline(compileSpirv(passthroughVertexShader), compileSpirv(redFragmentShader),
+                   VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP, &stripPipeline);
+
+    const float vertices[][4] = {
+        { -1, -1, 0, 1 }, { 1, -1, 0, 1 }, { -1, 1, 0, 1 },
+        { 1, -1, 0, 1 }, { 1, 1, 0, 1 }, { -1, 1, 0, 1 },
+    };
+
+    VkBuffer vertexBuffer;
+    createBuffer(vertices, sizeof(vertices), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, &vertexBuffer);
+
+    const VkQueryPipelineStatisticFlags statistics =
+        VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT;
+
+    VkQueryPool queryPool;
+    VK_ASSERT(device.CreateQueryPool(VK_QUERY_TYPE_PIPELINE_STATISTICS, 2, statistics, &queryPool));
+
+    VkCommandBuffer commandBuffer;
+    beginCommandBuffer(&commandBuffer);
+    driver.vkCmdResetQueryPool(commandBuffer, queryPool, 0, 2);
+    beginRenderPass(commandBuffer);
+
+    VkDeviceSize offset = 0;
+    driver.vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &offset);
+
+    driver.vkCmdBeginQuery(commandBuffer, queryPool, 0, 0);
+    driver.vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, listPipeline);
+    driver.vkCmdDraw(commandBuffer, 6, 2, 0, 0);
+    driver.vkCmdEndQuery(commandBuffer, queryPool, 0);
+
+    driver.vkCmdBeginQuery(commandBuffer, queryPool, 1, 0);
+    driver.vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, stripPipeline);
+    driver.vkCmdDraw(commandBuffer, 5, 1, 0, 0);
+    driver.vkCmdEndQuery(commandBuffer, queryPool, 1);
+
+    driver.vkCmdEndRenderPass(commandBuffer);
+    submitAndWait(commandBuffer);
+
+    uint64_t results[2][3] = {};
+    VK_ASSERT(device.GetQueryPoolResults(queryPool, 0, 2, sizeof(results), results, sizeof(results[0]),
+                                         VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+
+    // Every vertex is shaded once per instance, even though the shader runs
+    // on several vertices at a time.
+    EXPECT_EQ(results[0][0], 12u);  // Input assembly vertices
+    EXPECT_EQ(results[0][1], 4u);   // Input assembly primitives
+    EXPECT_EQ(results[0][2], 12u);  // Vertex shader invocations
+
+    EXPECT_EQ(results[1][0], 5u);
+    EXPECT_EQ(results[1][1], 3u);
+    EXPECT_EQ(results[1][2], 5u);
+}
+
+// Each half of the target, as a triangle list.
+static const float halvesVertices[][4] = {
+    { -1, -1, 0, 1 }, { 0, -1, 0, 1 }, { -1, 1, 0, 1 },
+    { 0, -1, 0, 1 }, { 0, 1, 0, 1 }, { -1, 1, 0, 1 },
+    { 0, -1, 0, 1 }, { 1, -1, 0, 1 }, { 0, 1, 0, 1 },
+    { 1, -1, 0, 1 }, { 1, 1, 0, 1 }, { 0, 1, 0, 1 },
+};
+
+TEST_F(SwiftShaderVulkanGraphicsTest, DrawIndirect)
+{
+    VkPipeline pipeline;
+    createPipeline(compileSpirv(passthroughVertexShader), compileSpirv(redFragmentShader),
+                   VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, &pipeline);
+
+    VkBuffer vertexBuffer;
+    createBuffer(halvesVertices, sizeof(halvesVertices), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, &vertexBuffer);
+
+    // Sub-draws which don't continue each other, including an empty one
+    const VkDrawIndirectCommand commands[] = {
+        // vertexCount, instanceCount, firstVertex, firstInstance
+        { 6, 1, 0, 0 },
+        { 0, 1, 0, 0 },
+        { 3, 2, 6, 1 },
+        { 3, 1, 9, 0 },
+    };
+
+    VkBuffer indirectBuffer;
+    createBuffer(commands, sizeof(commands), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, &indirectBuffer);
+
+    VkQueryPool queryPool;
+    VK_ASSERT(device.CreateQueryPool(VK_QUERY_TYPE_PIPELINE_STATISTICS, 1,
+                                     VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT, &queryPool));
+
+    VkCommandBuffer commandBuffer;
+    beginCommandBuffer(&commandBuffer);
+    driver.vkCmdResetQueryPool(commandBuffer, queryPool, 0, 1);
+    beginRenderPass(commandBuffer);
+
+    VkDeviceSize offset = 0;
+    driver.vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &offset);
+    driver.vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+
+    driver.vkCmdBeginQuery(commandBuffer, queryPool, 0, 0);
+    driver.vkCmdDrawIndirect(commandBuffer, indirectBuffer, 0, 4, sizeof(VkDrawIndirectCommand));
+    driver.vkCmdEndQuery(commandBuffer, queryPool, 0);
+
+    driver.vkCmdEndRenderPass(commandBuffer);
+    copyToReadback(commandBuffer, colorImage);
+    submitAndWait(commandBuffer);
+
+    uint64_t primitives = 0;
+    VK_ASSERT(device.GetQueryPoolResults(queryPool, 0, 1, sizeof(primitives), &primitives, sizeof(primitives),
+                                         VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+    EXPECT_EQ(primitives, 5u);
+
+    for(uint32_t y = 0; y < height; y++)
+    {
+        for(uint32_t x = 0; x < width; x++)
+        {
+            ASSERT_EQ(getPixel(x, y), 0xFF0000FFu) << "at " << x << ", " << y;
+        }
+    }
+}
+
+TEST_F(SwiftShaderVulkanGraphicsTest, DrawIndexedIndirect)
+{
+    VkPipeline pipeline;
+    createPipeline(compileSpirv(passthroughVertexShader), compileSpirv(redFragmentShader),
+                   VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, &pipeline);
+
+    VkBuffer vertexBuffer;
+    createBuffer(halvesVertices, sizeof(halvesVertices), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, &vertexBuffer);
+
+    const uint16_t indices[] = { 0, 1, 2, 3, 4, 5 };
+
+    VkBuffer indexBuffer;
+    createBuffer(indices, sizeof(indices), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, &indexBuffer);
+
+    // The right half reuses the left half's indices, with a vertex offset
+    const VkDrawIndexedIndirectCommand commands[] = {
+        // indexCount, instanceCount, firstIndex, vertexOffset, firstInstance
+        { 6, 1, 0, 0, 0 },
+        { 3, 1, 3, 6, 0 },
+        { 3, 1, 0, 6, 0 },
+    };
+
+    VkBuffer indirectBuffer;
+    createBuffer(commands, sizeof(commands), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, &indirectBuffer);
+
+    VkCommandBuffer commandBuffer;
+    beginCommandBuffer(&commandBuffer);
+    beginRenderPass(commandBuffer);
+
+    VkDeviceSize offset = 0;
+    driver.vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &offset);
+    driver.vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT16);
+    driver.vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    driver.vkCmdDrawIndexedIndirect(commandBuffer, indirectBuffer, 0, 3, sizeof(VkDrawIndexedIndirectCommand));
+
+    driver.vkCmdEndRenderPass(commandBuffer);
+    copyToReadback(commandBuffer, colorImage);
+    submitAndWait(commandBuffer);
+
+    for(uint32_t y = 0; y < height; y++)
+    {
+        for(uint32_t x = 0; x < width; x++)
+        {
+            ASSERT_EQ(getPixel(x, y), 0xFF0000FFu) << "at " << x << ", " << y;
+        }
+    }
+}
+
+// Passes the vec4 at location 0 through to the position, but moves vertices
+// whose index is less than 6 out of the viewport.
+static const char *vertexIndexVertexShader =
+              "OpCapability Shader\n"
+              "OpMemoryModel Logical GLSL450\n"
+              "OpEntryPoint Vertex %1 \"main\" %2 %3 %4\n"
+              "OpDecorate %2 Location 0\n"
+              "OpDecorate %3 BuiltIn Position\n"
+              "OpDecorate %4 BuiltIn VertexIndex\n"
+         "%5 = OpTypeVoid\n"
+         "%6 = OpTypeFunction %5\n"             // void()
+         "%7 = OpTypeFloat 32\n"                // float
+         "%8 = OpTypeVector %7 4\n"             // vec4
+         "%9 = OpTypePointer Input %8\n"        // vec4*
+         "%2 = OpVariable %9 Input\n"           // position in
+        "%10 = OpTypePointer Output %8\n"       // vec4*
+         "%3 = OpVariable %10 Output\n"         // gl_Position
+        "%11 = OpTypeInt 32 1\n"                // int
+        "%12 = OpTypePointer Input %11\n"       // int*
+         "%4 = OpVariable %12 Input\n"          // gl_VertexIndex
+        "%13 = OpTypeBool\n"                    // bool
+        "%14 = OpConstant %11 6\n"              // 6
+        "%15 = OpConstant %7 0\n"               // 0.0
+        "%16 = OpConstant %7 4\n"               // 4.0
+         "%1 = OpFunction %5 None %6\n"         // -- Function begin --
+        "%17 = OpLabel\n"
+        "%18 = OpLoad %8 %2\n"
+        "%19 = OpLoad %11 %4\n"
+        "%20 = OpSLessThan %13 %19 %14\n"       // gl_VertexIndex < 6
+        "%21 = OpSelect %7 %20 %16 %15\n"
+        "%22 = OpCompositeExtract %7 %18 0\n"
+        "%23 = OpFAdd %7 %22 %21\n"
+        "%24 = OpCompositeInsert %8 %23 %18 0\n"
+              "OpStore %3 %24\n"
+              "OpReturn\n"
+              "OpFunctionEnd\n";
+
+TEST_F(SwiftShaderVulkanGraphicsTest, VertexIndexIncludesFirstVertex)
+{
+    VkPipeline pipeline;
+    createPipeline(compileSpirv(vertexIndexVertexShader), compileSpirv(redFragmentShader),
+                   VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, &pipeline);
+
+    VkBuffer vertexBuffer;
+    createBuffer(halvesVertices, sizeof(halvesVertices), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, &vertexBuffer);
+
+    const uint16_t indices[] = { 0, 1, 2, 3, 4, 5 };
+
+    VkBuffer indexBuffer;
+    createBuffer(indices, sizeof(indices), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, &indexBuffer);
+
+    // The right half starts at vertex 6, or at index 0 with a vertex offset of 6
+    const VkDrawIndirectCommand command = { 6, 1, 6, 0 };
+    const VkDrawIndexedIndirectCommand indexedCommand = { 6, 1, 0, 6, 0 };
+
+    VkBuffer indirectBuffer;
+    createBuffer(&command, sizeof(command), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, &indirectBuffer);
+
+    VkBuffer indexedIndirectBuffer;
+    createBuffer(&indexedCommand, sizeof(indexedCommand), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, &indexedIndirectBuffer);
+
+    enum DrawMode { DIRECT, INDEXED, INDIRECT, INDEXED_INDIRECT };
+
+    for(DrawMode mode : { DIRECT, INDEXED, INDIRECT, INDEXED_INDIRECT })
+    {
+        SCOPED_TRACE(mode);
+
+        VkCommandBuffer commandBuffer;
+        beginCommandBuffer(&commandBuffer);
+        beginRenderPass(commandBuffer);
+
+        VkDeviceSize offset = 0;
+        driver.vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &offset);
+        driver.vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT16);
+        driver.vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+
+        switch(mode)
+        {
+        case DIRECT:
+            driver.vkCmdDraw(commandBuffer, 6, 1, 6, 0);
+            break;
+        case INDEXED:
+            driver.vkCmdDrawIndexed(commandBuffer, 6, 1, 0, 6, 0);
+            break;
+        case INDIRECT:
+            driver.vkCmdDrawIndirect(commandBuffer, indirectBuffer, 0, 1, sizeof(VkDrawIndirectCommand));
+            break;
+        case INDEXED_INDIRECT:
+            driver.vkCmdDrawIndexedIndirect(commandBuffer, indexedIndirectBuffer, 0, 1, sizeof(VkDrawIndexedIndirectCommand));
+            break;
+        }
+
+        driver.vkCmdEndRenderPass(commandBuffer);
+        copyToReadback(commandBuffer, colorImage);
+        submitAndWait(commandBuffer);
+
+        for(uint32_t y = 0; y < height; y++)
+        {
+            for(uint32_t x = 0; x < width; x++)
+            {
+                bool right = (x >= width / 2);
+                ASSERT_EQ(getPixel(x, y), right ? 0xFF0000FFu : 0x00000000u) << "at " << x << ", " << y;
+            }
+        }
+    }
+}
+
+// Renders to an image, and copies it after a barrier, before the next render
+// pass clears it. The copy must see all of the first pass, and none of the
+// second.
+TEST_F(SwiftShaderVulkanGraphicsTest, RenderToTextureAcrossBarrier)
+{
+    VkPipeline pipeline;
+    createPipeline(compileSpirv(passthroughVertexShader), compileSpirv(redFragmentShader),
+                   VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, &pipeline);
+
+    VkBuffer vertexBuffer;
+    createBuffer(halvesVertices, sizeof(halvesVertices), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, &vertexBuffer);
+
+    VkCommandBuffer commandBuffer;
+    beginCommandBuffer(&commandBuffer);
+    beginRenderPass(commandBuffer);
+
+    VkDeviceSize offset = 0;
+    driver.vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &offset);
+    driver.vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    driver.vkCmdDraw(commandBuffer, 12, 1, 0, 0);
+    driver.vkCmdEndRenderPass(commandBuffer);
+
+    imageBarrier(commandBuffer, colorImage,
+                 VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                 VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                 VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+    copyToReadback(commandBuffer, colorImage);
+    imageBarrier(commandBuffer, colorImage,
+                 VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_UNDEFINED,
+                 VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+                 VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+
+    beginRenderPass(commandBuffer);
+    driver.vkCmdEndRenderPass(commandBuffer);
+    submitAndWait(commandBuffer);
+
+    for(uint32_t y = 0; y < height; y++)
+    {
+        for(uint32_t x = 0; x < width; x++)
+        {
+            ASSERT_EQ(getPixel(x, y), 0xFF0000FFu) << "at " << x << ", " << y;
+        }
+    }
+}
+
+// Resolves a render pass whose render area only covers the middle of the
+// attachments. The resolve attachment must keep its contents outside of it.
+TEST_F(SwiftShaderVulkanGraphicsTest, ResolveRenderArea)
+{
+    VkImage multisampleImage;
+    createImage(VK_SAMPLE_COUNT_4_BIT, &multisampleImage);
+    VkImageView multisampleView;
+    VK_ASSERT(device.CreateImageView(multisampleImage, colorFormat, &multisampleView));
+
+    VkImage resolveImage;
+    createImage(VK_SAMPLE_COUNT_1_BIT, &resolveImage);
+    VkImageView resolveView;
+    VK_ASSERT(device.CreateImageView(resolveImage, colorFormat, &resolveView));
+
+    VkRenderPass resolvePass;
+    createRenderPass(VK_SAMPLE_COUNT_4_BIT, true, &resolvePass);
+    VkFramebuffer resolveFramebuffer;
+    VK_ASSERT(device.CreateFramebuffer(resolvePass, { multisampleView, resolveView }, width, height,
+                                       &resolveFramebuffer));
+
+    VkPipeline pipeline;
+    createPipeline(compileSpirv(passthroughVertexShader), compileSpirv(redFragmentShader),
+                   VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, &pipeline, resolvePass, VK_SAMPLE_COUNT_4_BIT);
+
+    VkBuffer vertexBuffer;
+    createBuffer(halvesVertices, sizeof(halvesVertices), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, &vertexBuffer);
+
+    VkCommandBuffer commandBuffer;
+    beginCommandBuffer(&commandBuffer);
+
+    imageBarrier(commandBuffer, resolveImage,
+                 VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                 VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0,
+                 VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+
+    const VkClearColorValue green = { { 0.0f, 1.0f, 0.0f, 1.0f } };
+    const VkImageSubresourceRange range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    driver.vkCmdClearColorImage(commandBuffer, resolveImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &green, 1, &range);
+
+    imageBarrier(commandBuffer, resolveImage,
+                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                 VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                 VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+
+    const VkRect2D renderArea = { { 4, 4 }, { 8, 8 } };
+    beginRenderPass(commandBuffer, resolvePass, resolveFramebuffer, renderArea);
+
+    VkDeviceSize offset = 0;
+    driver.vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &offset);
+    driver.vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    driver.vkCmdDraw(commandBuffer, 12, 1, 0, 0);
+
+    driver.vkCmdEndRenderPass(commandBuffer);
+    copyToReadback(commandBuffer, resolveImage);
+    submitAndWait(commandBuffer);
+
+    for(uint32_t y = 0; y < height; y++)
+    {
+        for(uint32_t x = 0; x < width; x++)
+        {
+            bool inside = (x >= 4) && (x < 12) && (y >= 4) && (y < 12);
+            ASSERT_EQ(getPixel(x, y), inside ? 0xFF0000FFu : 0xFF00FF00u) << "at " << x << ", " << y;
+        }
+    }
+}
+
+TEST_F(SwiftShaderVulkanGraphicsTest, SharedEdgesCoverPixelsOnce)
+{
+    VkPipeline pipeline;
+    createPipeline(compileSpirv(passthroughVertexShader), compileSpirv(redFragmentShader),
+                   VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, &pipeline, VK_NULL_HANDLE, VK_SAMPLE_COUNT_1_BIT,
+                   VK_NULL_HANDLE, true);
+
+    // A fan of triangles around the center of pixel (7, 7), whose shared edges pass through
+    // pixel centers horizontally, vertically and diagonally. At scale 1 it covers the target
+    // exactly, and at scale 2 each triangle is clipped to a polygon with more edges.
+    const float ring[][2] = {
+        { 0.0f, 0.0f }, { 7.5f, 0.0f }, { 16.0f, 0.0f }, { 16.0f, 7.5f },
+        { 16.0f, 16.0f }, { 7.5f, 16.0f }, { 0.0f, 16.0f }, { 0.0f, 7.5f },
+    };
+
+    for(float scale : { 1.0f, 2.0f })
+    {
+        SCOPED_TRACE(scale);
+
+        // Converts framebuffer coordinates, scaled away from the fan's center, to clip space
+        auto vertex = [&](const float (&p)[2], std::vector<float> &vertices)
+        {
+            float x = 7.5f + (p[0] - 7.5f) * scale;
+            float y = 7.5f + (p[1] - 7.5f) * scale;
+            vertices.insert(vertices.end(), { x * 2.0f / width - 1.0f, y * 2.0f / height - 1.0f, 0.0f, 1.0f });
+        };
+
+        const float center[2] = { 7.5f, 7.5f };
+        std::vector<float> vertices;
+
+        for(size_t i = 0; i < 8; i++)
+        {
+            vertex(center, vertices);
+            vertex(ring[i], vertices);
+            vertex(ring[(i + 1) % 8], vertices);
+        }
+
+        VkBuffer vertexBuffer;
+        createBuffer(vertices.data(), vertices.size() * sizeof(float), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, &vertexBuffer);
+
+        VkCommandBuffer commandBuffer;
+        beginCommandBuffer(&commandBuffer);
+        beginRenderPass(commandBuffer);
+
+        VkDeviceSize offset = 0;
+        driver.vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &offset);
+        driver.vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+        driver.vkCmdDraw(commandBuffer, 24, 1, 0, 0);
+
+        driver.vkCmdEndRenderPass(commandBuffer);
+        copyToReadback(commandBuffer, colorImage);
+        submitAndWait(commandBuffer);
+
+        // A quarter of opaque red, added once
+        for(uint32_t y = 0; y < height; y++)
+        {
+            for(uint32_t x = 0; x < width; x++)
+            {
+                ASSERT_EQ(getPixel(x, y), 0x40000040u) << "at " << x << ", " << y;
+            }
+        }
+    }
+}
+
+TEST_F(SwiftShaderVulkanGraphicsTest, TopLeftRule)
+{
+    VkPipeline pipeline;
+    createPipeline(compileSpirv(passthroughVertexShader), compileSpirv(redFragmentShader),
+                   VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP, &pipeline, VK_NULL_HANDLE, VK_SAMPLE_COUNT_1_BIT,
+                   VK_NULL_HANDLE, true);
+
+    // A square with its corners at the centers of pixels (2, 2) and (12, 12). The centers on
+    // its top and left edges are covered, and those on its bottom and right edges aren't.
+    auto ndc = [](float p) { return p * 2.0f / width - 1.0f; };
+    const float vertices[][4] = {
+        { ndc(2.5f), ndc(2.5f), 0, 1 }, { ndc(12.5f), ndc(2.5f), 0, 1 },
+        { ndc(2.5f), ndc(12.5f), 0, 1 }, { ndc(12.5f), ndc(12.5f), 0, 1 },
+    };
+
+    VkBuffer vertexBuffer;
+    createBuffer(vertices, sizeof(vertices), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, &vertexBuffer);
+
+    VkCommandBuffer commandBuffer;
+    beginCommandBuffer(&commandBuffer);
+    beginRenderPass(commandBuffer);
+
+    VkDeviceSize offset = 0;
+    driver.vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &offset);
+    driver.vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    driver.vkCmdDraw(commandBuffer, 4, 1, 0, 0);
+
+    driver.vkCmdEndRenderPass(commandBuffer);
+    copyToReadback(commandBuffer, colorImage);
+    submitAndWait(commandBuffer);
+
+    for(uint32_t y = 0; y < height; y++)
+    {
+        for(uint32_t x = 0; x < width; x++)
+        {
+            bool inside = (x >= 2) && (x < 12) && (y >= 2) && (y < 12);
+            ASSERT_EQ(getPixel(x, y), inside ? 0x40000040u : 0x00000000u) << "at " << x << ", " << y;
+        }
+    }
+}
+
+// Passes the vec4 at location 0 through to the position, and writes green
+// to location 1 only.
+static const char *sparseOutputVertexShader =
+              "OpCapability Shader\n"
+              "OpMemoryModel Logical GLSL450\n"
+              "OpEntryPoint Vertex %1 \"main\" %2 %3 %4\n"
+              "OpDecorate %2 Location 0\n"
+              "OpDecorate %3 BuiltIn Position\n"
+              "OpDecorate %4 Location 1\n"
+         "%5 = OpTypeVoid\n"
+         "%6 = OpTypeFunction %5\n"             // void()
+         "%7 = OpTypeFloat 32\n"                // float
+         "%8 = OpTypeVector %7 4\n"             // vec4
+         "%9 = OpTypePointer Input %8\n"        // vec4*
+         "%2 = OpVariable %9 Input\n"           // position in
+        "%10 = OpTypePointer Output %8\n"       // vec4*
+         "%3 = OpVariable %10 Output\n"         // gl_Position
+         "%4 = OpVariable %10 Output\n"         // location 1 out
+        "%11 = OpConstant %7 0\n"               // 0.0
+        "%12 = OpConstant %7 1\n"               // 1.0
+        "%13 = OpConstantComposite %8 %11 %12 %11 %11\n"  // vec4(0, 1, 0, 0)
+         "%1 = OpFunction %5 None %6\n"         // -- Function begin --
+        "%14 = OpLabel\n"
+        "%15 = OpLoad %8 %2\n"
+              "OpStore %3 %15\n"
+              "OpStore %4 %13\n"
+              "OpReturn\n"
+              "OpFunctionEnd\n";
+
+// Outputs opaque red plus the sum of its inputs at locations 0, 1 and 2.
+static const char *sumInputsFragmentShader =
+              "OpCapability Shader\n"
+              "OpMemoryModel Logical GLSL450\n"
+              "OpEntryPoint Fragment %1 \"main\" %2 %3 %4 %5\n"
+              "OpExecutionMode %1 OriginUpperLeft\n"
+              "OpDecorate %2 Location 0\n"
+              "OpDecorate %3 Location 0\n"
+              "OpDecorate %4 Location 1\n"
+              "OpDecorate %5 Location 2\n"
+         "%6 = OpTypeVoid\n"
+         "%7 = OpTypeFunction %6\n"             // void()
+         "%8 = OpTypeFloat 32\n"                // float
+         "%9 = OpTypeVector %8 4\n"             // vec4
+        "%10 = OpTypePointer Output %9\n"       // vec4*
+         "%2 = OpVariable %10 Output\n"         // color out
+        "%11 = OpTypePointer Input %9\n"        // vec4*
+         "%3 = OpVariable %11 Input\n"          // location 0 in
+         "%4 = OpVariable %11 Input\n"          // location 1 in
+         "%5 = OpVariable %11 Input\n"          // location 2 in
+        "%12 = OpConstant %8 0\n"               // 0.0
+        "%13 = OpConstant %8 1\n"               // 1.0
+        "%14 = OpConstantComposite %9 %13 %12 %12 %13\n"  // vec4(1, 0, 0, 1)
+         "%1 = OpFunction %6 None %7\n"         // -- Function begin --
+        "%15 = OpLabel\n"
+        "%16 = OpLoad %9 %3\n"
+        "%17 = OpLoad %9 %4\n"
+        "%18 = OpLoad %9 %5\n"
+        "%19 = OpFAdd %9 %16 %17\n"
+        "%20 = OpFAdd %9 %19 %18\n"
+        "%21 = OpFAdd %9 %20 %14\n"
+              "OpStore %2 %21\n"
+              "OpReturn\n"
+              "OpFunctionEnd\n";
+
+TEST_F(SwiftShaderVulkanGraphicsTest, UnwrittenVertexOutputsReadAsZero)
+{
+    // Vertices only store the vertex shader's outputs up to location 1, so
+    // location 0 isn't written, and location 2 isn't stored at all.
+    VkPipeline pipeline;
+    createPipeline(compileSpirv(sparseOutputVertexShader), compileSpirv(sumInputsFragmentShader),
+                   VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, &pipeline);
+
+    VkBuffer vertexBuffer;
+    createBuffer(halvesVertices, sizeof(halvesVertices), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, &vertexBuffer);
+
+    VkCommandBuffer commandBuffer;
+    beginCommandBuffer(&commandBuffer);
+    beginRenderPass(commandBuffer);
+
+    VkDeviceSize offset = 0;
+    driver.vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &offset);
+    driver.vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    driver.vkCmdDraw(commandBuffer, 12, 1, 0, 0);
+
+    driver.vkCmdEndRenderPass(commandBuffer);
+    copyToReadback(commandBuffer, colorImage);
+    submitAndWait(commandBuffer);
+
+    // Opaque yellow
+    for(uint32_t y = 0; y < height; y++)
+    {
+        for(uint32_t x = 0; x < width; x++)
+        {
+            ASSERT_EQ(getPixel(x, y), 0xFF00FFFFu) << "at " << x << ", " << y;
+        }
+    }
+}
+
+// Presentation tests create an instance with a surface extension, and a device
+// with the swapchain extension.
+class SwiftShaderVulkanPresentTest : public testing::Test
+{
+protected:
+    static constexpr uint32_t width = 16;
+    static constexpr uint32_t height = 16;
+
+    // Creates the instance with VK_KHR_surface and the given platform surface
+    // extension, and a device which can present.
+    void createDevice(const char *surfaceExtension)
+    {
+        ASSERT_TRUE(driver.loadSwiftShader());
+
+        const char *extensions[] = { VK_KHR_SURFACE_EXTENSION_NAME, surfaceExtension };
+
+        const VkInstanceCreateInfo createInfo = {
+            VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,  // sType
+            nullptr,                                 // pNext
+            0,                                       // flags
+            nullptr,                                 // pApplicationInfo
+            0,                                       // enabledLayerCount
+            nullptr,                                 // ppEnabledLayerNames
+            2,                                       // enabledExtensionCount
+            extensions,                              // ppEnabledExtensionNames
+        };
+
+        VK_ASSERT(driver.vkCreateInstance(&createInfo, nullptr, &instance));
+
+        ASSERT_TRUE(driver.resolve(instance));
+
+        VK_ASSERT(Device::CreateComputeDevice(&driver, instance, &device, { VK_KHR_SWAPCHAIN_EXTENSION_NAME }));
+        ASSERT_TRUE(device.IsValid());
+    }
+
+    void TearDown() override
+    {
+        if(device.IsValid())
+        {
+            device.Destroy();
+        }
+
+        if(instance != VK_NULL_HANDLE)
+        {
+            driver.vkDestroyInstance(instance, nullptr);
+        }
+    }
+
+    // Creates a surface which doesn't present to a window.
+    void createHeadlessSurface(VkSurfaceKHR *out)
+    {
+        const VkHeadlessSurfaceCreateInfoEXT info = {
+            VK_STRUCTURE_TYPE_HEADLESS_SURFACE_CREATE_INFO_EXT,  // sType
+            nullptr,                                             // pNext
+            0,                                                   // flags
+        };
+
+        VK_ASSERT(driver.vkCreateHeadlessSurfaceEXT(instance, &info, nullptr, out));
+    }
+
+    // Creates a swapchain for surface, and clears and presents each of its
+    // images in turn, checking the result of every presentation.
+    void presentImages(VkSurfaceKHR surface)
+    {
+        VkSurfaceCapabilitiesKHR capabilities;
+        VK_ASSERT(device.GetSurfaceCapabilities(surface, &capabilities));
+
+        std::vector<VkSurfaceFormatKHR> formats;
+        VK_ASSERT(device.GetSurfaceFormats(surface, &formats));
+        ASSERT_FALSE(formats.empty());
+
+        // An extent of 0xFFFFFFFF means the swapchain determines the size
+        VkExtent2D extent = capabilities.currentExtent;
+        if(extent.width == 0xFFFFFFFF)
+        {
+            extent = { width, height };
+        }
+
+        const uint32_t imageCount = 2;
+
+        VkSwapchainKHR swapchain;
+        VK_ASSERT(device.CreateSwapchain(surface, imageCount, formats[0], extent, VK_NULL_HANDLE, &swapchain));
+
+        std::vector<VkImage> images;
+        VK_ASSERT(device.GetSwapchainImages(swapchain, &images));
+        ASSERT_GE(images.size(), imageCount);
+
+        VkCommandPool commandPool;
+        VK_ASSERT(device.CreateCommandPool(&commandPool));
+
+        for(size_t i = 0; i < images.size(); i++)
+        {
+            VkFence fence;
+            VK_ASSERT(device.CreateFence(false, &fence));
+
+            uint32_t imageIndex = static_cast<uint32_t>(images.size());
+            VK_ASSERT(device.AcquireNextImage(swapchain, fence, &imageIndex));
+            ASSERT_LT(imageIndex, images.size());
+            VK_ASSERT(device.WaitForFences({ fence }, true, UINT64_MAX));
+            device.DestroyFence(fence);
+
+            VkCommandBuffer commandBuffer;
+            VK_ASSERT(device.AllocateCommandBuffer(commandPool, &commandBuffer));
+            VK_ASSERT(device.BeginCommandBuffer(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, commandBuffer));
+
+            const VkImageSubresourceRange range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+            VkImageMemoryBarrier barrier = {
+                VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,  // sType
+                nullptr,                                 // pNext
+                0,                                       // srcAccessMask
+                VK_ACCESS_TRANSFER_WRITE_BIT,            // dstAccessMask
+                VK_IMAGE_LAYOUT_UNDEFINED,               // oldLayout
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,    // newLayout
+                VK_QUEUE_FAMILY_IGNORED,                 // srcQueueFamilyIndex
+                VK_QUEUE_FAMILY_IGNORED,                 // dstQueueFamilyIndex
+                images[imageIndex],                      // image
+                range,                                   // subresourceRange
+            };
+            driver.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                                        VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+            const VkClearColorValue color = { { 1.0f, 0.0f, 0.0f, 1.0f } };
+            driver.vkCmdClearColorImage(commandBuffer, images[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                        &color, 1, &range);
+
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = 0;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+            driver.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+            VK_ASSERT(driver.vkEndCommandBuffer(commandBuffer));
+            VK_ASSERT(device.QueueSubmitAndWait(commandBuffer));
+
+            VkResult result = VK_RESULT_MAX_ENUM;
+            VK_ASSERT(device.QueuePresent(swapchain, imageIndex, &result));
+            VK_ASSERT(result);
+        }
+
+        device.DestroySwapchain(swapchain);
+    }
+
+    Driver driver;
+    VkInstance instance = VK_NULL_HANDLE;
+    Device device;
+};
+
+TEST_F(SwiftShaderVulkanPresentTest, Headless)
+{
+    createDevice(VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME);
+    ASSERT_FALSE(HasFatalFailure());
+
+    VkSurfaceKHR surface;
+    createHeadlessSurface(&surface);
+    ASSERT_FALSE(HasFatalFailure());
+
+    presentImages(surface);
+
+    driver.vkDestroySurfaceKHR(instance, surface, nullptr);
+}
+
+// Presenting an image of a swapchain which got retired by a newer one is
+// rejected, which is reported both for that swapchain and by the call.
+TEST_F(SwiftShaderVulkanPresentTest, RetiredSwapchain)
+{
+    createDevice(VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME);
+    ASSERT_FALSE(HasFatalFailure());
+
+    VkSurfaceKHR surface;
+    createHeadlessSurface(&surface);
+    ASSERT_FALSE(HasFatalFailure());
+
+    std::vector<VkSurfaceFormatKHR> formats;
+    VK_ASSERT(device.GetSurfaceFormats(surface, &formats));
+    ASSERT_FALSE(formats.empty());
+
+    VkSwapchainKHR oldSwapchain;
+    VK_ASSERT(device.CreateSwapchain(surface, 2, formats[0], { width, height }, VK_NULL_HANDLE, &oldSwapchain));
+
+    VkFence fence;
+    VK_ASSERT(device.CreateFence(false, &fence));
+
+    uint32_t imageIndex = 0;
+    VK_ASSERT(device.AcquireNextImage(oldSwapchain, fence, &imageIndex));
+    VK_ASSERT(device.WaitForFences({ fence }, true, UINT64_MAX));
+    device.DestroyFence(fence);
+
+    VkSwapchainKHR swapchain;
+    VK_ASSERT(device.CreateSwapchain(surface, 2, formats[0], { width, height }, oldSwapchain, &swapchain));
+
+    VkResult result = VK_SUCCESS;
+    EXPECT_EQ(device.QueuePresent(oldSwapchain, imageIndex, &result), VK_ERROR_OUT_OF_DATE_KHR);
+    EXPECT_EQ(result, VK_ERROR_OUT_OF_DATE_KHR);
+
+    device.DestroySwapchain(oldSwapchain);
+    device.DestroySwapchain(swapchain);
+    driver.vkDestroySurfaceKHR(instance, surface, nullptr);
+}
+
+#if defined(__linux__)
+// Presents to an X11 window. libX11 is loaded at run time, like the driver
+// does, and the test is skipped when it or a display isn't available.
+TEST_F(SwiftShaderVulkanPresentTest, Xlib)
+{
+    void *libX11 = dlopen("libX11.so.6", RTLD_LAZY);
+    if(!libX11)
+    {
+        GTEST_SKIP() << "libX11 is not available";
+    }
+
+    auto openDisplay = reinterpret_cast<decltype(&XOpenDisplay)>(dlsym(libX11, "XOpenDisplay"));
+    auto closeDisplay = reinterpret_cast<decltype(&XCloseDisplay)>(dlsym(libX11, "XCloseDisplay"));
+    auto defaultScreen = reinterpret_cast<decltype(&XDefaultScreen)>(dlsym(libX11, "XDefaultScreen"));
+    auto rootWindow = reinterpret_cast<decltype(&XRootWindow)>(dlsym(libX11, "XRootWindow"));
+    auto createSimpleWindow = reinterpret_cast<decltype(&XCreateSimpleWindow)>(dlsym(libX11, "XCreateSimpleWindow"));
+    auto destroyWindow = reinterpret_cast<decltype(&XDestroyWindow)>(dlsym(libX11, "XDestroyWindow"));
+    ASSERT_TRUE(openDisplay && closeDisplay && defaultScreen && rootWindow && createSimpleWindow && destroyWindow);
+
+    Display *display = openDisplay(nullptr);
+    if(!display)
+    {
+        dlclose(libX11);
+        GTEST_SKIP() << "No X display is available";
+    }
+
+    Window window = createSimpleWindow(display, rootWindow(display, defaultScreen(display)),
+                                       0, 0, width, height, 0, 0, 0);
+
+    createDevice(VK_KHR_XLIB_SURFACE_EXTENSION_NAME);
+
+    if(!HasFatalFailure())
+    {
+        // The platform entry point isn't part of the common function list
+        auto createXlibSurface = reinterpret_cast<PFN_vkCreateXlibSurfaceKHR>(
+            driver.vk_icdGetInstanceProcAddr(instance, "vkCreateXlibSurfaceKHR"));
+        EXPECT_NE(createXlibSurface, nullptr);
+
+        const VkXlibSurfaceCreateInfoKHR info = {
+            VK_STRUCTURE_TYPE_XLIB_SURFACE_CREATE_INFO_KHR,  // sType
+            nullptr,                                         // pNext
+            0,                                               // flags
+            display,                                         // dpy
+            window,                                          // window
+        };
+
+        VkSurfaceKHR surface = VK_NULL_HANDLE;
+        if(createXlibSurface)
+        {
+            EXPECT_EQ(createXlibSurface(instance, &info, nullptr, &surface), VK_SUCCESS);
+        }
+
+        if(surface != VK_NULL_HANDLE)
+        {
+            presentImages(surface);
+            driver.vkDestroySurfaceKHR(instance, surface, nullptr);
+        }
+    }
+
+    destroyWindow(display, window);
+    closeDisplay(display);
+    dlclose(libX11);
+}
+#endif